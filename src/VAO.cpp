@@ -1,11 +1,11 @@
 #include "VAO.h"
-#include <GLFW/glfw3.h>
+#include "glState.h"
 
 
 
 VertexArrayObject::VertexArrayObject() : renderID(0) {
-    // Check if OpenGL context is current
-    if (!glfwGetCurrentContext()) {
+    // Check that a context was created and GL loaded, whichever window system made it
+    if (!GLAD_GL_VERSION_3_3) {
         std::cerr << "Error: No OpenGL context current when creating VAO!" << std::endl;
         return;
     }
@@ -20,6 +20,7 @@ VertexArrayObject::VertexArrayObject() : renderID(0) {
 
 VertexArrayObject::~VertexArrayObject() {
     if (renderID != 0) {
+        getGLState().vertexArrayDeleted(renderID);
         glDeleteVertexArrays(1, &renderID);
         checkGLError("glDeleteVertexArrays");
     }
@@ -30,13 +31,11 @@ void VertexArrayObject::bind() const {
         std::cerr << "Warning: Attempting to bind VAO with ID 0!" << std::endl;
         return;
     }
-    glBindVertexArray(renderID);
-    checkGLError("glBindVertexArray");
+    getGLState().bindVertexArray(renderID);
 }
 
 void VertexArrayObject::unbind() const {
-    glBindVertexArray(0);
-    checkGLError("glUnbindVertexArray(0)");
+    getGLState().bindVertexArray(0);
 }
 
 void VertexArrayObject::linkAttrib(VertexBufferObject& VBO, GLuint layout, GLuint numComponents, GLenum type, GLsizeiptr stride, void* offset) {
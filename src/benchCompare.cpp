@@ -0,0 +1,82 @@
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <string>
+#include "benchmark.h"
+#include "log.h"
+
+// Compares a benchmark report against a saved baseline and exits non-zero on regressions:
+//   benchCompare baseline.json current.json [--threshold=5] [--min-delta-ms=0.05]
+// A timing metric regresses when it is both threshold percent and min-delta-ms slower;
+// draw call, triangle and render target memory figures regress on any growth beyond the
+// threshold.
+
+namespace {
+
+bool isTiming(const std::string& metric) {
+    return metric.rfind("drawCalls.", 0) != 0 && metric.rfind("triangles.", 0) != 0 &&
+           metric.rfind("memory.", 0) != 0;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    std::string baselinePath;
+    std::string currentPath;
+    double thresholdPercent = 5.0;
+    double minDeltaMs = 0.05;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg.rfind("--threshold=", 0) == 0) {
+            thresholdPercent = std::atof(arg.substr(12).c_str());
+        } else if (arg.rfind("--min-delta-ms=", 0) == 0) {
+            minDeltaMs = std::atof(arg.substr(15).c_str());
+        } else if (baselinePath.empty()) {
+            baselinePath = arg;
+        } else {
+            currentPath = arg;
+        }
+    }
+    if (baselinePath.empty() || currentPath.empty()) {
+        std::fprintf(stderr, "usage: benchCompare baseline.json current.json [--threshold=5] [--min-delta-ms=0.05]\n");
+        return 2;
+    }
+
+    std::map<std::string, double> baseline;
+    std::map<std::string, double> current;
+    if (!readBenchmarkMetrics(baselinePath, baseline) || !readBenchmarkMetrics(currentPath, current)) {
+        Log::flush();
+        return 2;
+    }
+
+    int regressions = 0;
+    int improvements = 0;
+    std::printf("%-32s %12s %12s %9s\n", "metric", "baseline", "current", "change");
+    for (const auto& entry : baseline) {
+        auto found = current.find(entry.first);
+        if (found == current.end()) {
+            std::printf("%-32s %12.4f %12s %9s\n", entry.first.c_str(), entry.second, "-", "missing");
+            continue;
+        }
+        double before = entry.second;
+        double after = found->second;
+        double delta = after - before;
+        double percent = before != 0.0 ? delta / before * 100.0 : (delta != 0.0 ? 100.0 : 0.0);
+        bool significant = percent > thresholdPercent && (!isTiming(entry.first) || delta > minDeltaMs);
+        bool better = -percent > thresholdPercent && (!isTiming(entry.first) || -delta > minDeltaMs);
+        const char* flag = significant ? "  REGRESSION" : (better ? "  improved" : "");
+        std::printf("%-32s %12.4f %12.4f %+8.1f%%%s\n", entry.first.c_str(), before, after, percent, flag);
+        regressions += significant ? 1 : 0;
+        improvements += better ? 1 : 0;
+    }
+    for (const auto& entry : current) {
+        if (baseline.find(entry.first) == baseline.end()) {
+            std::printf("%-32s %12s %12.4f %9s\n", entry.first.c_str(), "-", entry.second, "new");
+        }
+    }
+
+    std::printf("%d regressions, %d improvements (threshold %.1f%%, %.3f ms)\n", regressions, improvements,
+                thresholdPercent, minDeltaMs);
+    Log::flush();
+    return regressions > 0 ? 1 : 0;
+}
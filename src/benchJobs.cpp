@@ -0,0 +1,168 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include "frustum.h"
+#include "jobSystem.h"
+#include "log.h"
+
+// Measures how the job system scales from one thread to many:
+//   benchJobs [--max-threads=N] [--repeat=5]
+// Each thread count gets its own JobSystem with one worker fewer (the main thread makes
+// up the rest by helping in wait()) and runs three workloads:
+//   cull    parallelFor over a million boxes against a frustum, like a draw list view
+//   tree    a job tree four children wide, spawned from inside its own jobs, tiny leaves
+//   decode  64 independent jobs of about a millisecond, like loading images
+// Times are the median of the repeats; speedup is against one thread.
+
+namespace {
+
+const size_t CULL_BOXES = 1 << 20;
+const int TREE_DEPTH = 7;
+const int DECODE_JOBS = 64;
+
+double millisecondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Stand-in for real work, seeded at run time so it can't be folded away
+uint32_t spin(uint32_t seed, int iterations) {
+    for (int i = 0; i < iterations; ++i) {
+        seed = seed * 1664525u + 1013904223u;
+        seed ^= seed >> 13;
+    }
+    return seed;
+}
+
+struct CullScene {
+    std::vector<glm::vec3> boxMin;
+    std::vector<glm::vec3> boxMax;
+    Frustum frustum;
+};
+
+CullScene makeCullScene() {
+    CullScene scene;
+    scene.boxMin.reserve(CULL_BOXES);
+    scene.boxMax.reserve(CULL_BOXES);
+    uint32_t seed = 1;
+    for (size_t i = 0; i < CULL_BOXES; ++i) {
+        glm::vec3 center;
+        for (int axis = 0; axis < 3; ++axis) {
+            seed = spin(seed, 1);
+            center[axis] = (seed % 20000) / 100.0f - 100.0f;
+        }
+        scene.boxMin.push_back(center - glm::vec3(0.5f));
+        scene.boxMax.push_back(center + glm::vec3(0.5f));
+    }
+    glm::mat4 projection = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 150.0f);
+    glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 10.0f, 0.0f), glm::vec3(30.0f, 0.0f, 40.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    scene.frustum = Frustum(projection * view);
+    return scene;
+}
+
+uint32_t runCull(JobSystem& jobs, const CullScene& scene) {
+    std::atomic<uint32_t> visible(0);
+    jobs.parallelFor(scene.boxMin.size(), 0, [&](size_t begin, size_t end) {
+        uint32_t count = 0;
+        for (size_t i = begin; i < end; ++i) {
+            count += scene.frustum.intersectsAABB(scene.boxMin[i], scene.boxMax[i]) ? 1 : 0;
+        }
+        visible.fetch_add(count, std::memory_order_relaxed);
+    });
+    return visible.load();
+}
+
+void spawnTree(JobSystem& jobs, int depth, std::atomic<uint32_t>& sink) {
+    if (depth == 0) {
+        sink.fetch_xor(spin(sink.load(std::memory_order_relaxed) + 1, 2000), std::memory_order_relaxed);
+        return;
+    }
+    JobHandle self = JobSystem::getCurrentJob();
+    for (int child = 0; child < 4; ++child) {
+        jobs.run([&jobs, &sink, depth] { spawnTree(jobs, depth - 1, sink); }, self);
+    }
+}
+
+uint32_t runTree(JobSystem& jobs) {
+    std::atomic<uint32_t> sink(0);
+    JobHandle root = jobs.run([&jobs, &sink] { spawnTree(jobs, TREE_DEPTH, sink); });
+    jobs.wait(root);
+    return sink.load();
+}
+
+uint32_t runDecode(JobSystem& jobs) {
+    std::atomic<uint32_t> sink(0);
+    JobHandle batch = jobs.create(nullptr);
+    for (int i = 0; i < DECODE_JOBS; ++i) {
+        jobs.submit(jobs.create([&sink, i] {
+            sink.fetch_xor(spin(static_cast<uint32_t>(i) + sink.load(std::memory_order_relaxed), 400000),
+                           std::memory_order_relaxed);
+        }, batch));
+    }
+    jobs.submit(batch);
+    jobs.wait(batch);
+    return sink.load();
+}
+
+template <typename Workload>
+double medianMs(int repeat, uint32_t& checksum, Workload workload) {
+    std::vector<double> times;
+    for (int i = 0; i < repeat; ++i) {
+        auto start = std::chrono::steady_clock::now();
+        checksum ^= workload();
+        times.push_back(millisecondsSince(start));
+    }
+    std::sort(times.begin(), times.end());
+    return times[times.size() / 2];
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    int maxThreads = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+    int repeat = 5;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg.rfind("--max-threads=", 0) == 0) {
+            maxThreads = std::atoi(arg.substr(14).c_str());
+        } else if (arg.rfind("--repeat=", 0) == 0) {
+            repeat = std::atoi(arg.substr(9).c_str());
+        } else {
+            std::fprintf(stderr, "usage: benchJobs [--max-threads=N] [--repeat=5]\n");
+            return 2;
+        }
+    }
+    maxThreads = std::max(1, std::min(maxThreads, static_cast<int>(JobSystem::MAX_WORKERS) + 1));
+    repeat = std::max(1, repeat);
+
+    CullScene scene = makeCullScene();
+    std::printf("%7s %10s %7s %10s %7s %10s %7s %9s %9s\n", "threads", "cull ms", "x", "tree ms", "x", "decode ms", "x",
+                "stolen", "helped");
+    double baseline[3] = {};
+    uint32_t checksum = 0;
+    for (int threads = 1; threads <= maxThreads; ++threads) {
+        JobSystem jobs(threads - 1);
+        double ms[3];
+        ms[0] = medianMs(repeat, checksum, [&] { return runCull(jobs, scene); });
+        ms[1] = medianMs(repeat, checksum, [&] { return runTree(jobs); });
+        ms[2] = medianMs(repeat, checksum, [&] { return runDecode(jobs); });
+        if (threads == 1) {
+            std::copy(ms, ms + 3, baseline);
+        }
+        JobSystemStats stats = jobs.getStats();
+        std::printf("%7d %10.3f %6.2fx %10.3f %6.2fx %10.3f %6.2fx %9llu %9llu\n", threads, ms[0], baseline[0] / ms[0],
+                    ms[1], baseline[1] / ms[1], ms[2], baseline[2] / ms[2],
+                    static_cast<unsigned long long>(stats.jobsStolen), static_cast<unsigned long long>(stats.jobsHelped));
+    }
+    // Printed so the work can't be optimized out
+    std::printf("checksum %08x\n", checksum);
+    Log::flush();
+    return 0;
+}
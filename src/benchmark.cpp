@@ -0,0 +1,133 @@
+#include "benchmark.h"
+#include "log.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+namespace {
+
+// Nearest-rank percentile of an ascending list
+double percentile(const std::vector<double>& sorted, double p) {
+    if (sorted.empty()) return 0.0;
+    size_t rank = static_cast<size_t>(std::ceil(p * sorted.size()));
+    return sorted[std::min(sorted.size(), std::max<size_t>(rank, 1)) - 1];
+}
+
+std::string escapeJSON(const std::string& text) {
+    std::string escaped;
+    for (char c : text) {
+        if (c == '"' || c == '\\') escaped += '\\';
+        escaped += c;
+    }
+    return escaped;
+}
+
+void addSummary(std::vector<std::pair<std::string, double>>& metrics, const std::string& name, const SampleSummary& summary) {
+    metrics.emplace_back(name + ".avg", summary.average);
+    metrics.emplace_back(name + ".p50", summary.p50);
+    metrics.emplace_back(name + ".p95", summary.p95);
+    metrics.emplace_back(name + ".p99", summary.p99);
+    metrics.emplace_back(name + ".max", summary.max);
+}
+
+} // namespace
+
+SampleSummary summarizeSamples(std::vector<double> samples) {
+    SampleSummary summary;
+    summary.samples = samples.size();
+    if (samples.empty()) return summary;
+    std::sort(samples.begin(), samples.end());
+    double sum = 0.0;
+    for (double sample : samples) sum += sample;
+    summary.average = sum / samples.size();
+    summary.p50 = percentile(samples, 0.50);
+    summary.p95 = percentile(samples, 0.95);
+    summary.p99 = percentile(samples, 0.99);
+    summary.max = samples.back();
+    return summary;
+}
+
+bool writeBenchmarkJSON(const std::string& path, const BenchmarkReport& report) {
+    std::ofstream out(path);
+    if (!out) {
+        LOG_ERROR(Render, "Could not write benchmark report to %s", path.c_str());
+        return false;
+    }
+
+    std::vector<std::pair<std::string, double>> metrics;
+    addSummary(metrics, "cpuFrameMs", report.cpuFrameMs);
+    addSummary(metrics, "cpuSubmitMs", report.cpuSubmitMs);
+    addSummary(metrics, "gpuFrameMs", report.gpuFrameMs);
+    metrics.emplace_back("drawCalls.avg", report.drawCalls.average);
+    metrics.emplace_back("drawCalls.max", report.drawCalls.max);
+    metrics.emplace_back("triangles.avg", report.triangles.average);
+    metrics.emplace_back("triangles.max", report.triangles.max);
+    metrics.emplace_back("memory.renderTargetMB", report.renderTargetBytes / (1024.0 * 1024.0));
+    for (const GpuPassStats& pass : report.gpuPasses) {
+        metrics.emplace_back("gpuPass." + pass.name + ".avg", pass.averageMs);
+        metrics.emplace_back("gpuPass." + pass.name + ".p95", pass.p95Ms);
+    }
+
+    out << std::fixed << std::setprecision(4);
+    out << "{\n";
+    out << "  \"scene\": \"" << escapeJSON(report.scene) << "\",\n";
+    out << "  \"cameraPath\": \"" << escapeJSON(report.cameraPath) << "\",\n";
+    out << "  \"renderer\": \"" << escapeJSON(report.renderer) << "\",\n";
+    out << "  \"width\": " << report.width << ",\n  \"height\": " << report.height << ",\n";
+    out << "  \"samples\": " << report.samples << ",\n";
+    out << "  \"antiAliasing\": \"" << escapeJSON(report.antiAliasing) << "\",\n";
+    out << "  \"frames\": " << report.frames << ",\n  \"warmupFrames\": " << report.warmupFrames << ",\n";
+    out << "  \"gpuFrames\": " << report.gpuFrameMs.samples << ",\n";
+    out << "  \"gpuDroppedFrames\": " << report.gpuDroppedFrames << ",\n";
+    out << "  \"metrics\": {\n";
+    for (size_t i = 0; i < metrics.size(); ++i) {
+        out << "    \"" << escapeJSON(metrics[i].first) << "\": " << metrics[i].second
+            << (i + 1 < metrics.size() ? ",\n" : "\n");
+    }
+    out << "  }\n}\n";
+    LOG_INFO(Render, "Benchmark report written to %s", path.c_str());
+    return true;
+}
+
+bool readBenchmarkMetrics(const std::string& path, std::map<std::string, double>& metrics) {
+    std::ifstream in(path);
+    if (!in) {
+        LOG_ERROR(Render, "Could not open benchmark report %s", path.c_str());
+        return false;
+    }
+    std::stringstream buffer;
+    buffer << in.rdbuf();
+    const std::string text = buffer.str();
+
+    // Only the flat object writeBenchmarkJSON produces is understood: "name": number pairs
+    size_t start = text.find("\"metrics\"");
+    start = start == std::string::npos ? std::string::npos : text.find('{', start);
+    size_t end = start == std::string::npos ? std::string::npos : text.find('}', start);
+    if (end == std::string::npos) {
+        LOG_ERROR(Render, "%s has no metrics object", path.c_str());
+        return false;
+    }
+
+    metrics.clear();
+    size_t position = start + 1;
+    while (true) {
+        size_t nameBegin = text.find('"', position);
+        if (nameBegin == std::string::npos || nameBegin > end) break;
+        std::string name;
+        size_t i = nameBegin + 1;
+        for (; i < end && text[i] != '"'; ++i) {
+            if (text[i] == '\\' && i + 1 < end) ++i;
+            name += text[i];
+        }
+        size_t colon = text.find(':', i);
+        if (colon == std::string::npos || colon > end) break;
+        char* parsedEnd = nullptr;
+        double value = std::strtod(text.c_str() + colon + 1, &parsedEnd);
+        metrics[name] = value;
+        position = static_cast<size_t>(parsedEnd - text.c_str());
+    }
+    return true;
+}
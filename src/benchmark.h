@@ -0,0 +1,49 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+#include "gpuProfiler.h"
+
+struct SampleSummary {
+    size_t samples = 0;
+    double average = 0.0;
+    double p50 = 0.0;
+    double p95 = 0.0;
+    double p99 = 0.0;
+    double max = 0.0;
+};
+
+SampleSummary summarizeSamples(std::vector<double> samples);
+
+// One run of the headless flythrough benchmark
+struct BenchmarkReport {
+    std::string scene;
+    std::string cameraPath;
+    std::string renderer;
+    unsigned int width = 0;
+    unsigned int height = 0;
+    int samples = 1;
+    std::string antiAliasing;
+    int frames = 0;
+    int warmupFrames = 0;
+
+    SampleSummary cpuFrameMs;  // interval between frame starts
+    SampleSummary cpuSubmitMs; // CPU time spent issuing the frame
+    SampleSummary gpuFrameMs;
+    SampleSummary drawCalls;   // main pass
+    SampleSummary triangles;
+    int gpuDroppedFrames = 0;
+    std::vector<GpuPassStats> gpuPasses;
+    // Scene render targets and TAA history
+    size_t renderTargetBytes = 0;
+};
+
+// Run settings plus a flat "metrics" object ("gpuFrameMs.p95", "gpuPass.Skybox.avg", ...)
+// that benchCompare reads back
+bool writeBenchmarkJSON(const std::string& path, const BenchmarkReport& report);
+bool readBenchmarkMetrics(const std::string& path, std::map<std::string, double>& metrics);
+
+#endif // BENCHMARK_H
@@ -29,6 +29,18 @@ glm::mat4 Camera::setProjectionMatrix(float aspectRatio) {
     return projectionMatrix;
 }
 
+void Camera::setPose(glm::vec3 position, float yaw, float pitch) {
+    this->position = position;
+    this->yaw = yaw;
+    this->pitch = pitch;
+    updateCameraVectors();
+}
+
+void Camera::setViewportSize(unsigned int width, unsigned int height) {
+    this->width = width;
+    this->height = height > 0 ? height : 1;
+}
+
 void Camera::ProcessKeyboard(Camera_Movement direction, float deltaTime) {
     float velocity = movementSpeed * deltaTime;
     if (direction == FORWARD) {
@@ -93,5 +105,22 @@ glm::mat4 Camera::getViewMatrix() const {
 }
 
 glm::mat4 Camera::getProjectionMatrix() const {
+    glm::mat4 projection = getUnjitteredProjectionMatrix();
+    // The third column scales with view z and w = -z, so this moves NDC by exactly +jitter
+    projection[2][0] -= jitter.x;
+    projection[2][1] -= jitter.y;
+    return projection;
+}
+
+glm::mat4 Camera::getUnjitteredProjectionMatrix() const {
     return glm::perspective(glm::radians(zoom), static_cast<float>(width) / static_cast<float>(height), nearPlane, farPlane);
+}
+
+glm::mat4 Camera::getPreviousViewProjection() const {
+    return hasPreviousFrame ? previousViewProjection : getUnjitteredProjectionMatrix() * getViewMatrix();
+}
+
+void Camera::endFrame() {
+    previousViewProjection = getUnjitteredProjectionMatrix() * getViewMatrix();
+    hasPreviousFrame = true;
 }
\ No newline at end of file
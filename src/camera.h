@@ -28,10 +28,32 @@ public:
 	glm::mat4 setModelMatrix() { return glm::mat4(1.0f); }
 
 	glm::mat4 getViewMatrix() const;
+	// Includes the subpixel jitter; rasterization uses this one
 	glm::mat4 getProjectionMatrix() const;
+	glm::mat4 getUnjitteredProjectionMatrix() const;
 	glm::mat4 getModelMatrix() const { return modelMatrix; }
 	glm::vec3 getFront() const { return front; }
 	glm::vec3 getPosition() const { return position; }
+	float getYaw() const { return yaw; }
+	float getPitch() const { return pitch; }
+	float getNearPlane() const { return nearPlane; }
+	float getFarPlane() const { return farPlane; }
+	// Vertical field of view in degrees
+	float getFov() const { return zoom; }
+	float getAspectRatio() const { return static_cast<float>(width) / static_cast<float>(height); }
+
+	// Places the camera directly (scripted and headless runs)
+	void setPose(glm::vec3 position, float yaw, float pitch);
+	// Render target size, for the projection's aspect ratio
+	void setViewportSize(unsigned int width, unsigned int height);
+
+	// Subpixel offset for temporal anti-aliasing, in NDC units (2 / render size is one pixel)
+	void setJitter(glm::vec2 ndcOffset) { jitter = ndcOffset; }
+	glm::vec2 getJitter() const { return jitter; }
+	// Unjittered view-projection of the last finished frame, for motion vectors. Until
+	// the first endFrame() it is the current one, so nothing appears to move.
+	glm::mat4 getPreviousViewProjection() const;
+	void endFrame();
 
 	void ProcessKeyboard(Camera_Movement direction, float deltaTime);
 	void ProcessMouseMovement(float xoffset, float yoffset, bool constrainPitch = true);
@@ -56,6 +78,9 @@ private:
 	float nearPlane;
 	unsigned int width;
 	unsigned int height;
+	glm::vec2 jitter = glm::vec2(0.0f);
+	glm::mat4 previousViewProjection = glm::mat4(1.0f);
+	bool hasPreviousFrame = false;
 };
 
 #endif
\ No newline at end of file
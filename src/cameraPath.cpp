@@ -0,0 +1,110 @@
+#include "cameraPath.h"
+#include "log.h"
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+namespace {
+
+glm::vec3 catmullRom(const glm::vec3& p0, const glm::vec3& p1, const glm::vec3& p2, const glm::vec3& p3, float t) {
+    float t2 = t * t;
+    float t3 = t2 * t;
+    return 0.5f * ((2.0f * p1) + (-p0 + p2) * t + (2.0f * p0 - 5.0f * p1 + 4.0f * p2 - p3) * t2 +
+                   (-p0 + 3.0f * p1 - 3.0f * p2 + p3) * t3);
+}
+
+} // namespace
+
+bool CameraPath::load(const std::string& path) {
+    std::ifstream in(path);
+    if (!in) {
+        LOG_ERROR(Scene, "Could not open camera path %s", path.c_str());
+        return false;
+    }
+
+    keyframes.clear();
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(in, line)) {
+        lineNumber++;
+        size_t comment = line.find('#');
+        if (comment != std::string::npos) {
+            line.erase(comment);
+        }
+        if (line.find_first_not_of(" \t\r") == std::string::npos) continue;
+
+        std::istringstream fields(line);
+        CameraKeyframe keyframe;
+        if (!(fields >> keyframe.time >> keyframe.position.x >> keyframe.position.y >> keyframe.position.z
+                     >> keyframe.yaw >> keyframe.pitch)) {
+            LOG_ERROR(Scene, "%s:%d: expected \"time x y z yaw pitch\"", path.c_str(), lineNumber);
+            keyframes.clear();
+            return false;
+        }
+        if (!keyframes.empty() && keyframe.time < keyframes.back().time) {
+            LOG_ERROR(Scene, "%s:%d: keyframe times must increase", path.c_str(), lineNumber);
+            keyframes.clear();
+            return false;
+        }
+        keyframes.push_back(keyframe);
+    }
+
+    if (keyframes.empty()) {
+        LOG_ERROR(Scene, "Camera path %s has no keyframes", path.c_str());
+        return false;
+    }
+    LOG_INFO(Scene, "Camera path %s: %zu keyframes over %.2f s", path.c_str(), keyframes.size(), getDuration());
+    return true;
+}
+
+bool CameraPath::save(const std::string& path) const {
+    std::ofstream out(path);
+    if (!out) {
+        LOG_ERROR(Scene, "Could not write camera path %s", path.c_str());
+        return false;
+    }
+    out.precision(7);
+    out << "# time x y z yaw pitch\n";
+    for (const CameraKeyframe& keyframe : keyframes) {
+        out << keyframe.time << ' ' << keyframe.position.x << ' ' << keyframe.position.y << ' ' << keyframe.position.z
+            << ' ' << keyframe.yaw << ' ' << keyframe.pitch << '\n';
+    }
+    LOG_INFO(Scene, "Camera path with %zu keyframes written to %s", keyframes.size(), path.c_str());
+    return true;
+}
+
+void CameraPath::addKeyframe(const CameraKeyframe& keyframe) {
+    CameraKeyframe added = keyframe;
+    if (!keyframes.empty()) {
+        added.time = std::max(added.time, keyframes.back().time);
+    }
+    keyframes.push_back(added);
+}
+
+CameraKeyframe CameraPath::sample(float time) const {
+    if (keyframes.empty()) {
+        return CameraKeyframe{0.0f, glm::vec3(0.0f), -90.0f, 0.0f};
+    }
+    if (time <= keyframes.front().time) return keyframes.front();
+    if (time >= keyframes.back().time) return keyframes.back();
+
+    // First keyframe after time; the segment runs from the one before it
+    auto next = std::upper_bound(keyframes.begin(), keyframes.end(), time,
+                                 [](float t, const CameraKeyframe& keyframe) { return t < keyframe.time; });
+    size_t i2 = static_cast<size_t>(next - keyframes.begin());
+    size_t i1 = i2 - 1;
+    size_t i0 = i1 > 0 ? i1 - 1 : i1;
+    size_t i3 = i2 + 1 < keyframes.size() ? i2 + 1 : i2;
+
+    const CameraKeyframe& a = keyframes[i1];
+    const CameraKeyframe& b = keyframes[i2];
+    float span = b.time - a.time;
+    float t = span > 0.0f ? (time - a.time) / span : 1.0f;
+
+    CameraKeyframe result;
+    result.time = time;
+    result.position = catmullRom(keyframes[i0].position, a.position, b.position, keyframes[i3].position, t);
+    result.yaw = a.yaw + (b.yaw - a.yaw) * t;
+    result.pitch = a.pitch + (b.pitch - a.pitch) * t;
+    return result;
+}
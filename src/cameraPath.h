@@ -0,0 +1,38 @@
+#ifndef CAMERA_PATH_H
+#define CAMERA_PATH_H
+
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+
+struct CameraKeyframe {
+    float time;        // seconds from the start of the path
+    glm::vec3 position;
+    float yaw;
+    float pitch;
+};
+
+// Keyframed camera flythrough. The file is plain text, one "time x y z yaw pitch" keyframe
+// per line in increasing time, '#' starts a comment. Positions follow a Catmull-Rom
+// spline through the keyframes; yaw and pitch are interpolated linearly.
+class CameraPath {
+public:
+    bool load(const std::string& path);
+    bool save(const std::string& path) const;
+
+    // Appends a keyframe; its time must not be earlier than the last one
+    void addKeyframe(const CameraKeyframe& keyframe);
+    void clear() { keyframes.clear(); }
+
+    bool empty() const { return keyframes.empty(); }
+    size_t size() const { return keyframes.size(); }
+    float getDuration() const { return keyframes.empty() ? 0.0f : keyframes.back().time; }
+
+    // Pose at the given time, clamped to the ends of the path
+    CameraKeyframe sample(float time) const;
+
+private:
+    std::vector<CameraKeyframe> keyframes;
+};
+
+#endif // CAMERA_PATH_H
@@ -0,0 +1,197 @@
+#include "cpuProfiler.h"
+#include "gpuProfiler.h"
+#include "log.h"
+#include <glad/glad.h>
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+
+namespace {
+
+thread_local ThreadZoneBuffer* currentThreadBuffer = nullptr;
+
+const uint32_t GPU_TRACK = 1000;
+
+std::string escapeJSON(const std::string& text) {
+    std::string escaped;
+    for (char c : text) {
+        if (c == '"' || c == '\\') escaped += '\\';
+        escaped += c;
+    }
+    return escaped;
+}
+
+void writeEvent(std::ofstream& out, bool& first, const std::string& name, uint32_t track, double beginUs, double durationUs) {
+    char timing[96];
+    std::snprintf(timing, sizeof(timing), "\"ts\": %.3f, \"dur\": %.3f", beginUs, durationUs);
+    out << (first ? "\n" : ",\n") << "    {\"name\": \"" << escapeJSON(name) << "\", \"ph\": \"X\", \"pid\": 1, \"tid\": "
+        << track << ", " << timing << "}";
+    first = false;
+}
+
+void writeThreadName(std::ofstream& out, bool& first, uint32_t track, const std::string& name) {
+    out << (first ? "\n" : ",\n") << "    {\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " << track
+        << ", \"args\": {\"name\": \"" << escapeJSON(name) << "\"}}";
+    first = false;
+}
+
+} // namespace
+
+ThreadZoneBuffer& CpuProfiler::getThreadBuffer() {
+    if (!currentThreadBuffer) {
+        std::lock_guard<std::mutex> lock(threadsMutex);
+        std::unique_ptr<ThreadZoneBuffer> buffer(new ThreadZoneBuffer());
+        buffer->threadIndex = static_cast<uint32_t>(threads.size());
+        buffer->name = "Thread " + std::to_string(buffer->threadIndex);
+        buffer->events.resize(ThreadZoneBuffer::CAPACITY);
+        currentThreadBuffer = buffer.get();
+        threads.push_back(std::move(buffer));
+    }
+    return *currentThreadBuffer;
+}
+
+void CpuProfiler::setThreadName(const char* name) {
+    ThreadZoneBuffer& buffer = getThreadBuffer();
+    std::lock_guard<std::mutex> lock(threadsMutex);
+    buffer.name = name;
+}
+
+void CpuProfiler::recordZone(const char* name, uint64_t beginNs, uint64_t endNs) {
+    ThreadZoneBuffer& buffer = getThreadBuffer();
+    uint64_t index = buffer.written.load(std::memory_order_relaxed);
+    buffer.events[index % ThreadZoneBuffer::CAPACITY] = CpuZoneEvent{name, beginNs, endNs};
+    buffer.written.store(index + 1, std::memory_order_release);
+}
+
+void CpuProfiler::recordGpuZone(const std::string& name, uint64_t submitNs, uint64_t gpuBeginNs, uint64_t gpuEndNs) {
+    if (state == CaptureState::Idle || state == CaptureState::Pending) return;
+    // Only frames submitted while recording belong to the capture
+    if (submitNs < captureStartNs || (captureEndNs != 0 && submitNs >= captureEndNs)) return;
+    gpuZones.push_back(GpuZoneEvent{name, static_cast<uint64_t>(static_cast<int64_t>(gpuBeginNs) + gpuToCpuOffsetNs),
+                                    static_cast<uint64_t>(static_cast<int64_t>(gpuEndNs) + gpuToCpuOffsetNs)});
+}
+
+void CpuProfiler::requestCapture(int frames, const std::string& path) {
+    if (state != CaptureState::Idle || frames <= 0) return;
+#ifndef RAYTRACER_PROFILING
+    LOG_WARN(Render, "Built without RAYTRACER_PROFILING; the trace will only contain GPU passes");
+#endif
+    framesRequested = frames;
+    capturePath = path;
+    state = CaptureState::Pending;
+}
+
+void CpuProfiler::startCapture() {
+    // One synchronous timestamp read per capture maps GPU time onto the CPU clock
+    GLint64 gpuNow = 0;
+    uint64_t before = nowNs();
+    glGetInteger64v(GL_TIMESTAMP, &gpuNow);
+    uint64_t after = nowNs();
+    gpuToCpuOffsetNs = static_cast<int64_t>((before + after) / 2) - static_cast<int64_t>(gpuNow);
+
+    {
+        std::lock_guard<std::mutex> lock(threadsMutex);
+        for (auto& buffer : threads) {
+            uint64_t written = buffer->written.load(std::memory_order_acquire);
+            buffer->captureBegin = written;
+            buffer->captureEnd = written;
+        }
+    }
+    gpuZones.clear();
+    captureStartNs = nowNs();
+    captureEndNs = 0;
+    framesLeft = framesRequested;
+    state = CaptureState::Recording;
+    recording.store(true, std::memory_order_relaxed);
+    LOG_INFO(Render, "Capturing %d frames to %s", framesRequested, capturePath.c_str());
+}
+
+void CpuProfiler::stopRecording() {
+    recording.store(false, std::memory_order_relaxed);
+    captureEndNs = nowNs();
+    // Zones already open when recording stops still land after captureEnd and are dropped
+    std::lock_guard<std::mutex> lock(threadsMutex);
+    for (auto& buffer : threads) {
+        buffer->captureEnd = buffer->written.load(std::memory_order_acquire);
+    }
+}
+
+void CpuProfiler::frameMark() {
+    switch (state) {
+        case CaptureState::Idle:
+            break;
+        case CaptureState::Pending:
+            startCapture();
+            break;
+        case CaptureState::Recording:
+            if (--framesLeft <= 0) {
+                stopRecording();
+                // GPU results of the last recorded frames arrive QUERY_FRAMES frames later
+                framesLeft = static_cast<int>(GpuProfiler::QUERY_FRAMES) + 1;
+                state = CaptureState::Draining;
+            }
+            break;
+        case CaptureState::Draining:
+            if (--framesLeft <= 0) {
+                writeTrace();
+                gpuZones.clear();
+                state = CaptureState::Idle;
+            }
+            break;
+    }
+}
+
+void CpuProfiler::writeTrace() {
+    std::ofstream out(capturePath);
+    if (!out) {
+        LOG_ERROR(Render, "Could not write trace to %s", capturePath.c_str());
+        return;
+    }
+
+    size_t cpuEvents = 0;
+    bool first = true;
+    out << "{\n  \"displayTimeUnit\": \"ms\",\n  \"traceEvents\": [";
+
+    {
+        std::lock_guard<std::mutex> lock(threadsMutex);
+        for (const auto& buffer : threads) {
+            uint64_t begin = buffer->captureBegin;
+            uint64_t end = buffer->captureEnd;
+            // The owner may be writing slot written right now, so only the slots after it
+            // still hold what they held at end; older ones were overwritten as the ring wrapped
+            uint64_t written = buffer->written.load(std::memory_order_acquire);
+            if (written + 1 > ThreadZoneBuffer::CAPACITY) {
+                begin = std::max(begin, written + 1 - ThreadZoneBuffer::CAPACITY);
+            }
+            if (begin >= end) continue;
+            writeThreadName(out, first, buffer->threadIndex, buffer->name);
+
+            uint64_t count = end - begin;
+            for (uint64_t i = begin; i < end; ++i) {
+                const CpuZoneEvent& event = buffer->events[i % ThreadZoneBuffer::CAPACITY];
+                writeEvent(out, first, event.name, buffer->threadIndex,
+                           (static_cast<double>(event.beginNs) - captureStartNs) / 1000.0,
+                           (event.endNs - event.beginNs) / 1000.0);
+            }
+            cpuEvents += static_cast<size_t>(count);
+        }
+    }
+
+    if (!gpuZones.empty()) {
+        writeThreadName(out, first, GPU_TRACK, "GPU");
+        for (const GpuZoneEvent& zone : gpuZones) {
+            writeEvent(out, first, zone.name, GPU_TRACK,
+                       (static_cast<double>(zone.beginNs) - captureStartNs) / 1000.0,
+                       (zone.endNs - zone.beginNs) / 1000.0);
+        }
+    }
+
+    out << "\n  ]\n}\n";
+    LOG_INFO(Render, "Trace of %d frames written to %s (%zu CPU zones, %zu GPU zones)",
+             framesRequested, capturePath.c_str(), cpuEvents, gpuZones.size());
+}
+
+CpuProfiler& getCpuProfiler() {
+    static CpuProfiler profiler;
+    return profiler;
+}
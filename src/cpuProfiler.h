@@ -0,0 +1,125 @@
+#ifndef CPU_PROFILER_H
+#define CPU_PROFILER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Zones are compiled in when RAYTRACER_PROFILING is defined (set per build type in CMake).
+// Without it PROFILE_ZONE expands to nothing and captures only contain GPU passes.
+#ifdef RAYTRACER_PROFILING
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+// name must outlive the capture (a string literal)
+#define PROFILE_ZONE(name) CpuProfileZone PROFILE_CONCAT(profileZone, __LINE__)(name)
+#define PROFILE_THREAD_NAME(name) getCpuProfiler().setThreadName(name)
+#else
+#define PROFILE_ZONE(name) ((void)0)
+#define PROFILE_THREAD_NAME(name) ((void)0)
+#endif
+
+struct CpuZoneEvent {
+    const char* name;
+    uint64_t beginNs;
+    uint64_t endNs;
+};
+
+// Events of one thread. Only the owning thread writes events and written, and it may still
+// be doing so while a capture starts or is exported, so the profiler never resets the ring:
+// it notes where the capture began and ended instead. Buffers are never freed, so zones
+// belong on long-lived threads.
+struct ThreadZoneBuffer {
+    static const size_t CAPACITY = 1 << 16;
+
+    uint32_t threadIndex = 0;
+    std::string name;
+    std::vector<CpuZoneEvent> events;
+    std::atomic<uint64_t> written{0};
+    // Values of written when the last capture started and stopped, under threadsMutex
+    uint64_t captureBegin = 0;
+    uint64_t captureEnd = 0;
+};
+
+// Records scoped zones from any thread into per-thread rings while a capture is running and
+// writes N frames as a Chrome trace (chrome://tracing, Perfetto). GPU passes from
+// GpuProfiler are added on their own track: GL_TIMESTAMP is read once when the capture
+// starts to map GPU time onto the CPU clock, so both line up on one timeline.
+class CpuProfiler {
+public:
+    static uint64_t nowNs() {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
+
+    // Starts at the next frameMark() and writes the trace after the GPU caught up
+    void requestCapture(int frames, const std::string& path);
+    bool isCaptureActive() const { return state != CaptureState::Idle; }
+    bool isRecording() const { return recording.load(std::memory_order_relaxed); }
+
+    // Call once per frame on the render thread, after swapping buffers
+    void frameMark();
+
+    void setThreadName(const char* name);
+    void recordZone(const char* name, uint64_t beginNs, uint64_t endNs);
+    // Raw GL timestamps of one pass; submitNs is when the CPU began that frame
+    void recordGpuZone(const std::string& name, uint64_t submitNs, uint64_t gpuBeginNs, uint64_t gpuEndNs);
+
+private:
+    enum class CaptureState {
+        Idle,
+        Pending,
+        Recording,
+        Draining
+    };
+
+    struct GpuZoneEvent {
+        std::string name;
+        uint64_t beginNs;
+        uint64_t endNs;
+    };
+
+    std::atomic<bool> recording{false};
+    CaptureState state = CaptureState::Idle;
+    int framesRequested = 0;
+    int framesLeft = 0;
+    std::string capturePath;
+    uint64_t captureStartNs = 0;
+    uint64_t captureEndNs = 0;
+    // CPU clock minus GPU clock, measured when the capture starts
+    int64_t gpuToCpuOffsetNs = 0;
+    std::vector<GpuZoneEvent> gpuZones;
+
+    std::mutex threadsMutex;
+    std::vector<std::unique_ptr<ThreadZoneBuffer>> threads;
+
+    ThreadZoneBuffer& getThreadBuffer();
+    void startCapture();
+    void stopRecording();
+    void writeTrace();
+};
+
+CpuProfiler& getCpuProfiler();
+
+class CpuProfileZone {
+public:
+    explicit CpuProfileZone(const char* name)
+        : name(name), beginNs(getCpuProfiler().isRecording() ? CpuProfiler::nowNs() : 0) {}
+    ~CpuProfileZone() {
+        if (beginNs != 0) {
+            getCpuProfiler().recordZone(name, beginNs, CpuProfiler::nowNs());
+        }
+    }
+
+    CpuProfileZone(const CpuProfileZone&) = delete;
+    CpuProfileZone& operator=(const CpuProfileZone&) = delete;
+
+private:
+    const char* name;
+    uint64_t beginNs;
+};
+
+#endif // CPU_PROFILER_H
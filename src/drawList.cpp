@@ -0,0 +1,161 @@
+#include "drawList.h"
+#include "model.h"
+#include "objectData.h"
+#include "frustum.h"
+#include "cpuProfiler.h"
+#include "jobSystem.h"
+#include <algorithm>
+#include <chrono>
+
+void* FrameArena::allocate(size_t size, size_t alignment) {
+    while (current < blocks.size()) {
+        Block& block = blocks[current];
+        size_t aligned = (offset + alignment - 1) & ~(alignment - 1);
+        if (aligned + size <= block.size) {
+            offset = aligned + size;
+            return block.data.get() + aligned;
+        }
+        current++;
+        offset = 0;
+    }
+    // new[] aligns for any fundamental type, which is all lists hold
+    Block block;
+    block.size = std::max(static_cast<size_t>(BLOCK_SIZE), size);
+    block.data.reset(new unsigned char[block.size]);
+    blocks.push_back(std::move(block));
+    current = blocks.size() - 1;
+    offset = size;
+    return blocks.back().data.get();
+}
+
+void FrameArena::reset() {
+    current = 0;
+    offset = 0;
+}
+
+size_t FrameArena::getCapacity() const {
+    size_t bytes = 0;
+    for (const Block& block : blocks) {
+        bytes += block.size;
+    }
+    return bytes;
+}
+
+DrawListBuilder::DrawListBuilder() : viewCount(0), builtViews(0) {
+}
+
+void DrawListBuilder::beginFrame() {
+    viewCount = 0;
+    builtViews = 0;
+    tasks.clear();
+    stats = DrawListStats();
+    stats.workers = getJobSystem().getWorkerCount();
+}
+
+int DrawListBuilder::addView(const DrawViewRequest& request) {
+    if (viewCount == views.size()) {
+        views.push_back(std::unique_ptr<View>(new View()));
+    }
+    View& view = *views[viewCount];
+    view.request = request;
+    view.list = DrawList();
+    view.arena.reset();
+    return static_cast<int>(viewCount++);
+}
+
+void DrawListBuilder::addTask(std::function<void()> task) {
+    tasks.push_back(std::move(task));
+}
+
+void DrawListBuilder::build(const std::vector<Model>& models, const std::vector<int>& firstObject) {
+    if (tasks.empty() && builtViews == viewCount) return;
+    PROFILE_ZONE("Build draw lists");
+    auto start = std::chrono::steady_clock::now();
+
+    size_t taskCount = tasks.size();
+    size_t viewBegin = builtViews;
+    // One job each, so a long view doesn't hold up the ones queued behind it
+    getJobSystem().parallelFor(taskCount + (viewCount - viewBegin), 1, [&](size_t begin, size_t end) {
+        for (size_t job = begin; job < end; ++job) {
+            if (job < taskCount) {
+                tasks[job]();
+            } else {
+                cullView(*views[viewBegin + job - taskCount], models, firstObject);
+            }
+        }
+    });
+
+    stats.tasks += static_cast<int>(taskCount);
+    stats.views += static_cast<int>(viewCount - builtViews);
+    for (size_t i = builtViews; i < viewCount; ++i) {
+        stats.arenaBytes += views[i]->arena.getCapacity();
+    }
+    tasks.clear();
+    builtViews = viewCount;
+    stats.buildMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void DrawListBuilder::cullView(View& view, const std::vector<Model>& models, const std::vector<int>& firstObject) {
+    PROFILE_ZONE("Cull view");
+    const DrawViewRequest& request = view.request;
+    DrawList& list = view.list;
+
+    int faceCount = std::max(1, std::min(request.faceCount, static_cast<int>(DrawViewRequest::MAX_FACES)));
+    Frustum frustums[DrawViewRequest::MAX_FACES];
+    for (int face = 0; face < faceCount; ++face) {
+        frustums[face] = Frustum(request.viewProjections[face]);
+    }
+
+    // Sized for everything passing; the arena keeps the memory for the next frame
+    size_t instanceCount = 0;
+    for (const Model& model : models) {
+        instanceCount += model.getInstanceCount();
+    }
+    GLuint* objects = view.arena.allocateArray<GLuint>(std::max<size_t>(instanceCount, 1));
+    DrawCommand* commands = view.arena.allocateArray<DrawCommand>(std::max<size_t>(models.size(), 1));
+    size_t objectCount = 0;
+    size_t commandCount = 0;
+
+    for (size_t m = 0; m < models.size(); ++m) {
+        const Model& model = models[m];
+        if (request.casters != ShadowCasters::All && model.isDynamic() != (request.casters == ShadowCasters::Dynamic)) {
+            continue;
+        }
+        const std::vector<glm::mat4>& transforms = model.getInstanceTransforms();
+        size_t first = objectCount;
+        for (size_t i = 0; i < transforms.size(); ++i) {
+            glm::vec3 worldMin, worldMax;
+            transformAABB(transforms[i], model.getLocalMin(), model.getLocalMax(), worldMin, worldMax);
+            GLuint faceMask = 0;
+            for (int face = 0; face < faceCount; ++face) {
+                if (frustums[face].intersectsAABB(worldMin, worldMax)) {
+                    faceMask |= 1u << face;
+                }
+            }
+            if (faceMask == 0) continue;
+            GLuint object = static_cast<GLuint>(firstObject[m] + i);
+            // Single views need no mask; cube faces tell the geometry shader where to emit
+            objects[objectCount++] = faceCount > 1 ? object | (faceMask << ObjectDataBuffer::FACE_MASK_SHIFT) : object;
+        }
+
+        size_t count = objectCount - first;
+        list.stats.instances += static_cast<int>(transforms.size());
+        if (count == 0) continue;
+        DrawCommand& command = commands[commandCount++];
+        command.sortKey = (static_cast<uint64_t>(model.getShaderFeatures()) << 32) | m;
+        command.model = static_cast<uint32_t>(m);
+        command.first = static_cast<uint32_t>(first);
+        command.count = static_cast<uint32_t>(count);
+        list.stats.visibleInstances += static_cast<int>(count);
+        list.stats.drawCalls++;
+        list.stats.triangles += model.getTriangleCount() * count;
+    }
+
+    std::sort(commands, commands + commandCount, [](const DrawCommand& a, const DrawCommand& b) {
+        return a.sortKey < b.sortKey;
+    });
+    list.objects = objects;
+    list.objectCount = objectCount;
+    list.commands = commands;
+    list.commandCount = commandCount;
+}
@@ -0,0 +1,141 @@
+// drawList.h - Per-view draw lists built on worker threads
+#ifndef DRAW_LIST_H
+#define DRAW_LIST_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+class Model;
+
+// Which shadow casters a shadow pass draws: static ones are cached, dynamic ones are
+// drawn over the cache every frame
+enum class ShadowCasters {
+    All,
+    Static,
+    Dynamic
+};
+
+struct InstanceCullStats {
+    int instances = 0;
+    int visibleInstances = 0;
+    int drawCalls = 0;
+    size_t triangles = 0;
+};
+
+// Linear allocator for one view's lists. Blocks are kept across reset(), so once a view
+// has seen its largest frame it never allocates again.
+class FrameArena {
+public:
+    static const size_t BLOCK_SIZE = 64 * 1024;
+
+    FrameArena() : current(0), offset(0) {}
+
+    FrameArena(const FrameArena&) = delete;
+    FrameArena& operator=(const FrameArena&) = delete;
+
+    // alignment must be a power of two
+    void* allocate(size_t size, size_t alignment);
+    template <typename T>
+    T* allocateArray(size_t count) {
+        return static_cast<T*>(allocate(count * sizeof(T), alignof(T)));
+    }
+    void reset();
+    size_t getCapacity() const;
+
+private:
+    struct Block {
+        std::unique_ptr<unsigned char[]> data;
+        size_t size;
+    };
+
+    std::vector<Block> blocks;
+    size_t current;
+    size_t offset;
+};
+
+// One model's instanced draw in a list. Lists are sorted by key: shader features in the
+// high half, so each default.frag variant is bound once, then model index.
+struct DrawCommand {
+    uint64_t sortKey;
+    uint32_t model;
+    // Into the list's object indices
+    uint32_t first;
+    uint32_t count;
+};
+
+// A view to cull: the camera or a shadow map, or the faces of a shadow cube drawn together
+struct DrawViewRequest {
+    static const int MAX_FACES = 6;
+
+    glm::mat4 viewProjections[MAX_FACES];
+    int faceCount = 1;
+    ShadowCasters casters = ShadowCasters::All;
+};
+
+// A view's visible object indices (cube faces: with their face mask from
+// ObjectDataBuffer::FACE_MASK_SHIFT up) and the sorted draws over them, in its arena
+struct DrawList {
+    const GLuint* objects = nullptr;
+    size_t objectCount = 0;
+    const DrawCommand* commands = nullptr;
+    size_t commandCount = 0;
+    InstanceCullStats stats;
+};
+
+struct DrawListStats {
+    int views = 0;
+    int tasks = 0;
+    int workers = 0;
+    // Time the GL thread spent in build(), its own share of the jobs included
+    double buildMs = 0.0;
+    size_t arenaBytes = 0;
+};
+
+// Culls, filters and sorts every view of a frame in parallel. Views (and any other CPU
+// work of the frame, added as tasks) are queued on the GL thread, build() runs one job
+// system job per view and task while the GL thread helps, and the GL thread then only
+// uploads the finished lists and replays their commands. Jobs read models and never
+// touch GL, so the models must not change while build() runs.
+class DrawListBuilder {
+public:
+    DrawListBuilder();
+
+    DrawListBuilder(const DrawListBuilder&) = delete;
+    DrawListBuilder& operator=(const DrawListBuilder&) = delete;
+
+    // Forgets last frame's views and rewinds their arenas
+    void beginFrame();
+    // Returns the view's index for getList()
+    int addView(const DrawViewRequest& request);
+    void addTask(std::function<void()> task);
+    // Builds every view and runs every task queued since the last build
+    void build(const std::vector<Model>& models, const std::vector<int>& firstObject);
+
+    bool isBuilt(int view) const { return view >= 0 && static_cast<size_t>(view) < builtViews; }
+    const DrawList& getList(int view) const { return views[view]->list; }
+    const DrawViewRequest& getRequest(int view) const { return views[view]->request; }
+    // Totals of the frame so far
+    const DrawListStats& getStats() const { return stats; }
+
+private:
+    struct View {
+        DrawViewRequest request;
+        DrawList list;
+        FrameArena arena;
+    };
+
+    std::vector<std::unique_ptr<View>> views;
+    size_t viewCount;
+    size_t builtViews;
+    std::vector<std::function<void()>> tasks;
+    DrawListStats stats;
+
+    static void cullView(View& view, const std::vector<Model>& models, const std::vector<int>& firstObject);
+};
+
+#endif // DRAW_LIST_H
@@ -0,0 +1,191 @@
+#include "dynamicResolution.h"
+#include "glState.h"
+#include "log.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// Over budget: close half the gap to the predicted scale per measurement
+const float DECREASE_GAIN = 0.5f;
+const float MAX_DECREASE = 0.1f;
+// Under budget by more than the headroom: creep back up so one cheap frame doesn't oscillate
+const float INCREASE_GAIN = 0.1f;
+const float MAX_INCREASE = 0.02f;
+const float HEADROOM = 0.85f;
+
+unsigned int scaledSize(unsigned int size, float scale) {
+    // Even sizes keep the upscale's texel grid from shifting by half a pixel between steps
+    unsigned int scaled = static_cast<unsigned int>(size * scale + 0.5f) & ~1u;
+    return std::max(2u, std::min(scaled, size));
+}
+
+} // namespace
+
+DynamicResolution::DynamicResolution(const std::string& vertexPath, const std::string& fragmentPath, int samples,
+                                     TemporalAA* temporal)
+    : samples(temporal ? 1 : samples), temporal(temporal), upscaleShader(vertexPath.c_str(), fragmentPath.c_str()),
+      nextQuery(0), frameQuery(-1), scale(1.0f), lastGpuMs(0.0f), outputWidth(0), outputHeight(0), renderWidth(0), renderHeight(0) {
+    GLint maxColorSamples = 1, maxDepthSamples = 1;
+    glGetIntegerv(GL_MAX_COLOR_TEXTURE_SAMPLES, &maxColorSamples);
+    glGetIntegerv(GL_MAX_DEPTH_TEXTURE_SAMPLES, &maxDepthSamples);
+    int maxSamples = std::min(maxColorSamples, maxDepthSamples);
+    if (this->samples > maxSamples) {
+        LOG_WARN(Render, "%d samples requested, the driver allows %d", this->samples, maxSamples);
+        this->samples = maxSamples;
+    }
+    glGenQueries(QUERY_COUNT, queries);
+    std::fill(queryPending, queryPending + QUERY_COUNT, false);
+}
+
+DynamicResolution::~DynamicResolution() {
+    glDeleteQueries(QUERY_COUNT, queries);
+}
+
+void DynamicResolution::collectQueries() {
+    // Oldest first, so the controller sees measurements in submission order
+    for (int i = 0; i < QUERY_COUNT; ++i) {
+        int slot = (nextQuery + i) % QUERY_COUNT;
+        if (!queryPending[slot]) continue;
+        GLuint available = 0;
+        glGetQueryObjectuiv(queries[slot], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available) break;
+        GLuint64 elapsed = 0;
+        glGetQueryObjectui64v(queries[slot], GL_QUERY_RESULT, &elapsed);
+        queryPending[slot] = false;
+        lastGpuMs = static_cast<float>(elapsed) / 1.0e6f;
+        updateScale(lastGpuMs);
+    }
+}
+
+void DynamicResolution::updateScale(float gpuMs) {
+    if (!settings.enabled || gpuMs <= 0.0f) return;
+
+    // Cost follows the pixel count, which goes with the square of the per-axis scale
+    float desired = scale * std::sqrt(settings.targetMs / gpuMs);
+    if (gpuMs > settings.targetMs) {
+        scale -= std::min((scale - desired) * DECREASE_GAIN, MAX_DECREASE);
+    } else if (gpuMs < settings.targetMs * HEADROOM) {
+        scale += std::min((desired - scale) * INCREASE_GAIN, MAX_INCREASE);
+    }
+    scale = std::max(settings.minScale, std::min(scale, settings.maxScale));
+}
+
+SceneTargets DynamicResolution::beginFrame(FrameGraph& graph, unsigned int width, unsigned int height) {
+    outputWidth = std::max(width, 1u);
+    outputHeight = std::max(height, 1u);
+
+    collectQueries();
+    if (!settings.enabled) {
+        scale = settings.maxScale;
+    }
+    scale = std::max(settings.minScale, std::min(scale, settings.maxScale));
+    renderWidth = scaledSize(outputWidth, scale);
+    renderHeight = scaledSize(outputHeight, scale);
+
+    FrameGraphTextureDesc colorDesc;
+    colorDesc.width = outputWidth;
+    colorDesc.height = outputHeight;
+    colorDesc.format = GL_RGBA8;
+    colorDesc.samples = samples;
+    FrameGraphTextureDesc depthDesc = colorDesc;
+    depthDesc.format = GL_DEPTH_COMPONENT24;
+    FrameGraphTextureDesc velocityDesc = colorDesc;
+    velocityDesc.format = GL_RG16F;
+
+    // Declared up front: the execute function below copies the handles before setup runs
+    SceneTargets scene;
+    scene.width = renderWidth;
+    scene.height = renderHeight;
+    scene.color = graph.createTexture("Scene color", colorDesc);
+    scene.depth = graph.createTexture("Scene depth", depthDesc);
+    if (temporal) {
+        scene.velocity = graph.createTexture("Velocity", velocityDesc);
+    }
+    // The timer spans from this clear to the end of the upscale
+    frameQuery = -1;
+    if (!queryPending[nextQuery]) {
+        frameQuery = nextQuery;
+        queryPending[nextQuery] = true;
+        nextQuery = (nextQuery + 1) % QUERY_COUNT;
+    }
+    int query = frameQuery;
+    graph.addPass("Scene clear",
+        [&](FrameGraphPassBuilder& builder) {
+            for (FrameGraphResource attachment : scene.getColorAttachments()) {
+                builder.write(attachment);
+            }
+            builder.write(scene.depth);
+        },
+        [this, scene, query](FrameGraph& frame) {
+            if (query >= 0) {
+                glBeginQuery(GL_TIME_ELAPSED, queries[query]);
+            }
+            GLStateCache& state = getGLState();
+            frame.bindRenderTarget(scene.getColorAttachments(), scene.depth);
+            state.viewport(0, 0, scene.width, scene.height);
+            state.setDepthTest(true);
+            state.depthMask(true);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        });
+    return scene;
+}
+
+void DynamicResolution::addOutputPasses(FrameGraph& graph, const SceneTargets& scene, FrameGraphResource output) {
+    FrameGraphResource color = scene.color;
+    if (samples > 1) {
+        FrameGraphTextureDesc resolvedDesc = graph.getDesc(scene.color);
+        resolvedDesc.samples = 1;
+        FrameGraphResource resolved = graph.createTexture("Resolved color", resolvedDesc);
+        graph.addPass("MSAA resolve",
+            [&](FrameGraphPassBuilder& builder) {
+                builder.read(scene.color);
+                builder.write(resolved);
+            },
+            [scene, resolved](FrameGraph& frame) {
+                // Only the read binding goes around the cache, and it is put back afterwards
+                GLuint target = frame.getFramebuffer({ resolved });
+                frame.bindRenderTarget({ resolved });
+                glBindFramebuffer(GL_READ_FRAMEBUFFER, frame.getFramebuffer({ scene.color }));
+                glBlitFramebuffer(0, 0, scene.width, scene.height, 0, 0, scene.width, scene.height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+                glBindFramebuffer(GL_READ_FRAMEBUFFER, target);
+            });
+        color = resolved;
+    }
+    if (temporal) {
+        color = temporal->addPass(graph, color, scene.velocity, scene.width, scene.height);
+    }
+
+    int query = frameQuery;
+    graph.addPass("Upscale",
+        [&](FrameGraphPassBuilder& builder) {
+            builder.read(color);
+            builder.write(output);
+        },
+        [this, color, output, query](FrameGraph& frame) {
+            frame.bindRenderTarget({ output });
+            upscale(frame.getTexture(color));
+            if (query >= 0) {
+                glEndQuery(GL_TIME_ELAPSED);
+            }
+        });
+}
+
+void DynamicResolution::upscale(GLuint sceneColor) {
+    GLStateCache& state = getGLState();
+    state.viewport(0, 0, outputWidth, outputHeight);
+    state.setDepthTest(false);
+    state.setCullFace(false);
+
+    upscaleShader.activate();
+    state.bindTexture(0, GL_TEXTURE_2D, sceneColor);
+    upscaleShader.setInt("sceneColor", 0);
+    GLfloat renderSize[2] = { static_cast<GLfloat>(renderWidth), static_cast<GLfloat>(renderHeight) };
+    GLfloat textureSize[2] = { static_cast<GLfloat>(outputWidth), static_cast<GLfloat>(outputHeight) };
+    upscaleShader.setVec2("renderSize", renderSize);
+    upscaleShader.setVec2("textureSize", textureSize);
+    upscaleShader.setFloat("sharpness", settings.sharpness);
+    emptyVAO.bind();
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    state.setDepthTest(true);
+}
@@ -0,0 +1,82 @@
+#ifndef DYNAMIC_RESOLUTION_H
+#define DYNAMIC_RESOLUTION_H
+
+#include <glad/glad.h>
+#include <string>
+#include "frameGraph.h"
+#include "shader.h"
+#include "temporalAA.h"
+#include "VAO.h"
+
+struct DynamicResolutionSettings {
+    bool enabled = true;
+    // GPU time the scene may take, upscale included
+    float targetMs = 16.0f;
+    float minScale = 0.5f;
+    float maxScale = 1.0f;
+    // 0 = plain bilinear upscale, 1 = strongest sharpening
+    float sharpness = 0.5f;
+};
+
+// Renders the scene into an offscreen target at a per-axis fraction of the window and
+// upscales it with contrast-adaptive sharpening. The scale follows the GPU time of the
+// scene, measured with its own GL_TIME_ELAPSED queries: it drops quickly when a frame
+// goes over budget and climbs back slowly once there is headroom. The target is
+// a window-sized frame graph transient, so changing the scale never reallocates.
+// Anti-aliasing is either MSAA on the target or, given a TemporalAA, a single-sampled
+// target with velocity that is resolved temporally before the upscale.
+class DynamicResolution {
+public:
+    DynamicResolution(const std::string& vertexPath, const std::string& fragmentPath, int samples,
+                      TemporalAA* temporal = nullptr);
+    ~DynamicResolution();
+
+    DynamicResolution(const DynamicResolution&) = delete;
+    DynamicResolution& operator=(const DynamicResolution&) = delete;
+
+    // Picks this frame's resolution and declares the scene target with a pass clearing it
+    SceneTargets beginFrame(FrameGraph& graph, unsigned int outputWidth, unsigned int outputHeight);
+    // Declares the MSAA or temporal resolve and the upscale into output, a framebuffer
+    // of the size given to beginFrame()
+    void addOutputPasses(FrameGraph& graph, const SceneTargets& scene, FrameGraphResource output);
+
+    DynamicResolutionSettings& getSettings() { return settings; }
+    float getScale() const { return scale; }
+    unsigned int getRenderWidth() const { return renderWidth; }
+    unsigned int getRenderHeight() const { return renderHeight; }
+    unsigned int getOutputWidth() const { return outputWidth; }
+    unsigned int getOutputHeight() const { return outputHeight; }
+    float getLastGpuMs() const { return lastGpuMs; }
+    int getSamples() const { return samples; }
+    TemporalAA* getTemporalAA() const { return temporal; }
+
+private:
+    // Results arrive a few frames late; a slot still pending is skipped, not waited on
+    static const int QUERY_COUNT = 4;
+
+    DynamicResolutionSettings settings;
+    int samples;
+    TemporalAA* temporal;
+    Shader upscaleShader;
+    // Core profile needs a VAO bound even for the attributeless fullscreen triangle
+    VertexArrayObject emptyVAO;
+
+    GLuint queries[QUERY_COUNT];
+    bool queryPending[QUERY_COUNT];
+    int nextQuery;
+    // Slot timing the frame being declared, -1 when all are still pending
+    int frameQuery;
+
+    float scale;
+    float lastGpuMs;
+    unsigned int outputWidth;
+    unsigned int outputHeight;
+    unsigned int renderWidth;
+    unsigned int renderHeight;
+
+    void collectQueries();
+    void updateScale(float gpuMs);
+    void upscale(GLuint sceneColor);
+};
+
+#endif // DYNAMIC_RESOLUTION_H
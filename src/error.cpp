@@ -1,14 +1,152 @@
 #include "error.h"
-void checkGLError(const std::string& operation) {
+#include "glExtensions.h"
+#include "log.h"
+#include <cstdlib>
+
+#ifndef RAYTRACER_GL_DEBUG_DEFAULT_MODE
+#define RAYTRACER_GL_DEBUG_DEFAULT_MODE 1
+#endif
+
+bool glErrorPollingEnabled = false;
+
+static GLDebugMode currentMode = GLDebugMode::Off;
+static bool pollOncePerFrame = false;
+
+static const char* getErrorName(GLenum error) {
+    switch (error) {
+        case GL_INVALID_ENUM: return "GL_INVALID_ENUM";
+        case GL_INVALID_VALUE: return "GL_INVALID_VALUE";
+        case GL_INVALID_OPERATION: return "GL_INVALID_OPERATION";
+        case GL_INVALID_FRAMEBUFFER_OPERATION: return "GL_INVALID_FRAMEBUFFER_OPERATION";
+        case GL_OUT_OF_MEMORY: return "GL_OUT_OF_MEMORY";
+        default: return "Unknown error";
+    }
+}
+
+static const char* getSeverityName(GLenum severity) {
+    switch (severity) {
+        case GL_DEBUG_SEVERITY_HIGH: return "high";
+        case GL_DEBUG_SEVERITY_MEDIUM: return "medium";
+        case GL_DEBUG_SEVERITY_LOW: return "low";
+        default: return "info";
+    }
+}
+
+static const char* getDebugTypeName(GLenum type) {
+    switch (type) {
+        case GL_DEBUG_TYPE_ERROR: return "error";
+        case GL_DEBUG_TYPE_DEPRECATED_BEHAVIOR: return "deprecated";
+        case GL_DEBUG_TYPE_UNDEFINED_BEHAVIOR: return "undefined behavior";
+        case GL_DEBUG_TYPE_PORTABILITY: return "portability";
+        case GL_DEBUG_TYPE_PERFORMANCE: return "performance";
+        default: return "other";
+    }
+}
+
+static const char* getDebugSourceName(GLenum source) {
+    switch (source) {
+        case GL_DEBUG_SOURCE_API: return "api";
+        case GL_DEBUG_SOURCE_WINDOW_SYSTEM: return "window system";
+        case GL_DEBUG_SOURCE_SHADER_COMPILER: return "shader compiler";
+        case GL_DEBUG_SOURCE_THIRD_PARTY: return "third party";
+        case GL_DEBUG_SOURCE_APPLICATION: return "application";
+        default: return "other";
+    }
+}
+
+static void APIENTRY glDebugCallback(GLenum source, GLenum type, GLuint id, GLenum severity,
+                                     GLsizei /*length*/, const GLchar* message, const void* /*userParam*/) {
+    // Callbacks may arrive on a driver thread; the log ring is safe to write from there
+    LogLevel level = (severity == GL_DEBUG_SEVERITY_HIGH || type == GL_DEBUG_TYPE_ERROR) ? LogLevel::Error : LogLevel::Warn;
+    RT_LOG(level, LogCategory::GL, "[%s, %s, %s, id %u] %s",
+           getSeverityName(severity), getDebugSourceName(source), getDebugTypeName(type), id, message);
+}
+
+void reportGLError(const std::string& operation) {
     GLenum error = glGetError();
-    if (error != GL_NO_ERROR) {
-        std::cerr << "OpenGL Error during " << operation << ": " << error << std::endl;
-        switch(error) {
-            case GL_INVALID_ENUM: std::cerr << "GL_INVALID_ENUM" << std::endl; break;
-            case GL_INVALID_VALUE: std::cerr << "GL_INVALID_VALUE" << std::endl; break;
-            case GL_INVALID_OPERATION: std::cerr << "GL_INVALID_OPERATION_" << std::endl; break;
-            case GL_OUT_OF_MEMORY: std::cerr << "GL_OUT_OF_MEMORY" << std::endl; break;
-            default: std::cerr << "Unknown error" << std::endl; break;
+    while (error != GL_NO_ERROR) {
+        std::cerr << "OpenGL Error during " << operation << ": " << error << " (" << getErrorName(error) << ")" << std::endl;
+        error = glGetError();
+    }
+}
+
+GLDebugMode parseGLDebugMode(const std::string& name, GLDebugMode fallback) {
+    if (name == "off") return GLDebugMode::Off;
+    if (name == "callback") return GLDebugMode::Callback;
+    if (name == "strict") return GLDebugMode::Strict;
+    std::cerr << "Unknown GL debug mode '" << name << "', expected off, callback or strict" << std::endl;
+    return fallback;
+}
+
+const char* getGLDebugModeName(GLDebugMode mode) {
+    switch (mode) {
+        case GLDebugMode::Off: return "off";
+        case GLDebugMode::Callback: return "callback";
+        case GLDebugMode::Strict: return "strict";
+        default: return "unknown";
+    }
+}
+
+GLDebugMode getDefaultGLDebugMode() {
+#ifdef RAYTRACER_GL_DEBUG_DISABLED
+    return GLDebugMode::Off;
+#else
+    GLDebugMode mode = static_cast<GLDebugMode>(RAYTRACER_GL_DEBUG_DEFAULT_MODE);
+    if (const char* env = std::getenv("RAYTRACER_GL_DEBUG")) {
+        mode = parseGLDebugMode(env, mode);
+    }
+    return mode;
+#endif
+}
+
+void setGLDebugMode(GLDebugMode mode) {
+#ifdef RAYTRACER_GL_DEBUG_DISABLED
+    if (mode != GLDebugMode::Off) {
+        std::cerr << "GL error checking was compiled out (RAYTRACER_GL_DEBUG=OFF); ignoring mode '" << getGLDebugModeName(mode) << "'" << std::endl;
+    }
+    mode = GLDebugMode::Off;
+#endif
+
+    const bool khrDebug = getGLExtensions().khrDebug;
+    currentMode = mode;
+    glErrorPollingEnabled = (mode == GLDebugMode::Strict);
+    pollOncePerFrame = false;
+
+    if (mode == GLDebugMode::Off) {
+        if (khrDebug) {
+            glDisable(GL_DEBUG_OUTPUT);
+        }
+        return;
+    }
+
+    if (!khrDebug) {
+        if (mode == GLDebugMode::Callback) {
+            std::cerr << "KHR_debug unavailable; falling back to one glGetError poll per frame" << std::endl;
+            pollOncePerFrame = true;
         }
+        return;
+    }
+
+    glEnable(GL_DEBUG_OUTPUT);
+    // Strict mode wants messages attributed to the call that caused them
+    if (mode == GLDebugMode::Strict) {
+        glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+    } else {
+        glDisable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+    }
+    glDebugMessageCallback(glDebugCallback, nullptr);
+    glDebugMessageControl(GL_DONT_CARE, GL_DONT_CARE, GL_DONT_CARE, 0, nullptr, GL_TRUE);
+    glDebugMessageControl(GL_DONT_CARE, GL_DONT_CARE, GL_DEBUG_SEVERITY_NOTIFICATION, 0, nullptr, GL_FALSE);
+}
+
+GLDebugMode getGLDebugMode() {
+    return currentMode;
+}
+
+void checkGLFrameErrors() {
+#ifndef RAYTRACER_GL_DEBUG_DISABLED
+    if (pollOncePerFrame) {
+        reportGLError("frame");
     }
-}
\ No newline at end of file
+#endif
+}
@@ -5,6 +5,37 @@
 #include <iostream>
 #include <glad/glad.h>
 
-void checkGLError(const std::string& operation);
+// How GL errors are surfaced:
+//   Off      - nothing is checked
+//   Callback - KHR_debug message callback, no glGetError on the hot path
+//   Strict   - glGetError after every checkGLError (synchronizes with the driver)
+// Building with RAYTRACER_GL_DEBUG_DISABLED compiles every check out.
+enum class GLDebugMode {
+    Off,
+    Callback,
+    Strict
+};
 
-#endif // ERROR_H
\ No newline at end of file
+// Compile-time default, overridden by the RAYTRACER_GL_DEBUG environment variable
+GLDebugMode getDefaultGLDebugMode();
+GLDebugMode parseGLDebugMode(const std::string& name, GLDebugMode fallback);
+const char* getGLDebugModeName(GLDebugMode mode);
+
+// Needs a current context and loadGLExtensions() to have run
+void setGLDebugMode(GLDebugMode mode);
+GLDebugMode getGLDebugMode();
+
+void reportGLError(const std::string& operation);
+
+// Once-per-frame poll, used in Callback mode when the driver has no KHR_debug
+void checkGLFrameErrors();
+
+extern bool glErrorPollingEnabled;
+
+#ifdef RAYTRACER_GL_DEBUG_DISABLED
+#define checkGLError(operation) ((void)0)
+#else
+#define checkGLError(operation) do { if (glErrorPollingEnabled) reportGLError(operation); } while (0)
+#endif
+
+#endif // ERROR_H
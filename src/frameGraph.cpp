@@ -0,0 +1,506 @@
+#include "frameGraph.h"
+#include "error.h"
+#include "glState.h"
+#include "gpuProfiler.h"
+#include "log.h"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <queue>
+#include <sstream>
+
+namespace {
+
+bool isDepthFormat(GLenum format) {
+    return format == GL_DEPTH_COMPONENT16 || format == GL_DEPTH_COMPONENT24 || format == GL_DEPTH_COMPONENT32F ||
+           format == GL_DEPTH24_STENCIL8 || format == GL_DEPTH32F_STENCIL8;
+}
+
+struct FormatInfo {
+    GLenum format;
+    const char* name;
+    unsigned int bytesPerPixel;
+    // Pixel transfer format and type for allocating storage without data
+    GLenum baseFormat;
+    GLenum type;
+};
+
+const FormatInfo FORMATS[] = {
+    { GL_R8, "R8", 1, GL_RED, GL_UNSIGNED_BYTE },
+    { GL_RG8, "RG8", 2, GL_RG, GL_UNSIGNED_BYTE },
+    { GL_RGBA8, "RGBA8", 4, GL_RGBA, GL_UNSIGNED_BYTE },
+    { GL_R16F, "R16F", 2, GL_RED, GL_HALF_FLOAT },
+    { GL_RG16F, "RG16F", 4, GL_RG, GL_HALF_FLOAT },
+    { GL_RGBA16F, "RGBA16F", 8, GL_RGBA, GL_HALF_FLOAT },
+    { GL_R32F, "R32F", 4, GL_RED, GL_FLOAT },
+    { GL_RG32F, "RG32F", 8, GL_RG, GL_FLOAT },
+    { GL_RGBA32F, "RGBA32F", 16, GL_RGBA, GL_FLOAT },
+    { GL_R11F_G11F_B10F, "R11G11B10F", 4, GL_RGB, GL_FLOAT },
+    // 24-bit depth is padded to 32 bits by every driver we know of
+    { GL_DEPTH_COMPONENT16, "DEPTH16", 2, GL_DEPTH_COMPONENT, GL_UNSIGNED_SHORT },
+    { GL_DEPTH_COMPONENT24, "DEPTH24", 4, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT },
+    { GL_DEPTH_COMPONENT32F, "DEPTH32F", 4, GL_DEPTH_COMPONENT, GL_FLOAT },
+    { GL_DEPTH24_STENCIL8, "DEPTH24_STENCIL8", 4, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8 },
+};
+
+const FormatInfo* findFormat(GLenum format) {
+    for (const FormatInfo& info : FORMATS) {
+        if (info.format == format) return &info;
+    }
+    return nullptr;
+}
+
+std::string describeDesc(const FrameGraphTextureDesc& desc) {
+    const FormatInfo* info = findFormat(desc.format);
+    char text[96];
+    std::snprintf(text, sizeof(text), "%ux%u %s%s", desc.width, desc.height, info ? info->name : "?",
+                  desc.samples > 1 ? (" x" + std::to_string(desc.samples)).c_str() : "");
+    return text;
+}
+
+double megabytes(size_t bytes) {
+    return bytes / (1024.0 * 1024.0);
+}
+
+} // namespace
+
+size_t FrameGraphTextureDesc::getBytes() const {
+    const FormatInfo* info = findFormat(format);
+    return static_cast<size_t>(width) * height * std::max(samples, 1) * (info ? info->bytesPerPixel : 4);
+}
+
+FrameGraphResource FrameGraphPassBuilder::create(const std::string& name, const FrameGraphTextureDesc& desc) {
+    return write(graph.createTexture(name, desc));
+}
+
+FrameGraphResource FrameGraphPassBuilder::read(FrameGraphResource resource) {
+    if (!graph.isValid(resource)) return NO_RESOURCE;
+    graph.passes[pass].reads.push_back(resource);
+    graph.resources[resource].readers.push_back(pass);
+    return resource;
+}
+
+FrameGraphResource FrameGraphPassBuilder::write(FrameGraphResource resource) {
+    if (!graph.isValid(resource)) return NO_RESOURCE;
+    graph.passes[pass].writes.push_back(resource);
+    graph.resources[resource].writers.push_back(pass);
+    return resource;
+}
+
+void FrameGraphPassBuilder::setSideEffect() {
+    graph.passes[pass].sideEffect = true;
+}
+
+FrameGraph::FrameGraph() {
+}
+
+FrameGraph::~FrameGraph() {
+    clearFramebuffers();
+    GLStateCache& state = getGLState();
+    for (PooledTexture& pooled : pool) {
+        state.textureDeleted(pooled.texture);
+        glDeleteTextures(1, &pooled.texture);
+    }
+}
+
+void FrameGraph::reset() {
+    resources.clear();
+    passes.clear();
+    order.clear();
+}
+
+FrameGraphResource FrameGraph::createTexture(const std::string& name, const FrameGraphTextureDesc& desc) {
+    Resource resource;
+    resource.name = name;
+    resource.desc = desc;
+    resources.push_back(resource);
+    return static_cast<FrameGraphResource>(resources.size()) - 1;
+}
+
+FrameGraphResource FrameGraph::importTexture(const std::string& name, GLuint texture, const FrameGraphTextureDesc& desc) {
+    Resource resource;
+    resource.name = name;
+    resource.desc = desc;
+    resource.imported = true;
+    resource.texture = texture;
+    resources.push_back(resource);
+    return static_cast<FrameGraphResource>(resources.size()) - 1;
+}
+
+FrameGraphResource FrameGraph::importFramebuffer(const std::string& name, GLuint framebuffer, unsigned int width, unsigned int height) {
+    Resource resource;
+    resource.name = name;
+    resource.desc.width = width;
+    resource.desc.height = height;
+    resource.imported = true;
+    resource.framebuffer = true;
+    resource.importedFramebuffer = framebuffer;
+    resources.push_back(resource);
+    return static_cast<FrameGraphResource>(resources.size()) - 1;
+}
+
+void FrameGraph::markOutput(FrameGraphResource resource) {
+    if (isValid(resource)) {
+        resources[resource].output = true;
+    }
+}
+
+void FrameGraph::addPass(const std::string& name, const SetupFunction& setup, const ExecuteFunction& execute) {
+    Pass pass;
+    pass.name = name;
+    pass.execute = execute;
+    passes.push_back(pass);
+    FrameGraphPassBuilder builder(*this, static_cast<int>(passes.size()) - 1);
+    setup(builder);
+}
+
+void FrameGraph::cull() {
+    for (Resource& resource : resources) {
+        resource.needed = resource.output;
+    }
+    for (Pass& pass : passes) {
+        pass.live = pass.sideEffect;
+    }
+
+    // A pass lives when it writes something needed; everything it touches is then needed
+    // too, which keeps the passes producing its inputs and the earlier writers of its outputs
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (Pass& pass : passes) {
+            if (!pass.live) {
+                for (FrameGraphResource resource : pass.writes) {
+                    pass.live = pass.live || resources[resource].needed;
+                }
+                if (!pass.live) continue;
+                changed = true;
+            }
+            for (const std::vector<FrameGraphResource>* list : { &pass.reads, &pass.writes }) {
+                for (FrameGraphResource resource : *list) {
+                    if (!resources[resource].needed) {
+                        resources[resource].needed = true;
+                        changed = true;
+                    }
+                }
+            }
+        }
+    }
+}
+
+bool FrameGraph::sortPasses() {
+    // Writers of a resource run in declaration order, then everything that only reads it
+    std::vector<std::vector<int>> edges(passes.size());
+    std::vector<int> incoming(passes.size(), 0);
+    auto addEdge = [&](int from, int to) {
+        if (from == to || !passes[from].live || !passes[to].live) return;
+        edges[from].push_back(to);
+        incoming[to]++;
+    };
+    for (const Resource& resource : resources) {
+        for (size_t i = 1; i < resource.writers.size(); ++i) {
+            addEdge(resource.writers[i - 1], resource.writers[i]);
+        }
+        for (int reader : resource.readers) {
+            if (std::find(resource.writers.begin(), resource.writers.end(), reader) != resource.writers.end()) continue;
+            for (int writer : resource.writers) {
+                addEdge(writer, reader);
+            }
+        }
+    }
+
+    order.clear();
+    std::priority_queue<int, std::vector<int>, std::greater<int>> ready;
+    for (size_t i = 0; i < passes.size(); ++i) {
+        if (passes[i].live && incoming[i] == 0) ready.push(static_cast<int>(i));
+    }
+    while (!ready.empty()) {
+        int pass = ready.top();
+        ready.pop();
+        order.push_back(pass);
+        for (int next : edges[pass]) {
+            if (--incoming[next] == 0) ready.push(next);
+        }
+    }
+
+    size_t livePasses = 0;
+    for (const Pass& pass : passes) {
+        livePasses += pass.live ? 1 : 0;
+    }
+    if (order.size() != livePasses) {
+        LOG_ERROR(Render, "Frame graph has a dependency cycle; running passes in declaration order");
+        order.clear();
+        for (size_t i = 0; i < passes.size(); ++i) {
+            if (passes[i].live) order.push_back(static_cast<int>(i));
+        }
+        return false;
+    }
+    return true;
+}
+
+int FrameGraph::acquireTexture(const FrameGraphTextureDesc& desc) {
+    for (size_t i = 0; i < pool.size(); ++i) {
+        if (!pool[i].inUse && pool[i].desc == desc) {
+            pool[i].inUse = true;
+            pool[i].idleFrames = 0;
+            return static_cast<int>(i);
+        }
+    }
+
+    PooledTexture pooled;
+    pooled.desc = desc;
+    pooled.inUse = true;
+    glGenTextures(1, &pooled.texture);
+    if (desc.samples > 1) {
+        // Multisample textures are never sampled by the renderer, so the cache doesn't track them
+        glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, pooled.texture);
+        glTexImage2DMultisample(GL_TEXTURE_2D_MULTISAMPLE, desc.samples, desc.format, desc.width, desc.height, GL_TRUE);
+        glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, 0);
+    } else {
+        const FormatInfo* info = findFormat(desc.format);
+        getGLState().bindTexture(0, GL_TEXTURE_2D, pooled.texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, desc.format, desc.width, desc.height, 0, info ? info->baseFormat : GL_RGBA,
+                     info ? info->type : GL_UNSIGNED_BYTE, nullptr);
+        GLint filter = isDepthFormat(desc.format) ? GL_NEAREST : GL_LINEAR;
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    }
+    checkGLError("allocate frame graph texture");
+    LOG_DEBUG(Render, "Frame graph pool: new %s texture", describeDesc(desc).c_str());
+    pool.push_back(pooled);
+    return static_cast<int>(pool.size()) - 1;
+}
+
+void FrameGraph::allocateTransients() {
+    for (PooledTexture& pooled : pool) {
+        pooled.inUse = false;
+    }
+    for (Resource& resource : resources) {
+        resource.firstUse = -1;
+        resource.lastUse = -1;
+        resource.physical = -1;
+    }
+    for (size_t position = 0; position < order.size(); ++position) {
+        const Pass& pass = passes[order[position]];
+        for (const std::vector<FrameGraphResource>* list : { &pass.reads, &pass.writes }) {
+            for (FrameGraphResource resource : *list) {
+                Resource& used = resources[resource];
+                if (used.firstUse < 0) used.firstUse = static_cast<int>(position);
+                used.lastUse = static_cast<int>(position);
+            }
+        }
+    }
+
+    // Walk the schedule: a texture returns to the pool after its last use, and a transient
+    // created later with the same description takes it over
+    size_t liveBytes = 0;
+    std::vector<bool> usedThisFrame(pool.size(), false);
+    for (size_t position = 0; position < order.size(); ++position) {
+        for (Resource& resource : resources) {
+            if (resource.imported || resource.firstUse != static_cast<int>(position)) continue;
+            resource.physical = acquireTexture(resource.desc);
+            resource.texture = pool[resource.physical].texture;
+            usedThisFrame.resize(pool.size(), false);
+            if (!usedThisFrame[resource.physical]) {
+                usedThisFrame[resource.physical] = true;
+                stats.physicalTextures++;
+            }
+            stats.transientTextures++;
+            stats.unaliasedTransientBytes += resource.desc.getBytes();
+            liveBytes += resource.desc.getBytes();
+        }
+        stats.peakTransientBytes = std::max(stats.peakTransientBytes, liveBytes);
+        for (Resource& resource : resources) {
+            if (resource.imported || resource.physical < 0 || resource.lastUse != static_cast<int>(position)) continue;
+            pool[resource.physical].inUse = false;
+            liveBytes -= resource.desc.getBytes();
+        }
+    }
+}
+
+void FrameGraph::releaseIdleTextures() {
+    GLStateCache& state = getGLState();
+    // Resources hold pool indices from before any eviction, so gather them first
+    std::vector<bool> used(pool.size(), false);
+    for (const Resource& resource : resources) {
+        if (!resource.imported && resource.physical >= 0) {
+            used[resource.physical] = true;
+        }
+    }
+    bool released = false;
+    size_t kept = 0;
+    for (size_t i = 0; i < pool.size(); ++i) {
+        PooledTexture& pooled = pool[i];
+        pooled.idleFrames = used[i] ? 0 : pooled.idleFrames + 1;
+        if (pooled.idleFrames > POOL_RETENTION_FRAMES) {
+            if (!released) {
+                // Cached framebuffers may reference it
+                clearFramebuffers();
+                released = true;
+            }
+            state.textureDeleted(pooled.texture);
+            glDeleteTextures(1, &pooled.texture);
+            continue;
+        }
+        if (kept != i) {
+            pool[kept] = std::move(pooled);
+            // Resources on a moved texture follow it, for dump()
+            for (Resource& resource : resources) {
+                if (!resource.imported && resource.physical == static_cast<int>(i)) {
+                    resource.physical = static_cast<int>(kept);
+                }
+            }
+        }
+        kept++;
+    }
+    pool.resize(kept);
+    stats.pooledBytes = 0;
+    for (const PooledTexture& pooled : pool) {
+        stats.pooledBytes += pooled.desc.getBytes();
+    }
+}
+
+void FrameGraph::clearFramebuffers() {
+    GLStateCache& state = getGLState();
+    for (auto& entry : framebuffers) {
+        state.framebufferDeleted(entry.second);
+        glDeleteFramebuffers(1, &entry.second);
+    }
+    framebuffers.clear();
+}
+
+void FrameGraph::execute() {
+    stats = FrameGraphStats();
+    cull();
+    sortPasses();
+    allocateTransients();
+    stats.passes = static_cast<int>(order.size());
+    stats.culledPasses = static_cast<int>(passes.size() - order.size());
+
+    for (int index : order) {
+        Pass& pass = passes[index];
+        GpuProfileScope gpuScope(pass.name);
+        pass.execute(*this);
+    }
+    releaseIdleTextures();
+
+    if (!dumpPath.empty()) {
+        std::ofstream out(dumpPath);
+        if (out) {
+            out << dump();
+            LOG_INFO(Render, "Frame graph written to %s", dumpPath.c_str());
+        } else {
+            LOG_ERROR(Render, "Could not write frame graph to %s", dumpPath.c_str());
+        }
+        dumpPath.clear();
+    }
+}
+
+GLuint FrameGraph::getTexture(FrameGraphResource resource) const {
+    return isValid(resource) ? resources[resource].texture : 0;
+}
+
+const FrameGraphTextureDesc& FrameGraph::getDesc(FrameGraphResource resource) const {
+    static const FrameGraphTextureDesc none;
+    return isValid(resource) ? resources[resource].desc : none;
+}
+
+void FrameGraph::bindRenderTarget(const std::vector<FrameGraphResource>& colors, FrameGraphResource depth) {
+    getGLState().bindFramebuffer(getFramebuffer(colors, depth));
+}
+
+GLuint FrameGraph::getFramebuffer(const std::vector<FrameGraphResource>& colors, FrameGraphResource depth) {
+    if (colors.size() == 1 && depth == NO_RESOURCE && isValid(colors[0]) && resources[colors[0]].framebuffer) {
+        return resources[colors[0]].importedFramebuffer;
+    }
+
+    std::vector<GLuint> key;
+    for (FrameGraphResource color : colors) {
+        key.push_back(getTexture(color));
+    }
+    // The depth attachment is always last, 0 without one
+    key.push_back(getTexture(depth));
+    auto it = framebuffers.find(key);
+    if (it != framebuffers.end()) {
+        return it->second;
+    }
+
+    GLStateCache& state = getGLState();
+    GLuint previous = state.getFramebuffer();
+    GLuint framebuffer = 0;
+    glGenFramebuffers(1, &framebuffer);
+    state.bindFramebuffer(framebuffer);
+    std::vector<GLenum> drawBuffers;
+    for (size_t i = 0; i < colors.size(); ++i) {
+        GLenum target = getDesc(colors[i]).samples > 1 ? GL_TEXTURE_2D_MULTISAMPLE : GL_TEXTURE_2D;
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + static_cast<GLenum>(i), target, key[i], 0);
+        drawBuffers.push_back(GL_COLOR_ATTACHMENT0 + static_cast<GLenum>(i));
+    }
+    if (depth != NO_RESOURCE) {
+        const FrameGraphTextureDesc& desc = getDesc(depth);
+        GLenum attachment = desc.format == GL_DEPTH24_STENCIL8 || desc.format == GL_DEPTH32F_STENCIL8
+                                ? GL_DEPTH_STENCIL_ATTACHMENT : GL_DEPTH_ATTACHMENT;
+        glFramebufferTexture2D(GL_FRAMEBUFFER, attachment, desc.samples > 1 ? GL_TEXTURE_2D_MULTISAMPLE : GL_TEXTURE_2D,
+                               key.back(), 0);
+    }
+    if (drawBuffers.empty()) {
+        glDrawBuffer(GL_NONE);
+        glReadBuffer(GL_NONE);
+    } else {
+        glDrawBuffers(static_cast<GLsizei>(drawBuffers.size()), drawBuffers.data());
+    }
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        LOG_ERROR(Render, "Frame graph framebuffer for %s is not complete",
+                  colors.empty() ? resources[depth].name.c_str() : resources[colors[0]].name.c_str());
+    }
+    state.bindFramebuffer(previous);
+    framebuffers.emplace(key, framebuffer);
+    return framebuffer;
+}
+
+std::string FrameGraph::dump() const {
+    std::ostringstream out;
+    char line[256];
+    std::snprintf(line, sizeof(line),
+                  "Frame graph: %d passes (%d culled), %d transients in %d textures, peak %.2f MB (%.2f MB unaliased), pool %.2f MB\n",
+                  stats.passes, stats.culledPasses, stats.transientTextures, stats.physicalTextures,
+                  megabytes(stats.peakTransientBytes), megabytes(stats.unaliasedTransientBytes), megabytes(stats.pooledBytes));
+    out << line;
+
+    auto names = [this](const std::vector<FrameGraphResource>& list) {
+        std::string joined;
+        for (FrameGraphResource resource : list) {
+            joined += (joined.empty() ? "" : ", ") + resources[resource].name;
+        }
+        return joined.empty() ? std::string("-") : joined;
+    };
+    for (size_t position = 0; position < order.size(); ++position) {
+        const Pass& pass = passes[order[position]];
+        std::snprintf(line, sizeof(line), "  %2zu. %-14s reads: %s; writes: %s%s\n", position + 1, pass.name.c_str(),
+                      names(pass.reads).c_str(), names(pass.writes).c_str(), pass.sideEffect ? " (side effect)" : "");
+        out << line;
+    }
+    for (const Pass& pass : passes) {
+        if (!pass.live) {
+            out << "  culled: " << pass.name << " (writes: " << names(pass.writes) << ")\n";
+        }
+    }
+
+    out << "Resources:\n";
+    for (const Resource& resource : resources) {
+        if (resource.imported) {
+            std::snprintf(line, sizeof(line), "  %-14s imported %s%s\n", resource.name.c_str(),
+                          resource.framebuffer ? "framebuffer" : "texture", resource.output ? ", output" : "");
+        } else if (resource.physical >= 0) {
+            std::snprintf(line, sizeof(line), "  %-14s %-18s texture %d, passes %d-%d, %.2f MB\n", resource.name.c_str(),
+                          describeDesc(resource.desc).c_str(), resource.physical, resource.firstUse + 1,
+                          resource.lastUse + 1, megabytes(resource.desc.getBytes()));
+        } else {
+            std::snprintf(line, sizeof(line), "  %-14s %-18s unused\n", resource.name.c_str(), describeDesc(resource.desc).c_str());
+        }
+        out << line;
+    }
+    return out.str();
+}
@@ -0,0 +1,189 @@
+#ifndef FRAME_GRAPH_H
+#define FRAME_GRAPH_H
+
+#include <glad/glad.h>
+#include <cstddef>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+// Handle of a texture or framebuffer declared for the current frame; -1 is none
+typedef int FrameGraphResource;
+const FrameGraphResource NO_RESOURCE = -1;
+
+struct FrameGraphTextureDesc {
+    unsigned int width = 0;
+    unsigned int height = 0;
+    // Sized internal format; depth formats attach as depth
+    GLenum format = GL_RGBA8;
+    // Above 1 allocates a GL_TEXTURE_2D_MULTISAMPLE, only usable as an attachment or blit source
+    int samples = 1;
+
+    bool operator==(const FrameGraphTextureDesc& other) const {
+        return width == other.width && height == other.height && format == other.format && samples == other.samples;
+    }
+    size_t getBytes() const;
+};
+
+struct FrameGraphStats {
+    int passes = 0;
+    int culledPasses = 0;
+    // Transient textures declared this frame, and the pooled textures that backed them
+    int transientTextures = 0;
+    int physicalTextures = 0;
+    // Most transient memory live at once, against what separate textures would need
+    size_t peakTransientBytes = 0;
+    size_t unaliasedTransientBytes = 0;
+    // Everything the pool holds, including textures idle this frame
+    size_t pooledBytes = 0;
+};
+
+class FrameGraph;
+
+// Given to a pass's setup function to declare what it touches. Writing a resource that
+// an earlier pass wrote keeps that pass: its content is loaded, not discarded.
+class FrameGraphPassBuilder {
+public:
+    // A transient texture, first written by this pass
+    FrameGraphResource create(const std::string& name, const FrameGraphTextureDesc& desc);
+    FrameGraphResource read(FrameGraphResource resource);
+    FrameGraphResource write(FrameGraphResource resource);
+    // Never culled, whether or not anything reads its results
+    void setSideEffect();
+
+private:
+    friend class FrameGraph;
+    FrameGraphPassBuilder(FrameGraph& graph, int pass) : graph(graph), pass(pass) {}
+
+    FrameGraph& graph;
+    int pass;
+};
+
+// Per-frame render graph. Each frame the renderer declares its passes with the resources
+// they read and write, then execute() culls passes whose results nothing uses, orders the
+// rest by their dependencies (declaration order breaks ties), and backs transient
+// textures with a pool. GL cannot alias raw memory, so aliasing means two transients
+// whose lifetimes don't overlap and whose descriptions match share one texture. Textures
+// and framebuffers owned elsewhere (shadow maps, TAA history, the window) are imported
+// and only take part in ordering and culling.
+class FrameGraph {
+public:
+    typedef std::function<void(FrameGraphPassBuilder&)> SetupFunction;
+    typedef std::function<void(FrameGraph&)> ExecuteFunction;
+
+    // Pooled textures unused for this many frames are released
+    static const int POOL_RETENTION_FRAMES = 60;
+
+    FrameGraph();
+    ~FrameGraph();
+
+    FrameGraph(const FrameGraph&) = delete;
+    FrameGraph& operator=(const FrameGraph&) = delete;
+
+    // Drops last frame's declarations; the pool and framebuffers stay
+    void reset();
+
+    FrameGraphResource createTexture(const std::string& name, const FrameGraphTextureDesc& desc);
+    // texture may be 0 for resources that only order passes (shadow maps written by their own FBOs)
+    FrameGraphResource importTexture(const std::string& name, GLuint texture, const FrameGraphTextureDesc& desc);
+    FrameGraphResource importFramebuffer(const std::string& name, GLuint framebuffer, unsigned int width, unsigned int height);
+    // Presented or read back after the frame: its writers are never culled
+    void markOutput(FrameGraphResource resource);
+
+    // setup runs immediately; execute runs from execute() if the pass survives culling
+    void addPass(const std::string& name, const SetupFunction& setup, const ExecuteFunction& execute);
+
+    // Compiles and runs the frame. Each pass is timed as a GPU profiler pass of its name.
+    void execute();
+
+    // For pass execute functions
+    GLuint getTexture(FrameGraphResource resource) const;
+    const FrameGraphTextureDesc& getDesc(FrameGraphResource resource) const;
+    // Binds a framebuffer with these attachments (cached per texture set), or the imported
+    // framebuffer when color is one; the viewport is left to the pass
+    void bindRenderTarget(const std::vector<FrameGraphResource>& colors, FrameGraphResource depth = NO_RESOURCE);
+    // The same framebuffer without binding it, e.g. as a blit source
+    GLuint getFramebuffer(const std::vector<FrameGraphResource>& colors, FrameGraphResource depth = NO_RESOURCE);
+
+    const FrameGraphStats& getStats() const { return stats; }
+    // Pass list of the last executed frame: order, culled passes, resources and memory
+    std::string dump() const;
+    // Writes dump() after the next execute()
+    void requestDump(const std::string& path) { dumpPath = path; }
+
+private:
+    friend class FrameGraphPassBuilder;
+
+    struct Resource {
+        std::string name;
+        FrameGraphTextureDesc desc;
+        bool imported = false;
+        bool framebuffer = false;
+        bool output = false;
+        GLuint texture = 0;
+        GLuint importedFramebuffer = 0;
+        // Declaration indices of the passes that write and read it
+        std::vector<int> writers;
+        std::vector<int> readers;
+        // Position in the execution order of its first and last live use
+        int firstUse = -1;
+        int lastUse = -1;
+        int physical = -1;
+        bool needed = false;
+    };
+
+    struct Pass {
+        std::string name;
+        ExecuteFunction execute;
+        std::vector<FrameGraphResource> reads;
+        std::vector<FrameGraphResource> writes;
+        bool sideEffect = false;
+        bool live = false;
+    };
+
+    struct PooledTexture {
+        FrameGraphTextureDesc desc;
+        GLuint texture = 0;
+        bool inUse = false;
+        int idleFrames = 0;
+    };
+
+    std::vector<Resource> resources;
+    std::vector<Pass> passes;
+    // Live passes, in execution order
+    std::vector<int> order;
+    std::vector<PooledTexture> pool;
+    std::map<std::vector<GLuint>, GLuint> framebuffers;
+    FrameGraphStats stats;
+    std::string dumpPath;
+
+    bool isValid(FrameGraphResource resource) const {
+        return resource >= 0 && resource < static_cast<int>(resources.size());
+    }
+    void cull();
+    bool sortPasses();
+    void allocateTransients();
+    int acquireTexture(const FrameGraphTextureDesc& desc);
+    void releaseIdleTextures();
+    void clearFramebuffers();
+};
+
+// The main scene's attachments for one frame: declared by DynamicResolution, drawn into by
+// the scene's passes. Only the lower left width x height region is rendered.
+struct SceneTargets {
+    FrameGraphResource color = NO_RESOURCE;
+    FrameGraphResource depth = NO_RESOURCE;
+    // Only with temporal AA
+    FrameGraphResource velocity = NO_RESOURCE;
+    unsigned int width = 0;
+    unsigned int height = 0;
+
+    std::vector<FrameGraphResource> getColorAttachments() const {
+        std::vector<FrameGraphResource> colors(1, color);
+        if (velocity != NO_RESOURCE) colors.push_back(velocity);
+        return colors;
+    }
+};
+
+#endif // FRAME_GRAPH_H
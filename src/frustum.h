@@ -0,0 +1,23 @@
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include <glm/glm.hpp>
+
+// Six planes extracted from a view-projection matrix (Gribb/Hartmann), normals pointing inward
+class Frustum {
+public:
+    Frustum() = default;
+    explicit Frustum(const glm::mat4& viewProjection);
+
+    // Conservative: boxes straddling a corner outside all planes still count as visible
+    bool intersectsAABB(const glm::vec3& min, const glm::vec3& max) const;
+
+private:
+    glm::vec4 planes[6];
+};
+
+// World-space AABB of a transformed local AABB
+void transformAABB(const glm::mat4& transform, const glm::vec3& localMin, const glm::vec3& localMax,
+                   glm::vec3& worldMin, glm::vec3& worldMax);
+
+#endif // FRUSTUM_H
@@ -0,0 +1,79 @@
+#include "glExtensions.h"
+#include <cstring>
+#include <iostream>
+
+PFNGLEXTDEBUGMESSAGECALLBACKPROC glext_glDebugMessageCallback = nullptr;
+PFNGLEXTDEBUGMESSAGECONTROLPROC glext_glDebugMessageControl = nullptr;
+PFNGLEXTPUSHDEBUGGROUPPROC glext_glPushDebugGroup = nullptr;
+PFNGLEXTPOPDEBUGGROUPPROC glext_glPopDebugGroup = nullptr;
+PFNGLEXTGETPROGRAMBINARYPROC glext_glGetProgramBinary = nullptr;
+PFNGLEXTPROGRAMBINARYPROC glext_glProgramBinary = nullptr;
+PFNGLEXTPROGRAMPARAMETERIPROC glext_glProgramParameteri = nullptr;
+PFNGLEXTBUFFERSTORAGEPROC glext_glBufferStorage = nullptr;
+
+static GLExtensionSupport extensionSupport;
+
+static bool versionAtLeast(int major, int minor) {
+    return extensionSupport.majorVersion > major ||
+           (extensionSupport.majorVersion == major && extensionSupport.minorVersion >= minor);
+}
+
+bool hasGLExtension(const char* name) {
+    GLint count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (GLint i = 0; i < count; ++i) {
+        const char* ext = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, i));
+        if (ext && std::strcmp(ext, name) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool loadGLExtensions(GLADloadproc load) {
+    if (!load) {
+        std::cerr << "loadGLExtensions: no proc address loader" << std::endl;
+        return false;
+    }
+
+    glGetIntegerv(GL_MAJOR_VERSION, &extensionSupport.majorVersion);
+    glGetIntegerv(GL_MINOR_VERSION, &extensionSupport.minorVersion);
+
+    // Core 4.3 exports the unsuffixed names; the KHR extension on a core profile does too
+    if (versionAtLeast(4, 3) || hasGLExtension("GL_KHR_debug")) {
+        glext_glDebugMessageCallback = (PFNGLEXTDEBUGMESSAGECALLBACKPROC)load("glDebugMessageCallback");
+        glext_glDebugMessageControl = (PFNGLEXTDEBUGMESSAGECONTROLPROC)load("glDebugMessageControl");
+        glext_glPushDebugGroup = (PFNGLEXTPUSHDEBUGGROUPPROC)load("glPushDebugGroup");
+        glext_glPopDebugGroup = (PFNGLEXTPOPDEBUGGROUPPROC)load("glPopDebugGroup");
+        extensionSupport.khrDebug = glext_glDebugMessageCallback && glext_glDebugMessageControl;
+    }
+
+    if (versionAtLeast(4, 1) || hasGLExtension("GL_ARB_get_program_binary")) {
+        glext_glGetProgramBinary = (PFNGLEXTGETPROGRAMBINARYPROC)load("glGetProgramBinary");
+        glext_glProgramBinary = (PFNGLEXTPROGRAMBINARYPROC)load("glProgramBinary");
+        glext_glProgramParameteri = (PFNGLEXTPROGRAMPARAMETERIPROC)load("glProgramParameteri");
+        GLint formatCount = 0;
+        if (glext_glGetProgramBinary && glext_glProgramBinary && glext_glProgramParameteri) {
+            glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+        }
+        extensionSupport.programBinary = formatCount > 0;
+    }
+
+    if (versionAtLeast(4, 4) || hasGLExtension("GL_ARB_buffer_storage")) {
+        glext_glBufferStorage = (PFNGLEXTBUFFERSTORAGEPROC)load("glBufferStorage");
+        extensionSupport.bufferStorage = glext_glBufferStorage != nullptr;
+    }
+
+    // Only a texture parameter and a limit, no entry points
+    if (versionAtLeast(4, 6) || hasGLExtension("GL_EXT_texture_filter_anisotropic") ||
+        hasGLExtension("GL_ARB_texture_filter_anisotropic")) {
+        glGetFloatv(GL_MAX_TEXTURE_MAX_ANISOTROPY_EXT, &extensionSupport.maxAnisotropy);
+        extensionSupport.textureFilterAnisotropic = extensionSupport.maxAnisotropy > 1.0f;
+    }
+
+    return true;
+}
+
+const GLExtensionSupport& getGLExtensions() {
+    return extensionSupport;
+}
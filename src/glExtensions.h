@@ -0,0 +1,104 @@
+#ifndef GL_EXTENSIONS_H
+#define GL_EXTENSIONS_H
+
+#include <glad/glad.h>
+
+// glad is generated for core 3.3 with no extensions. Entry points the renderer can use
+// when the driver offers them are loaded here, glad-style, so call sites read like plain GL.
+
+struct GLExtensionSupport {
+    int majorVersion = 0;
+    int minorVersion = 0;
+    bool khrDebug = false;
+    bool programBinary = false;
+    bool bufferStorage = false;
+    // EXT/ARB_texture_filter_anisotropic (core in 4.6); maxAnisotropy is 1 without it
+    bool textureFilterAnisotropic = false;
+    float maxAnisotropy = 1.0f;
+};
+
+// Must be called after gladLoadGL with the same proc-address function the context uses
+bool loadGLExtensions(GLADloadproc load);
+const GLExtensionSupport& getGLExtensions();
+bool hasGLExtension(const char* name);
+
+// KHR_debug (core in 4.3)
+#ifndef GL_DEBUG_OUTPUT
+#define GL_DEBUG_OUTPUT_SYNCHRONOUS 0x8242
+#define GL_DEBUG_SOURCE_API 0x8246
+#define GL_DEBUG_SOURCE_WINDOW_SYSTEM 0x8247
+#define GL_DEBUG_SOURCE_SHADER_COMPILER 0x8248
+#define GL_DEBUG_SOURCE_THIRD_PARTY 0x8249
+#define GL_DEBUG_SOURCE_APPLICATION 0x824A
+#define GL_DEBUG_SOURCE_OTHER 0x824B
+#define GL_DEBUG_TYPE_ERROR 0x824C
+#define GL_DEBUG_TYPE_DEPRECATED_BEHAVIOR 0x824D
+#define GL_DEBUG_TYPE_UNDEFINED_BEHAVIOR 0x824E
+#define GL_DEBUG_TYPE_PORTABILITY 0x824F
+#define GL_DEBUG_TYPE_PERFORMANCE 0x8250
+#define GL_DEBUG_TYPE_OTHER 0x8251
+#define GL_DEBUG_TYPE_MARKER 0x8268
+#define GL_DEBUG_TYPE_PUSH_GROUP 0x8269
+#define GL_DEBUG_TYPE_POP_GROUP 0x826A
+#define GL_DEBUG_SEVERITY_HIGH 0x9146
+#define GL_DEBUG_SEVERITY_MEDIUM 0x9147
+#define GL_DEBUG_SEVERITY_LOW 0x9148
+#define GL_DEBUG_SEVERITY_NOTIFICATION 0x826B
+#define GL_DEBUG_OUTPUT 0x92E0
+#define GL_CONTEXT_FLAG_DEBUG_BIT 0x00000002
+#endif
+
+typedef void (APIENTRYP PFNGLEXTDEBUGMESSAGECALLBACKPROC)(GLDEBUGPROC callback, const void* userParam);
+typedef void (APIENTRYP PFNGLEXTDEBUGMESSAGECONTROLPROC)(GLenum source, GLenum type, GLenum severity, GLsizei count, const GLuint* ids, GLboolean enabled);
+typedef void (APIENTRYP PFNGLEXTPUSHDEBUGGROUPPROC)(GLenum source, GLuint id, GLsizei length, const GLchar* message);
+typedef void (APIENTRYP PFNGLEXTPOPDEBUGGROUPPROC)(void);
+
+extern PFNGLEXTDEBUGMESSAGECALLBACKPROC glext_glDebugMessageCallback;
+extern PFNGLEXTDEBUGMESSAGECONTROLPROC glext_glDebugMessageControl;
+extern PFNGLEXTPUSHDEBUGGROUPPROC glext_glPushDebugGroup;
+extern PFNGLEXTPOPDEBUGGROUPPROC glext_glPopDebugGroup;
+#define glDebugMessageCallback glext_glDebugMessageCallback
+#define glDebugMessageControl glext_glDebugMessageControl
+#define glPushDebugGroup glext_glPushDebugGroup
+#define glPopDebugGroup glext_glPopDebugGroup
+
+// ARB_get_program_binary (core in 4.1). A driver may expose the entry points yet
+// report zero binary formats, in which case programBinary stays false.
+#ifndef GL_PROGRAM_BINARY_LENGTH
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#define GL_PROGRAM_BINARY_FORMATS 0x87FF
+#endif
+
+typedef void (APIENTRYP PFNGLEXTGETPROGRAMBINARYPROC)(GLuint program, GLsizei bufSize, GLsizei* length, GLenum* binaryFormat, void* binary);
+typedef void (APIENTRYP PFNGLEXTPROGRAMBINARYPROC)(GLuint program, GLenum binaryFormat, const void* binary, GLsizei length);
+typedef void (APIENTRYP PFNGLEXTPROGRAMPARAMETERIPROC)(GLuint program, GLenum pname, GLint value);
+
+extern PFNGLEXTGETPROGRAMBINARYPROC glext_glGetProgramBinary;
+extern PFNGLEXTPROGRAMBINARYPROC glext_glProgramBinary;
+extern PFNGLEXTPROGRAMPARAMETERIPROC glext_glProgramParameteri;
+#define glGetProgramBinary glext_glGetProgramBinary
+#define glProgramBinary glext_glProgramBinary
+#define glProgramParameteri glext_glProgramParameteri
+
+// ARB_buffer_storage (core in 4.4): immutable storage that can stay mapped while the GPU reads it
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#define GL_MAP_COHERENT_BIT 0x0080
+#define GL_DYNAMIC_STORAGE_BIT 0x0100
+#define GL_CLIENT_STORAGE_BIT 0x0200
+#endif
+
+typedef void (APIENTRYP PFNGLEXTBUFFERSTORAGEPROC)(GLenum target, GLsizeiptr size, const void* data, GLbitfield flags);
+
+extern PFNGLEXTBUFFERSTORAGEPROC glext_glBufferStorage;
+#define glBufferStorage glext_glBufferStorage
+
+// EXT_texture_filter_anisotropic; the ARB extension and 4.6 use the same values
+#ifndef GL_TEXTURE_MAX_ANISOTROPY_EXT
+#define GL_TEXTURE_MAX_ANISOTROPY_EXT 0x84FE
+#define GL_MAX_TEXTURE_MAX_ANISOTROPY_EXT 0x84FF
+#endif
+
+#endif // GL_EXTENSIONS_H
@@ -0,0 +1,199 @@
+#include "glState.h"
+
+GLStateCache::GLStateCache() : viewportRect{0, 0, 0, 0} {
+    invalidate();
+}
+
+void GLStateCache::invalidate() {
+    program = UNKNOWN;
+    vertexArray = UNKNOWN;
+    activeUnit = UNKNOWN;
+    for (auto& unit : textures) {
+        for (GLuint& texture : unit) {
+            texture = UNKNOWN;
+        }
+    }
+    framebuffer = UNKNOWN;
+    // The rectangle is kept so getViewport() stays usable; only the next set is forced
+    viewportKnown = false;
+    cullFace = -1;
+    depthTest = -1;
+    depthWrite = -1;
+    cullMode = UNKNOWN;
+    depthCompare = UNKNOWN;
+}
+
+void GLStateCache::useProgram(GLuint newProgram) {
+    if (program == newProgram) {
+        stats.skipped++;
+        return;
+    }
+    glUseProgram(newProgram);
+    program = newProgram;
+    stats.issued++;
+}
+
+void GLStateCache::bindVertexArray(GLuint vao) {
+    if (vertexArray == vao) {
+        stats.skipped++;
+        return;
+    }
+    glBindVertexArray(vao);
+    vertexArray = vao;
+    stats.issued++;
+}
+
+void GLStateCache::selectUnit(GLuint unit) {
+    if (activeUnit == unit) {
+        return;
+    }
+    glActiveTexture(GL_TEXTURE0 + unit);
+    activeUnit = unit;
+    stats.issued++;
+}
+
+int GLStateCache::targetSlot(GLenum target) {
+    switch (target) {
+        case GL_TEXTURE_2D: return 0;
+        case GL_TEXTURE_CUBE_MAP: return 1;
+        case GL_TEXTURE_BUFFER: return 2;
+        case GL_TEXTURE_2D_ARRAY: return 3;
+        default: return -1;
+    }
+}
+
+void GLStateCache::bindTexture(GLuint unit, GLenum target, GLuint texture) {
+    int slot = targetSlot(target);
+    if (slot < 0 || unit >= MAX_TEXTURE_UNITS) {
+        selectUnit(unit);
+        glBindTexture(target, texture);
+        stats.issued++;
+        return;
+    }
+    if (textures[unit][slot] == texture) {
+        stats.skipped++;
+        return;
+    }
+    selectUnit(unit);
+    glBindTexture(target, texture);
+    textures[unit][slot] = texture;
+    stats.issued++;
+}
+
+void GLStateCache::bindFramebuffer(GLuint newFramebuffer) {
+    if (framebuffer == newFramebuffer) {
+        stats.skipped++;
+        return;
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, newFramebuffer);
+    framebuffer = newFramebuffer;
+    stats.issued++;
+}
+
+void GLStateCache::viewport(GLint x, GLint y, GLsizei width, GLsizei height) {
+    if (viewportKnown && viewportRect[0] == x && viewportRect[1] == y &&
+        viewportRect[2] == width && viewportRect[3] == height) {
+        stats.skipped++;
+        return;
+    }
+    glViewport(x, y, width, height);
+    viewportRect[0] = x;
+    viewportRect[1] = y;
+    viewportRect[2] = width;
+    viewportRect[3] = height;
+    viewportKnown = true;
+    stats.issued++;
+}
+
+void GLStateCache::setCapability(GLenum capability, bool enabled, int& shadow, GLStateStats& stats) {
+    int value = enabled ? 1 : 0;
+    if (shadow == value) {
+        stats.skipped++;
+        return;
+    }
+    if (enabled) {
+        glEnable(capability);
+    } else {
+        glDisable(capability);
+    }
+    shadow = value;
+    stats.issued++;
+}
+
+void GLStateCache::setCullFace(bool enabled) {
+    setCapability(GL_CULL_FACE, enabled, cullFace, stats);
+}
+
+void GLStateCache::setDepthTest(bool enabled) {
+    setCapability(GL_DEPTH_TEST, enabled, depthTest, stats);
+}
+
+void GLStateCache::cullFaceMode(GLenum mode) {
+    if (cullMode == mode) {
+        stats.skipped++;
+        return;
+    }
+    glCullFace(mode);
+    cullMode = mode;
+    stats.issued++;
+}
+
+void GLStateCache::depthFunc(GLenum func) {
+    if (depthCompare == func) {
+        stats.skipped++;
+        return;
+    }
+    glDepthFunc(func);
+    depthCompare = func;
+    stats.issued++;
+}
+
+void GLStateCache::depthMask(bool enabled) {
+    int value = enabled ? 1 : 0;
+    if (depthWrite == value) {
+        stats.skipped++;
+        return;
+    }
+    glDepthMask(enabled ? GL_TRUE : GL_FALSE);
+    depthWrite = value;
+    stats.issued++;
+}
+
+void GLStateCache::programDeleted(GLuint deleted) {
+    // A deleted program stays in use until another is bound, so its name is not safe to skip on
+    if (program == deleted) {
+        program = UNKNOWN;
+    }
+}
+
+void GLStateCache::vertexArrayDeleted(GLuint deleted) {
+    if (vertexArray == deleted) {
+        vertexArray = 0;
+    }
+}
+
+void GLStateCache::textureDeleted(GLuint deleted) {
+    for (auto& unit : textures) {
+        for (GLuint& texture : unit) {
+            if (texture == deleted) {
+                texture = 0;
+            }
+        }
+    }
+}
+
+void GLStateCache::framebufferDeleted(GLuint deleted) {
+    if (framebuffer == deleted) {
+        framebuffer = 0;
+    }
+}
+
+void GLStateCache::beginFrame() {
+    lastFrameStats = stats;
+    stats = GLStateStats();
+}
+
+GLStateCache& getGLState() {
+    static GLStateCache cache;
+    return cache;
+}
@@ -0,0 +1,84 @@
+#ifndef GL_STATE_H
+#define GL_STATE_H
+
+#include <glad/glad.h>
+#include <cstdint>
+
+struct GLStateStats {
+    uint64_t issued = 0;
+    uint64_t skipped = 0;
+};
+
+// Shadow copy of the GL state the renderer touches every frame: bound program, VAO,
+// textures per unit, draw framebuffer, viewport, face culling and depth state. Setters
+// compare against the shadow and only reach the driver when something changes, so the
+// frame never needs a glGet to save and restore state. Code outside the renderer that
+// changes GL state behind its back (ImGui) must be followed by invalidate().
+class GLStateCache {
+public:
+    static const unsigned int MAX_TEXTURE_UNITS = 32;
+
+    GLStateCache();
+
+    // Forget everything; the next call of each setter always reaches the driver
+    void invalidate();
+
+    void useProgram(GLuint program);
+    void bindVertexArray(GLuint vao);
+    // Selects the unit only when the binding has to change
+    void bindTexture(GLuint unit, GLenum target, GLuint texture);
+    void bindFramebuffer(GLuint framebuffer);
+    void viewport(GLint x, GLint y, GLsizei width, GLsizei height);
+    void setCullFace(bool enabled);
+    void cullFaceMode(GLenum mode);
+    void setDepthTest(bool enabled);
+    void depthFunc(GLenum func);
+    void depthMask(bool enabled);
+
+    // Deleting a bound object silently rebinds 0 and frees the name for reuse, so owners
+    // report deletions to keep a recycled name from being skipped as already bound
+    void programDeleted(GLuint deleted);
+    void vertexArrayDeleted(GLuint deleted);
+    void textureDeleted(GLuint deleted);
+    void framebufferDeleted(GLuint deleted);
+
+    // Last viewport and framebuffer set through the cache, for passes that render elsewhere
+    // and come back. An unknown framebuffer reads as 0, the window.
+    const GLint* getViewport() const { return viewportRect; }
+    GLuint getFramebuffer() const { return framebuffer == UNKNOWN ? 0 : framebuffer; }
+
+    // Counters of the frame in progress; beginFrame() moves them into getLastFrameStats()
+    void beginFrame();
+    const GLStateStats& getStats() const { return stats; }
+    const GLStateStats& getLastFrameStats() const { return lastFrameStats; }
+
+private:
+    // 2D, cube map, buffer and 2D array textures are tracked; other targets always reach the driver
+    static const int TRACKED_TARGETS = 4;
+    static const GLuint UNKNOWN = 0xFFFFFFFFu;
+
+    GLuint program;
+    GLuint vertexArray;
+    GLuint activeUnit;
+    GLuint textures[MAX_TEXTURE_UNITS][TRACKED_TARGETS];
+    GLuint framebuffer;
+    GLint viewportRect[4];
+    bool viewportKnown;
+    // -1 unknown, otherwise 0/1
+    int cullFace;
+    int depthTest;
+    int depthWrite;
+    GLenum cullMode;
+    GLenum depthCompare;
+
+    GLStateStats stats;
+    GLStateStats lastFrameStats;
+
+    void selectUnit(GLuint unit);
+    static int targetSlot(GLenum target);
+    static void setCapability(GLenum capability, bool enabled, int& shadow, GLStateStats& stats);
+};
+
+GLStateCache& getGLState();
+
+#endif // GL_STATE_H
@@ -0,0 +1,267 @@
+#include "gpuProfiler.h"
+#include "cpuProfiler.h"
+#include "log.h"
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+
+namespace {
+
+const char* FRAME_PASS = "Frame";
+
+// Nearest-rank percentile of an ascending list
+float percentile(const std::vector<float>& sorted, float p) {
+    if (sorted.empty()) return 0.0f;
+    size_t rank = static_cast<size_t>(std::ceil(p * sorted.size()));
+    return sorted[std::min(sorted.size(), std::max<size_t>(rank, 1)) - 1];
+}
+
+void summarize(std::vector<float>& sorted, GpuPassStats& stats) {
+    stats.samples = sorted.size();
+    if (sorted.empty()) return;
+    std::sort(sorted.begin(), sorted.end());
+    float sum = 0.0f;
+    for (float sample : sorted) sum += sample;
+    stats.averageMs = sum / sorted.size();
+    stats.p50Ms = percentile(sorted, 0.50f);
+    stats.p95Ms = percentile(sorted, 0.95f);
+    stats.p99Ms = percentile(sorted, 0.99f);
+    stats.maxMs = sorted.back();
+}
+
+std::string escapeJSON(const std::string& text) {
+    std::string escaped;
+    for (char c : text) {
+        if (c == '"' || c == '\\') escaped += '\\';
+        escaped += c;
+    }
+    return escaped;
+}
+
+} // namespace
+
+GpuProfiler::GpuProfiler()
+    : enabled(true), inFrame(false), frameIndex(0), droppedFrames(0), recording(false), recordedFrames(0) {
+}
+
+void GpuProfiler::releaseQueries() {
+    for (QueryFrame& frame : frames) {
+        if (!frame.queryPool.empty()) {
+            glDeleteQueries(static_cast<GLsizei>(frame.queryPool.size()), frame.queryPool.data());
+        }
+        frame = QueryFrame();
+    }
+    inFrame = false;
+    openPasses.clear();
+}
+
+int GpuProfiler::getPassIndex(const std::string& name) {
+    auto it = passIndices.find(name);
+    if (it != passIndices.end()) {
+        return it->second;
+    }
+    PassHistory history;
+    history.name = name;
+    history.samples.resize(HISTORY_FRAMES, 0.0f);
+    passes.push_back(std::move(history));
+    int index = static_cast<int>(passes.size()) - 1;
+    passIndices.emplace(name, index);
+    return index;
+}
+
+GLuint GpuProfiler::acquireQuery(QueryFrame& frame) {
+    if (frame.queriesUsed == frame.queryPool.size()) {
+        GLuint query = 0;
+        glGenQueries(1, &query);
+        frame.queryPool.push_back(query);
+    }
+    return frame.queryPool[frame.queriesUsed++];
+}
+
+void GpuProfiler::beginFrame() {
+    if (!enabled || inFrame) return;
+
+    frameIndex = (frameIndex + 1) % QUERY_FRAMES;
+    QueryFrame& frame = frames[frameIndex];
+    if (frame.pending) {
+        collect(frame);
+    }
+    frame.queriesUsed = 0;
+    frame.timed.clear();
+    frame.submitNs = CpuProfiler::nowNs();
+    frame.recorded = recording;
+    openPasses.clear();
+    inFrame = true;
+
+    beginPass(FRAME_PASS);
+}
+
+void GpuProfiler::endFrame() {
+    if (!inFrame) return;
+    while (!openPasses.empty()) {
+        endPass();
+    }
+    frames[frameIndex].pending = true;
+    inFrame = false;
+}
+
+void GpuProfiler::beginPass(const std::string& name) {
+    if (!inFrame) return;
+    QueryFrame& frame = frames[frameIndex];
+    TimedPass timed;
+    timed.pass = getPassIndex(name);
+    timed.beginQuery = acquireQuery(frame);
+    timed.endQuery = 0;
+    glQueryCounter(timed.beginQuery, GL_TIMESTAMP);
+    frame.timed.push_back(timed);
+    openPasses.push_back(frame.timed.size() - 1);
+}
+
+void GpuProfiler::endPass() {
+    if (!inFrame || openPasses.empty()) return;
+    QueryFrame& frame = frames[frameIndex];
+    TimedPass& timed = frame.timed[openPasses.back()];
+    timed.endQuery = acquireQuery(frame);
+    glQueryCounter(timed.endQuery, GL_TIMESTAMP);
+    openPasses.pop_back();
+}
+
+void GpuProfiler::collect(QueryFrame& frame) {
+    frame.pending = false;
+    if (frame.queriesUsed == 0) return;
+
+    // Queries complete in order, so the last one issued answers for the whole frame
+    GLuint available = 0;
+    glGetQueryObjectuiv(frame.queryPool[frame.queriesUsed - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available) {
+        droppedFrames++;
+        return;
+    }
+
+    CpuProfiler& cpuProfiler = getCpuProfiler();
+    bool tracing = cpuProfiler.isCaptureActive();
+    for (const TimedPass& timed : frame.timed) {
+        if (timed.endQuery == 0) continue;
+        GLuint64 begin = 0, end = 0;
+        glGetQueryObjectui64v(timed.beginQuery, GL_QUERY_RESULT, &begin);
+        glGetQueryObjectui64v(timed.endQuery, GL_QUERY_RESULT, &end);
+        PassHistory& history = passes[timed.pass];
+        if (tracing) {
+            cpuProfiler.recordGpuZone(history.name, frame.submitNs, begin, end);
+        }
+        history.frameTotal += end > begin ? static_cast<float>(end - begin) / 1.0e6f : 0.0f;
+        history.seenThisFrame = true;
+    }
+
+    if (frame.recorded) {
+        recordedFrames++;
+    }
+    for (PassHistory& history : passes) {
+        if (!history.seenThisFrame) continue;
+        if (frame.recorded) {
+            history.recorded.push_back(history.frameTotal);
+        }
+        history.last = history.frameTotal;
+        history.samples[history.next] = history.frameTotal;
+        history.next = (history.next + 1) % HISTORY_FRAMES;
+        if (history.count < HISTORY_FRAMES) {
+            history.count++;
+        }
+        history.frameTotal = 0.0f;
+        history.seenThisFrame = false;
+    }
+}
+
+std::vector<GpuPassStats> GpuProfiler::getStats() const {
+    std::vector<GpuPassStats> result;
+    std::vector<float> sorted;
+    for (const PassHistory& history : passes) {
+        GpuPassStats stats;
+        stats.name = history.name;
+        stats.samples = history.count;
+        stats.lastMs = history.last;
+        sorted.assign(history.samples.begin(), history.samples.begin() + history.count);
+        summarize(sorted, stats);
+        result.push_back(stats);
+    }
+    return result;
+}
+
+void GpuProfiler::clearRecording() {
+    for (PassHistory& history : passes) {
+        history.recorded.clear();
+    }
+    recordedFrames = 0;
+}
+
+std::vector<GpuPassStats> GpuProfiler::getRecordedStats() const {
+    std::vector<GpuPassStats> result;
+    std::vector<float> sorted;
+    for (const PassHistory& history : passes) {
+        if (history.recorded.empty()) continue;
+        GpuPassStats stats;
+        stats.name = history.name;
+        stats.lastMs = history.recorded.back();
+        sorted = history.recorded;
+        summarize(sorted, stats);
+        result.push_back(stats);
+    }
+    return result;
+}
+
+std::vector<float> GpuProfiler::getFrameHistory() const {
+    std::vector<float> history;
+    auto it = passIndices.find(FRAME_PASS);
+    if (it == passIndices.end()) return history;
+
+    const PassHistory& frame = passes[it->second];
+    size_t start = frame.count < HISTORY_FRAMES ? 0 : frame.next;
+    for (size_t i = 0; i < frame.count; ++i) {
+        history.push_back(frame.samples[(start + i) % HISTORY_FRAMES]);
+    }
+    return history;
+}
+
+bool GpuProfiler::exportCSV(const std::string& path) const {
+    std::ofstream out(path);
+    if (!out) {
+        LOG_ERROR(Render, "Could not write GPU profile to %s", path.c_str());
+        return false;
+    }
+    out << "pass,samples,last_ms,avg_ms,p50_ms,p95_ms,p99_ms,max_ms\n";
+    out << std::fixed << std::setprecision(4);
+    for (const GpuPassStats& stats : getStats()) {
+        out << stats.name << ',' << stats.samples << ',' << stats.lastMs << ',' << stats.averageMs << ','
+            << stats.p50Ms << ',' << stats.p95Ms << ',' << stats.p99Ms << ',' << stats.maxMs << '\n';
+    }
+    LOG_INFO(Render, "GPU profile written to %s", path.c_str());
+    return true;
+}
+
+bool GpuProfiler::exportJSON(const std::string& path) const {
+    std::ofstream out(path);
+    if (!out) {
+        LOG_ERROR(Render, "Could not write GPU profile to %s", path.c_str());
+        return false;
+    }
+    std::vector<GpuPassStats> all = getStats();
+    out << std::fixed << std::setprecision(4);
+    out << "{\n  \"historyFrames\": " << HISTORY_FRAMES << ",\n  \"droppedFrames\": " << droppedFrames << ",\n  \"passes\": [\n";
+    for (size_t i = 0; i < all.size(); ++i) {
+        const GpuPassStats& stats = all[i];
+        out << "    {\"name\": \"" << escapeJSON(stats.name) << "\", \"samples\": " << stats.samples
+            << ", \"lastMs\": " << stats.lastMs << ", \"avgMs\": " << stats.averageMs
+            << ", \"p50Ms\": " << stats.p50Ms << ", \"p95Ms\": " << stats.p95Ms
+            << ", \"p99Ms\": " << stats.p99Ms << ", \"maxMs\": " << stats.maxMs << "}"
+            << (i + 1 < all.size() ? ",\n" : "\n");
+    }
+    out << "  ]\n}\n";
+    LOG_INFO(Render, "GPU profile written to %s", path.c_str());
+    return true;
+}
+
+GpuProfiler& getGpuProfiler() {
+    static GpuProfiler profiler;
+    return profiler;
+}
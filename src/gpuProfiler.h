@@ -0,0 +1,123 @@
+#ifndef GPU_PROFILER_H
+#define GPU_PROFILER_H
+
+#include <glad/glad.h>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Summary of one pass over the recorded history, in milliseconds
+struct GpuPassStats {
+    std::string name;
+    size_t samples = 0;
+    float lastMs = 0.0f;
+    float averageMs = 0.0f;
+    float p50Ms = 0.0f;
+    float p95Ms = 0.0f;
+    float p99Ms = 0.0f;
+    float maxMs = 0.0f;
+};
+
+// Times render passes with GL_TIMESTAMP query pairs. Timestamps rather than
+// GL_TIME_ELAPSED so passes may nest inside the whole-frame "Frame" pass. Each frame's
+// queries are read QUERY_FRAMES frames later and only once the GPU reports them available,
+// so collecting never waits on the driver; a frame still in flight by then is dropped.
+class GpuProfiler {
+public:
+    // Matches the upload ring's depth: the GPU may legitimately run that far behind
+    static const unsigned int QUERY_FRAMES = 3;
+    // Frames of history kept per pass for the averages and percentiles
+    static const size_t HISTORY_FRAMES = 240;
+
+    GpuProfiler();
+
+    GpuProfiler(const GpuProfiler&) = delete;
+    GpuProfiler& operator=(const GpuProfiler&) = delete;
+
+    void setEnabled(bool enabled) { this->enabled = enabled; }
+    bool isEnabled() const { return enabled; }
+
+    // Collects the oldest finished frame and starts timing the "Frame" pass
+    void beginFrame();
+    void endFrame();
+
+    // A pass used several times in one frame (or nested in itself) is summed
+    void beginPass(const std::string& name);
+    void endPass();
+
+    // Statistics of every pass seen so far, in first-use order
+    std::vector<GpuPassStats> getStats() const;
+
+    // Frames begun while recording keep all their samples (not just the last HISTORY_FRAMES),
+    // for benchmarks. Their results arrive QUERY_FRAMES frames after recording stops.
+    void setRecording(bool recording) { this->recording = recording; }
+    void clearRecording();
+    std::vector<GpuPassStats> getRecordedStats() const;
+    int getRecordedFrames() const { return recordedFrames; }
+    // Frame times of the "Frame" pass, oldest first, for plotting
+    std::vector<float> getFrameHistory() const;
+    int getDroppedFrames() const { return droppedFrames; }
+
+    // The profiler is a global that outlives the context; call before it is destroyed
+    void releaseQueries();
+
+    bool exportCSV(const std::string& path) const;
+    bool exportJSON(const std::string& path) const;
+
+private:
+    struct TimedPass {
+        int pass;
+        GLuint beginQuery;
+        GLuint endQuery;
+    };
+
+    struct QueryFrame {
+        std::vector<GLuint> queryPool;
+        size_t queriesUsed = 0;
+        std::vector<TimedPass> timed;
+        uint64_t submitNs = 0;      // CPU clock at beginFrame, to place the frame in a trace
+        bool pending = false;
+        bool recorded = false;
+    };
+
+    struct PassHistory {
+        std::string name;
+        std::vector<float> samples; // ring of HISTORY_FRAMES
+        size_t next = 0;
+        size_t count = 0;
+        float last = 0.0f;
+        float frameTotal = 0.0f;    // accumulator while collecting one frame
+        bool seenThisFrame = false;
+        std::vector<float> recorded;
+    };
+
+    bool enabled;
+    bool inFrame;
+    unsigned int frameIndex;
+    QueryFrame frames[QUERY_FRAMES];
+    std::vector<size_t> openPasses; // indices into the current frame's timed list
+    std::vector<PassHistory> passes;
+    std::unordered_map<std::string, int> passIndices;
+    int droppedFrames;
+    bool recording;
+    int recordedFrames;
+
+    int getPassIndex(const std::string& name);
+    GLuint acquireQuery(QueryFrame& frame);
+    void collect(QueryFrame& frame);
+};
+
+GpuProfiler& getGpuProfiler();
+
+// Times the enclosing scope as one pass
+class GpuProfileScope {
+public:
+    explicit GpuProfileScope(const std::string& name) { getGpuProfiler().beginPass(name); }
+    ~GpuProfileScope() { getGpuProfiler().endPass(); }
+
+    GpuProfileScope(const GpuProfileScope&) = delete;
+    GpuProfileScope& operator=(const GpuProfileScope&) = delete;
+};
+
+#endif // GPU_PROFILER_H
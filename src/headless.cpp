@@ -0,0 +1,397 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+#include <glad/glad.h>
+#include "headlessContext.h"
+#include "benchmark.h"
+#include "cameraPath.h"
+#include "renderTarget.h"
+#include "dynamicResolution.h"
+#include "temporalAA.h"
+#include "sceneSetup.h"
+#include "scene.h"
+#include "jobSystem.h"
+#include "shader.h"
+#include "shaderCache.h"
+#include "glExtensions.h"
+#include "glState.h"
+#include "gpuProfiler.h"
+#include "cpuProfiler.h"
+#include "error.h"
+#include "log.h"
+
+// Renders a fixed number of frames into an offscreen target without a window, then writes
+// the last frame as an image and the frame timings. Meant for build machines with no
+// display:
+//   RayTracerHeadless --width=1280 --height=720 --frames=200 --camera=0,2,0,0,-10 --output=frame.ppm
+// With --camera-path the camera follows a recorded flythrough (see CameraPath), spread
+// evenly over the timed frames so every run renders the same views, and --benchmark
+// writes the frame time statistics as JSON for benchCompare:
+//   RayTracerHeadless --camera-path=sponza.path --frames=600 --benchmark=current.json
+// The scene goes through the same target, resolve and upscale passes as the window, at a
+// fixed native resolution, so --samples=8 and --taa runs compare the two AA paths:
+//   RayTracerHeadless --camera-path=sponza.path --samples=8 --benchmark=msaa.json
+//   RayTracerHeadless --camera-path=sponza.path --taa --benchmark=taa.json
+//   benchCompare msaa.json taa.json
+// --frame-graph writes the last frame's pass list and transient memory. --animate-model=N
+// moves model N every frame, which exercises the dynamic shadow caster path:
+//   RayTracerHeadless --animate-model=1 --frames=60
+
+namespace {
+
+struct HeadlessOptions {
+    unsigned int width = 1200;
+    unsigned int height = 800;
+    int frames = 100;
+    int warmupFrames = 10;
+    int samples = 1;
+    bool temporalAA = false;
+    bool hasCamera = false;
+    glm::vec3 cameraPosition = glm::vec3(0.0f);
+    float cameraYaw = -90.0f;
+    float cameraPitch = 0.0f;
+    std::string outputPath = "headless.ppm";
+    std::string timingPath;
+    std::string cameraPathFile;
+    std::string benchmarkPath;
+    std::string frameGraphPath;
+};
+
+bool parseCamera(const std::string& value, HeadlessOptions& options) {
+    float x, y, z, yaw, pitch;
+    if (std::sscanf(value.c_str(), "%f,%f,%f,%f,%f", &x, &y, &z, &yaw, &pitch) != 5) {
+        return false;
+    }
+    options.cameraPosition = glm::vec3(x, y, z);
+    options.cameraYaw = yaw;
+    options.cameraPitch = pitch;
+    options.hasCamera = true;
+    return true;
+}
+
+bool parseHeadlessOption(const std::string& arg, HeadlessOptions& options) {
+    if (arg.rfind("--width=", 0) == 0) {
+        options.width = static_cast<unsigned int>(std::max(1, std::atoi(arg.substr(8).c_str())));
+    } else if (arg.rfind("--height=", 0) == 0) {
+        options.height = static_cast<unsigned int>(std::max(1, std::atoi(arg.substr(9).c_str())));
+    } else if (arg.rfind("--frames=", 0) == 0) {
+        options.frames = std::max(1, std::atoi(arg.substr(9).c_str()));
+    } else if (arg.rfind("--warmup=", 0) == 0) {
+        options.warmupFrames = std::max(0, std::atoi(arg.substr(9).c_str()));
+    } else if (arg.rfind("--samples=", 0) == 0) {
+        options.samples = std::max(1, std::atoi(arg.substr(10).c_str()));
+    } else if (arg == "--taa") {
+        options.temporalAA = true;
+    } else if (arg.rfind("--camera=", 0) == 0) {
+        if (!parseCamera(arg.substr(9), options)) {
+            LOG_WARN(General, "Expected --camera=x,y,z,yaw,pitch, got %s", arg.c_str());
+        }
+    } else if (arg.rfind("--output=", 0) == 0) {
+        options.outputPath = arg.substr(9);
+    } else if (arg.rfind("--timing=", 0) == 0) {
+        options.timingPath = arg.substr(9);
+    } else if (arg.rfind("--camera-path=", 0) == 0) {
+        options.cameraPathFile = arg.substr(14);
+    } else if (arg.rfind("--benchmark=", 0) == 0) {
+        options.benchmarkPath = arg.substr(12);
+    } else if (arg.rfind("--frame-graph=", 0) == 0) {
+        options.frameGraphPath = arg.substr(14);
+    } else {
+        return false;
+    }
+    return true;
+}
+
+double millisecondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    RendererOptions options;
+    HeadlessOptions headless;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (!parseHeadlessOption(arg, headless) && !parseRendererOption(arg, options)) {
+            LOG_WARN(General, "Unknown option %s", arg.c_str());
+        }
+    }
+
+    HeadlessContext context;
+    if (!context.create(options.debugMode != GLDebugMode::Off)) {
+        Log::flush();
+        return EXIT_FAILURE;
+    }
+    setGLDebugMode(options.debugMode);
+
+    int exitCode = EXIT_SUCCESS;
+    {
+        // Stands in for the window's framebuffer
+        RenderTarget target(headless.width, headless.height);
+        if (!target.isComplete()) {
+            Log::flush();
+            return EXIT_FAILURE;
+        }
+        std::unique_ptr<TemporalAA> temporal;
+        if (headless.temporalAA) {
+            temporal.reset(new TemporalAA(resolveSourcePath("src/shaders/fullscreen.vert"), resolveSourcePath("src/shaders/taa.frag")));
+        }
+        DynamicResolution sceneTarget(resolveSourcePath("src/shaders/fullscreen.vert"), resolveSourcePath("src/shaders/upscale.frag"),
+                                      headless.samples, temporal.get());
+        // Native resolution and a plain copy, so runs only differ in anti-aliasing
+        sceneTarget.getSettings().enabled = false;
+        sceneTarget.getSettings().sharpness = 0.0f;
+
+        ShaderPermutationManager shaderPermutations(resolveSourcePath("src/shaders/default.vert"), resolveSourcePath("src/shaders/default.frag"));
+        Shader shadowShader(resolveSourcePath("src/shaders/shadow.vert").c_str(), resolveSourcePath("src/shaders/shadow.frag").c_str());
+
+        GLStateCache& glState = getGLState();
+        glState.setDepthTest(true);
+        glState.depthFunc(GL_LESS);
+        glState.setCullFace(false);
+        glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+        if (headless.samples > 1) {
+            glEnable(GL_MULTISAMPLE);
+        }
+
+        auto loadStart = std::chrono::steady_clock::now();
+        Scene scene(options.scenePath.c_str());
+        if (scene.getModels().empty()) {
+            // A benchmark of an empty scene would only measure the clear
+            LOG_ERROR(Scene, "Nothing to render in %s", options.scenePath.c_str());
+            Log::flush();
+            return EXIT_FAILURE;
+        }
+        if (!options.skyboxPath.empty()) {
+            scene.setSkybox(options.skyboxPath);
+            scene.setSkyboxShader(resolveSourcePath("src/shaders/skybox.vert"), resolveSourcePath("src/shaders/skybox.frag"));
+        }
+        setupShadows(scene, options);
+        setupSponzaLightingWithShadows(scene);
+        ModelAnimator animator;
+        animator.attach(scene, options.animatedModel);
+        LOG_INFO(Scene, "Scene ready in %.1f ms", millisecondsSince(loadStart));
+
+        Camera& camera = scene.getCamera();
+        camera.setViewportSize(headless.width, headless.height);
+        if (headless.hasCamera) {
+            camera.setPose(headless.cameraPosition, headless.cameraYaw, headless.cameraPitch);
+        }
+        CameraPath cameraPath;
+        if (!headless.cameraPathFile.empty() && !cameraPath.load(headless.cameraPathFile)) {
+            Log::flush();
+            return EXIT_FAILURE;
+        }
+
+        GpuProfiler& gpuProfiler = getGpuProfiler();
+        CpuProfiler& cpuProfiler = getCpuProfiler();
+        PROFILE_THREAD_NAME("Main");
+        glState.invalidate();
+        FrameGraph frameGraph;
+
+        // Frame time is the interval between frame starts, as in the windowed loop. The upload
+        // ring's fences keep the CPU at most a few frames ahead, so it tracks GPU throughput.
+        const int totalFrames = headless.warmupFrames + headless.frames;
+        std::vector<double> frameMs;
+        std::vector<double> submitMs;
+        std::vector<double> drawCalls;
+        std::vector<double> triangles;
+        std::vector<double> drawListMs;
+        ShadowRenderStats shadowTotals;
+        frameMs.reserve(headless.frames);
+        submitMs.reserve(headless.frames);
+        auto previousStart = std::chrono::steady_clock::now();
+        auto timedStart = previousStart;
+        int droppedBefore = 0;
+        for (int frame = 0; frame < totalFrames; ++frame) {
+            const int timedFrame = frame - headless.warmupFrames;
+            if (timedFrame == 0) {
+                if (options.traceFrames > 0) {
+                    cpuProfiler.requestCapture(options.traceFrames, options.traceFile);
+                }
+                gpuProfiler.clearRecording();
+                gpuProfiler.setRecording(true);
+                droppedBefore = gpuProfiler.getDroppedFrames();
+            }
+            PROFILE_ZONE("Frame");
+            auto frameStart = std::chrono::steady_clock::now();
+            if (timedFrame > 0) {
+                frameMs.push_back(std::chrono::duration<double, std::milli>(frameStart - previousStart).count());
+            } else if (timedFrame == 0) {
+                timedStart = frameStart;
+            }
+            previousStart = frameStart;
+
+            if (!cameraPath.empty()) {
+                // Warm-up holds the first pose; timed frames step evenly along the path
+                float progress = headless.frames > 1 ? std::max(timedFrame, 0) / static_cast<float>(headless.frames - 1) : 0.0f;
+                CameraKeyframe pose = cameraPath.sample(progress * cameraPath.getDuration());
+                camera.setPose(pose.position, pose.yaw, pose.pitch);
+            }
+            // A fixed 60 Hz step, so every run sees the same poses
+            animator.update(scene, frame / 60.0f);
+
+            glState.beginFrame();
+            gpuProfiler.beginFrame();
+            frameGraph.reset();
+            FrameGraphResource output = frameGraph.importFramebuffer("Output", target.getFramebuffer(), headless.width, headless.height);
+            frameGraph.markOutput(output);
+            SceneTargets sceneTargets = sceneTarget.beginFrame(frameGraph, headless.width, headless.height);
+            if (temporal) {
+                temporal->jitterCamera(camera, sceneTargets.width, sceneTargets.height);
+            }
+            glFrontFace(GL_CCW);
+            scene.addPasses(frameGraph, shaderPermutations, shadowShader, sceneTargets);
+            sceneTarget.addOutputPasses(frameGraph, sceneTargets, output);
+            if (frame == totalFrames - 1 && !headless.frameGraphPath.empty()) {
+                frameGraph.requestDump(headless.frameGraphPath);
+            }
+            {
+                PROFILE_ZONE("Scene draw");
+                frameGraph.execute();
+            }
+            camera.endFrame();
+            gpuProfiler.endFrame();
+            checkGLFrameErrors();
+            if (timedFrame >= 0) {
+                submitMs.push_back(millisecondsSince(frameStart));
+                drawCalls.push_back(scene.getRenderStats().drawCalls);
+                triangles.push_back(static_cast<double>(scene.getRenderStats().triangles));
+                drawListMs.push_back(scene.getDrawListStats().buildMs);
+                const ShadowRenderStats& shadowStats = scene.getShadowManager().getRenderStats();
+                shadowTotals.tilesRendered += shadowStats.tilesRendered;
+                shadowTotals.tilesCached += shadowStats.tilesCached;
+                shadowTotals.tilesComposited += shadowStats.tilesComposited;
+                shadowTotals.tilesFiltered += shadowStats.tilesFiltered;
+                shadowTotals.tilesDeferred += shadowStats.tilesDeferred;
+                shadowTotals.cubesRendered += shadowStats.cubesRendered;
+                shadowTotals.cubesCached += shadowStats.cubesCached;
+                shadowTotals.cubesComposited += shadowStats.cubesComposited;
+                shadowTotals.cubesDeferred += shadowStats.cubesDeferred;
+            }
+            glFlush();
+            cpuProfiler.frameMark();
+        }
+        gpuProfiler.setRecording(false);
+        // The last frame ends when the GPU has finished it
+        glFinish();
+        frameMs.push_back(millisecondsSince(previousStart));
+        double totalMs = millisecondsSince(timedStart);
+
+        // Collect the recorded frames still in the profiler and let a pending trace complete
+        for (int i = 0; i < static_cast<int>(GpuProfiler::QUERY_FRAMES) || (cpuProfiler.isCaptureActive() && i < 16); ++i) {
+            gpuProfiler.beginFrame();
+            gpuProfiler.endFrame();
+            cpuProfiler.frameMark();
+        }
+
+        std::vector<unsigned char> pixels;
+        if (!headless.outputPath.empty()) {
+            if (target.readPixels(pixels) && writePPM(headless.outputPath, target.getWidth(), target.getHeight(), pixels)) {
+                LOG_INFO(Render, "Wrote %s", headless.outputPath.c_str());
+            } else {
+                exitCode = EXIT_FAILURE;
+            }
+        }
+
+        if (!headless.timingPath.empty()) {
+            std::ofstream timing(headless.timingPath);
+            timing << "frame,frame_ms,submit_ms,draw_calls,triangles\n";
+            for (size_t i = 0; i < frameMs.size(); ++i) {
+                timing << i << ',' << frameMs[i] << ',' << submitMs[i] << ',' << drawCalls[i] << ',' << triangles[i] << '\n';
+            }
+            LOG_INFO(Render, "Frame timings written to %s", headless.timingPath.c_str());
+        }
+
+        BenchmarkReport report;
+        report.scene = options.scenePath;
+        report.cameraPath = headless.cameraPathFile;
+        report.renderer = reinterpret_cast<const char*>(glGetString(GL_RENDERER));
+        report.width = target.getWidth();
+        report.height = target.getHeight();
+        report.samples = sceneTarget.getSamples();
+        report.antiAliasing = temporal ? "taa" : (sceneTarget.getSamples() > 1 ? "msaa" : "none");
+        // Textures the graph's pool holds, plus the history TAA keeps between frames
+        report.renderTargetBytes = frameGraph.getStats().pooledBytes + (temporal ? temporal->getMemoryBytes() : 0);
+        report.frames = headless.frames;
+        report.warmupFrames = headless.warmupFrames;
+        report.cpuFrameMs = summarizeSamples(frameMs);
+        report.cpuSubmitMs = summarizeSamples(submitMs);
+        report.drawCalls = summarizeSamples(drawCalls);
+        report.triangles = summarizeSamples(triangles);
+        report.gpuPasses = gpuProfiler.getRecordedStats();
+        report.gpuDroppedFrames = gpuProfiler.getDroppedFrames() - droppedBefore;
+        for (const GpuPassStats& pass : report.gpuPasses) {
+            if (pass.name == "Frame") {
+                report.gpuFrameMs.samples = pass.samples;
+                report.gpuFrameMs.average = pass.averageMs;
+                report.gpuFrameMs.p50 = pass.p50Ms;
+                report.gpuFrameMs.p95 = pass.p95Ms;
+                report.gpuFrameMs.p99 = pass.p99Ms;
+                report.gpuFrameMs.max = pass.maxMs;
+            }
+        }
+
+        std::printf("%d frames at %ux%u (%s, %d samples) in %.1f ms: %.2f fps\n", headless.frames, headless.width,
+                    headless.height, report.antiAliasing.c_str(), report.samples, totalMs, headless.frames * 1000.0 / totalMs);
+        const FrameGraphStats& graphStats = frameGraph.getStats();
+        std::printf("render targets %.1f MB; frame graph %d passes (%d culled), %d transients in %d textures, peak %.1f MB (%.1f MB unaliased)\n",
+                    report.renderTargetBytes / (1024.0 * 1024.0), graphStats.passes, graphStats.culledPasses,
+                    graphStats.transientTextures, graphStats.physicalTextures, graphStats.peakTransientBytes / (1024.0 * 1024.0),
+                    graphStats.unaliasedTransientBytes / (1024.0 * 1024.0));
+        std::printf("cpu frame ms: p50 %.3f  p95 %.3f  p99 %.3f  max %.3f\n", report.cpuFrameMs.p50,
+                    report.cpuFrameMs.p95, report.cpuFrameMs.p99, report.cpuFrameMs.max);
+        std::printf("gpu frame ms: p50 %.3f  p95 %.3f  p99 %.3f  max %.3f (%zu frames, %d dropped)\n", report.gpuFrameMs.p50,
+                    report.gpuFrameMs.p95, report.gpuFrameMs.p99, report.gpuFrameMs.max, report.gpuFrameMs.samples,
+                    report.gpuDroppedFrames);
+        std::printf("draw calls avg %.1f max %.0f, triangles avg %.0f max %.0f\n", report.drawCalls.average,
+                    report.drawCalls.max, report.triangles.average, report.triangles.max);
+        const DrawListStats& drawListStats = scene.getDrawListStats();
+        SampleSummary drawListSummary = summarizeSamples(drawListMs);
+        std::printf("draw lists: %d views, %d tasks on %d job workers + GL thread (%.1f KB arenas); build ms avg %.3f p95 %.3f\n",
+                    drawListStats.views, drawListStats.tasks, drawListStats.workers, drawListStats.arenaBytes / 1024.0,
+                    drawListSummary.average, drawListSummary.p95);
+        JobSystemStats jobStats = getJobSystem().getStats();
+        std::printf("job system: %d workers; %llu jobs run, %llu stolen, %llu run while waiting\n", jobStats.workers,
+                    static_cast<unsigned long long>(jobStats.jobsRun), static_cast<unsigned long long>(jobStats.jobsStolen),
+                    static_cast<unsigned long long>(jobStats.jobsHelped));
+        const ShadowManager& shadows = scene.getShadowManager();
+        const ShadowRenderStats& lastShadowStats = shadows.getRenderStats();
+        std::printf("shadow atlas %u^2 (%.1f MB): %d lights (%d dropped), %.0f%% used; tiles %d rendered, %d cached, %d composited\n",
+                    shadows.getAtlasSize(), shadows.getAtlasBytes() / (1024.0 * 1024.0), lastShadowStats.shadowedLights,
+                    lastShadowStats.droppedLights, lastShadowStats.atlasUsage * 100.0f, shadowTotals.tilesRendered,
+                    shadowTotals.tilesCached, shadowTotals.tilesComposited);
+        if (shadows.usesMoments()) {
+            std::printf("shadow moments %u^2 (%.1f MB); tiles %d filtered\n", shadows.getAtlasSize() / ShadowMomentAtlas::DOWNSAMPLE,
+                        shadows.getMomentAtlasBytes() / (1024.0 * 1024.0), shadowTotals.tilesFiltered);
+        }
+        if (shadows.getCubeMapCapacity() > 0) {
+            std::printf("shadow cubes %d (%.1f MB); cubes %d rendered, %d cached, %d composited\n", shadows.getCubeMapCapacity(),
+                        shadows.getCubeMapBytes() / (1024.0 * 1024.0), shadowTotals.cubesRendered, shadowTotals.cubesCached,
+                        shadowTotals.cubesComposited);
+        }
+        const ShadowUpdateScheduler& scheduler = shadows.getScheduler();
+        if (scheduler.getSettings().enabled) {
+            std::printf("shadow schedule: budget %zu triangles (%.3f ms per 1k measured); %d tiles, %d cubes deferred\n",
+                        scheduler.getTriangleBudget(), scheduler.getMsPerThousandTriangles(), shadowTotals.tilesDeferred,
+                        shadowTotals.cubesDeferred);
+        }
+        for (const GpuPassStats& pass : report.gpuPasses) {
+            std::printf("gpu %-12s avg %.3f ms  p95 %.3f ms\n", pass.name.c_str(), pass.averageMs, pass.p95Ms);
+        }
+        if (!headless.benchmarkPath.empty() && !writeBenchmarkJSON(headless.benchmarkPath, report)) {
+            exitCode = EXIT_FAILURE;
+        }
+
+        gpuProfiler.releaseQueries();
+    }
+    context.destroy();
+    Log::flush();
+    return exitCode;
+}
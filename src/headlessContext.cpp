@@ -0,0 +1,115 @@
+#include "headlessContext.h"
+#include "glExtensions.h"
+#include "log.h"
+#include <EGL/eglext.h>
+#include <glad/glad.h>
+#include <cstring>
+
+namespace {
+
+bool hasEGLExtension(const char* extensions, const char* name) {
+    if (!extensions) return false;
+    size_t length = std::strlen(name);
+    for (const char* found = std::strstr(extensions, name); found; found = std::strstr(found + 1, name)) {
+        if ((found == extensions || found[-1] == ' ') && (found[length] == ' ' || found[length] == '\0')) {
+            return true;
+        }
+    }
+    return false;
+}
+
+EGLDisplay openDisplay() {
+    const char* clientExtensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+    if (hasEGLExtension(clientExtensions, "EGL_MESA_platform_surfaceless")) {
+        auto getPlatformDisplay = reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(
+            eglGetProcAddress("eglGetPlatformDisplayEXT"));
+        if (getPlatformDisplay) {
+            EGLDisplay display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+            if (display != EGL_NO_DISPLAY) return display;
+        }
+    }
+    return eglGetDisplay(EGL_DEFAULT_DISPLAY);
+}
+
+} // namespace
+
+HeadlessContext::HeadlessContext() : display(EGL_NO_DISPLAY), context(EGL_NO_CONTEXT) {
+}
+
+HeadlessContext::~HeadlessContext() {
+    destroy();
+}
+
+bool HeadlessContext::create(bool debugContext) {
+    display = openDisplay();
+    EGLint major = 0, minor = 0;
+    if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor)) {
+        LOG_ERROR(GL, "No EGL display available");
+        display = EGL_NO_DISPLAY;
+        return false;
+    }
+    LOG_INFO(GL, "EGL %d.%d, vendor %s", major, minor, eglQueryString(display, EGL_VENDOR));
+
+    const char* extensions = eglQueryString(display, EGL_EXTENSIONS);
+    if (!hasEGLExtension(extensions, "EGL_KHR_surfaceless_context")) {
+        LOG_ERROR(GL, "EGL display lacks EGL_KHR_surfaceless_context");
+        destroy();
+        return false;
+    }
+    if (!eglBindAPI(EGL_OPENGL_API)) {
+        LOG_ERROR(GL, "EGL display has no desktop OpenGL");
+        destroy();
+        return false;
+    }
+
+    // The context renders only into framebuffer objects, so any config will do
+    EGLConfig config = EGL_NO_CONFIG_KHR;
+    if (!hasEGLExtension(extensions, "EGL_KHR_no_config_context")) {
+        const EGLint configAttributes[] = { EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE };
+        EGLint count = 0;
+        if (!eglChooseConfig(display, configAttributes, &config, 1, &count) || count == 0) {
+            LOG_ERROR(GL, "No EGL config supports desktop OpenGL");
+            destroy();
+            return false;
+        }
+    }
+
+    const EGLint contextAttributes[] = {
+        EGL_CONTEXT_MAJOR_VERSION, 3,
+        EGL_CONTEXT_MINOR_VERSION, 3,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_CONTEXT_OPENGL_DEBUG, debugContext ? EGL_TRUE : EGL_FALSE,
+        EGL_NONE
+    };
+    context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttributes);
+    if (context == EGL_NO_CONTEXT || !eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context)) {
+        LOG_ERROR(GL, "Could not create a GL 3.3 core context (EGL error 0x%x)", eglGetError());
+        destroy();
+        return false;
+    }
+
+    if (!gladLoadGLLoader(reinterpret_cast<GLADloadproc>(getProcAddress))) {
+        LOG_ERROR(GL, "Failed to load OpenGL functions");
+        destroy();
+        return false;
+    }
+    loadGLExtensions(reinterpret_cast<GLADloadproc>(getProcAddress));
+    LOG_INFO(GL, "Headless context: %s, %s", reinterpret_cast<const char*>(glGetString(GL_RENDERER)),
+             reinterpret_cast<const char*>(glGetString(GL_VERSION)));
+    return true;
+}
+
+void HeadlessContext::destroy() {
+    if (display == EGL_NO_DISPLAY) return;
+    eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    if (context != EGL_NO_CONTEXT) {
+        eglDestroyContext(display, context);
+        context = EGL_NO_CONTEXT;
+    }
+    eglTerminate(display);
+    display = EGL_NO_DISPLAY;
+}
+
+void* HeadlessContext::getProcAddress(const char* name) {
+    return reinterpret_cast<void*>(eglGetProcAddress(name));
+}
@@ -0,0 +1,29 @@
+#ifndef HEADLESS_CONTEXT_H
+#define HEADLESS_CONTEXT_H
+
+#include <EGL/egl.h>
+
+// GL 3.3 core context without a window or surface, for rendering into a RenderTarget on
+// machines with no display (Mesa llvmpipe on build boxes). Uses Mesa's surfaceless EGL
+// platform when present, else the default display; either needs
+// EGL_KHR_surfaceless_context.
+class HeadlessContext {
+public:
+    HeadlessContext();
+    ~HeadlessContext();
+
+    HeadlessContext(const HeadlessContext&) = delete;
+    HeadlessContext& operator=(const HeadlessContext&) = delete;
+
+    // Creates the context, makes it current and loads GL through glad
+    bool create(bool debugContext);
+    void destroy();
+
+    static void* getProcAddress(const char* name);
+
+private:
+    EGLDisplay display;
+    EGLContext context;
+};
+
+#endif // HEADLESS_CONTEXT_H
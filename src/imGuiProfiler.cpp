@@ -0,0 +1,210 @@
+#include "imGuiProfiler.h"
+#include "cpuProfiler.h"
+#include <algorithm>
+#include <cstdio>
+
+void ImGuiProfiler::render() {
+    if (!showWindow) return;
+    ImGui::SetNextWindowPos(ImVec2(1200 - 400 - 420, 0), ImGuiCond_FirstUseEver);
+    ImGui::SetNextWindowSize(ImVec2(420, 300), ImGuiCond_FirstUseEver);
+
+    if (ImGui::Begin("GPU Profiler", &showWindow)) {
+        bool enabled = profiler.isEnabled();
+        if (ImGui::Checkbox("Enabled", &enabled)) {
+            profiler.setEnabled(enabled);
+        }
+        ImGui::SameLine();
+        ImGui::Text("Dropped frames: %d", profiler.getDroppedFrames());
+
+        std::vector<float> frameHistory = profiler.getFrameHistory();
+        if (!frameHistory.empty()) {
+            char overlay[32];
+            std::snprintf(overlay, sizeof(overlay), "GPU frame %.2f ms", frameHistory.back());
+            ImGui::PlotLines("##gpuframe", frameHistory.data(), static_cast<int>(frameHistory.size()), 0,
+                             overlay, 0.0f, FLT_MAX, ImVec2(0, 60));
+        }
+
+        if (dynamicResolution) {
+            renderDynamicResolution();
+        }
+        if (frameGraph) {
+            renderFrameGraph();
+        }
+        if (shadowManager) {
+            renderShadowSchedule();
+        }
+
+        ImGui::Separator();
+        renderPassTable(profiler.getStats());
+        ImGui::Separator();
+        renderExportButtons();
+    }
+    ImGui::End();
+}
+
+void ImGuiProfiler::renderPassTable(const std::vector<GpuPassStats>& stats) {
+    ImGuiTableFlags flags = ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingFixedFit;
+    if (!ImGui::BeginTable("GpuPasses", 6, flags)) return;
+
+    ImGui::TableSetupColumn("Pass", ImGuiTableColumnFlags_WidthStretch);
+    ImGui::TableSetupColumn("Last");
+    ImGui::TableSetupColumn("Avg");
+    ImGui::TableSetupColumn("p50");
+    ImGui::TableSetupColumn("p95");
+    ImGui::TableSetupColumn("p99");
+    ImGui::TableHeadersRow();
+
+    for (const GpuPassStats& pass : stats) {
+        ImGui::TableNextRow();
+        ImGui::TableNextColumn();
+        ImGui::TextUnformatted(pass.name.c_str());
+        ImGui::TableNextColumn();
+        ImGui::Text("%.3f", pass.lastMs);
+        ImGui::TableNextColumn();
+        ImGui::Text("%.3f", pass.averageMs);
+        ImGui::TableNextColumn();
+        ImGui::Text("%.3f", pass.p50Ms);
+        ImGui::TableNextColumn();
+        ImGui::Text("%.3f", pass.p95Ms);
+        ImGui::TableNextColumn();
+        ImGui::Text("%.3f", pass.p99Ms);
+    }
+    ImGui::EndTable();
+    ImGui::TextDisabled("Milliseconds over the last %zu frames", GpuProfiler::HISTORY_FRAMES);
+}
+
+void ImGuiProfiler::renderExportButtons() {
+    if (ImGui::Button("Export CSV")) {
+        exportStatus = profiler.exportCSV("gpu_profile.csv") ? "Wrote gpu_profile.csv" : "CSV export failed";
+    }
+    ImGui::SameLine();
+    if (ImGui::Button("Export JSON")) {
+        exportStatus = profiler.exportJSON("gpu_profile.json") ? "Wrote gpu_profile.json" : "JSON export failed";
+    }
+    ImGui::SameLine();
+    CpuProfiler& cpuProfiler = getCpuProfiler();
+    if (cpuProfiler.isCaptureActive()) {
+        ImGui::TextDisabled("Capturing trace...");
+    } else if (ImGui::Button("Capture trace")) {
+        cpuProfiler.requestCapture(120, "cpu_trace.json");
+        exportStatus = "Tracing 120 frames to cpu_trace.json";
+    }
+    if (!exportStatus.empty()) {
+        ImGui::SameLine();
+        ImGui::TextUnformatted(exportStatus.c_str());
+    }
+}
+
+void ImGuiProfiler::renderDynamicResolution() {
+    if (!ImGui::CollapsingHeader("Dynamic resolution")) return;
+
+    DynamicResolutionSettings& settings = dynamicResolution->getSettings();
+    ImGui::Checkbox("Follow budget", &settings.enabled);
+    ImGui::SliderFloat("Target (ms)", &settings.targetMs, 2.0f, 50.0f, "%.1f");
+    ImGui::SliderFloat("Min scale", &settings.minScale, 0.25f, settings.maxScale, "%.2f");
+    ImGui::SliderFloat("Max scale", &settings.maxScale, settings.minScale, 1.0f, "%.2f");
+    ImGui::SliderFloat("Sharpness", &settings.sharpness, 0.0f, 1.0f, "%.2f");
+    ImGui::Text("Scene %ux%u of %ux%u (%.0f%%), %.2f ms GPU",
+                dynamicResolution->getRenderWidth(), dynamicResolution->getRenderHeight(),
+                dynamicResolution->getOutputWidth(), dynamicResolution->getOutputHeight(),
+                dynamicResolution->getScale() * 100.0f, dynamicResolution->getLastGpuMs());
+
+    TemporalAA* temporal = dynamicResolution->getTemporalAA();
+    if (temporal) {
+        TemporalAASettings& taa = temporal->getSettings();
+        ImGui::Checkbox("Temporal AA", &taa.enabled);
+        ImGui::SameLine();
+        ImGui::SliderFloat("History", &taa.historyWeight, 0.5f, 0.98f, "%.2f");
+    } else {
+        ImGui::Text("%dx MSAA", dynamicResolution->getSamples());
+    }
+    if (temporal) {
+        ImGui::Text("TAA history %.1f MB", temporal->getMemoryBytes() / (1024.0 * 1024.0));
+    }
+}
+
+void ImGuiProfiler::renderFrameGraph() {
+    if (!ImGui::CollapsingHeader("Frame graph")) return;
+
+    const FrameGraphStats& stats = frameGraph->getStats();
+    ImGui::Text("%d passes, %d culled", stats.passes, stats.culledPasses);
+    ImGui::Text("%d transients in %d textures", stats.transientTextures, stats.physicalTextures);
+    ImGui::Text("Peak %.1f MB (%.1f MB unaliased), pool %.1f MB", stats.peakTransientBytes / (1024.0 * 1024.0),
+                stats.unaliasedTransientBytes / (1024.0 * 1024.0), stats.pooledBytes / (1024.0 * 1024.0));
+    if (ImGui::Button("Dump frame graph")) {
+        frameGraph->requestDump("frame_graph.txt");
+        exportStatus = "Wrote frame_graph.txt";
+    }
+}
+
+void ImGuiProfiler::renderShadowSchedule() {
+    if (!ImGui::CollapsingHeader("Shadow schedule")) return;
+
+    ShadowUpdateScheduler& scheduler = shadowManager->getScheduler();
+    ShadowScheduleSettings& settings = scheduler.getSettings();
+    ImGui::Checkbox("Budget updates", &settings.enabled);
+    int thousands = static_cast<int>(settings.triangleBudget / 1000);
+    if (ImGui::SliderInt("Triangles (k)", &thousands, 0, 4000)) {
+        settings.triangleBudget = static_cast<size_t>(thousands) * 1000;
+    }
+    ImGui::SliderFloat("Time (ms)", &settings.millisecondBudget, 0.0f, 10.0f, "%.2f");
+
+    const ShadowRenderStats& stats = shadowManager->getRenderStats();
+    if (scheduler.getTriangleBudget() > 0) {
+        ImGui::Text("Budget %zu triangles, %zu scheduled", scheduler.getTriangleBudget(), scheduler.getScheduledTriangles());
+    } else {
+        ImGui::Text("No budget, %zu triangles scheduled", scheduler.getScheduledTriangles());
+    }
+    if (scheduler.getMsPerThousandTriangles() > 0.0f) {
+        ImGui::SameLine();
+        ImGui::TextDisabled("(%.3f ms per 1k)", scheduler.getMsPerThousandTriangles());
+    }
+    ImGui::Text("Tiles %d drawn, %d deferred, %d cached; cubes %d drawn, %d deferred, %d cached",
+                stats.tilesRendered, stats.tilesDeferred, stats.tilesCached, stats.cubesRendered, stats.cubesDeferred,
+                stats.cubesCached);
+
+    const std::vector<ShadowUpdate>& updates = scheduler.getUpdates();
+    if (updates.empty()) return;
+    ImGuiTableFlags flags = ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingFixedFit |
+                            ImGuiTableFlags_ScrollY;
+    float height = ImGui::GetTextLineHeightWithSpacing() * static_cast<float>(std::min<size_t>(updates.size(), 8) + 1);
+    if (!ImGui::BeginTable("ShadowSchedule", 6, flags, ImVec2(0.0f, height + 4.0f))) return;
+
+    ImGui::TableSetupScrollFreeze(0, 1);
+    ImGui::TableSetupColumn("Map", ImGuiTableColumnFlags_WidthStretch);
+    ImGui::TableSetupColumn("Change");
+    ImGui::TableSetupColumn("Priority");
+    ImGui::TableSetupColumn("Triangles");
+    ImGui::TableSetupColumn("Waited");
+    ImGui::TableSetupColumn("Update");
+    ImGui::TableHeadersRow();
+
+    for (const ShadowUpdate& update : updates) {
+        ImGui::TableNextRow();
+        ImGui::TableNextColumn();
+        if (update.tile < 0) {
+            ImGui::Text("Light %zu cube", update.lightIndex);
+        } else {
+            ImGui::Text("Light %zu tile %d", update.lightIndex, update.tile);
+        }
+        ImGui::TableNextColumn();
+        switch (update.reason) {
+            case ShadowUpdateReason::Invalid: ImGui::TextUnformatted("invalid"); break;
+            case ShadowUpdateReason::Light: ImGui::TextUnformatted("light"); break;
+            case ShadowUpdateReason::Casters: ImGui::TextUnformatted("casters"); break;
+        }
+        ImGui::TableNextColumn();
+        ImGui::Text("%.2f", update.priority);
+        ImGui::TableNextColumn();
+        ImGui::Text("%zu", update.cost);
+        ImGui::TableNextColumn();
+        ImGui::Text("%d", update.framesWaiting);
+        ImGui::TableNextColumn();
+        if (update.scheduled) {
+            ImGui::TextUnformatted("now");
+        } else {
+            ImGui::TextDisabled("deferred");
+        }
+    }
+    ImGui::EndTable();
+}
@@ -0,0 +1,42 @@
+#ifndef IMGUI_PROFILER_H
+#define IMGUI_PROFILER_H
+
+#include "gpuProfiler.h"
+#include "dynamicResolution.h"
+#include "frameGraph.h"
+#include "shadowManager.h"
+#include <imgui.h>
+#include <string>
+
+// GPU pass timings panel, docked to the left of the Light Manager window
+class ImGuiProfiler {
+public:
+    explicit ImGuiProfiler(GpuProfiler& profiler) : profiler(profiler) {}
+
+    void render();
+
+    void setVisible(bool visible) { showWindow = visible; }
+    bool isVisible() const { return showWindow; }
+    // Adds the resolution controller's settings; null hides them
+    void setDynamicResolution(DynamicResolution* resolution) { dynamicResolution = resolution; }
+    // Adds the frame graph's pass and memory counts; null hides them
+    void setFrameGraph(FrameGraph* graph) { frameGraph = graph; }
+    // Adds the shadow update budget and each frame's schedule; null hides them
+    void setShadowManager(ShadowManager* shadows) { shadowManager = shadows; }
+
+private:
+    GpuProfiler& profiler;
+    DynamicResolution* dynamicResolution = nullptr;
+    FrameGraph* frameGraph = nullptr;
+    ShadowManager* shadowManager = nullptr;
+    bool showWindow = true;
+    std::string exportStatus;
+
+    void renderPassTable(const std::vector<GpuPassStats>& stats);
+    void renderExportButtons();
+    void renderDynamicResolution();
+    void renderFrameGraph();
+    void renderShadowSchedule();
+};
+
+#endif // IMGUI_PROFILER_H
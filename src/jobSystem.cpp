@@ -0,0 +1,205 @@
+#include "jobSystem.h"
+#include "cpuProfiler.h"
+#include "log.h"
+#include <algorithm>
+#include <cstdlib>
+#include <string>
+
+namespace {
+
+// Which system's pool the current thread belongs to, and its queue there
+thread_local const JobSystem* workerSystem = nullptr;
+thread_local int workerQueue = 0;
+// Innermost job running on this thread; a waiting job's thread may run others inside it
+thread_local const JobHandle* runningJob = nullptr;
+
+} // namespace
+
+JobSystem::JobSystem(int workerCount)
+    : queued(0), stopping(false), jobsRun(0), jobsStolen(0), jobsHelped(0) {
+    if (workerCount < 0) {
+        if (const char* env = std::getenv("RAYTRACER_JOB_WORKERS")) {
+            workerCount = std::atoi(env);
+        } else {
+            workerCount = static_cast<int>(std::thread::hardware_concurrency()) - 1;
+        }
+    }
+    workerCount = std::max(0, std::min(workerCount, static_cast<int>(MAX_WORKERS)));
+    for (int i = 0; i <= workerCount; ++i) {
+        queues.emplace_back(new WorkQueue());
+    }
+    for (int i = 0; i < workerCount; ++i) {
+        workers.emplace_back(&JobSystem::workerLoop, this, i + 1);
+    }
+    LOG_DEBUG(General, "Job system started with %d workers", workerCount);
+}
+
+JobSystem::~JobSystem() {
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    // Jobs nobody waited for still run, as they would have on a worker
+    while (runOne(0, false)) {
+    }
+}
+
+JobHandle JobSystem::create(std::function<void()> function, const JobHandle& parent) {
+    JobHandle job = std::make_shared<Job>();
+    job->function = std::move(function);
+    if (parent) {
+        parent->unfinished.fetch_add(1, std::memory_order_relaxed);
+        job->parent = parent;
+    }
+    return job;
+}
+
+void JobSystem::submit(const JobHandle& job) {
+    WorkQueue& queue = *queues[currentQueue()];
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.jobs.push_back(job);
+    }
+    queued.fetch_add(1, std::memory_order_release);
+    if (!workers.empty()) {
+        // A worker between checking for work and sleeping holds the mutex, so it either
+        // sees the job or is already waiting for this notify
+        { std::lock_guard<std::mutex> lock(sleepMutex); }
+        wake.notify_one();
+    }
+}
+
+JobHandle JobSystem::run(std::function<void()> function, const JobHandle& parent) {
+    JobHandle job = create(std::move(function), parent);
+    submit(job);
+    return job;
+}
+
+void JobSystem::wait(const JobHandle& job) {
+    if (!job) return;
+    int queue = currentQueue();
+    while (!job->isFinished()) {
+        if (!runOne(queue, true)) {
+            // What's left is running on other threads
+            std::this_thread::yield();
+        }
+    }
+}
+
+void JobSystem::parallelFor(size_t count, size_t grain, const std::function<void(size_t begin, size_t end)>& body) {
+    if (count == 0) return;
+    if (grain == 0) {
+        grain = std::max<size_t>(1, count / (static_cast<size_t>(getThreadCount()) * 4));
+    }
+    if (workers.empty() || count <= grain) {
+        body(0, count);
+        return;
+    }
+
+    // The chunks go on the caller's queue: it works through them from the back while
+    // idle workers steal from the front
+    JobHandle root = create(nullptr);
+    for (size_t begin = 0; begin < count; begin += grain) {
+        size_t end = std::min(count, begin + grain);
+        submit(create([&body, begin, end] { body(begin, end); }, root));
+    }
+    // The root has nothing to run itself
+    finish(root);
+    wait(root);
+}
+
+JobHandle JobSystem::getCurrentJob() {
+    return runningJob ? *runningJob : JobHandle();
+}
+
+JobSystemStats JobSystem::getStats() const {
+    JobSystemStats stats;
+    stats.workers = getWorkerCount();
+    stats.jobsRun = jobsRun.load(std::memory_order_relaxed);
+    stats.jobsStolen = jobsStolen.load(std::memory_order_relaxed);
+    stats.jobsHelped = jobsHelped.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void JobSystem::workerLoop(int queue) {
+    workerSystem = this;
+    workerQueue = queue;
+    std::string name = "Job worker " + std::to_string(queue - 1);
+    PROFILE_THREAD_NAME(name.c_str());
+    for (;;) {
+        if (runOne(queue, false)) continue;
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        wake.wait(lock, [this] { return stopping || queued.load(std::memory_order_acquire) > 0; });
+        if (stopping) return;
+    }
+}
+
+int JobSystem::currentQueue() const {
+    return workerSystem == this ? workerQueue : 0;
+}
+
+JobHandle JobSystem::take(int queue) {
+    JobHandle job;
+    {
+        WorkQueue& own = *queues[queue];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.jobs.empty()) {
+            job = std::move(own.jobs.back());
+            own.jobs.pop_back();
+        }
+    }
+    for (size_t i = 1; !job && i < queues.size(); ++i) {
+        WorkQueue& victim = *queues[(queue + i) % queues.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.jobs.empty()) {
+            job = std::move(victim.jobs.front());
+            victim.jobs.pop_front();
+            jobsStolen.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+    if (job) {
+        queued.fetch_sub(1, std::memory_order_relaxed);
+    }
+    return job;
+}
+
+bool JobSystem::runOne(int queue, bool helping) {
+    JobHandle job = take(queue);
+    if (!job) return false;
+    if (helping) {
+        jobsHelped.fetch_add(1, std::memory_order_relaxed);
+    }
+    execute(job);
+    return true;
+}
+
+void JobSystem::execute(const JobHandle& job) {
+    if (job->function) {
+        const JobHandle* outer = runningJob;
+        runningJob = &job;
+        job->function();
+        runningJob = outer;
+        // Captures go as soon as the job has run, not when its last handle does
+        job->function = nullptr;
+    }
+    jobsRun.fetch_add(1, std::memory_order_relaxed);
+    finish(job);
+}
+
+void JobSystem::finish(JobHandle job) {
+    // The last child to finish finishes its parent, and so on up the tree
+    while (job) {
+        if (job->unfinished.fetch_sub(1, std::memory_order_acq_rel) != 1) return;
+        JobHandle parent = std::move(job->parent);
+        job = std::move(parent);
+    }
+}
+
+JobSystem& getJobSystem() {
+    static JobSystem system;
+    return system;
+}
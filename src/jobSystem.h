@@ -0,0 +1,117 @@
+// jobSystem.h - Work-stealing job scheduler shared by loading and per-frame CPU work
+#ifndef JOB_SYSTEM_H
+#define JOB_SYSTEM_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class Job;
+using JobHandle = std::shared_ptr<Job>;
+
+// A function to run once, and the children it waits for. A job counts as finished when
+// it has run and every child has finished, so waiting on a parent waits on its tree.
+class Job {
+public:
+    bool isFinished() const { return unfinished.load(std::memory_order_acquire) == 0; }
+
+private:
+    friend class JobSystem;
+
+    std::function<void()> function;
+    JobHandle parent;
+    // One for the job itself until it has run, plus one per unfinished child
+    std::atomic<int> unfinished{1};
+};
+
+struct JobSystemStats {
+    int workers = 0;
+    // Totals since the system started
+    uint64_t jobsRun = 0;
+    // Taken from another thread's queue
+    uint64_t jobsStolen = 0;
+    // Run by a thread waiting on a job rather than by an idle worker
+    uint64_t jobsHelped = 0;
+};
+
+// Each worker has its own deque: it pushes and pops at the back, so a job's children run
+// on the thread that made them while their data is still in cache, and idle workers steal
+// the oldest job from the front of someone else's. Threads outside the pool (the GL
+// thread, loaders) share one extra queue. wait() never blocks while there is work: the
+// waiting thread runs queued jobs until its own is done, so with no workers at all every
+// job still runs, on whichever thread waits for it.
+class JobSystem {
+public:
+    // Below 0 uses RAYTRACER_JOB_WORKERS or one less than the hardware threads, up to
+    // MAX_WORKERS; 0 runs everything on the threads that wait
+    explicit JobSystem(int workerCount = -1);
+    // Runs whatever is still queued, then stops the workers
+    ~JobSystem();
+
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    static const int MAX_WORKERS = 63;
+
+    // Makes a job without queueing it. A child has to be created before its parent
+    // finishes: before the parent is submitted, or from inside the parent's function
+    // (with getCurrentJob() as the parent).
+    JobHandle create(std::function<void()> function, const JobHandle& parent = JobHandle());
+    void submit(const JobHandle& job);
+    // create() and submit() in one
+    JobHandle run(std::function<void()> function, const JobHandle& parent = JobHandle());
+    // Runs queued jobs on the calling thread until the job and all its children finished
+    void wait(const JobHandle& job);
+    // Calls body over [0, count) in chunks of grain items (0 picks a few chunks per
+    // thread) and returns once all of them ran; the calling thread takes chunks too
+    void parallelFor(size_t count, size_t grain, const std::function<void(size_t begin, size_t end)>& body);
+
+    // The job whose function is running on this thread, null outside of one
+    static JobHandle getCurrentJob();
+
+    int getWorkerCount() const { return static_cast<int>(workers.size()); }
+    // Workers plus the thread that waits
+    int getThreadCount() const { return getWorkerCount() + 1; }
+    JobSystemStats getStats() const;
+
+private:
+    struct WorkQueue {
+        std::mutex mutex;
+        std::deque<JobHandle> jobs;
+    };
+
+    // Queue 0 is shared by threads outside the pool; worker i owns queue i + 1
+    std::vector<std::unique_ptr<WorkQueue>> queues;
+    std::vector<std::thread> workers;
+    // Jobs queued and not yet taken, so idle workers know when to sleep
+    std::atomic<size_t> queued;
+    std::mutex sleepMutex;
+    std::condition_variable wake;
+    bool stopping;
+
+    std::atomic<uint64_t> jobsRun;
+    std::atomic<uint64_t> jobsStolen;
+    std::atomic<uint64_t> jobsHelped;
+
+    void workerLoop(int queue);
+    // The calling thread's queue in this system
+    int currentQueue() const;
+    // Pops the newest job of its own queue, or steals the oldest of another
+    JobHandle take(int queue);
+    // Runs one queued job if there is any
+    bool runOne(int queue, bool helping);
+    void execute(const JobHandle& job);
+    void finish(JobHandle job);
+};
+
+// The process-wide job system, started on first use
+JobSystem& getJobSystem();
+
+#endif // JOB_SYSTEM_H
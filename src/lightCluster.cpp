@@ -0,0 +1,318 @@
+#include "lightCluster.h"
+#include "error.h"
+#include "glState.h"
+#include <glm/gtc/type_ptr.hpp>
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define CLUSTER_SIMD_SSE
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define CLUSTER_SIMD_NEON
+#endif
+
+// Tests four spheres against one cluster AABB; bit i of the result is set when sphere i overlaps.
+static inline unsigned int overlapMask4(const float* x, const float* y, const float* z, const float* r, const ClusterBounds& b) {
+#if defined(CLUSTER_SIMD_SSE)
+    const __m128 zero = _mm_setzero_ps();
+    __m128 px = _mm_loadu_ps(x);
+    __m128 py = _mm_loadu_ps(y);
+    __m128 pz = _mm_loadu_ps(z);
+    __m128 pr = _mm_loadu_ps(r);
+
+    // Distance from the sphere centre to the box along each axis (0 when inside)
+    __m128 dx = _mm_max_ps(zero, _mm_max_ps(_mm_sub_ps(_mm_set1_ps(b.min.x), px), _mm_sub_ps(px, _mm_set1_ps(b.max.x))));
+    __m128 dy = _mm_max_ps(zero, _mm_max_ps(_mm_sub_ps(_mm_set1_ps(b.min.y), py), _mm_sub_ps(py, _mm_set1_ps(b.max.y))));
+    __m128 dz = _mm_max_ps(zero, _mm_max_ps(_mm_sub_ps(_mm_set1_ps(b.min.z), pz), _mm_sub_ps(pz, _mm_set1_ps(b.max.z))));
+
+    __m128 dist2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+    return static_cast<unsigned int>(_mm_movemask_ps(_mm_cmple_ps(dist2, _mm_mul_ps(pr, pr))));
+#elif defined(CLUSTER_SIMD_NEON)
+    const float32x4_t zero = vdupq_n_f32(0.0f);
+    float32x4_t px = vld1q_f32(x);
+    float32x4_t py = vld1q_f32(y);
+    float32x4_t pz = vld1q_f32(z);
+    float32x4_t pr = vld1q_f32(r);
+
+    float32x4_t dx = vmaxq_f32(zero, vmaxq_f32(vsubq_f32(vdupq_n_f32(b.min.x), px), vsubq_f32(px, vdupq_n_f32(b.max.x))));
+    float32x4_t dy = vmaxq_f32(zero, vmaxq_f32(vsubq_f32(vdupq_n_f32(b.min.y), py), vsubq_f32(py, vdupq_n_f32(b.max.y))));
+    float32x4_t dz = vmaxq_f32(zero, vmaxq_f32(vsubq_f32(vdupq_n_f32(b.min.z), pz), vsubq_f32(pz, vdupq_n_f32(b.max.z))));
+
+    float32x4_t dist2 = vmlaq_f32(vmlaq_f32(vmulq_f32(dx, dx), dy, dy), dz, dz);
+    uint32x4_t hit = vcleq_f32(dist2, vmulq_f32(pr, pr));
+    static const uint32_t laneBits[4] = { 1, 2, 4, 8 };
+    return vaddvq_u32(vandq_u32(hit, vld1q_u32(laneBits)));
+#else
+    unsigned int mask = 0;
+    for (int i = 0; i < 4; ++i) {
+        float dx = std::max(0.0f, std::max(b.min.x - x[i], x[i] - b.max.x));
+        float dy = std::max(0.0f, std::max(b.min.y - y[i], y[i] - b.max.y));
+        float dz = std::max(0.0f, std::max(b.min.z - z[i], z[i] - b.max.z));
+        if (dx * dx + dy * dy + dz * dz <= r[i] * r[i]) {
+            mask |= 1u << i;
+        }
+    }
+    return mask;
+#endif
+}
+
+static inline unsigned int lowestBit(unsigned int mask) {
+#if defined(__GNUC__) || defined(__clang__)
+    return static_cast<unsigned int>(__builtin_ctz(mask));
+#else
+    unsigned int bit = 0;
+    while (!(mask & 1u)) { mask >>= 1; ++bit; }
+    return bit;
+#endif
+}
+
+LightClusterGrid::LightClusterGrid(DynamicUploadRing& uploads)
+    : uploads(uploads), bufferBase(0), cachedProjection(0.0f), nearPlane(0.1f), farPlane(100.0f) {
+    clusterBounds.resize(CLUSTER_COUNT);
+    clusterRecords.resize(CLUSTER_COUNT);
+}
+
+void LightClusterGrid::buildClusterBounds(const glm::mat4& projection) {
+    glm::mat4 invProjection = glm::inverse(projection);
+
+    // Reconstruct the planes from the projection so zoom changes are picked up
+    nearPlane = projection[3][2] / (projection[2][2] - 1.0f);
+    farPlane = projection[3][2] / (projection[2][2] + 1.0f);
+    float depthRatio = farPlane / nearPlane;
+
+    for (unsigned int z = 0; z < GRID_Z; ++z) {
+        // Exponential slicing keeps clusters roughly cubic along the view direction
+        float sliceNear = nearPlane * std::pow(depthRatio, static_cast<float>(z) / GRID_Z);
+        float sliceFar = nearPlane * std::pow(depthRatio, static_cast<float>(z + 1) / GRID_Z);
+
+        for (unsigned int y = 0; y < GRID_Y; ++y) {
+            for (unsigned int x = 0; x < GRID_X; ++x) {
+                glm::vec3 bmin(FLT_MAX);
+                glm::vec3 bmax(-FLT_MAX);
+
+                for (unsigned int corner = 0; corner < 4; ++corner) {
+                    float ndcX = -1.0f + 2.0f * static_cast<float>(x + (corner & 1u)) / GRID_X;
+                    float ndcY = -1.0f + 2.0f * static_cast<float>(y + (corner >> 1)) / GRID_Y;
+
+                    // Point on the near plane, then slide it along the eye ray to both slice depths
+                    glm::vec4 nearPoint = invProjection * glm::vec4(ndcX, ndcY, -1.0f, 1.0f);
+                    glm::vec3 ray = glm::vec3(nearPoint) / nearPoint.w;
+                    ray /= -ray.z;
+
+                    glm::vec3 pNear = ray * sliceNear;
+                    glm::vec3 pFar = ray * sliceFar;
+                    bmin = glm::min(bmin, glm::min(pNear, pFar));
+                    bmax = glm::max(bmax, glm::max(pNear, pFar));
+                }
+
+                ClusterBounds& bounds = clusterBounds[(z * GRID_Y + y) * GRID_X + x];
+                bounds.min = bmin;
+                bounds.max = bmax;
+            }
+        }
+    }
+
+    cachedProjection = projection;
+}
+
+void LightClusterGrid::packLights(const LightManager& lightManager, const glm::mat4& view) {
+    lightData.clear();
+    sphereX.clear();
+    sphereY.clear();
+    sphereZ.clear();
+    sphereRadius.clear();
+
+    const std::vector<Light>& lights = lightManager.getLights();
+
+    // Point lights first, then spot lights, so per-cluster index lists keep the same order
+    for (int pass = 0; pass < 2; ++pass) {
+        LightType wanted = pass == 0 ? LightType::Point : LightType::Spot;
+
+        for (size_t i = 0; i < lights.size(); ++i) {
+            const Light& light = lights[i];
+            const LightProperties& props = light.getProperties();
+            if (light.getType() != wanted || !props.enabled) {
+                continue;
+            }
+
+            float range = std::min(light.calculateRange(), props.range);
+            float cosInner = std::cos(glm::radians(props.innerCutoff));
+            float cosOuter = std::cos(glm::radians(props.outerCutoff));
+
+            lightData.push_back(glm::vec4(props.position, range));
+            lightData.push_back(glm::vec4(props.color, props.intensity));
+            lightData.push_back(glm::vec4(props.constant, props.linear, props.quadratic, static_cast<float>(i)));
+            lightData.push_back(glm::vec4(props.direction, 0.0f));
+            lightData.push_back(glm::vec4(cosInner, cosOuter, 0.0f, 0.0f));
+
+            glm::vec3 center = props.position;
+            float radius = range;
+            if (wanted == LightType::Spot) {
+                // Tightest sphere around the cone instead of the full range sphere
+                float halfAngle = glm::radians(props.outerCutoff);
+                if (halfAngle > glm::radians(45.0f)) {
+                    center = props.position + props.direction * (range * cosOuter);
+                    radius = range * std::sin(halfAngle);
+                } else {
+                    radius = range / (2.0f * cosOuter);
+                    center = props.position + props.direction * radius;
+                }
+            }
+
+            glm::vec3 viewCenter = glm::vec3(view * glm::vec4(center, 1.0f));
+            sphereX.push_back(viewCenter.x);
+            sphereY.push_back(viewCenter.y);
+            sphereZ.push_back(viewCenter.z);
+            sphereRadius.push_back(radius);
+
+            if (wanted == LightType::Point) {
+                stats.pointLights++;
+            } else {
+                stats.spotLights++;
+            }
+        }
+    }
+}
+
+void LightClusterGrid::assignLights(size_t pointCount, size_t spotCount) {
+    const size_t lightCount = pointCount + spotCount;
+    const float depthRatio = farPlane / nearPlane;
+
+    // Per-slice compacted SoA lists so each froxel only tests lights overlapping its depth range
+    std::vector<float> sliceX, sliceY, sliceZ, sliceR;
+    std::vector<GLuint> sliceLight;
+
+    lightIndices.clear();
+
+    for (unsigned int z = 0; z < GRID_Z; ++z) {
+        sliceX.clear();
+        sliceY.clear();
+        sliceZ.clear();
+        sliceR.clear();
+        sliceLight.clear();
+
+        float sliceNear = nearPlane * std::pow(depthRatio, static_cast<float>(z) / GRID_Z);
+        float sliceFar = nearPlane * std::pow(depthRatio, static_cast<float>(z + 1) / GRID_Z);
+
+        for (size_t i = 0; i < lightCount; ++i) {
+            float depth = -sphereZ[i];
+            if (depth + sphereRadius[i] < sliceNear || depth - sphereRadius[i] > sliceFar) {
+                continue;
+            }
+            sliceX.push_back(sphereX[i]);
+            sliceY.push_back(sphereY[i]);
+            sliceZ.push_back(sphereZ[i]);
+            sliceR.push_back(sphereRadius[i]);
+            sliceLight.push_back(static_cast<GLuint>(i));
+        }
+
+        // Pad to a multiple of 4 with spheres that can never overlap anything
+        size_t sliceCount = sliceLight.size();
+        while (sliceX.size() % 4 != 0) {
+            sliceX.push_back(1e18f);
+            sliceY.push_back(1e18f);
+            sliceZ.push_back(1e18f);
+            sliceR.push_back(0.0f);
+        }
+
+        for (unsigned int y = 0; y < GRID_Y; ++y) {
+            for (unsigned int x = 0; x < GRID_X; ++x) {
+                unsigned int cluster = (z * GRID_Y + y) * GRID_X + x;
+                const ClusterBounds& bounds = clusterBounds[cluster];
+
+                GLuint offset = static_cast<GLuint>(lightIndices.size());
+                GLuint points = 0;
+                GLuint spots = 0;
+                bool overflow = false;
+
+                for (size_t i = 0; i < sliceX.size() && !overflow; i += 4) {
+                    unsigned int mask = overlapMask4(&sliceX[i], &sliceY[i], &sliceZ[i], &sliceR[i], bounds);
+                    while (mask) {
+                        size_t lane = i + lowestBit(mask);
+                        mask &= mask - 1;
+                        if (lane >= sliceCount) {
+                            break;
+                        }
+                        if (points + spots >= MAX_LIGHTS_PER_CLUSTER) {
+                            overflow = true;
+                            break;
+                        }
+
+                        GLuint light = sliceLight[lane];
+                        lightIndices.push_back(light);
+                        if (light < pointCount) {
+                            points++;
+                        } else {
+                            spots++;
+                        }
+                    }
+                }
+
+                if (overflow) {
+                    stats.overflowedClusters++;
+                }
+                stats.maxLightsInCluster = std::max(stats.maxLightsInCluster, static_cast<int>(points + spots));
+                clusterRecords[cluster] = glm::uvec2(offset, (points << 16) | spots);
+            }
+        }
+    }
+
+    stats.totalIndices = static_cast<int>(lightIndices.size());
+}
+
+void LightClusterGrid::upload() {
+    // Texture buffers may not be empty
+    if (lightData.empty()) lightData.push_back(glm::vec4(0.0f));
+    if (lightIndices.empty()) lightIndices.push_back(0);
+
+    UploadAllocation lights = uploads.allocate(lightData.size() * sizeof(glm::vec4), sizeof(glm::vec4));
+    UploadAllocation records = uploads.allocate(clusterRecords.size() * sizeof(glm::uvec2), sizeof(glm::uvec2));
+    UploadAllocation indices = uploads.allocate(lightIndices.size() * sizeof(GLuint), sizeof(GLuint));
+    if (!lights.valid() || !records.valid() || !indices.valid()) {
+        // The ring grows next frame; keep reading last frame's lights until then
+        return;
+    }
+
+    std::memcpy(lights.data, lightData.data(), lights.size);
+    std::memcpy(records.data, clusterRecords.data(), records.size);
+    std::memcpy(indices.data, lightIndices.data(), indices.size);
+    uploads.flush();
+
+    bufferBase = glm::ivec3(lights.offset / sizeof(glm::vec4), records.offset / sizeof(glm::uvec2), indices.offset / sizeof(GLuint));
+}
+
+void LightClusterGrid::build(const LightManager& lightManager, const Camera& camera) {
+    // The TAA jitter would otherwise rebuild the bounds every frame
+    glm::mat4 projection = camera.getUnjitteredProjectionMatrix();
+    if (projection != cachedProjection) {
+        buildClusterBounds(projection);
+    }
+
+    stats = ClusterStats();
+    packLights(lightManager, camera.getViewMatrix());
+    assignLights(static_cast<size_t>(stats.pointLights), static_cast<size_t>(stats.spotLights));
+}
+
+void LightClusterGrid::bindForRendering(Shader& shader) {
+    GLStateCache& state = getGLState();
+    state.bindTexture(CLUSTER_LIGHT_DATA_UNIT, GL_TEXTURE_BUFFER, uploads.getTextureView(GL_RGBA32F));
+    state.bindTexture(CLUSTER_RECORD_UNIT, GL_TEXTURE_BUFFER, uploads.getTextureView(GL_RG32UI));
+    state.bindTexture(CLUSTER_INDEX_UNIT, GL_TEXTURE_BUFFER, uploads.getTextureView(GL_R32UI));
+
+    shader.setInt("clusterLightData", CLUSTER_LIGHT_DATA_UNIT);
+    shader.setInt("clusterRecords", CLUSTER_RECORD_UNIT);
+    shader.setInt("clusterLightIndices", CLUSTER_INDEX_UNIT);
+
+    // slice = log(viewDepth) * scale + bias, matching buildClusterBounds
+    float sliceScale = GRID_Z / std::log(farPlane / nearPlane);
+    float sliceBias = -sliceScale * std::log(nearPlane);
+    shader.setFloat("clusterSliceScale", sliceScale);
+    shader.setFloat("clusterSliceBias", sliceBias);
+    glm::ivec3 gridSize(GRID_X, GRID_Y, GRID_Z);
+    shader.setIVec3("clusterGridSize", glm::value_ptr(gridSize));
+    shader.setIVec3("clusterBufferBase", glm::value_ptr(bufferBase));
+}
@@ -0,0 +1,84 @@
+#ifndef LIGHT_CLUSTER_H
+#define LIGHT_CLUSTER_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <vector>
+#include "lightManager.h"
+#include "camera.h"
+#include "shader.h"
+#include "uploadRing.h"
+
+// Texture units used by the clustered lighting buffers (shadow maps use 10-13)
+const GLuint CLUSTER_LIGHT_DATA_UNIT = 14;
+const GLuint CLUSTER_RECORD_UNIT = 15;
+const GLuint CLUSTER_INDEX_UNIT = 16;
+
+struct ClusterBounds {
+    glm::vec3 min;
+    glm::vec3 max;
+};
+
+struct ClusterStats {
+    int pointLights = 0;
+    int spotLights = 0;
+    int totalIndices = 0;
+    int maxLightsInCluster = 0;
+    int overflowedClusters = 0;
+};
+
+// Splits the view frustum into froxels and assigns point/spot lights to them on the CPU.
+// Light data, per-cluster (offset, count) records and the flat index list are written to
+// the frame's upload ring and read as texture buffers, so default.frag only loops over the
+// lights touching its cluster.
+class LightClusterGrid {
+public:
+    static const unsigned int GRID_X = 16;
+    static const unsigned int GRID_Y = 9;
+    static const unsigned int GRID_Z = 24;
+    static const unsigned int CLUSTER_COUNT = GRID_X * GRID_Y * GRID_Z;
+    static const unsigned int MAX_LIGHTS_PER_CLUSTER = 256;
+    // vec4 texels per light in the light data buffer
+    static const unsigned int TEXELS_PER_LIGHT = 5;
+
+    explicit LightClusterGrid(DynamicUploadRing& uploads);
+
+    LightClusterGrid(const LightClusterGrid&) = delete;
+    LightClusterGrid& operator=(const LightClusterGrid&) = delete;
+
+    // Assigns lights to clusters on the CPU; never touches GL or the ring, so it may run
+    // on a draw list worker
+    void build(const LightManager& lightManager, const Camera& camera);
+    // Writes the last build to the upload ring; GL thread only
+    void upload();
+    void bindForRendering(Shader& shader);
+
+    const ClusterStats& getStats() const { return stats; }
+
+private:
+    DynamicUploadRing& uploads;
+    // Texel offsets of this frame's light data, records and indices in the ring's views
+    glm::ivec3 bufferBase;
+
+    std::vector<ClusterBounds> clusterBounds;
+    glm::mat4 cachedProjection;
+    float nearPlane;
+    float farPlane;
+
+    // CPU-side staging for the upload
+    std::vector<glm::vec4> lightData;
+    std::vector<glm::uvec2> clusterRecords;
+    std::vector<GLuint> lightIndices;
+
+    // View-space culling spheres in SoA layout, one per packed light. assignLights copies
+    // each slice's overlapping spheres into lists padded to a multiple of 4 for SIMD.
+    std::vector<float> sphereX, sphereY, sphereZ, sphereRadius;
+
+    ClusterStats stats;
+
+    void buildClusterBounds(const glm::mat4& projection);
+    void packLights(const LightManager& lightManager, const glm::mat4& view);
+    void assignLights(size_t pointCount, size_t spotCount);
+};
+
+#endif // LIGHT_CLUSTER_H
@@ -1,9 +1,9 @@
 #include "lightManager.h"
-#include "../../RayTracer/include/glm/gtc/type_ptr.hpp"
+#include "cpuProfiler.h"
+#include <algorithm>
+#include <glm/gtc/type_ptr.hpp>
 
 size_t MAX_DIRECTIONAL_LIGHTS = 4;
-size_t MAX_POINT_LIGHTS = 32;
-size_t MAX_SPOT_LIGHTS = 4;
 
 LightManager::LightManager() {}
 LightManager::~LightManager() {}
@@ -107,18 +107,21 @@ std::vector<size_t> LightManager::getLightsInRange(const glm::vec3 &position, fl
     return indices;
 }
 
+int LightManager::getDirectionalLightCount() const
+{
+    size_t count = getLightsByType(LightType::Directional).size();
+    return static_cast<int>(std::min(count, MAX_DIRECTIONAL_LIGHTS));
+}
+
 void LightManager::updateShaderUniforms(Shader &shader) const
 {
+    PROFILE_ZONE("Light uploads");
     uploadDirectionalLights(shader);
-    uploadPointLights(shader);
-    uploadSpotLights(shader);
 }
 
 void LightManager::uploadDirectionalLights(Shader &shader) const
 {
     std::vector<size_t> directionalLights = getLightsByType(LightType::Directional);
-    shader.setFloat("numDirectionalLights", static_cast<float>(directionalLights.size()));
-
     for (size_t i = 0; i < directionalLights.size() && i < MAX_DIRECTIONAL_LIGHTS; i++)
     {
         const Light &light = lights[directionalLights[i]];
@@ -126,49 +129,9 @@ void LightManager::uploadDirectionalLights(Shader &shader) const
 
         std::string base = "directionalLights[" + std::to_string(i) + "]";
 
-        shader.setVec4((base + ".direction"), glm::value_ptr(glm::vec4(properties.direction, 0.0f)));
-        shader.setVec4((base + ".color"), glm::value_ptr(glm::vec4(properties.color, properties.intensity)));
-        shader.setBool((base + ".enabled"), properties.enabled);
-    }
-}
-
-void LightManager::uploadPointLights(Shader &shader) const
-{
-    std::vector<size_t> pointLights = getLightsByType(LightType::Point);
-    shader.setFloat("numPointLights", static_cast<float>(pointLights.size()));
-
-    for (size_t i = 0; i < pointLights.size() && i < MAX_POINT_LIGHTS; i++)
-    {
-        const Light &light = lights[pointLights[i]];
-        const LightProperties &properties = light.getProperties();
-
-        std::string base = "pointLights[" + std::to_string(i) + "]";
-
-        shader.setVec4((base + ".position"), glm::value_ptr(glm::vec4(properties.position, 1.0f)));
-        shader.setVec4((base + ".color"), glm::value_ptr(glm::vec4(properties.color, properties.intensity)));
-        shader.setVec4((base + ".attenuation"), glm::value_ptr(glm::vec4(properties.constant, properties.linear, properties.quadratic, 0.0f)));
-        shader.setBool((base + ".enabled"), properties.enabled);
-    }
-}
-
-void LightManager::uploadSpotLights(Shader &shader) const
-{
-    auto spotLights = getLightsByType(LightType::Spot);
-
-    shader.setFloat("numSpotLights", static_cast<float>(spotLights.size()));
-
-    for (size_t i = 0; i < spotLights.size() && i < 16; ++i)
-    { // Limit to 16 spot lights
-        const Light &light = lights[spotLights[i]];
-        const LightProperties &properties = light.getProperties();
-
-        std::string base = "spotLights[" + std::to_string(i) + "]";
-
-        shader.setVec4((base + ".position"), glm::value_ptr(glm::vec4(properties.position, 1.0f)));
-        shader.setVec4((base + ".direction"), glm::value_ptr(glm::vec4(properties.direction, 0.0f)));
+        // w carries the light's index for the shadow table, like attenuation.w of clustered lights
+        shader.setVec4((base + ".direction"), glm::value_ptr(glm::vec4(properties.direction, static_cast<float>(directionalLights[i]))));
         shader.setVec4((base + ".color"), glm::value_ptr(glm::vec4(properties.color, properties.intensity)));
-        shader.setVec4((base + ".attenuation"), glm::value_ptr(glm::vec4(properties.constant, properties.linear, properties.quadratic, 0.0f)));
-        shader.setVec4((base + ".cutoff"), glm::value_ptr(glm::vec4(cos(glm::radians(properties.innerCutoff)), cos(glm::radians(properties.outerCutoff)), 0.0f, 0.0f)));
         shader.setBool((base + ".enabled"), properties.enabled);
     }
 }
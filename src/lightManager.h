@@ -41,6 +41,8 @@ public:
     void updateShaderUniforms(Shader& shader) const;
 
     std::vector<size_t> getLightsByType(LightType type) const;
+    // Directional lights uploaded to the shader (capped), i.e. DIRECTIONAL_LIGHT_COUNT
+    int getDirectionalLightCount() const;
 
     std::vector<size_t> getLightsInRange(const glm::vec3& position, float radius = 0.0f) const;
 
@@ -52,9 +54,8 @@ public:
 private:
     std::vector<Light> lights;
 
+    // Point and spot lights are culled and uploaded per cluster by LightClusterGrid
     void uploadDirectionalLights(Shader& shader) const;
-    void uploadPointLights(Shader& shader) const;
-    void uploadSpotLights(Shader& shader) const;
 };
 
 #endif // LIGHT_MANAGER_H
@@ -0,0 +1,232 @@
+#include "log.h"
+#include <chrono>
+#include <condition_variable>
+#include <cstdarg>
+#include <cstdio>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+namespace {
+
+const size_t RING_CAPACITY = 2048; // must be a power of two
+const size_t RING_MASK = RING_CAPACITY - 1;
+const size_t MESSAGE_SIZE = 240;
+
+const char* levelNames[] = { "trace", "debug", "info", "warn", "error", "off" };
+const char* categoryNames[] = { "general", "gl", "render", "shadow", "light", "scene", "shader" };
+
+struct LogEntry {
+    std::atomic<size_t> sequence;
+    int64_t timestampUs;
+    LogLevel level;
+    LogCategory category;
+    char message[MESSAGE_SIZE];
+};
+
+// Bounded multi-producer ring (Vyukov); a single consumer drains it under consumerMutex
+class Logger {
+public:
+    Logger() : enqueuePos(0), dequeuePos(0), dropped(0), running(true),
+               startTime(std::chrono::steady_clock::now()) {
+        for (size_t i = 0; i < RING_CAPACITY; ++i) {
+            entries[i].sequence.store(i, std::memory_order_relaxed);
+        }
+        writerThread = std::thread(&Logger::run, this);
+    }
+
+    ~Logger() {
+        {
+            std::lock_guard<std::mutex> lock(wakeMutex);
+            running = false;
+        }
+        wake.notify_one();
+        writerThread.join();
+        drain();
+    }
+
+    void push(LogLevel level, LogCategory category, const char* format, va_list args) {
+        size_t pos = enqueuePos.load(std::memory_order_relaxed);
+        LogEntry* entry = nullptr;
+        for (;;) {
+            entry = &entries[pos & RING_MASK];
+            size_t seq = entry->sequence.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+            if (diff == 0) {
+                if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                dropped.fetch_add(1, std::memory_order_relaxed);
+                return;
+            } else {
+                pos = enqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+
+        entry->timestampUs = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - startTime).count();
+        entry->level = level;
+        entry->category = category;
+        std::vsnprintf(entry->message, MESSAGE_SIZE, format, args);
+        entry->sequence.store(pos + 1, std::memory_order_release);
+
+        if (level >= LogLevel::Error) {
+            wake.notify_one();
+        }
+    }
+
+    bool drain() {
+        std::lock_guard<std::mutex> lock(consumerMutex);
+        bool wroteAny = false;
+        for (;;) {
+            LogEntry& entry = entries[dequeuePos & RING_MASK];
+            size_t seq = entry.sequence.load(std::memory_order_acquire);
+            if (seq != dequeuePos + 1) {
+                break;
+            }
+
+            std::FILE* out = entry.level >= LogLevel::Warn ? stderr : stdout;
+            std::fprintf(out, "[%9.3f] [%s] [%s] %s\n",
+                         entry.timestampUs / 1000000.0,
+                         categoryNames[static_cast<uint32_t>(entry.category)],
+                         levelNames[static_cast<int>(entry.level)],
+                         entry.message);
+
+            entry.sequence.store(dequeuePos + RING_CAPACITY, std::memory_order_release);
+            dequeuePos++;
+            wroteAny = true;
+        }
+
+        uint64_t lost = dropped.exchange(0, std::memory_order_relaxed);
+        if (lost > 0) {
+            totalDropped += lost;
+            std::fprintf(stderr, "[log] ring buffer full, dropped %llu messages\n", static_cast<unsigned long long>(lost));
+        }
+        if (wroteAny) {
+            std::fflush(stdout);
+        }
+        return wroteAny;
+    }
+
+    uint64_t getDropped() {
+        std::lock_guard<std::mutex> lock(consumerMutex);
+        return totalDropped + dropped.load(std::memory_order_relaxed);
+    }
+
+private:
+    LogEntry entries[RING_CAPACITY];
+    std::atomic<size_t> enqueuePos;
+    size_t dequeuePos;
+    std::atomic<uint64_t> dropped;
+    uint64_t totalDropped = 0;
+
+    bool running;
+    std::chrono::steady_clock::time_point startTime;
+    std::mutex consumerMutex;
+    std::mutex wakeMutex;
+    std::condition_variable wake;
+    std::thread writerThread;
+
+    void run() {
+        std::unique_lock<std::mutex> lock(wakeMutex);
+        while (running) {
+            lock.unlock();
+            bool wroteAny = drain();
+            lock.lock();
+            if (!wroteAny && running) {
+                wake.wait_for(lock, std::chrono::milliseconds(5));
+            }
+        }
+    }
+};
+
+Logger& getLogger() {
+    static Logger logger;
+    return logger;
+}
+
+} // namespace
+
+namespace Log {
+
+std::atomic<int> runtimeLevel(static_cast<int>(LogLevel::Info));
+std::atomic<uint32_t> enabledCategories(0xFFFFFFFFu);
+
+void write(LogLevel level, LogCategory category, const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    getLogger().push(level, category, format, args);
+    va_end(args);
+}
+
+void setLevel(LogLevel level) {
+    runtimeLevel.store(static_cast<int>(level), std::memory_order_relaxed);
+}
+
+LogLevel getLevel() {
+    return static_cast<LogLevel>(runtimeLevel.load(std::memory_order_relaxed));
+}
+
+void setCategoryEnabled(LogCategory category, bool enabled) {
+    uint32_t bit = 1u << static_cast<uint32_t>(category);
+    if (enabled) {
+        enabledCategories.fetch_or(bit, std::memory_order_relaxed);
+    } else {
+        enabledCategories.fetch_and(~bit, std::memory_order_relaxed);
+    }
+}
+
+bool isCategoryEnabled(LogCategory category) {
+    return (enabledCategories.load(std::memory_order_relaxed) & (1u << static_cast<uint32_t>(category))) != 0;
+}
+
+void setEnabledCategories(const std::string& list) {
+    if (list == "all") {
+        enabledCategories.store(0xFFFFFFFFu, std::memory_order_relaxed);
+        return;
+    }
+
+    uint32_t mask = 0;
+    std::stringstream ss(list);
+    std::string name;
+    while (std::getline(ss, name, ',')) {
+        bool found = false;
+        for (uint32_t i = 0; i < static_cast<uint32_t>(LogCategory::Count); ++i) {
+            if (name == categoryNames[i]) {
+                mask |= 1u << i;
+                found = true;
+            }
+        }
+        if (!found) {
+            std::cerr << "Unknown log category '" << name << "'" << std::endl;
+        }
+    }
+    enabledCategories.store(mask, std::memory_order_relaxed);
+}
+
+LogLevel parseLevel(const std::string& name, LogLevel fallback) {
+    for (int i = 0; i <= static_cast<int>(LogLevel::Off); ++i) {
+        if (name == levelNames[i]) {
+            return static_cast<LogLevel>(i);
+        }
+    }
+    std::cerr << "Unknown log level '" << name << "'" << std::endl;
+    return fallback;
+}
+
+const char* getCategoryName(LogCategory category) {
+    return categoryNames[static_cast<uint32_t>(category)];
+}
+
+void flush() {
+    getLogger().drain();
+}
+
+uint64_t getDroppedCount() {
+    return getLogger().getDropped();
+}
+
+} // namespace Log
@@ -0,0 +1,95 @@
+#ifndef LOG_H
+#define LOG_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+enum class LogLevel : int {
+    Trace = 0,
+    Debug = 1,
+    Info = 2,
+    Warn = 3,
+    Error = 4,
+    Off = 5
+};
+
+enum class LogCategory : uint32_t {
+    General,
+    GL,
+    Render,
+    Shadow,
+    Light,
+    Scene,
+    Shader,
+    Count
+};
+
+// Levels below this are stripped at compile time (set per build type in CMake)
+#ifndef RAYTRACER_LOG_MIN_LEVEL
+#define RAYTRACER_LOG_MIN_LEVEL 0
+#endif
+
+// Messages are formatted straight into a lock-free ring buffer by the calling thread and
+// written to stdout/stderr by a background thread, so logging never blocks on console I/O.
+// When the ring is full new messages are dropped and counted rather than waiting.
+namespace Log {
+    extern std::atomic<int> runtimeLevel;
+    extern std::atomic<uint32_t> enabledCategories;
+
+    inline bool isEnabled(LogLevel level, LogCategory category) {
+        return static_cast<int>(level) >= runtimeLevel.load(std::memory_order_relaxed) &&
+               (enabledCategories.load(std::memory_order_relaxed) & (1u << static_cast<uint32_t>(category))) != 0;
+    }
+
+#if defined(__GNUC__) || defined(__clang__)
+    void write(LogLevel level, LogCategory category, const char* format, ...) __attribute__((format(printf, 3, 4)));
+#else
+    void write(LogLevel level, LogCategory category, const char* format, ...);
+#endif
+
+    void setLevel(LogLevel level);
+    LogLevel getLevel();
+    void setCategoryEnabled(LogCategory category, bool enabled);
+    bool isCategoryEnabled(LogCategory category);
+
+    // "shadow,scene" enables only those categories; "all" enables everything
+    void setEnabledCategories(const std::string& list);
+    LogLevel parseLevel(const std::string& name, LogLevel fallback);
+    const char* getCategoryName(LogCategory category);
+
+    // Blocks until everything queued so far has been written
+    void flush();
+    uint64_t getDroppedCount();
+}
+
+#define RT_LOG(level, category, ...) \
+    do { if (Log::isEnabled(level, category)) Log::write(level, category, __VA_ARGS__); } while (0)
+
+#if RAYTRACER_LOG_MIN_LEVEL <= 0
+#define LOG_TRACE(category, ...) RT_LOG(LogLevel::Trace, LogCategory::category, __VA_ARGS__)
+#else
+#define LOG_TRACE(category, ...) ((void)0)
+#endif
+
+#if RAYTRACER_LOG_MIN_LEVEL <= 1
+#define LOG_DEBUG(category, ...) RT_LOG(LogLevel::Debug, LogCategory::category, __VA_ARGS__)
+#else
+#define LOG_DEBUG(category, ...) ((void)0)
+#endif
+
+#if RAYTRACER_LOG_MIN_LEVEL <= 2
+#define LOG_INFO(category, ...) RT_LOG(LogLevel::Info, LogCategory::category, __VA_ARGS__)
+#else
+#define LOG_INFO(category, ...) ((void)0)
+#endif
+
+#if RAYTRACER_LOG_MIN_LEVEL <= 3
+#define LOG_WARN(category, ...) RT_LOG(LogLevel::Warn, LogCategory::category, __VA_ARGS__)
+#else
+#define LOG_WARN(category, ...) ((void)0)
+#endif
+
+#define LOG_ERROR(category, ...) RT_LOG(LogLevel::Error, LogCategory::category, __VA_ARGS__)
+
+#endif // LOG_H
@@ -1,4 +1,7 @@
+#include <algorithm>
+#include <cstdlib>
 #include <iostream>
+#include <memory>
 #include <string>
 #include <vector>
 #include <glad/glad.h>
@@ -17,7 +20,18 @@
 #include <imgui_impl_glfw.h>
 #include <imgui_impl_opengl3.h>
 #include "imGuiLightManager.h"
+#include "imGuiProfiler.h"
+#include "gpuProfiler.h"
+#include "cpuProfiler.h"
 #include "shadowManager.h"
+#include "log.h"
+#include "shaderCache.h"
+#include "glExtensions.h"
+#include "glState.h"
+#include "error.h"
+#include "sceneSetup.h"
+#include "cameraPath.h"
+#include "dynamicResolution.h"
 const unsigned int width = 1200;
 const unsigned int height = 800;
 
@@ -32,36 +46,6 @@ bool firstMouse = true;
 // Each face has its own vertices and UVs for proper texture repetition
 
 
-void setupSponzaLightingWithShadows(Scene& scene) {
-    // Clear existing lights
-    scene.getLightManager().removeAllLights();
-    
-    std::cout << "=== Setting up Sponza lighting with camera-based shadows ===" << std::endl;
-    
-    // Add a simple directional light
-    size_t mainLightIndex = scene.addDirectionalLight(
-        glm::normalize(glm::vec3(0.3f, -0.8f, 0.5f)), // Sun-like direction
-        glm::vec3(1.0f, 0.95f, 0.8f),                 // Warm sunlight
-        2.0f                                           // Intensity
-    );
-    
-    // Enable shadows - no need to set scene bounds, it will use the camera
-    scene.enableShadowsForLight(mainLightIndex, 2048);
-    
-    // Add a fill light (optional)
-    size_t fillLightIndex = scene.addDirectionalLight(
-        glm::normalize(glm::vec3(-0.2f, -0.3f, -0.8f)),
-        glm::vec3(0.4f, 0.6f, 1.0f),                    // Cool fill light
-        0.3f
-    );
-    
-    std::cout << "Lighting setup complete!" << std::endl;
-    std::cout << "Main light index: " << mainLightIndex << std::endl;
-    std::cout << "Fill light index: " << fillLightIndex << std::endl;
-    std::cout << "Shadow maps: " << scene.getShadowManager().getShadowMapCount() << std::endl;
-}
-
-
 void mouse_callback(GLFWwindow* window, double xpos, double ypos) {
     Camera* camera = static_cast<Camera*>(glfwGetWindowUserPointer(window));
 
@@ -84,13 +68,41 @@ void scroll_callback(GLFWwindow* window, double xoffset, double yoffset) {
 }
 
 
-int main(int, char**){
+int main(int argc, char** argv){
+
+    RendererOptions options;
+    // Camera keyframes for the headless benchmark (--camera-path), saved on exit
+    std::string recordPath;
+    // The scene renders offscreen, so MSAA belongs to the dynamic resolution target
+    int samples = 8;
+    // Temporal AA instead of MSAA: one sample per pixel plus a velocity buffer
+    bool temporalAA = false;
+    DynamicResolutionSettings resolutionSettings;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg.rfind("--record-path=", 0) == 0) {
+            recordPath = arg.substr(14);
+        } else if (arg.rfind("--msaa=", 0) == 0) {
+            samples = std::max(1, std::atoi(arg.c_str() + 7));
+        } else if (arg.rfind("--target-ms=", 0) == 0) {
+            resolutionSettings.targetMs = static_cast<float>(std::atof(arg.c_str() + 12));
+        } else if (arg.rfind("--min-scale=", 0) == 0) {
+            resolutionSettings.minScale = static_cast<float>(std::atof(arg.c_str() + 12));
+        } else if (arg == "--taa") {
+            temporalAA = true;
+        } else if (arg == "--fixed-resolution") {
+            resolutionSettings.enabled = false;
+        } else if (!parseRendererOption(arg, options)) {
+            LOG_WARN(General, "Unknown option %s", arg.c_str());
+        }
+    }
+    GLDebugMode debugMode = options.debugMode;
 
     glfwInit();
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
 	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-    glfwWindowHint(GLFW_SAMPLES, 8);
+    glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, debugMode != GLDebugMode::Off ? GLFW_TRUE : GLFW_FALSE);
     GLFWwindow* window = glfwCreateWindow(width, height, "Ray Tracer", NULL, NULL);
     glfwMakeContextCurrent(window);
     if (glfwGetCurrentContext() == nullptr) {
@@ -102,6 +114,9 @@ int main(int, char**){
         std::cout << "Failed to initialize OpenGL context!" << std::endl;
         exit(EXIT_FAILURE);
     }
+    loadGLExtensions((GLADloadproc)glfwGetProcAddress);
+    setGLDebugMode(debugMode);
+    std::cout << "GL debug mode: " << getGLDebugModeName(getGLDebugMode()) << std::endl;
 
     glfwSetCursorPosCallback(window, mouse_callback);
     glfwSetScrollCallback(window, scroll_callback);
@@ -118,24 +133,47 @@ int main(int, char**){
     ImGui_ImplGlfw_InitForOpenGL(window, true);
     ImGui_ImplOpenGL3_Init("#version 330");
 
-    Shader shaderProgram("/Users/colintaylortaylor/Documents/raytracer/src/shaders/default.vert", "/Users/colintaylortaylor/Documents/raytracer/src/shaders/default.frag");
-    Shader shadowShader("/Users/colintaylortaylor/Documents/raytracer/src/shaders/shadow.vert", "/Users/colintaylortaylor/Documents/raytracer/src/shaders/shadow.frag");
+    // Variants of the main shader are compiled on first use, one per material/light/shadow combination
+    ShaderPermutationManager shaderPermutations(resolveSourcePath("src/shaders/default.vert"), resolveSourcePath("src/shaders/default.frag"));
+    Shader shadowShader(resolveSourcePath("src/shaders/shadow.vert").c_str(), resolveSourcePath("src/shaders/shadow.frag").c_str());
 
-    glEnable(GL_DEPTH_TEST);
-    glDepthFunc(GL_LESS);
-    glDisable(GL_CULL_FACE);
+    GLStateCache& glState = getGLState();
+    glState.setDepthTest(true);
+    glState.depthFunc(GL_LESS);
+    glState.setCullFace(false);
     glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
     glEnable(GL_MULTISAMPLE);
-    Scene scene("/Users/colintaylortaylor/Documents/raytracer/scenes/KhronosGroup glTF-Sample-Assets main Models-Sponza/glTF/Sponza.gltf");
-    GLenum err;
-    
-
-    scene.setSkybox("/Users/colintaylortaylor/Documents/raytracer/scenes/KhronosGroup glTF-Sample-Assets main Models-Sponza/skybox");
-    scene.setSkyboxShader("/Users/colintaylortaylor/Documents/raytracer/src/shaders/skybox.vert", "/Users/colintaylortaylor/Documents/raytracer/src/shaders/skybox.frag");
+    std::unique_ptr<TemporalAA> temporal;
+    if (temporalAA) {
+        temporal.reset(new TemporalAA(resolveSourcePath("src/shaders/fullscreen.vert"), resolveSourcePath("src/shaders/taa.frag")));
+    }
+    DynamicResolution dynamicResolution(resolveSourcePath("src/shaders/fullscreen.vert"), resolveSourcePath("src/shaders/upscale.frag"),
+                                        samples, temporal.get());
+    dynamicResolution.getSettings() = resolutionSettings;
+    Scene scene(options.scenePath.c_str());
+
+    if (!options.skyboxPath.empty()) {
+        scene.setSkybox(options.skyboxPath);
+        scene.setSkyboxShader(resolveSourcePath("src/shaders/skybox.vert"), resolveSourcePath("src/shaders/skybox.frag"));
+    }
+    setupShadows(scene, options);
     setupSponzaLightingWithShadows(scene);
+    ModelAnimator animator;
+    animator.attach(scene, options.animatedModel);
+
+    const ShaderCacheStats& shaderStats = getShaderCache().getStats();
+    LOG_INFO(Shader, "Shader setup: %d programs, %d from cache (%.2f ms warm), %d compiled (%.2f ms cold), %d rejected, cache %s",
+             shaderStats.programs, shaderStats.hits, shaderStats.warmMs, shaderStats.compiled, shaderStats.coldMs, shaderStats.rejected,
+             getShaderCache().isEnabled() ? getShaderCache().getDirectory().c_str() : "disabled");
 
     Camera& camera = scene.getCamera();
     ImGuiLightManager lightUI(scene.getLightManager(), camera);
+    GpuProfiler& gpuProfiler = getGpuProfiler();
+    ImGuiProfiler profilerUI(gpuProfiler);
+    profilerUI.setDynamicResolution(&dynamicResolution);
+    FrameGraph frameGraph;
+    profilerUI.setFrameGraph(&frameGraph);
+    profilerUI.setShadowManager(&scene.getShadowManager());
 
     glfwSetWindowUserPointer(window, &camera);
 
@@ -143,38 +181,111 @@ int main(int, char**){
     float lastFrame = 0.0f;
     float fpsTimer = 0.0f;
     int frameCount = 0;
+    CameraPath recordedPath;
+    float recordStart = -1.0f;
+    float lastKeyframe = 0.0f;
+    const float KEYFRAME_INTERVAL = 0.1f;
+
+    // Scene and skybox loading touched GL state outside the cache
+    glState.invalidate();
+
+    PROFILE_THREAD_NAME("Main");
+    CpuProfiler& cpuProfiler = getCpuProfiler();
+    if (options.traceFrames > 0) {
+        cpuProfiler.requestCapture(options.traceFrames, options.traceFile);
+    }
 
     while (!glfwWindowShouldClose(window)) {
-        
+        PROFILE_ZONE("Frame");
+
         float currentFrame = glfwGetTime();
         deltaTime = currentFrame - lastFrame;
         lastFrame = currentFrame;
 
         Camera* cameraPtr = static_cast<Camera*>(glfwGetWindowUserPointer(window));
-        if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
-            cameraPtr->ProcessKeyboard(FORWARD, deltaTime);
-        if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)
-            cameraPtr->ProcessKeyboard(BACKWARD, deltaTime);
-        if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS)
-            cameraPtr->ProcessKeyboard(LEFT, deltaTime);
-        if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
-            cameraPtr->ProcessKeyboard(RIGHT, deltaTime);
-
-        ImGui_ImplOpenGL3_NewFrame();
-        ImGui_ImplGlfw_NewFrame();
-        ImGui::NewFrame();
-        lightUI.render();
-
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        {
+            PROFILE_ZONE("Input");
+            if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
+                cameraPtr->ProcessKeyboard(FORWARD, deltaTime);
+            if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)
+                cameraPtr->ProcessKeyboard(BACKWARD, deltaTime);
+            if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS)
+                cameraPtr->ProcessKeyboard(LEFT, deltaTime);
+            if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
+                cameraPtr->ProcessKeyboard(RIGHT, deltaTime);
+        }
+
+        if (!recordPath.empty()) {
+            if (recordStart < 0.0f) {
+                recordStart = currentFrame;
+                lastKeyframe = currentFrame - KEYFRAME_INTERVAL;
+            }
+            if (currentFrame - lastKeyframe >= KEYFRAME_INTERVAL) {
+                recordedPath.addKeyframe(CameraKeyframe{currentFrame - recordStart, cameraPtr->getPosition(),
+                                                        cameraPtr->getYaw(), cameraPtr->getPitch()});
+                lastKeyframe = currentFrame;
+            }
+        }
+
+        {
+            PROFILE_ZONE("ImGui build");
+            ImGui_ImplOpenGL3_NewFrame();
+            ImGui_ImplGlfw_NewFrame();
+            ImGui::NewFrame();
+            lightUI.render();
+            profilerUI.render();
+        }
+        animator.update(scene, currentFrame);
+
+        int framebufferWidth, framebufferHeight;
+        glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+        glState.beginFrame();
+        gpuProfiler.beginFrame();
+        // Scaling is uniform, so the window's aspect ratio holds for the scaled target too
+        camera.setViewportSize(framebufferWidth, framebufferHeight);
+        frameGraph.reset();
+        FrameGraphResource windowTarget = frameGraph.importFramebuffer("Window", 0, framebufferWidth, framebufferHeight);
+        frameGraph.markOutput(windowTarget);
+        SceneTargets sceneTargets = dynamicResolution.beginFrame(frameGraph, framebufferWidth, framebufferHeight);
+        if (temporal) {
+            temporal->jitterCamera(camera, sceneTargets.width, sceneTargets.height);
+        }
         glFrontFace(GL_CCW);
-        scene.drawWithShadows(shaderProgram, shadowShader);
+        scene.addPasses(frameGraph, shaderPermutations, shadowShader, sceneTargets);
+        dynamicResolution.addOutputPasses(frameGraph, sceneTargets, windowTarget);
 
-        ImGui::Render();
-        ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+        // ImGui goes on top of the upscaled image at native resolution
+        {
+            PROFILE_ZONE("ImGui render");
+            ImGui::Render();
+        }
+        frameGraph.addPass("ImGui",
+            [&](FrameGraphPassBuilder& builder) {
+                builder.write(windowTarget);
+            },
+            [&](FrameGraph& frame) {
+                frame.bindRenderTarget({ windowTarget });
+                glState.viewport(0, 0, framebufferWidth, framebufferHeight);
+                ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+            });
+        {
+            PROFILE_ZONE("Scene draw");
+            frameGraph.execute();
+        }
+        camera.endFrame();
+        gpuProfiler.endFrame();
+        // ImGui binds its own program, VAO, texture and blend/cull/depth state
+        glState.invalidate();
 
 
-        glfwSwapBuffers(window);
-        glfwPollEvents();
+        checkGLFrameErrors();
+
+        {
+            PROFILE_ZONE("Swap");
+            glfwSwapBuffers(window);
+            glfwPollEvents();
+        }
+        cpuProfiler.frameMark();
 
         // FPS calculation and window title update
         frameCount++;
@@ -183,16 +294,31 @@ int main(int, char**){
             float fps = frameCount / fpsTimer;
             std::string title = "Ray Tracer - FPS: " + std::to_string(static_cast<int>(fps));
             glfwSetWindowTitle(window, title.c_str());
+#if RAYTRACER_LOG_MIN_LEVEL <= 1
+            const GLStateStats& stateStats = glState.getLastFrameStats();
+            LOG_DEBUG(GL, "GL state per frame: %llu calls issued, %llu redundant calls skipped",
+                      static_cast<unsigned long long>(stateStats.issued), static_cast<unsigned long long>(stateStats.skipped));
+#endif
+#if RAYTRACER_LOG_MIN_LEVEL <= 1
+            const UploadRingStats& uploadStats = scene.getUploadRing().getStats();
+            LOG_DEBUG(Render, "Upload ring: %zu bytes last frame, %zu peak, %d fence waits (%.2f ms), %d overflows",
+                      uploadStats.frameBytes, uploadStats.peakFrameBytes, uploadStats.fenceWaits, uploadStats.fenceWaitMs, uploadStats.overflows);
+#endif
             frameCount = 0;
             fpsTimer = 0.0f;
         }
     }
+    if (!recordPath.empty()) {
+        recordedPath.save(recordPath);
+    }
+    gpuProfiler.releaseQueries();
     ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplGlfw_Shutdown();
     ImGui::DestroyContext();
 
     glfwDestroyWindow(window);
     glfwTerminate();
+    Log::flush();
 
     return 0;
 }
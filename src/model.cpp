@@ -1,5 +1,7 @@
 #include "model.h"
+#include "glState.h"
 #include <iostream>
+#include <cfloat>
 
 static std::vector<Vertex> assembleVertices(
     const std::vector<glm::vec3>& positions,
@@ -30,10 +32,28 @@ Model::Model(const std::vector<glm::vec3>& vertices, const std::vector<unsigned
              const std::vector<glm::vec3>& tangents, const std::vector<glm::vec3>& bitangents,
              const glm::mat4x4& modelMatrix, const MaterialProperties& material) :
     vertices(vertices), indices(indices), colors(colors), textures(std::move(textures)), 
-    normals(normals), uvs(uvs), tangents(tangents), bitangents(bitangents), initialized(false), modelMatrix(modelMatrix), material(material)
+    normals(normals), uvs(uvs), tangents(tangents), bitangents(bitangents), instanceTransforms(1, modelMatrix), initialized(false), material(material),
+    shaderFeatures(SHADER_FEATURE_NONE)
 {
     // Don't create OpenGL objects in constructor - defer until first draw
     //std::cout << "Model constructor called - deferring OpenGL object creation" << std::endl;
+
+    localMin = glm::vec3(FLT_MAX);
+    localMax = glm::vec3(-FLT_MAX);
+    for (const glm::vec3& vertex : vertices) {
+        localMin = glm::min(localMin, vertex);
+        localMax = glm::max(localMax, vertex);
+    }
+
+    for (const Texture& texture : this->textures) {
+        if (texture.type == TextureType::Normal) {
+            shaderFeatures |= SHADER_FEATURE_NORMAL_MAP;
+        }
+    }
+    // Only alpha-masked materials pay for the discard; everything else keeps early-Z
+    if (material.alphaMode_MASK) {
+        shaderFeatures |= SHADER_FEATURE_ALPHA_MASK;
+    }
 }
 
 void Model::initializeGL() {
@@ -42,7 +62,7 @@ void Model::initializeGL() {
     //std::cout << "Initializing OpenGL objects for model..." << std::endl;
     
     // Check OpenGL context
-    if (!glfwGetCurrentContext()) {
+    if (!GLAD_GL_VERSION_3_3) {
         std::cerr << "Error: No OpenGL context when initializing model!" << std::endl;
         return;
     }
@@ -51,13 +71,14 @@ void Model::initializeGL() {
     std::vector<Vertex> assembledVertices = assembleVertices(vertices, colors, normals, uvs, tangents, bitangents);
     //calculateTangents(assembledVertices, indices);
 
-    // Create OpenGL objects in the correct order
+    // Create OpenGL objects in the correct order. The VAO is bound first: VAOs stay bound
+    // between draws, and the EBO binding would otherwise land in the previous model's VAO.
     vao = std::make_unique<VertexArrayObject>();
+    vao->bind();
     vbo = std::make_unique<VertexBufferObject>(assembledVertices);
     ebo = std::make_unique<ElementBufferObject>(indices);
     
     // Setup vertex attributes
-    vao->bind();
     vbo->bind();
     ebo->bind();
     
@@ -76,7 +97,7 @@ void Model::initializeGL() {
     //std::cout << "Model OpenGL objects initialized successfully" << std::endl;
 }
 
-void Model::draw(Shader& shader, Camera& camera) {
+void Model::draw(Shader& shader, int instanceBase, int instanceCount) {
     // Initialize OpenGL objects on first draw
     if (!initialized) {
         initializeGL();
@@ -86,78 +107,38 @@ void Model::draw(Shader& shader, Camera& camera) {
         }
     }
 
-    //std::cout << "Drawing Model with VAO ID: " << vao->getID() << std::endl;
-    
-    // Bind textures
-    for (size_t i = 0; i < textures.size(); ++i) {
-        std::string uniformName;
-        switch (textures[i].type) {
-            case TextureType::Diffuse:  
-                uniformName = "baseColorTexture"; 
-                break;
-            case TextureType::Normal:   
-                uniformName = "normalTexture"; 
-                break;
-            case TextureType::Metallic: 
-                uniformName = "metallicRoughnessTexture"; 
-                break;
-            case TextureType::Roughness: 
-                uniformName = "metallicRoughnessTexture"; 
-                break;
-            case TextureType::Occlusion: 
-                uniformName = "occlusionTexture"; 
-                break;
-            case TextureType::Emissive: 
-                uniformName = "emissiveTexture"; 
-                break;
-            case TextureType::Specular: 
-                uniformName = "specularTexture"; 
-                break;
-            default: 
-                uniformName = "texture" + std::to_string(i); 
-                break;
+    // Material textures go to fixed units; units this model has no texture for get 0,
+    // as the per-draw unbinds used to leave them. The cache skips bindings shared with
+    // the previous draw.
+    GLuint unitTextures[MATERIAL_TEXTURE_UNITS] = {};
+    for (auto& texture : textures) {
+        texture.loadTexture();
+        if (texture.loaded && texture.unit < MATERIAL_TEXTURE_UNITS) {
+            unitTextures[texture.unit] = texture.ID;
         }
-        textures[i].bind();
-        textures[i].texUnit(shader, uniformName.c_str(), textures[i].unit);
+    }
+    GLStateCache& state = getGLState();
+    for (GLuint unit = 0; unit < MATERIAL_TEXTURE_UNITS; ++unit) {
+        state.bindTexture(unit, GL_TEXTURE_2D, unitTextures[unit]);
     }
 
-
-    // Set matrices
-    //std::cout << camera.printViewMatrix() << std::endl;
-    shader.setMat4("view", glm::value_ptr(camera.getViewMatrix()));
-    shader.setMat4("projection", glm::value_ptr(camera.getProjectionMatrix()));
-    shader.setMat4("model", glm::value_ptr(this->getModelMatrix()));
-
-
-    shader.setVec4("baseColorFactor", glm::value_ptr(material.baseColorFactor));
-    shader.setFloat("alphaCutoff", material.alphaCutoff);
-    shader.setFloat("metallicFactor", material.metallicFactor);
-    shader.setFloat("roughnessFactor", material.roughnessFactor);
-    shader.setBool("useAlphaBlending", material.alphaMode_MASK);
+    // Matrices and material factors come from ObjectDataBuffer
+    shader.setInt("instanceBase", instanceBase);
     // Enable/disable face culling based on doubleSided
-    
-    if (material.doubleSided) {
-        glDisable(GL_CULL_FACE);
-    } else {
-        glEnable(GL_CULL_FACE);
-    }
+    state.setCullFace(!material.doubleSided);
+
     // Draw
     vao->bind();
+    glDrawElementsInstanced(GL_TRIANGLES, static_cast<GLsizei>(indices.size()), GL_UNSIGNED_INT, 0, instanceCount);
+}
 
-    glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(indices.size()), GL_UNSIGNED_INT, 0);
-    
-    // Check for errors after drawing
-    // GLenum err = glGetError();
-    // if (err != GL_NO_ERROR) {
-    //     std::cerr << "OpenGL error after draw: " << err << std::endl;
-    // }
-
-    // Cleanup
-    for (auto& texture : textures) {
-        texture.unbind();
-    }
-    
-    vao->unbind();
+void Model::bindMaterialSamplers(Shader& shader) {
+    // Units match the slots Scene assigns when importing glTF materials
+    shader.setInt("baseColorTexture", 0);
+    shader.setInt("normalTexture", 1);
+    shader.setInt("metallicRoughnessTexture", 2);
+    shader.setInt("occlusionTexture", 3);
+    shader.setInt("emissiveTexture", 4);
 }
 
 
@@ -244,7 +225,7 @@ void Model::calculateTangents(std::vector<Vertex>& vertices, const std::vector<u
     }
 }
 
-void Model::drawShadow(Shader& shadowShader) {
+void Model::drawShadow(Shader& shadowShader, int instanceBase, int instanceCount) {
     // Initialize OpenGL objects on first draw
     if (!initialized) {
         initializeGL();
@@ -254,40 +235,16 @@ void Model::drawShadow(Shader& shadowShader) {
         }
     }
 
-    // Only set the model matrix for shadow rendering
-    shadowShader.setMat4("model", glm::value_ptr(this->getModelMatrix()));
-
-    // Don't bind textures or set material properties for shadow pass
-    
-    // Draw only geometry
-    vao->bind();
-    glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(indices.size()), GL_UNSIGNED_INT, 0);
-    vao->unbind();
-}
+    // Transforms come from ObjectDataBuffer; no textures or material for the shadow pass
+    shadowShader.setInt("instanceBase", instanceBase);
 
-void Model::drawGeometryOnly() {
-    // Initialize OpenGL objects on first draw
-    if (!initialized) {
-        initializeGL();
-        if (!initialized) {
-            std::cerr << "Failed to initialize OpenGL objects for model!" << std::endl;
-            return;
-        }
+    // Face culling follows the material, as in the main pass
+    GLStateCache& state = getGLState();
+    state.setCullFace(!material.doubleSided);
+    if (!material.doubleSided) {
+        state.cullFaceMode(GL_BACK);
     }
 
-    // This method ONLY draws geometry - no texture binding, no uniform setting
-    // Assumes shader is already active and model matrix is already set
-    
-    // Handle face culling
-    if (material.doubleSided) {
-        glDisable(GL_CULL_FACE);
-    } else {
-        glEnable(GL_CULL_FACE);
-        glCullFace(GL_BACK);
-    }
-    
-    // Draw geometry
     vao->bind();
-    glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(indices.size()), GL_UNSIGNED_INT, 0);
-    vao->unbind();
+    glDrawElementsInstanced(GL_TRIANGLES, static_cast<GLsizei>(indices.size()), GL_UNSIGNED_INT, 0, instanceCount);
 }
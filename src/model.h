@@ -11,7 +11,10 @@
 #include "texture.h"
 #include "camera.h"
 #include "shader.h"
-#include "GLFW/glfw3.h"
+#include "shaderPermutation.h"
+
+// Material textures use units 0-4 (base color, normal, metallic-roughness, occlusion, emissive)
+const GLuint MATERIAL_TEXTURE_UNITS = 5;
 
 struct MaterialProperties {
     glm::vec4 baseColorFactor = glm::vec4(1.0f);
@@ -20,6 +23,8 @@ struct MaterialProperties {
     float roughnessFactor = 1.0f;
     bool alphaMode_MASK = false;
     bool doubleSided = false;
+    // Entry in ObjectDataBuffer's material table (the glTF material index)
+    int materialIndex = 0;
 };
 
 
@@ -37,12 +42,33 @@ public:
     // Delete copy constructor and copy assignment operator
     Model(const Model&) = delete;
     Model& operator=(const Model&) = delete;
-    glm::mat4x4 getModelMatrix() const { return modelMatrix; }
-    void draw(Shader& shader, Camera& camera);
+    // Transform of the first instance
+    glm::mat4x4 getModelMatrix() const { return instanceTransforms.front(); }
+    // Another copy of the same geometry and material, drawn in the same instanced call
+    void addInstance(const glm::mat4x4& transform) { instanceTransforms.push_back(transform); }
+    // Scene::setInstanceTransform also tells the object buffer and shadow caches
+    void setInstanceTransform(size_t instance, const glm::mat4x4& transform) { instanceTransforms[instance] = transform; }
+    size_t getInstanceCount() const { return instanceTransforms.size(); }
+    const std::vector<glm::mat4x4>& getInstanceTransforms() const { return instanceTransforms; }
+    const glm::vec3& getLocalMin() const { return localMin; }
+    const glm::vec3& getLocalMax() const { return localMax; }
+    size_t getTriangleCount() const { return indices.size() / 3; }
+    // Dynamic models are expected to move and are left out of cached shadow depth
+    bool isDynamic() const { return dynamic; }
+    void setDynamic(bool isDynamic) { dynamic = isDynamic; }
+
+    // Draws instanceCount instances whose object indices start at instanceBase in
+    // ObjectDataBuffer's visible instance list
+    void draw(Shader& shader, int instanceBase, int instanceCount);
+    // Points the material sampler uniforms at their units; once per shader, not per draw
+    static void bindMaterialSamplers(Shader& shader);
     MaterialProperties getMaterialProperties() const { return material; }
-    void drawShadow(Shader& shadowShader);
-    void drawGeometryOnly();
+    // ShaderFeature bits for the cheapest default.frag variant that can draw this model
+    uint32_t getShaderFeatures() const { return shaderFeatures; }
+    void drawShadow(Shader& shadowShader, int instanceBase, int instanceCount);
     const std::vector<glm::vec3>& getVertices() const { return vertices; }
+    // Material textures, uploaded on first draw unless loaded earlier
+    std::vector<Texture>& getTextures() { return textures; }
 private:
     // Use smart pointers to manage OpenGL objects
     std::unique_ptr<VertexArrayObject> vao;
@@ -57,11 +83,15 @@ private:
     std::vector<glm::vec3> colors;
     std::vector<glm::vec3> tangents;
     std::vector<glm::vec3> bitangents;
-    glm::mat4x4 modelMatrix;
+    std::vector<glm::mat4x4> instanceTransforms;
+    glm::vec3 localMin;
+    glm::vec3 localMax;
     
     bool initialized;
+    bool dynamic = false;
 
     MaterialProperties material;
+    uint32_t shaderFeatures;
     void calculateTangents(std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices);
     void calculateBitangents(std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices);
     void initializeGL();
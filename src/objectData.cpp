@@ -0,0 +1,179 @@
+#include "objectData.h"
+#include "model.h"
+#include "error.h"
+#include "glState.h"
+#include <algorithm>
+#include <cstring>
+
+ObjectDataBuffer::ObjectDataBuffer(DynamicUploadRing& uploads)
+    : uploads(uploads), objectBuffer(0), objectTexture(0), materialBuffer(0), materialTexture(0),
+      initialized(false), dirty(true), objectCount(0), moving(false), uploadedThisFrame(false) {
+}
+
+ObjectDataBuffer::~ObjectDataBuffer() {
+    if (!initialized) return;
+    GLStateCache& state = getGLState();
+    state.textureDeleted(objectTexture);
+    state.textureDeleted(materialTexture);
+    glDeleteTextures(1, &objectTexture);
+    glDeleteTextures(1, &materialTexture);
+    glDeleteBuffers(1, &objectBuffer);
+    glDeleteBuffers(1, &materialBuffer);
+}
+
+void ObjectDataBuffer::initializeGL() {
+    if (initialized) return;
+
+    glGenBuffers(1, &objectBuffer);
+    glGenBuffers(1, &materialBuffer);
+    glGenTextures(1, &objectTexture);
+    glGenTextures(1, &materialTexture);
+
+    // Texture buffers need storage before they can be attached
+    const glm::vec4 empty(0.0f);
+    glBindBuffer(GL_TEXTURE_BUFFER, objectBuffer);
+    glBufferData(GL_TEXTURE_BUFFER, sizeof(empty), &empty, GL_STATIC_DRAW);
+    glBindBuffer(GL_TEXTURE_BUFFER, materialBuffer);
+    glBufferData(GL_TEXTURE_BUFFER, sizeof(empty), &empty, GL_STATIC_DRAW);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+    // Attached on their own units, where they stay bound for rendering
+    GLStateCache& state = getGLState();
+    state.bindTexture(OBJECT_DATA_UNIT, GL_TEXTURE_BUFFER, objectTexture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, objectBuffer);
+    state.bindTexture(MATERIAL_DATA_UNIT, GL_TEXTURE_BUFFER, materialTexture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, materialBuffer);
+
+    checkGLError("create object data buffers");
+    initialized = true;
+}
+
+void ObjectDataBuffer::updateView(const Camera& camera) {
+    initializeGL();
+
+    ViewBlockData data;
+    data.view = camera.getViewMatrix();
+    data.projection = camera.getProjectionMatrix();
+    data.viewProjection = data.projection * data.view;
+    data.unjitteredViewProjection = camera.getUnjitteredProjectionMatrix() * data.view;
+    data.previousViewProjection = camera.getPreviousViewProjection();
+    data.cameraPos = glm::vec4(camera.getPosition(), 1.0f);
+
+    UploadAllocation allocation = uploads.allocateUniform(sizeof(ViewBlockData));
+    if (!allocation.valid()) {
+        return;
+    }
+    std::memcpy(allocation.data, &data, sizeof(ViewBlockData));
+    uploads.flush();
+    viewAllocation = allocation;
+}
+
+void ObjectDataBuffer::updateObjects(const std::vector<Model>& models) {
+    initializeGL();
+    if (!dirty && objectCount == models.size()) {
+        return;
+    }
+
+    size_t instanceCount = 0;
+    for (const Model& model : models) {
+        instanceCount += model.getInstanceCount();
+    }
+    // Records only line up with last frame's when no model or instance came or went
+    bool samePlacement = objectCount == models.size() && previousTransforms.size() == instanceCount;
+
+    objectData.clear();
+    objectData.reserve(instanceCount * TEXELS_PER_OBJECT);
+    materialData.clear();
+    firstObject.clear();
+    currentTransforms.clear();
+    currentTransforms.reserve(instanceCount);
+    moving = false;
+
+    int objectIndex = 0;
+    for (const Model& model : models) {
+        const MaterialProperties& material = model.getMaterialProperties();
+        firstObject.push_back(objectIndex);
+
+        for (const glm::mat4& modelMatrix : model.getInstanceTransforms()) {
+            glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(modelMatrix)));
+            const glm::mat4& previousMatrix = samePlacement ? previousTransforms[objectIndex] : modelMatrix;
+            for (int c = 0; c < 4; ++c) {
+                objectData.push_back(modelMatrix[c]);
+            }
+            objectData.push_back(glm::vec4(normalMatrix[0], static_cast<float>(material.materialIndex)));
+            objectData.push_back(glm::vec4(normalMatrix[1], 0.0f));
+            objectData.push_back(glm::vec4(normalMatrix[2], 0.0f));
+            for (int c = 0; c < 4; ++c) {
+                objectData.push_back(previousMatrix[c]);
+            }
+            moving = moving || previousMatrix != modelMatrix;
+            currentTransforms.push_back(modelMatrix);
+            objectIndex++;
+        }
+
+        // Meshes sharing a glTF material write the same entry
+        size_t base = static_cast<size_t>(material.materialIndex) * TEXELS_PER_MATERIAL;
+        if (materialData.size() < base + TEXELS_PER_MATERIAL) {
+            materialData.resize(base + TEXELS_PER_MATERIAL, glm::vec4(0.0f));
+        }
+        materialData[base] = material.baseColorFactor;
+        materialData[base + 1] = glm::vec4(material.metallicFactor, material.roughnessFactor, material.alphaCutoff, 0.0f);
+    }
+
+    if (!objectData.empty()) {
+        glBindBuffer(GL_TEXTURE_BUFFER, objectBuffer);
+        glBufferData(GL_TEXTURE_BUFFER, objectData.size() * sizeof(glm::vec4), objectData.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_TEXTURE_BUFFER, materialBuffer);
+        glBufferData(GL_TEXTURE_BUFFER, materialData.size() * sizeof(glm::vec4), materialData.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    }
+
+    objectCount = models.size();
+    dirty = false;
+    uploadedThisFrame = true;
+    checkGLError("upload object data");
+}
+
+void ObjectDataBuffer::endFrame() {
+    if (!uploadedThisFrame) return;
+    uploadedThisFrame = false;
+    previousTransforms = currentTransforms;
+    if (moving) {
+        // Last frame's matrices now equal this frame's, so objects that stop moving
+        // stop reporting motion
+        dirty = true;
+        moving = false;
+    }
+}
+
+int ObjectDataBuffer::uploadDrawList(const DrawList& list) {
+    if (list.objectCount == 0) {
+        return 0;
+    }
+    // Each pass gets its own slice of the frame's ring region, so earlier passes' draws
+    // keep their lists
+    UploadAllocation allocation = uploads.allocate(list.objectCount * sizeof(GLuint), sizeof(GLuint));
+    if (!allocation.valid()) {
+        // Nothing to draw from until the ring has grown
+        return -1;
+    }
+    std::memcpy(allocation.data, list.objects, allocation.size);
+    uploads.flush();
+    return static_cast<int>(allocation.offset / sizeof(GLuint));
+}
+
+void ObjectDataBuffer::bindForRendering(Shader& shader) {
+    if (viewAllocation.valid()) {
+        glBindBufferRange(GL_UNIFORM_BUFFER, VIEW_BLOCK_BINDING, uploads.getBuffer(), viewAllocation.offset, viewAllocation.size);
+    }
+    shader.setUniformBlockBinding("ViewBlock", VIEW_BLOCK_BINDING);
+
+    GLStateCache& state = getGLState();
+    state.bindTexture(OBJECT_DATA_UNIT, GL_TEXTURE_BUFFER, objectTexture);
+    state.bindTexture(MATERIAL_DATA_UNIT, GL_TEXTURE_BUFFER, materialTexture);
+    state.bindTexture(INSTANCE_OBJECTS_UNIT, GL_TEXTURE_BUFFER, uploads.getTextureView(GL_R32UI));
+
+    shader.setInt("objectData", OBJECT_DATA_UNIT);
+    shader.setInt("materialData", MATERIAL_DATA_UNIT);
+    shader.setInt("instanceObjects", INSTANCE_OBJECTS_UNIT);
+}
@@ -0,0 +1,100 @@
+#ifndef OBJECT_DATA_H
+#define OBJECT_DATA_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <vector>
+#include "camera.h"
+#include "drawList.h"
+#include "shader.h"
+#include "uploadRing.h"
+
+class Model;
+
+// Texture units for the per-object and material buffers (clusters use 14-16)
+const GLuint OBJECT_DATA_UNIT = 17;
+const GLuint MATERIAL_DATA_UNIT = 18;
+const GLuint INSTANCE_OBJECTS_UNIT = 19;
+// Uniform block binding point of ViewBlock
+const GLuint VIEW_BLOCK_BINDING = 0;
+
+// Matches the std140 ViewBlock in default.vert/default.frag
+struct ViewBlockData {
+    glm::mat4 view;
+    glm::mat4 projection;
+    glm::mat4 viewProjection;
+    // Without the TAA jitter: this frame's and the previous frame's, for motion vectors
+    glm::mat4 unjitteredViewProjection;
+    glm::mat4 previousViewProjection;
+    glm::vec4 cameraPos;
+};
+
+// Per-view uniforms go into a std140 block written to the upload ring once per pass.
+// Per-object data (model matrix, normal matrix, material index and last frame's model
+// matrix) and the material table are texture buffers built when the model list or an
+// instance transform changes, one record per instance.
+// Each pass's DrawList (culled off the GL thread by DrawListBuilder) has its surviving
+// object indices written to the ring, so a model draws all its visible instances with one
+// glDrawElementsInstanced.
+class ObjectDataBuffer {
+public:
+    // vec4 texels per object: model matrix columns, then normal matrix columns with
+    // the material index in the w of the first one, then the previous frame's model
+    // matrix columns for motion vectors
+    static const unsigned int TEXELS_PER_OBJECT = 11;
+    // baseColorFactor, then (metallic, roughness, alphaCutoff, 0)
+    static const unsigned int TEXELS_PER_MATERIAL = 2;
+    // Object indices stay below this bit in per-face instance entries
+    static const unsigned int FACE_MASK_SHIFT = 26;
+    static const int MAX_CULL_FACES = 6;
+
+    explicit ObjectDataBuffer(DynamicUploadRing& uploads);
+    ~ObjectDataBuffer();
+
+    ObjectDataBuffer(const ObjectDataBuffer&) = delete;
+    ObjectDataBuffer& operator=(const ObjectDataBuffer&) = delete;
+
+    void updateView(const Camera& camera);
+    // Rebuilds object and material data when the model count changed or after markDirty()
+    void updateObjects(const std::vector<Model>& models);
+    void markDirty() { dirty = true; }
+    // Call once per frame after the main pass: this frame's instance transforms become
+    // the previous ones of the next
+    void endFrame();
+    // First object record of each model, as of the last updateObjects(); what draw lists
+    // index from
+    const std::vector<int>& getFirstObjects() const { return firstObject; }
+
+    // Writes a list's object indices to the upload ring and returns the texel offset its
+    // commands' first instances are relative to, or -1 when the ring is full
+    int uploadDrawList(const DrawList& list);
+
+    void bindForRendering(Shader& shader);
+
+private:
+    DynamicUploadRing& uploads;
+    // Latest ViewBlock, bound by range
+    UploadAllocation viewAllocation;
+    GLuint objectBuffer, objectTexture;
+    GLuint materialBuffer, materialTexture;
+    bool initialized;
+    bool dirty;
+    size_t objectCount;
+
+    std::vector<glm::vec4> objectData;
+    std::vector<glm::vec4> materialData;
+    // First object record of each model; its instances follow contiguously
+    std::vector<int> firstObject;
+    // Per object: the model matrix last uploaded, and the one of the previous frame
+    std::vector<glm::mat4> currentTransforms;
+    std::vector<glm::mat4> previousTransforms;
+    // Whether an uploaded previous matrix differs from its current one, so the next frame
+    // has to upload again for that motion to stop
+    bool moving;
+    // Whether this frame uploaded, so endFrame() has new transforms to roll over
+    bool uploadedThisFrame;
+
+    void initializeGL();
+};
+
+#endif // OBJECT_DATA_H
@@ -0,0 +1,77 @@
+#include "renderTarget.h"
+#include "error.h"
+#include "glState.h"
+#include "log.h"
+#include <algorithm>
+#include <fstream>
+
+RenderTarget::RenderTarget(unsigned int width, unsigned int height)
+    : width(width), height(height), framebuffer(0), colorTexture(0), complete(false) {
+    GLStateCache& state = getGLState();
+    glGenTextures(1, &colorTexture);
+    state.bindTexture(0, GL_TEXTURE_2D, colorTexture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    glGenFramebuffers(1, &framebuffer);
+    state.bindFramebuffer(framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, colorTexture, 0);
+    complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+    state.bindFramebuffer(0);
+
+    if (!complete) {
+        LOG_ERROR(Render, "Render target %ux%u is not complete", width, height);
+    }
+    checkGLError("create render target");
+}
+
+RenderTarget::~RenderTarget() {
+    GLStateCache& state = getGLState();
+    if (framebuffer != 0) {
+        state.framebufferDeleted(framebuffer);
+        glDeleteFramebuffers(1, &framebuffer);
+    }
+    if (colorTexture != 0) {
+        state.textureDeleted(colorTexture);
+        glDeleteTextures(1, &colorTexture);
+    }
+}
+
+bool RenderTarget::readPixels(std::vector<unsigned char>& pixels) {
+    if (!complete) return false;
+
+    std::vector<unsigned char> rows(static_cast<size_t>(width) * height * 4);
+    getGLState().bindFramebuffer(framebuffer);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, rows.data());
+    checkGLError("read render target");
+
+    // GL rows start at the bottom
+    const size_t stride = static_cast<size_t>(width) * 4;
+    pixels.resize(rows.size());
+    for (unsigned int y = 0; y < height; ++y) {
+        std::copy(rows.begin() + (height - 1 - y) * stride, rows.begin() + (height - y) * stride,
+                  pixels.begin() + y * stride);
+    }
+    return true;
+}
+
+bool writePPM(const std::string& path, unsigned int width, unsigned int height, const std::vector<unsigned char>& rgba) {
+    std::ofstream out(path, std::ios::binary);
+    if (!out) {
+        LOG_ERROR(Render, "Could not write image %s", path.c_str());
+        return false;
+    }
+    out << "P6\n" << width << " " << height << "\n255\n";
+    std::vector<unsigned char> rgb(static_cast<size_t>(width) * height * 3);
+    for (size_t i = 0, pixels = static_cast<size_t>(width) * height; i < pixels; ++i) {
+        rgb[i * 3 + 0] = rgba[i * 4 + 0];
+        rgb[i * 3 + 1] = rgba[i * 4 + 1];
+        rgb[i * 3 + 2] = rgba[i * 4 + 2];
+    }
+    out.write(reinterpret_cast<const char*>(rgb.data()), static_cast<std::streamsize>(rgb.size()));
+    return static_cast<bool>(out);
+}
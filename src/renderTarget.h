@@ -0,0 +1,39 @@
+#ifndef RENDER_TARGET_H
+#define RENDER_TARGET_H
+
+#include <glad/glad.h>
+#include <string>
+#include <vector>
+
+// Offscreen RGBA8 framebuffer standing in for the window when there is none. The frame
+// graph imports it as the output; the scene's own attachments are graph transients.
+class RenderTarget {
+public:
+    RenderTarget(unsigned int width, unsigned int height);
+    ~RenderTarget();
+
+    RenderTarget(const RenderTarget&) = delete;
+    RenderTarget& operator=(const RenderTarget&) = delete;
+
+    bool isComplete() const { return complete; }
+
+    // Tightly packed RGBA8 rows, top row first
+    bool readPixels(std::vector<unsigned char>& pixels);
+
+    GLuint getFramebuffer() const { return framebuffer; }
+    GLuint getColorTexture() const { return colorTexture; }
+    unsigned int getWidth() const { return width; }
+    unsigned int getHeight() const { return height; }
+
+private:
+    unsigned int width;
+    unsigned int height;
+    GLuint framebuffer;
+    GLuint colorTexture;
+    bool complete;
+};
+
+// Binary PPM (P6) of RGBA8 rows, alpha dropped
+bool writePPM(const std::string& path, unsigned int width, unsigned int height, const std::vector<unsigned char>& rgba);
+
+#endif // RENDER_TARGET_H
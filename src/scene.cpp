@@ -1,14 +1,88 @@
 #include "scene.h"
+#include "gpuProfiler.h"
+#include "cpuProfiler.h"
+#include "glState.h"
 #include <assimp/Importer.hpp>
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
+#include <assimp/GltfMaterial.h>
 #include <iostream>
 #include <string>
 #include <filesystem>
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <unordered_map>
+#include "log.h"
+#include "frustum.h"
+#include "jobSystem.h"
+
+static glm::mat4 toGlmMatrix(const aiMatrix4x4& m) {
+    // Assimp is row-major, glm column-major
+    return glm::mat4(
+        m.a1, m.b1, m.c1, m.d1,
+        m.a2, m.b2, m.c2, m.d2,
+        m.a3, m.b3, m.c3, m.d3,
+        m.a4, m.b4, m.c4, m.d4
+    );
+}
+
+static uint64_t hashBytes(uint64_t hash, const void* data, size_t size) {
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+// FNV-1a over everything that ends up in a Model's vertex/index buffers, plus the material
+static uint64_t hashMeshGeometry(const aiMesh* mesh) {
+    uint64_t hash = 14695981039346656037ull;
+    hash = hashBytes(hash, &mesh->mMaterialIndex, sizeof(mesh->mMaterialIndex));
+    hash = hashBytes(hash, &mesh->mNumVertices, sizeof(mesh->mNumVertices));
+    hash = hashBytes(hash, &mesh->mNumFaces, sizeof(mesh->mNumFaces));
+    hash = hashBytes(hash, mesh->mVertices, mesh->mNumVertices * sizeof(aiVector3D));
+    if (mesh->mNormals) {
+        hash = hashBytes(hash, mesh->mNormals, mesh->mNumVertices * sizeof(aiVector3D));
+    }
+    if (mesh->mTextureCoords[0]) {
+        hash = hashBytes(hash, mesh->mTextureCoords[0], mesh->mNumVertices * sizeof(aiVector3D));
+    }
+    for (unsigned int i = 0; i < mesh->mNumFaces; ++i) {
+        hash = hashBytes(hash, mesh->mFaces[i].mIndices, mesh->mFaces[i].mNumIndices * sizeof(unsigned int));
+    }
+    return hash;
+}
 
+static bool sameAttribute(const aiVector3D* a, const aiVector3D* b, unsigned int count) {
+    if (!a || !b) return a == b;
+    return std::memcmp(a, b, count * sizeof(aiVector3D)) == 0;
+}
 
+// Full comparison behind a hash match
+static bool meshGeometryEqual(const aiMesh* a, const aiMesh* b) {
+    if (a->mMaterialIndex != b->mMaterialIndex || a->mNumVertices != b->mNumVertices || a->mNumFaces != b->mNumFaces) {
+        return false;
+    }
+    unsigned int n = a->mNumVertices;
+    if (!sameAttribute(a->mVertices, b->mVertices, n) || !sameAttribute(a->mNormals, b->mNormals, n) ||
+        !sameAttribute(a->mTextureCoords[0], b->mTextureCoords[0], n) ||
+        !sameAttribute(a->mTangents, b->mTangents, n) || !sameAttribute(a->mBitangents, b->mBitangents, n)) {
+        return false;
+    }
+    for (unsigned int i = 0; i < a->mNumFaces; ++i) {
+        const aiFace& fa = a->mFaces[i];
+        const aiFace& fb = b->mFaces[i];
+        if (fa.mNumIndices != fb.mNumIndices ||
+            std::memcmp(fa.mIndices, fb.mIndices, fa.mNumIndices * sizeof(unsigned int)) != 0) {
+            return false;
+        }
+    }
+    return true;
+}
 
-Scene::Scene(const char* path) {
+Scene::Scene(const char* path) : shadowManager(uploadRing), lightClusters(uploadRing), objectData(uploadRing) {
     loadGLTF(path);
 }
 
@@ -26,11 +100,88 @@ bool Scene::loadGLTF(const std::string& path) {
         return false;
     }
     
+    // Every node referencing a mesh becomes an instance of one Model
+    std::vector<std::vector<glm::mat4>> meshTransforms(scene->mNumMeshes);
+    std::function<void(const aiNode*, const aiMatrix4x4&)> collectTransforms = [&](const aiNode* node, const aiMatrix4x4& parent) {
+        aiMatrix4x4 world = parent * node->mTransformation;
+        for (unsigned int i = 0; i < node->mNumMeshes; ++i) {
+            meshTransforms[node->mMeshes[i]].push_back(toGlmMatrix(world));
+        }
+        for (unsigned int i = 0; i < node->mNumChildren; ++i) {
+            collectTransforms(node->mChildren[i], world);
+        }
+    };
+    collectTransforms(scene->mRootNode, aiMatrix4x4());
+
+    // Hashing and converting meshes only read the aiScene, so both run on the job system;
+    // merging and adding the models stays in mesh order
+    JobSystem& jobs = getJobSystem();
+    std::vector<uint64_t> meshHashes(scene->mNumMeshes);
+    jobs.parallelFor(scene->mNumMeshes, 0, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            meshHashes[i] = hashMeshGeometry(scene->mMeshes[i]);
+        }
+    });
+
+    // Distinct aiMeshes with identical geometry and material are merged by content hash:
+    // each mesh's instances go to the first mesh with its geometry
+    std::unordered_map<uint64_t, std::vector<unsigned int>> geometryBuckets;
+    std::vector<unsigned int> meshTarget(scene->mNumMeshes);
+    size_t instanceCount = 0;
+    unsigned int mergedMeshes = 0;
     for (unsigned int i = 0; i < scene->mNumMeshes; ++i) {
         aiMesh* mesh = scene->mMeshes[i];
-        Model model = assimpMeshToModel(mesh, scene, path);
+        std::vector<glm::mat4>& transforms = meshTransforms[i];
+        if (transforms.empty()) {
+            transforms.push_back(glm::mat4(1.0f));
+        }
+        instanceCount += transforms.size();
+
+        auto& bucket = geometryBuckets[meshHashes[i]];
+        auto match = std::find_if(bucket.begin(), bucket.end(), [&](unsigned int first) {
+            return meshGeometryEqual(scene->mMeshes[first], mesh);
+        });
+        if (match != bucket.end()) {
+            meshTarget[i] = *match;
+            mergedMeshes++;
+            continue;
+        }
+        meshTarget[i] = i;
+        bucket.push_back(i);
+    }
+
+    std::vector<std::unique_ptr<Model>> converted(scene->mNumMeshes);
+    jobs.parallelFor(scene->mNumMeshes, 1, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            if (meshTarget[i] != i) continue;
+            converted[i].reset(new Model(assimpMeshToModel(scene->mMeshes[i], scene, path, meshTransforms[i][0])));
+        }
+    });
+
+    std::vector<size_t> meshModel(scene->mNumMeshes);
+    for (unsigned int i = 0; i < scene->mNumMeshes; ++i) {
+        const std::vector<glm::mat4>& transforms = meshTransforms[i];
+        if (meshTarget[i] != i) {
+            for (const glm::mat4& transform : transforms) {
+                models[meshModel[meshTarget[i]]].addInstance(transform);
+            }
+            objectData.markDirty();
+            continue;
+        }
+
+        Model& model = *converted[i];
+        for (size_t t = 1; t < transforms.size(); ++t) {
+            model.addInstance(transforms[t]);
+        }
+        loadingBounds.min = glm::min(loadingBounds.min, model.getLocalMin());
+        loadingBounds.max = glm::max(loadingBounds.max, model.getLocalMax());
+        meshModel[i] = models.size();
         addModel(std::move(model)); // Use move semantics
+        converted[i].reset();
     }
+    LOG_INFO(Scene, "Loaded %u meshes as %zu models with %zu instances (%u merged by geometry hash)",
+             scene->mNumMeshes, models.size(), instanceCount, mergedMeshes);
+    loadTextures();
 
     // Load camera from glTF if present
     if (scene->mNumCameras > 0) {
@@ -84,7 +235,7 @@ bool Scene::loadGLTF(const std::string& path) {
     return true;
 }
 
-Model Scene::assimpMeshToModel(aiMesh* mesh, const aiScene* scene, const std::string& gltfFilePath) {
+Model Scene::assimpMeshToModel(aiMesh* mesh, const aiScene* scene, const std::string& gltfFilePath, const glm::mat4& modelMatrix) {
     std::vector<glm::vec3> vertices;
     std::vector<unsigned int> indices;
     std::vector<Texture> textures;
@@ -100,16 +251,6 @@ Model Scene::assimpMeshToModel(aiMesh* mesh, const aiScene* scene, const std::st
         vertex.y = mesh->mVertices[i].y;
         vertex.z = mesh->mVertices[i].z;
         vertices.push_back(vertex);
-
-        loadingBounds.min.x = std::min(loadingBounds.min.x, vertex.x);
-        loadingBounds.min.y = std::min(loadingBounds.min.y, vertex.y);
-        loadingBounds.min.z = std::min(loadingBounds.min.z, vertex.z);
-        
-        loadingBounds.max.x = std::max(loadingBounds.max.x, vertex.x);
-        loadingBounds.max.y = std::max(loadingBounds.max.y, vertex.y);
-        loadingBounds.max.z = std::max(loadingBounds.max.z, vertex.z);
-
-
     }
 
     // Indices
@@ -236,76 +377,49 @@ Model Scene::assimpMeshToModel(aiMesh* mesh, const aiScene* scene, const std::st
         
     }
 
-    glm::mat4 modelMatrix(1.0f);
-
-    // Find the node that references this mesh
-    std::function<const aiNode*(const aiNode*)> findMeshNode = [&](const aiNode* node) -> const aiNode* {
-        for (unsigned int i = 0; i < node->mNumMeshes; ++i) {
-            if (scene->mMeshes[node->mMeshes[i]] == mesh) {
-                return node;
-            }
-        }
-        for (unsigned int i = 0; i < node->mNumChildren; ++i) {
-            const aiNode* found = findMeshNode(node->mChildren[i]);
-            if (found) return found;
-        }
-        return nullptr;
-    };
-
-    const aiNode* meshNode = findMeshNode(scene->mRootNode);
-    if (meshNode) {
-        aiMatrix4x4 aiMat = meshNode->mTransformation;
-        const aiNode* parent = meshNode->mParent;
-        while (parent) {
-            aiMat = parent->mTransformation * aiMat;
-            parent = parent->mParent;
-        }
-        // Convert aiMatrix4x4 to glm::mat4
-        modelMatrix = glm::mat4(
-            aiMat.a1, aiMat.b1, aiMat.c1, aiMat.d1,
-            aiMat.a2, aiMat.b2, aiMat.c2, aiMat.d2,
-            aiMat.a3, aiMat.b3, aiMat.c3, aiMat.d3,
-            aiMat.a4, aiMat.b4, aiMat.c4, aiMat.d4
-        );
-    }
-
-
     MaterialProperties matProps;
+    matProps.materialIndex = static_cast<int>(mesh->mMaterialIndex);
     aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
     // Get base color factor
     aiColor4D baseColorFactor;
     if (material->Get(AI_MATKEY_BASE_COLOR, baseColorFactor) == AI_SUCCESS) {
         matProps.baseColorFactor = glm::vec4(baseColorFactor.r, baseColorFactor.g, baseColorFactor.b, baseColorFactor.a);
-        std::cout << "Base color factor: (" << baseColorFactor.r << ", " << baseColorFactor.g << ", " << baseColorFactor.b << ", " << baseColorFactor.a << ")" << std::endl;
+        LOG_DEBUG(Scene, "Base color factor: (%g, %g, %g, %g)", baseColorFactor.r, baseColorFactor.g, baseColorFactor.b, baseColorFactor.a);
+    }
+
+    // Get alpha mode; only MASK materials alpha test, OPAQUE and BLEND keep early-Z
+    aiString alphaMode;
+    if (material->Get(AI_MATKEY_GLTF_ALPHAMODE, alphaMode) == AI_SUCCESS) {
+        matProps.alphaMode_MASK = std::strcmp(alphaMode.C_Str(), "MASK") == 0;
+        LOG_DEBUG(Scene, "Alpha mode: %s", alphaMode.C_Str());
     }
 
     // Get alpha cutoff
     float alphaCutoff = 0.5f;
-    if (material->Get(AI_MATKEY_OPACITY, alphaCutoff) == AI_SUCCESS) {
+    if (material->Get(AI_MATKEY_GLTF_ALPHACUTOFF, alphaCutoff) == AI_SUCCESS) {
         matProps.alphaCutoff = alphaCutoff;
-        std::cout << "Alpha cutoff: " << alphaCutoff << std::endl;
-        matProps.alphaMode_MASK = true;
+        LOG_DEBUG(Scene, "Alpha cutoff: %g", alphaCutoff);
     }
 
     // Get metallic factor
     float metallicFactor = 1.0f;
     if (material->Get(AI_MATKEY_METALLIC_FACTOR, metallicFactor) == AI_SUCCESS) {
         matProps.metallicFactor = metallicFactor;
-        std::cout << "Metallic factor: " << metallicFactor << std::endl;
+        LOG_DEBUG(Scene, "Metallic factor: %g", metallicFactor);
     }
 
     // Get roughness factor
     float roughnessFactor = 1.0f;
     if (material->Get(AI_MATKEY_ROUGHNESS_FACTOR, roughnessFactor) == AI_SUCCESS) {
         matProps.roughnessFactor = roughnessFactor;
-        std::cout << "Roughness factor: " << roughnessFactor << std::endl;
+        LOG_DEBUG(Scene, "Roughness factor: %g", roughnessFactor);
     }
 
     // Check for double sided
     int twoSided = 0;
     if (material->Get(AI_MATKEY_TWOSIDED, twoSided) == AI_SUCCESS) {
         matProps.doubleSided = (twoSided != 0);
-        std::cout << "Double sided: " << matProps.doubleSided << std::endl;
+        LOG_DEBUG(Scene, "Double sided: %d", matProps.doubleSided ? 1 : 0);
     } else {
         matProps.doubleSided = true;  // Force double-sided if not specified
     }
@@ -323,8 +437,122 @@ Model Scene::assimpMeshToModel(aiMesh* mesh, const aiScene* scene, const std::st
     return Model(vertices, indices, colors, textures, normals, uvs, tangents, bitangents, modelMatrix, matProps);
 }
 
+namespace {
+
+// World bounds of every instance of a model
+void modelBounds(const Model& model, SceneBounds& bounds) {
+    for (const glm::mat4& modelMatrix : model.getInstanceTransforms()) {
+        glm::vec3 worldMin, worldMax;
+        transformAABB(modelMatrix, model.getLocalMin(), model.getLocalMax(), worldMin, worldMax);
+        bounds.min = glm::min(bounds.min, worldMin);
+        bounds.max = glm::max(bounds.max, worldMax);
+    }
+}
+
+} // namespace
+
 void Scene::addModel(Model&& model) { // Accept Model by move
+    if (model.isDynamic()) {
+        dynamicModelCount++;
+    }
+    SceneBounds bounds;
+    modelBounds(model, bounds);
     models.emplace_back(std::move(model)); // Use emplace_back with move
+    recordCasterChange(bounds.min, bounds.max);
+}
+
+void Scene::loadTextures() {
+    PROFILE_ZONE("Texture loading");
+    std::vector<Texture*> pending;
+    for (Model& model : models) {
+        for (Texture& texture : model.getTextures()) {
+            pending.push_back(&texture);
+        }
+    }
+
+    // Decoded in batches of a couple per thread, each uploaded on this thread (which owns
+    // the GL context) before the next, so only one batch of images is ever in memory
+    JobSystem& jobs = getJobSystem();
+    size_t batch = static_cast<size_t>(jobs.getThreadCount()) * 2;
+    for (size_t first = 0; first < pending.size(); first += batch) {
+        size_t count = std::min(batch, pending.size() - first);
+        jobs.parallelFor(count, 1, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                pending[first + i]->decode();
+            }
+        });
+        for (size_t i = 0; i < count; ++i) {
+            pending[first + i]->loadTexture();
+        }
+    }
+    LOG_INFO(Scene, "Loaded %zu textures on %d threads", pending.size(), jobs.getThreadCount());
+}
+
+void Scene::markModelsChanged() {
+    recordCasterChange(glm::vec3(-FLT_MAX), glm::vec3(FLT_MAX));
+}
+
+void Scene::recordCasterChange(const glm::vec3& min, const glm::vec3& max) {
+    objectData.markDirty();
+    casterGeneration++;
+    casterChanges.push_back(CasterChange{ casterGeneration, min, max });
+    if (casterChanges.size() > MAX_CASTER_CHANGES) {
+        casterChanges.pop_front();
+    }
+}
+
+bool Scene::casterChangesIntersect(uint64_t sinceGeneration, const glm::vec3& min, const glm::vec3& max) const {
+    if (sinceGeneration >= casterGeneration) return false;
+    // Changes between the two are no longer recorded
+    if (casterChanges.empty() || casterChanges.front().generation > sinceGeneration + 1) return true;
+    for (const CasterChange& change : casterChanges) {
+        if (change.generation <= sinceGeneration) continue;
+        if (glm::all(glm::lessThanEqual(change.min, max)) && glm::all(glm::lessThanEqual(min, change.max))) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void Scene::setInstanceTransform(size_t modelIndex, size_t instance, const glm::mat4& transform) {
+    Model& model = models[modelIndex];
+    if (model.isDynamic()) {
+        model.setInstanceTransform(instance, transform);
+        objectData.markDirty();
+        return;
+    }
+    // Both where the instance was and where it went
+    glm::vec3 oldMin, oldMax, newMin, newMax;
+    transformAABB(model.getInstanceTransforms()[instance], model.getLocalMin(), model.getLocalMax(), oldMin, oldMax);
+    model.setInstanceTransform(instance, transform);
+    transformAABB(transform, model.getLocalMin(), model.getLocalMax(), newMin, newMax);
+    recordCasterChange(glm::min(oldMin, newMin), glm::max(oldMax, newMax));
+}
+
+void Scene::setModelDynamic(size_t modelIndex, bool dynamic) {
+    Model& model = models[modelIndex];
+    if (model.isDynamic() == dynamic) return;
+    model.setDynamic(dynamic);
+    dynamicModelCount = dynamic ? dynamicModelCount + 1 : dynamicModelCount - 1;
+    // The model enters or leaves the cached static depth
+    SceneBounds bounds;
+    modelBounds(model, bounds);
+    recordCasterChange(bounds.min, bounds.max);
+}
+
+void Scene::getCasterSphere(glm::vec3& center, float& radius) {
+    if (casterSphereGeneration != casterGeneration) {
+        SceneBounds bounds;
+        for (const auto& model : models) {
+            modelBounds(model, bounds);
+        }
+        bool empty = bounds.min.x > bounds.max.x;
+        casterCenter = empty ? glm::vec3(0.0f) : (bounds.min + bounds.max) * 0.5f;
+        casterRadius = empty ? 0.0f : glm::length(bounds.max - bounds.min) * 0.5f;
+        casterSphereGeneration = casterGeneration;
+    }
+    center = casterCenter;
+    radius = casterRadius;
 }
 
 void Scene::setCamera(const Camera& camera) {
@@ -335,20 +563,94 @@ Camera& Scene::getCamera() {
     return this->camera;
 }
 
-void Scene::draw(Shader& shader) {
+void Scene::draw(ShaderPermutationManager& shaders) {
+    uploadRing.beginFrame();
+    beginDrawLists();
 
     if(skybox && skyboxShader) {
+        GpuProfileScope gpuScope("Skybox");
         skybox->draw(*skyboxShader, camera);
     }
-    shader.activate();
-    lightManager.updateShaderUniforms(shader);
-    glm::vec3 camPos = camera.getPosition();
-    shader.setVec3("cameraPos", glm::value_ptr(camPos));
+    {
+        GpuProfileScope gpuScope("Main scene");
+        drawModels(shaders, false);
+    }
 
-    for (Model& model : models) {
-        model.draw(shader, camera);
+    objectData.endFrame();
+    uploadRing.endFrame();
+}
+
+void Scene::beginDrawLists() {
+    drawLists.beginFrame();
+    DrawViewRequest request;
+    request.viewProjections[0] = camera.getProjectionMatrix() * camera.getViewMatrix();
+    mainView = drawLists.addView(request);
+    // Assigning point/spot lights to clusters is CPU-only too, so it runs beside the culling
+    drawLists.addTask([this] {
+        PROFILE_ZONE("Light clusters");
+        lightClusters.build(lightManager, camera);
+    });
+}
+
+void Scene::buildDrawLists() {
+    // Object records have to match the models before any list indexes into them
+    objectData.updateObjects(models);
+    drawLists.build(models, objectData.getFirstObjects());
+}
+
+void Scene::drawModels(ShaderPermutationManager& shaders, bool withShadows) {
+    // Without a shadow pass nothing has begun this frame's lists yet
+    if (mainView < 0) {
+        beginDrawLists();
+    }
+    buildDrawLists();
+    const DrawList& list = drawLists.getList(mainView);
+    mainView = -1;
+
+    int instanceBase;
+    {
+        PROFILE_ZONE("Draw list upload");
+        // Once for every variant
+        lightClusters.upload();
+        objectData.updateView(camera);
+        instanceBase = objectData.uploadDrawList(list);
+    }
+    if (instanceBase < 0) {
+        // Nothing to draw from until the ring has grown
+        renderStats = InstanceCullStats();
+        return;
+    }
+    renderStats = list.stats;
+
+    ShaderVariantKey frameKey;
+    frameKey.shadows = withShadows && shadowManager.getShadowedLightCount() > 0;
+    frameKey.shadowMoments = frameKey.shadows && shadowManager.usesMoments();
+    frameKey.directionalLightCount = lightManager.getDirectionalLightCount();
+
+    // Commands are sorted by shader features, so each variant is bound and given the
+    // per-frame uniforms once, then draws all its models
+    PROFILE_ZONE("Draw submission");
+    size_t next = 0;
+    while (next < list.commandCount) {
+        ShaderVariantKey key = frameKey;
+        key.features = static_cast<uint32_t>(list.commands[next].sortKey >> 32);
+        Shader& shader = shaders.getVariant(key);
+
+        shader.activate();
+        Model::bindMaterialSamplers(shader);
+        lightManager.updateShaderUniforms(shader);
+        lightClusters.bindForRendering(shader);
+        objectData.bindForRendering(shader);
+        if (withShadows) {
+            shadowManager.bindShadowMapsForRendering(shader);
+        }
+
+        while (next < list.commandCount && static_cast<uint32_t>(list.commands[next].sortKey >> 32) == key.features) {
+            const DrawCommand& command = list.commands[next];
+            models[command.model].draw(shader, instanceBase + static_cast<int>(command.first), static_cast<int>(command.count));
+            next++;
+        }
     }
-    shader.deactivate();
 }
 
 void Scene::setSkybox(const std::string& directory) {
@@ -396,23 +698,12 @@ void Scene::calculateSceneBounds() {
     sceneMax = glm::vec3(-FLT_MAX);
     
     for (const auto& model : models) {
-        // Get model's vertices and transform them by model matrix
-        const auto& vertices = model.getVertices(); // You'll need to add this getter
-        glm::mat4 modelMatrix = model.getModelMatrix();
-        
-        for (const auto& vertex : vertices) {
-            // Transform vertex position by model matrix
-            glm::vec4 worldPos = modelMatrix * glm::vec4(vertex, 1.0f);
-            glm::vec3 pos = glm::vec3(worldPos);
-            
-            // Update min/max bounds
-            sceneMin.x = std::min(sceneMin.x, pos.x);
-            sceneMin.y = std::min(sceneMin.y, pos.y);
-            sceneMin.z = std::min(sceneMin.z, pos.z);
-            
-            sceneMax.x = std::max(sceneMax.x, pos.x);
-            sceneMax.y = std::max(sceneMax.y, pos.y);
-            sceneMax.z = std::max(sceneMax.z, pos.z);
+        // Transform the model's local bounds by every instance's matrix
+        for (const glm::mat4& modelMatrix : model.getInstanceTransforms()) {
+            glm::vec3 worldMin, worldMax;
+            transformAABB(modelMatrix, model.getLocalMin(), model.getLocalMax(), worldMin, worldMax);
+            sceneMin = glm::min(sceneMin, worldMin);
+            sceneMax = glm::max(sceneMax, worldMax);
         }
     }
     
@@ -439,36 +730,89 @@ void Scene::printSceneBounds() const {
     }
 }
 
-void Scene::drawWithShadows(Shader& shader, Shader& shadowShader) {
-    // First pass: Render shadow maps using the camera
-    shadowManager.renderShadowMaps(lightManager, *this, shadowShader, camera);
-    
-    // Second pass: Render scene with shadows
-    
-    // Draw skybox first (if present)
+void Scene::addPasses(FrameGraph& graph, ShaderPermutationManager& shaders, Shader& shadowShader, const SceneTargets& targets) {
+    uploadRing.beginFrame();
+
+    // Shadow maps render into the shadow manager's own framebuffers; the import only
+    // orders the main pass after them
+    FrameGraphResource shadowMaps = graph.importTexture("Shadow maps", 0, FrameGraphTextureDesc());
+    graph.addPass("Shadow maps",
+        [&](FrameGraphPassBuilder& builder) {
+            builder.write(shadowMaps);
+        },
+        [this, &shadowShader](FrameGraph&) {
+            // Models are settled for the frame once passes run, so its lists start here
+            beginDrawLists();
+            shadowManager.renderShadowMaps(lightManager, *this, shadowShader, camera);
+        });
+
+    std::vector<FrameGraphResource> colors = targets.getColorAttachments();
     if(skybox && skyboxShader) {
-        skybox->draw(*skyboxShader, camera);
+        graph.addPass("Skybox",
+            [&](FrameGraphPassBuilder& builder) {
+                for (FrameGraphResource color : colors) builder.write(color);
+                builder.write(targets.depth);
+            },
+            [this, colors, targets](FrameGraph& frame) {
+                frame.bindRenderTarget(colors, targets.depth);
+                getGLState().viewport(0, 0, targets.width, targets.height);
+                skybox->draw(*skyboxShader, camera);
+            });
     }
-    
-    // Activate main shader for scene rendering
-    shader.activate();
-    
-    // Upload light uniforms to the shader
-    lightManager.updateShaderUniforms(shader);
-    
-    // Set camera position for lighting calculations
-    glm::vec3 camPos = camera.getPosition();
-    shader.setVec3("cameraPos", glm::value_ptr(camPos));
-    
-    // Bind shadow maps for use in fragment shader
-    shadowManager.bindShadowMapsForRendering(shader);
-    
-    // Draw all models in the scene
-    for (Model& model : models) {
-        model.draw(shader, camera);
+
+    // Lights, clusters, view/object data and shadow maps are bound per shader variant
+    graph.addPass("Main scene",
+        [&](FrameGraphPassBuilder& builder) {
+            builder.read(shadowMaps);
+            for (FrameGraphResource color : colors) builder.write(color);
+            builder.write(targets.depth);
+        },
+        [this, &shaders, colors, targets](FrameGraph& frame) {
+            frame.bindRenderTarget(colors, targets.depth);
+            getGLState().viewport(0, 0, targets.width, targets.height);
+            drawModels(shaders, true);
+            objectData.endFrame();
+            uploadRing.endFrame();
+        });
+}
+
+int Scene::addShadowView(const glm::mat4& lightSpaceMatrix, ShadowCasters casters) {
+    DrawViewRequest request;
+    request.viewProjections[0] = lightSpaceMatrix;
+    request.casters = casters;
+    return drawLists.addView(request);
+}
+
+int Scene::addCubeShadowView(const glm::mat4* faceMatrices, ShadowCasters casters) {
+    DrawViewRequest request;
+    request.faceCount = DrawViewRequest::MAX_FACES;
+    std::copy(faceMatrices, faceMatrices + request.faceCount, request.viewProjections);
+    request.casters = casters;
+    return drawLists.addView(request);
+}
+
+size_t Scene::drawShadowView(Shader& shadowShader, int view) {
+    PROFILE_ZONE("Shadow casters");
+    // Same instanced path as the main pass, replaying the list the workers culled
+    if (!drawLists.isBuilt(view)) {
+        buildDrawLists();
     }
-    
-    shader.deactivate();
+    const DrawList& list = drawLists.getList(view);
+    int instanceBase = objectData.uploadDrawList(list);
+    if (instanceBase < 0) return 0;
+    objectData.bindForRendering(shadowShader);
+    const DrawViewRequest& request = drawLists.getRequest(view);
+    if (request.faceCount == 1) {
+        shadowShader.setMat4("lightSpaceMatrix", glm::value_ptr(request.viewProjections[0]));
+    }
+    // One instanced draw per model; for cubes the geometry shader only emits triangles
+    // to the faces in each instance's mask
+    for (size_t i = 0; i < list.commandCount; ++i) {
+        const DrawCommand& command = list.commands[i];
+        models[command.model].drawShadow(shadowShader, instanceBase + static_cast<int>(command.first),
+                                         static_cast<int>(command.count));
+    }
+    return list.stats.triangles;
 }
 
 // Remove the setSceneBounds requirement from shadow setup since we're using camera now
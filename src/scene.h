@@ -11,12 +11,26 @@
 #include "skybox.h"
 #include "lightManager.h"
 #include "shadowManager.h"
+#include "lightCluster.h"
+#include "shaderPermutation.h"
+#include "objectData.h"
+#include "drawList.h"
+#include "uploadRing.h"
+#include "frameGraph.h"
+#include <deque>
 
 struct SceneBounds {
     glm::vec3 min = glm::vec3(FLT_MAX);
     glm::vec3 max = glm::vec3(-FLT_MAX);
 };
 
+// World bounds a static caster change touched, and the generation it produced
+struct CasterChange {
+    uint64_t generation;
+    glm::vec3 min;
+    glm::vec3 max;
+};
+
 class Scene {
 public:
     Scene(const char* path);
@@ -25,8 +39,41 @@ public:
     Camera& getCamera();
 
     bool loadGLTF(const std::string& path);
-    void draw(Shader& shader);
-    void drawWithShadows(Shader& shader, Shader& shadowShader);
+    void draw(ShaderPermutationManager& shaders);
+    // Declares the shadow map, skybox and main passes drawing into targets
+    void addPasses(FrameGraph& graph, ShaderPermutationManager& shaders, Shader& shadowShader, const SceneTargets& targets);
+    // Queue the shadow casters of a set inside a light frustum, or overlapping any face of
+    // a shadow cube, for this frame's draw lists; both return the view for drawShadowView()
+    int addShadowView(const glm::mat4& lightSpaceMatrix, ShadowCasters casters = ShadowCasters::All);
+    int addCubeShadowView(const glm::mat4* faceMatrices, ShadowCasters casters = ShadowCasters::All);
+    // Culls every view queued so far (the camera's included) on the draw list workers
+    void buildDrawLists();
+    // Replays a built shadow view and returns the triangles drawn. The shadow shader must
+    // be active; a cube's instances carry the faces they reach, so the cube shader also
+    // needs its face matrices set.
+    size_t drawShadowView(Shader& shadowShader, int view);
+    // Views, workers and build time of the frame's draw lists
+    const DrawListStats& getDrawListStats() const { return drawLists.getStats(); }
+    // Bumped whenever static shadow casters may have changed; cached shadow maps compare against it
+    uint64_t getCasterGeneration() const { return casterGeneration; }
+    // Whether any static caster change after a generation touched a box, so maps of local
+    // lights can stay cached while geometry out of their reach moves. True when the
+    // history no longer reaches back that far.
+    bool casterChangesIntersect(uint64_t sinceGeneration, const glm::vec3& min, const glm::vec3& max) const;
+    // Call after moving or re-instancing static models; without bounds every cached map
+    // is redrawn
+    void markModelsChanged();
+    // Moving a dynamic model's instance leaves cached shadow depth alone
+    void setInstanceTransform(size_t modelIndex, size_t instance, const glm::mat4& transform);
+    void setModelDynamic(size_t modelIndex, bool dynamic);
+    bool hasDynamicCasters() const { return dynamicModelCount > 0; }
+    // Sphere around every caster instance as of the last static change, radius 0 without
+    // models. Dynamic casters that leave it are clamped to the shadow near plane.
+    void getCasterSphere(glm::vec3& center, float& radius);
+    // Culling and draw counts of the last main pass
+    const InstanceCullStats& getRenderStats() const { return renderStats; }
+    // Per-frame GPU data; draw() and addPasses() each begin and fence one frame
+    DynamicUploadRing& getUploadRing() { return uploadRing; }
     void setSkybox(const std::string& directory);
     void setSkyboxShader(const std::string& vertexPath, const std::string& fragmentPath);
 
@@ -36,6 +83,9 @@ public:
     ShadowManager& getShadowManager() { return shadowManager; }
     const ShadowManager& getShadowManager() const { return shadowManager; }
 
+    LightClusterGrid& getLightClusters() { return lightClusters; }
+    const LightClusterGrid& getLightClusters() const { return lightClusters; }
+
     std::vector<Model>& getModels() { return models; }
     const std::vector<Model>& getModels() const { return models; }
 
@@ -58,15 +108,40 @@ private:
     std::unique_ptr<Skybox> skybox;
     std::unique_ptr<Shader> skyboxShader;
     Camera camera;
-    Model assimpMeshToModel(aiMesh* mesh, const aiScene* scene, const std::string& gltfFilePath);
+    // Only reads the aiScene, so meshes are converted on job system workers
+    Model assimpMeshToModel(aiMesh* mesh, const aiScene* scene, const std::string& gltfFilePath, const glm::mat4& modelMatrix);
+    // Decodes every model's textures on the job system and uploads them
+    void loadTextures();
+    void drawModels(ShaderPermutationManager& shaders, bool withShadows);
+    // Starts the frame's draw lists with the camera's view and the light cluster build
+    void beginDrawLists();
+    // Bumps the caster generation for a change within these bounds
+    void recordCasterChange(const glm::vec3& min, const glm::vec3& max);
     LightManager lightManager;
+    // Declared before its users so it outlives them
+    DynamicUploadRing uploadRing;
     ShadowManager shadowManager;
+    LightClusterGrid lightClusters;
+    ObjectDataBuffer objectData;
+    DrawListBuilder drawLists;
+    // The camera's view in drawLists, -1 until this frame's lists are begun
+    int mainView = -1;
+    InstanceCullStats renderStats;
     glm::vec3 sceneMin = glm::vec3(FLT_MAX);
     glm::vec3 sceneMax = glm::vec3(-FLT_MAX);
     glm::vec3 calculatedSceneCenter;
     float calculatedSceneRadius;
     bool sceneBoundsCalculated = false;
     SceneBounds loadingBounds;
+    uint64_t casterGeneration = 1;
+    // Latest static caster changes, oldest first
+    static const size_t MAX_CASTER_CHANGES = 64;
+    std::deque<CasterChange> casterChanges;
+    size_t dynamicModelCount = 0;
+    // Generation the caster sphere was computed for
+    uint64_t casterSphereGeneration = 0;
+    glm::vec3 casterCenter = glm::vec3(0.0f);
+    float casterRadius = 0.0f;
 
 };
 
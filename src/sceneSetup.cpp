@@ -0,0 +1,149 @@
+#include "sceneSetup.h"
+#include "scene.h"
+#include "shaderCache.h"
+#include "frustum.h"
+#include "log.h"
+#include <glm/gtc/matrix_transform.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+
+#ifndef RAYTRACER_SOURCE_DIR
+#define RAYTRACER_SOURCE_DIR "."
+#endif
+
+namespace {
+
+const char* DEFAULT_SCENE = "scenes/KhronosGroup glTF-Sample-Assets main Models-Sponza/glTF/Sponza.gltf";
+const char* DEFAULT_SKYBOX = "scenes/KhronosGroup glTF-Sample-Assets main Models-Sponza/skybox";
+
+} // namespace
+
+std::string resolveSourcePath(const std::string& path) {
+    if (path.empty() || path[0] == '/') {
+        return path;
+    }
+    return std::string(RAYTRACER_SOURCE_DIR) + "/" + path;
+}
+
+RendererOptions::RendererOptions()
+    : debugMode(getDefaultGLDebugMode()), scenePath(resolveSourcePath(DEFAULT_SCENE)),
+      skyboxPath(resolveSourcePath(DEFAULT_SKYBOX)), traceFrames(0), traceFile("cpu_trace.json"),
+      momentShadows(false), shadowSoftness(-1.0f), shadowTriangleBudget(0), shadowMillisecondBudget(0.0f),
+      animatedModel(-1) {
+}
+
+bool parseRendererOption(const std::string& arg, RendererOptions& options) {
+    if (arg.rfind("--gl-debug=", 0) == 0) {
+        options.debugMode = parseGLDebugMode(arg.substr(11), options.debugMode);
+    } else if (arg.rfind("--log-level=", 0) == 0) {
+        Log::setLevel(Log::parseLevel(arg.substr(12), Log::getLevel()));
+    } else if (arg.rfind("--log-categories=", 0) == 0) {
+        Log::setEnabledCategories(arg.substr(17));
+    } else if (arg.rfind("--shader-cache=", 0) == 0) {
+        getShaderCache().setDirectory(arg.substr(15));
+    } else if (arg == "--no-shader-cache") {
+        getShaderCache().setDirectory("");
+    } else if (arg.rfind("--trace-frames=", 0) == 0) {
+        options.traceFrames = std::atoi(arg.substr(15).c_str());
+    } else if (arg.rfind("--trace-file=", 0) == 0) {
+        options.traceFile = arg.substr(13);
+    } else if (arg.rfind("--scene=", 0) == 0) {
+        options.scenePath = arg.substr(8);
+    } else if (arg.rfind("--skybox=", 0) == 0) {
+        options.skyboxPath = arg.substr(9);
+    } else if (arg.rfind("--shadow-filter=", 0) == 0) {
+        std::string filter = arg.substr(16);
+        if (filter != "moments" && filter != "pcf") {
+            LOG_WARN(General, "Expected --shadow-filter=moments|pcf, got %s", arg.c_str());
+        }
+        options.momentShadows = filter == "moments";
+    } else if (arg.rfind("--shadow-softness=", 0) == 0) {
+        options.shadowSoftness = static_cast<float>(std::atof(arg.substr(18).c_str()));
+    } else if (arg.rfind("--shadow-budget=", 0) == 0) {
+        options.shadowTriangleBudget = static_cast<size_t>(std::max(0.0, std::atof(arg.substr(16).c_str())));
+    } else if (arg.rfind("--shadow-budget-ms=", 0) == 0) {
+        options.shadowMillisecondBudget = std::max(0.0f, static_cast<float>(std::atof(arg.substr(19).c_str())));
+    } else if (arg.rfind("--animate-model=", 0) == 0) {
+        options.animatedModel = std::atoi(arg.substr(16).c_str());
+    } else {
+        return false;
+    }
+    return true;
+}
+
+void setupSponzaLightingWithShadows(Scene& scene) {
+    // Clear existing lights
+    scene.getLightManager().removeAllLights();
+    
+    std::cout << "=== Setting up Sponza lighting with camera-based shadows ===" << std::endl;
+    
+    // Add a simple directional light
+    size_t mainLightIndex = scene.addDirectionalLight(
+        glm::normalize(glm::vec3(0.3f, -0.8f, 0.5f)), // Sun-like direction
+        glm::vec3(1.0f, 0.95f, 0.8f),                 // Warm sunlight
+        2.0f                                           // Intensity
+    );
+    
+    // Enable shadows - no need to set scene bounds, it will use the camera
+    scene.enableShadowsForLight(mainLightIndex, 2048);
+    
+    // Add a fill light (optional)
+    size_t fillLightIndex = scene.addDirectionalLight(
+        glm::normalize(glm::vec3(-0.2f, -0.3f, -0.8f)),
+        glm::vec3(0.4f, 0.6f, 1.0f),                    // Cool fill light
+        0.3f
+    );
+    
+    std::cout << "Lighting setup complete!" << std::endl;
+    std::cout << "Main light index: " << mainLightIndex << std::endl;
+    std::cout << "Fill light index: " << fillLightIndex << std::endl;
+    std::cout << "Shadow maps: " << scene.getShadowManager().getShadowMapCount() << std::endl;
+}
+
+void setupShadows(Scene& scene, const RendererOptions& options) {
+    ShadowManager& shadows = scene.getShadowManager();
+    shadows.setPointShadowShader(resolveSourcePath("src/shaders/pointShadow.vert"),
+                                 resolveSourcePath("src/shaders/pointShadow.geom"),
+                                 resolveSourcePath("src/shaders/pointShadow.frag"));
+    shadows.setMomentShader(resolveSourcePath("src/shaders/fullscreen.vert"), resolveSourcePath("src/shaders/shadowMoments.frag"));
+    shadows.setFilterMode(options.momentShadows ? ShadowFilterMode::Moments : ShadowFilterMode::PCF);
+    if (options.shadowSoftness >= 0.0f) {
+        shadows.setShadowSoftness(options.shadowSoftness);
+    }
+    ShadowScheduleSettings& schedule = shadows.getScheduler().getSettings();
+    schedule.triangleBudget = options.shadowTriangleBudget;
+    schedule.millisecondBudget = options.shadowMillisecondBudget;
+    schedule.enabled = schedule.triangleBudget > 0 || schedule.millisecondBudget > 0.0f;
+}
+
+void ModelAnimator::attach(Scene& scene, int index) {
+    modelIndex = -1;
+    restTransforms.clear();
+    if (index < 0) return;
+    if (static_cast<size_t>(index) >= scene.getModels().size()) {
+        LOG_WARN(Scene, "--animate-model=%d, but the scene has %zu models", index, scene.getModels().size());
+        return;
+    }
+    const Model& model = scene.getModels()[index];
+    if (model.getInstanceCount() == 0) return;
+    restTransforms = model.getInstanceTransforms();
+    // A fraction of the first instance's size, so the motion shows at any scene scale
+    glm::vec3 worldMin, worldMax;
+    transformAABB(restTransforms[0], model.getLocalMin(), model.getLocalMax(), worldMin, worldMax);
+    amplitude = 0.25f * glm::length(worldMax - worldMin);
+    modelIndex = index;
+    scene.setModelDynamic(static_cast<size_t>(modelIndex), true);
+    LOG_INFO(Scene, "Animating model %d (%zu instances) as a dynamic shadow caster", modelIndex, restTransforms.size());
+}
+
+void ModelAnimator::update(Scene& scene, float time) {
+    if (modelIndex < 0) return;
+    for (size_t i = 0; i < restTransforms.size(); ++i) {
+        // Out of phase, so instances of one model don't move as a block
+        float phase = time * 2.0f + static_cast<float>(i) * 0.7f;
+        glm::vec3 offset = amplitude * glm::vec3(std::sin(phase), 0.0f, std::cos(phase));
+        scene.setInstanceTransform(static_cast<size_t>(modelIndex), i, glm::translate(glm::mat4(1.0f), offset) * restTransforms[i]);
+    }
+}
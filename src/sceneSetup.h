@@ -0,0 +1,61 @@
+#ifndef SCENE_SETUP_H
+#define SCENE_SETUP_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+#include "error.h"
+
+class Scene;
+
+// Relative paths resolve against the source tree (RAYTRACER_SOURCE_DIR from CMake)
+std::string resolveSourcePath(const std::string& path);
+
+// Command line options shared by the windowed and headless executables
+struct RendererOptions {
+    RendererOptions();
+
+    GLDebugMode debugMode;
+    std::string scenePath;
+    std::string skyboxPath; // empty disables the skybox
+    int traceFrames;
+    std::string traceFile;
+    // --shadow-filter=moments|pcf and --shadow-softness=texels; softness below 0 keeps
+    // the shadow manager's default
+    bool momentShadows;
+    float shadowSoftness;
+    // --shadow-budget=triangles and --shadow-budget-ms=ms; either turns on the shadow
+    // update scheduler
+    size_t shadowTriangleBudget;
+    float shadowMillisecondBudget;
+    // --animate-model=index moves that model's instances every frame as a dynamic shadow
+    // caster; below 0 nothing moves
+    int animatedModel;
+};
+
+// Applies one shared option; false when the argument is not one of them
+bool parseRendererOption(const std::string& arg, RendererOptions& options);
+
+void setupSponzaLightingWithShadows(Scene& scene);
+// Sets the shadow shaders and the shadow options of the command line
+void setupShadows(Scene& scene, const RendererOptions& options);
+
+// Sways the instances of one model around where they were loaded, so moving shadow
+// casters (and their motion vectors) can be checked without an animation system
+class ModelAnimator {
+public:
+    // Marks the model dynamic and keeps its current instance transforms as the rest pose.
+    // An index below 0 or past the scene's models leaves the animator idle.
+    void attach(Scene& scene, int modelIndex);
+    // time in seconds
+    void update(Scene& scene, float time);
+    bool isActive() const { return modelIndex >= 0; }
+
+private:
+    int modelIndex = -1;
+    std::vector<glm::mat4> restTransforms;
+    float amplitude = 0.0f;
+};
+
+#endif // SCENE_SETUP_H
@@ -1,4 +1,9 @@
 #include "shader.h"
+#include "shaderCache.h"
+#include "glState.h"
+#include "log.h"
+#include <chrono>
+#include <cstring>
 
 std::string get_file_contents(const char* filename)
 {
@@ -11,11 +16,72 @@ std::string get_file_contents(const char* filename)
 	return contents;
 }
 
-Shader::Shader(const char* vertexFile, const char* fragmentFile)
+std::string inject_defines(const std::string& source, const std::string& defines)
 {
-	std::string vertexCode = get_file_contents(vertexFile);
-	std::string fragmentCode = get_file_contents(fragmentFile);
+	if (defines.empty())
+	{
+		return source;
+	}
+	size_t versionPos = source.find("#version");
+	if (versionPos == std::string::npos)
+	{
+		return defines + source;
+	}
+	size_t lineEnd = source.find('\n', versionPos);
+	if (lineEnd == std::string::npos)
+	{
+		return source + "\n" + defines;
+	}
+	return source.substr(0, lineEnd + 1) + defines + source.substr(lineEnd + 1);
+}
+
+Shader::Shader(const char* vertexFile, const char* fragmentFile, const std::string& defines)
+{
+	build(vertexFile, nullptr, fragmentFile, defines);
+}
+
+Shader::Shader(const char* vertexFile, const char* geometryFile, const char* fragmentFile, const std::string& defines)
+{
+	build(vertexFile, geometryFile, fragmentFile, defines);
+}
+
+void Shader::build(const char* vertexFile, const char* geometryFile, const char* fragmentFile, const std::string& defines)
+{
+	auto start = std::chrono::steady_clock::now();
 
+	std::string vertexCode = inject_defines(get_file_contents(vertexFile), defines);
+	std::string geometryCode = geometryFile ? inject_defines(get_file_contents(geometryFile), defines) : std::string();
+	std::string fragmentCode = inject_defines(get_file_contents(fragmentFile), defines);
+
+	ShaderCache& cache = getShaderCache();
+	uint64_t key = cache.computeKey(vertexCode, fragmentCode, defines, geometryCode);
+	ID = cache.load(key);
+	bool fromCache = ID != 0;
+
+	if (!fromCache)
+	{
+		bool linked = false;
+		ID = compileProgram(vertexCode, geometryCode, fragmentCode, linked);
+		if (linked)
+		{
+			cache.store(key, ID);
+		}
+	}
+
+	double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	cache.recordSetup(fromCache, ms);
+	if (geometryFile)
+	{
+		LOG_INFO(Shader, "%s + %s + %s: %s in %.2f ms", vertexFile, geometryFile, fragmentFile, fromCache ? "loaded from cache" : "compiled", ms);
+	}
+	else
+	{
+		LOG_INFO(Shader, "%s + %s: %s in %.2f ms", vertexFile, fragmentFile, fromCache ? "loaded from cache" : "compiled", ms);
+	}
+}
+
+GLuint Shader::compileProgram(const std::string& vertexCode, const std::string& geometryCode, const std::string& fragmentCode, bool& linked)
+{
 	const char* vertexSource = vertexCode.c_str();
 	const char* fragmentSource = fragmentCode.c_str();
 
@@ -29,33 +95,53 @@ Shader::Shader(const char* vertexFile, const char* fragmentFile)
 	glCompileShader(fragmentShader);
 	compileErrors(fragmentShader, "FRAGMENT");
 
-	ID = glCreateProgram();
-	glAttachShader(ID, vertexShader);
-	glAttachShader(ID, fragmentShader);
-	glLinkProgram(ID);
-	compileErrors(ID, "PROGRAM");
+	GLuint geometryShader = 0;
+	if (!geometryCode.empty())
+	{
+		const char* geometrySource = geometryCode.c_str();
+		geometryShader = glCreateShader(GL_GEOMETRY_SHADER);
+		glShaderSource(geometryShader, 1, &geometrySource, NULL);
+		glCompileShader(geometryShader);
+		compileErrors(geometryShader, "GEOMETRY");
+	}
+
+	GLuint program = glCreateProgram();
+	glAttachShader(program, vertexShader);
+	if (geometryShader)
+	{
+		glAttachShader(program, geometryShader);
+	}
+	glAttachShader(program, fragmentShader);
+	getShaderCache().prepareForLink(program);
+	glLinkProgram(program);
+	linked = compileErrors(program, "PROGRAM");
 
 	glDeleteShader(vertexShader);
+	if (geometryShader)
+	{
+		glDeleteShader(geometryShader);
+	}
 	glDeleteShader(fragmentShader);
-
+	return program;
 }
 
 void Shader::activate()
 {
-	glUseProgram(ID);
+	getGLState().useProgram(ID);
 }
 
 void Shader::deactivate()
 {
-	glUseProgram(0);
+	getGLState().useProgram(0);
 }
 
 Shader::~Shader()
 {
+	getGLState().programDeleted(ID);
 	glDeleteProgram(ID);
 }
 
-void Shader::compileErrors(unsigned int shader, const char* type)
+bool Shader::compileErrors(unsigned int shader, const char* type)
 {
 	GLint hasCompiled;
 	char infoLog[1024];
@@ -77,28 +163,71 @@ void Shader::compileErrors(unsigned int shader, const char* type)
 			std::cout << "SHADER_LINKING_ERROR for:" << type << "\n" << infoLog << std::endl;
 		}
 	}
+	return hasCompiled == GL_TRUE;
+}
+
+GLint Shader::getUniformLocation(const std::string &name) const
+{
+	auto it = uniformLocations.find(name);
+	if (it != uniformLocations.end())
+	{
+		return it->second;
+	}
+	GLint location = glGetUniformLocation(ID, name.c_str());
+	uniformLocations.emplace(name, location);
+	return location;
+}
+
+void Shader::setUniformBlockBinding(const std::string &name, GLuint binding) const
+{
+	auto it = uniformBlockBindings.find(name);
+	if (it != uniformBlockBindings.end() && it->second == binding)
+	{
+		return;
+	}
+	uniformBlockBindings[name] = binding;
+	GLuint blockIndex = glGetUniformBlockIndex(ID, name.c_str());
+	if (blockIndex != GL_INVALID_INDEX)
+	{
+		glUniformBlockBinding(ID, blockIndex, binding);
+	}
 }
 
 void Shader::setMat4(const std::string &name, const GLfloat* value) const
 {
-    glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, value);
+    glUniformMatrix4fv(getUniformLocation(name), 1, GL_FALSE, value);
 }
 
 void Shader::setBool(const std::string &name, bool value) const
 {
-    glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
+    glUniform1i(getUniformLocation(name), (int)value);
 }
 
 void Shader::setFloat(const std::string &name, float value) const
 {
-    glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+    glUniform1f(getUniformLocation(name), value);
+}
+
+void Shader::setInt(const std::string &name, int value) const
+{
+    glUniform1i(getUniformLocation(name), value);
 }
 
 void Shader::setVec4(const std::string &name, const GLfloat* value) const
 {
-	glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, value);
+	glUniform4fv(getUniformLocation(name), 1, value);
+}
+void Shader::setVec2(const std::string &name, const GLfloat* value) const
+{
+    glUniform2fv(getUniformLocation(name), 1, value);
 }
+
 void Shader::setVec3(const std::string &name, const GLfloat* value) const
 {
-    glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, value);
+    glUniform3fv(getUniformLocation(name), 1, value);
+}
+
+void Shader::setIVec3(const std::string &name, const GLint* value) const
+{
+    glUniform3iv(getUniformLocation(name), 1, value);
 }
\ No newline at end of file
@@ -7,25 +7,45 @@
 #include<sstream>
 #include<iostream>
 #include<cerrno>
+#include<unordered_map>
 
 std::string get_file_contents(const char* filename);
+// Inserts preprocessor lines (e.g. "#define HAS_NORMAL_MAP 1\n") right after the #version directive
+std::string inject_defines(const std::string& source, const std::string& defines);
 
 class Shader
 {
 public:
 	GLuint ID;
-	Shader(const char* vertexFile, const char* fragmentFile);
+	Shader(const char* vertexFile, const char* fragmentFile, const std::string& defines = "");
+	// With a geometry stage between the two
+	Shader(const char* vertexFile, const char* geometryFile, const char* fragmentFile, const std::string& defines);
     ~Shader();
 	void setMat4(const std::string &name, const GLfloat* value) const;
 	void setFloat(const std::string &name, float value) const;
+	void setInt(const std::string &name, int value) const;
 	void setBool(const std::string &name, bool value) const;
 	void setVec4(const std::string &name, const GLfloat* value) const;
+	void setVec2(const std::string &name, const GLfloat* value) const;
 	void setVec3(const std::string &name, const GLfloat* value) const;
+	void setIVec3(const std::string &name, const GLint* value) const;
+
+	// Cached glGetUniformLocation; -1 for uniforms the variant compiled out
+	GLint getUniformLocation(const std::string &name) const;
+	// Points a uniform block at a binding point; the program keeps it, so only the first
+	// call per block queries GL
+	void setUniformBlockBinding(const std::string &name, GLuint binding) const;
 
 	void activate();
 	void deactivate();
 private:
-	void compileErrors(unsigned int shader, const char* type);
+	mutable std::unordered_map<std::string, GLint> uniformLocations;
+	mutable std::unordered_map<std::string, GLuint> uniformBlockBindings;
+
+	void build(const char* vertexFile, const char* geometryFile, const char* fragmentFile, const std::string& defines);
+	bool compileErrors(unsigned int shader, const char* type);
+	// An empty geometryCode links vertex and fragment only
+	GLuint compileProgram(const std::string& vertexCode, const std::string& geometryCode, const std::string& fragmentCode, bool& linked);
 };
 
 #endif
\ No newline at end of file
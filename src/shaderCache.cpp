@@ -0,0 +1,183 @@
+#include "shaderCache.h"
+#include "glExtensions.h"
+#include "log.h"
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+namespace {
+
+const uint32_t CACHE_MAGIC = 0x43535452; // "RTSC"
+const uint32_t CACHE_VERSION = 1;
+
+struct CacheHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t key;
+    uint32_t binaryFormat;
+    uint32_t length;
+};
+
+uint64_t fnv1a(uint64_t hash, const std::string& data) {
+    for (unsigned char c : data) {
+        hash ^= c;
+        hash *= 1099511628211ull;
+    }
+    // Separator so ("ab", "c") and ("a", "bc") hash differently
+    hash ^= 0xFF;
+    hash *= 1099511628211ull;
+    return hash;
+}
+
+std::string getGLString(GLenum name) {
+    const GLubyte* value = glGetString(name);
+    return value ? reinterpret_cast<const char*>(value) : "";
+}
+
+} // namespace
+
+ShaderCache::ShaderCache() {
+    const char* env = std::getenv("RAYTRACER_SHADER_CACHE");
+    directory = env ? env : "shader_cache";
+}
+
+void ShaderCache::setDirectory(const std::string& dir) {
+    directory = dir;
+}
+
+bool ShaderCache::isEnabled() const {
+    return !directory.empty() && getGLExtensions().programBinary;
+}
+
+uint64_t ShaderCache::computeKey(const std::string& vertexSource, const std::string& fragmentSource, const std::string& defines,
+                                 const std::string& geometrySource) const {
+    uint64_t hash = 14695981039346656037ull;
+    hash = fnv1a(hash, vertexSource);
+    hash = fnv1a(hash, fragmentSource);
+    if (!geometrySource.empty()) {
+        hash = fnv1a(hash, geometrySource);
+    }
+    hash = fnv1a(hash, defines);
+    hash = fnv1a(hash, getGLString(GL_VENDOR));
+    hash = fnv1a(hash, getGLString(GL_RENDERER));
+    hash = fnv1a(hash, getGLString(GL_VERSION));
+    return hash;
+}
+
+std::string ShaderCache::getEntryPath(uint64_t key) const {
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.bin", static_cast<unsigned long long>(key));
+    return (std::filesystem::path(directory) / name).string();
+}
+
+GLuint ShaderCache::load(uint64_t key) {
+    if (!isEnabled()) {
+        return 0;
+    }
+
+    std::string path = getEntryPath(key);
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        return 0;
+    }
+
+    CacheHeader header;
+    in.read(reinterpret_cast<char*>(&header), sizeof(header));
+    if (!in || header.magic != CACHE_MAGIC || header.version != CACHE_VERSION || header.key != key || header.length == 0) {
+        LOG_WARN(Shader, "Ignoring malformed shader cache entry %s", path.c_str());
+        return 0;
+    }
+
+    std::vector<char> binary(header.length);
+    in.read(binary.data(), binary.size());
+    if (!in) {
+        LOG_WARN(Shader, "Truncated shader cache entry %s", path.c_str());
+        return 0;
+    }
+
+    GLuint program = glCreateProgram();
+    glProgramBinary(program, header.binaryFormat, binary.data(), static_cast<GLsizei>(binary.size()));
+
+    GLint linked = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &linked);
+    if (linked != GL_TRUE) {
+        // Drivers may refuse binaries after an update even when the version string is unchanged
+        while (glGetError() != GL_NO_ERROR) {}
+        glDeleteProgram(program);
+        std::error_code ec;
+        std::filesystem::remove(path, ec);
+        stats.rejected++;
+        LOG_INFO(Shader, "Driver rejected cached program %016llx, recompiling", static_cast<unsigned long long>(key));
+        return 0;
+    }
+    return program;
+}
+
+void ShaderCache::prepareForLink(GLuint program) const {
+    if (isEnabled()) {
+        glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+}
+
+void ShaderCache::store(uint64_t key, GLuint program) {
+    if (!isEnabled()) {
+        return;
+    }
+
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) {
+        return;
+    }
+
+    std::vector<char> binary(length);
+    GLenum binaryFormat = 0;
+    GLsizei written = 0;
+    glGetProgramBinary(program, length, &written, &binaryFormat, binary.data());
+    if (written <= 0) {
+        return;
+    }
+
+    std::error_code ec;
+    std::filesystem::create_directories(directory, ec);
+    if (ec) {
+        LOG_WARN(Shader, "Cannot create shader cache directory %s: %s", directory.c_str(), ec.message().c_str());
+        return;
+    }
+
+    // Write to a temporary name and rename so a crash never leaves a half-written entry
+    std::string path = getEntryPath(key);
+    std::string tempPath = path + ".tmp";
+    {
+        std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+        CacheHeader header = { CACHE_MAGIC, CACHE_VERSION, key, binaryFormat, static_cast<uint32_t>(written) };
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(binary.data(), written);
+        if (!out) {
+            LOG_WARN(Shader, "Failed to write shader cache entry %s", tempPath.c_str());
+            return;
+        }
+    }
+    std::filesystem::rename(tempPath, path, ec);
+    if (ec) {
+        std::filesystem::remove(tempPath, ec);
+    }
+}
+
+void ShaderCache::recordSetup(bool fromCache, double milliseconds) {
+    stats.programs++;
+    if (fromCache) {
+        stats.hits++;
+        stats.warmMs += milliseconds;
+    } else {
+        stats.compiled++;
+        stats.coldMs += milliseconds;
+    }
+}
+
+ShaderCache& getShaderCache() {
+    static ShaderCache cache;
+    return cache;
+}
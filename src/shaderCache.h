@@ -0,0 +1,51 @@
+#ifndef SHADER_CACHE_H
+#define SHADER_CACHE_H
+
+#include <glad/glad.h>
+#include <cstdint>
+#include <string>
+
+struct ShaderCacheStats {
+    int programs = 0;
+    int hits = 0;       // linked straight from a cached binary
+    int compiled = 0;   // compiled from source (cold, or after a rejected binary)
+    int rejected = 0;   // binaries the driver refused
+    double warmMs = 0.0;
+    double coldMs = 0.0;
+};
+
+// Linked program binaries stored on disk, one file per program. The key covers every
+// stage's source (with defines already injected), the define list and the GL vendor, renderer
+// and version strings, so a driver update or an edited shader simply misses the cache.
+class ShaderCache {
+public:
+    ShaderCache();
+
+    // Empty directory disables the cache
+    void setDirectory(const std::string& dir);
+    const std::string& getDirectory() const { return directory; }
+    bool isEnabled() const;
+
+    // An empty geometry source hashes the same as a program without one
+    uint64_t computeKey(const std::string& vertexSource, const std::string& fragmentSource, const std::string& defines,
+                        const std::string& geometrySource = "") const;
+
+    // Returns a linked program, or 0 on a miss or when the driver rejects the binary
+    GLuint load(uint64_t key);
+    // Call before glLinkProgram so the driver keeps the binary around
+    void prepareForLink(GLuint program) const;
+    void store(uint64_t key, GLuint program);
+
+    void recordSetup(bool fromCache, double milliseconds);
+    const ShaderCacheStats& getStats() const { return stats; }
+
+private:
+    std::string directory;
+    ShaderCacheStats stats;
+
+    std::string getEntryPath(uint64_t key) const;
+};
+
+ShaderCache& getShaderCache();
+
+#endif // SHADER_CACHE_H
@@ -0,0 +1,38 @@
+#include "shaderPermutation.h"
+#include "log.h"
+
+ShaderPermutationManager::ShaderPermutationManager(const std::string& vertexPath, const std::string& fragmentPath)
+    : vertexPath(vertexPath), fragmentPath(fragmentPath) {
+}
+
+std::string ShaderPermutationManager::buildDefines(const ShaderVariantKey& key) {
+    std::string defines;
+    if (key.features & SHADER_FEATURE_NORMAL_MAP) {
+        defines += "#define HAS_NORMAL_MAP 1\n";
+    }
+    if (key.features & SHADER_FEATURE_ALPHA_MASK) {
+        defines += "#define ALPHA_MASK 1\n";
+    }
+    if (key.shadows) {
+        defines += "#define HAS_SHADOWS 1\n";
+    }
+    if (key.shadowMoments) {
+        defines += "#define SHADOW_MOMENTS 1\n";
+    }
+    defines += "#define DIRECTIONAL_LIGHT_COUNT " + std::to_string(key.directionalLightCount) + "\n";
+    return defines;
+}
+
+Shader& ShaderPermutationManager::getVariant(const ShaderVariantKey& key) {
+    auto it = variants.find(key.pack());
+    if (it != variants.end()) {
+        return *it->second;
+    }
+
+    LOG_INFO(Shader, "Building shader variant: features 0x%x, shadows %s, %d directional lights",
+             key.features, key.shadows ? (key.shadowMoments ? "moments" : "on") : "off", key.directionalLightCount);
+    auto shader = std::make_unique<Shader>(vertexPath.c_str(), fragmentPath.c_str(), buildDefines(key));
+    Shader& result = *shader;
+    variants.emplace(key.pack(), std::move(shader));
+    return result;
+}
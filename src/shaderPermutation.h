@@ -0,0 +1,48 @@
+#ifndef SHADER_PERMUTATION_H
+#define SHADER_PERMUTATION_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include "shader.h"
+
+// Per-material features baked into a variant instead of branched on in the fragment shader
+enum ShaderFeature : uint32_t {
+    SHADER_FEATURE_NONE = 0,
+    SHADER_FEATURE_NORMAL_MAP = 1u << 0,  // HAS_NORMAL_MAP
+    SHADER_FEATURE_ALPHA_MASK = 1u << 1   // ALPHA_MASK: alpha test with discard
+};
+
+struct ShaderVariantKey {
+    uint32_t features = SHADER_FEATURE_NONE;
+    bool shadows = false;           // HAS_SHADOWS
+    bool shadowMoments = false;     // SHADOW_MOMENTS: atlas tiles sampled as EVSM moments
+    int directionalLightCount = 0;  // DIRECTIONAL_LIGHT_COUNT
+
+    uint64_t pack() const {
+        return static_cast<uint64_t>(features) |
+               (static_cast<uint64_t>(shadows ? 1 : 0) << 32) |
+               (static_cast<uint64_t>(shadowMoments ? 1 : 0) << 33) |
+               (static_cast<uint64_t>(directionalLightCount & 0xFF) << 40);
+    }
+};
+
+// Compiles variants of one vertex/fragment pair on first use. Every variant goes through
+// the program binary cache, so only the first run on a machine pays for compilation.
+class ShaderPermutationManager {
+public:
+    ShaderPermutationManager(const std::string& vertexPath, const std::string& fragmentPath);
+
+    Shader& getVariant(const ShaderVariantKey& key);
+    size_t getVariantCount() const { return variants.size(); }
+
+    static std::string buildDefines(const ShaderVariantKey& key);
+
+private:
+    std::string vertexPath;
+    std::string fragmentPath;
+    std::unordered_map<uint64_t, std::unique_ptr<Shader>> variants;
+};
+
+#endif // SHADER_PERMUTATION_H
@@ -1,5 +1,11 @@
 #version 330 core
 
+// Variant defines are injected after #version by ShaderPermutationManager:
+//   HAS_NORMAL_MAP, ALPHA_MASK, HAS_SHADOWS, DIRECTIONAL_LIGHT_COUNT
+#ifndef DIRECTIONAL_LIGHT_COUNT
+#define DIRECTIONAL_LIGHT_COUNT 4
+#endif
+
 // Input from vertex shader
 in vec3 FragPos;
 in vec3 Color;
@@ -7,8 +13,13 @@ in vec3 Normal;
 in vec2 TexCoord;
 in vec3 Tangent;
 in vec3 Bitangent;
+flat in int MaterialIndex;
+in vec4 CurrentClip;
+in vec4 PreviousClip;
 
-out vec4 fragColor;
+layout(location = 0) out vec4 fragColor;
+// Screen-space motion since the previous frame in UV units; ignored without a velocity target
+layout(location = 1) out vec2 fragVelocity;
 
 // PBR texture uniforms
 uniform sampler2D baseColorTexture;
@@ -17,48 +28,65 @@ uniform sampler2D metallicRoughnessTexture;
 uniform sampler2D occlusionTexture;
 uniform sampler2D emissiveTexture;
 
-// Material factor uniforms
-uniform float metallicFactor;
-uniform float roughnessFactor;
-uniform vec4 baseColorFactor;
+// Material table, 2 texels per material: baseColorFactor, (metallic, roughness, alphaCutoff, 0)
+uniform samplerBuffer materialData;
 uniform vec4 emissiveFactor;
 
-// Alpha settings
-uniform float alphaCutoff;
-uniform bool useAlphaBlending;
-
-// Camera position
-uniform vec3 cameraPos;
-
-// Shadow mapping uniforms
-struct ShadowMap {
-    float textureUnit;
-    float lightIndex;
-    mat4 lightSpaceMatrix;
+// Per-view data shared with default.vert
+layout(std140) uniform ViewBlock {
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    mat4 unjitteredViewProjection;
+    mat4 previousViewProjection;
+    vec4 cameraPos;
 };
 
-uniform ShadowMap shadowMaps[4];
-uniform float numShadowMaps;
+// Shadow atlas holding every shadowed light's tiles: one per cascade for directional lights,
+// one for spot lights. shadowData (from shadowDataBase) starts with two texels per light
+// index, (first tile, tile count, cube + 1, far plane) and each cascade's view-space far
+// distance (for a cube, the position it was drawn from), then has five texels per tile: the light-space matrix columns and the tile's
+// rectangle (x, y, size) in atlas UVs with the far plane of perspective tiles (0 for
+// cascades). Lights at or past shadowLightCount or without tiles or a cube are unshadowed.
+#define MAX_CASCADES 4
+uniform sampler2DShadow shadowAtlas;
+uniform samplerBuffer shadowData;
+uniform int shadowDataBase;
+uniform int shadowLightCount;
+// Receiver bias in shadow map texels, scaled with slope (see slopeScaledBias)
 uniform float shadowBias;
+// Filter radius in texels, spread over shadowFilterTaps comparison taps
 uniform float shadowSoftness;
+#define MAX_SHADOW_TAPS 32
+uniform int shadowFilterTaps;
+// Point-light cubes, six layers each in +X, -X, +Y, -Y, +Z, -Z order, holding distance to
+// the light over its far plane
+uniform sampler2DArrayShadow pointShadowMaps;
+#ifdef SHADOW_MOMENTS
+// EVSM moments of every atlas tile at the same UVs, already blurred by shadowSoftness and
+// mipmapped, so one trilinear/anisotropic lookup replaces the filter taps
+uniform sampler2D shadowMoments;
+uniform float lightBleedReduction;
+// Warp exponents; must match shadowMoments.frag
+#define EVSM_POSITIVE 40.0
+#define EVSM_NEGATIVE 5.0
+// Screen-space derivatives of FragPos, taken in uniform control flow at the top of main()
+vec3 fragPosDx = vec3(0.0);
+vec3 fragPosDy = vec3(0.0);
+#endif
 
-uniform sampler2D shadowMap0;
-uniform sampler2D shadowMap1;
-uniform sampler2D shadowMap2;
-uniform sampler2D shadowMap3;
-
-// Light structures
+// Light structures; direction.w = light index in the LightManager
 struct DirectionalLight {
     vec4 direction;
     vec4 color;
     bool enabled;
 };
 
+// position.w = range, attenuation.w = light index in the LightManager
 struct PointLight {
     vec4 position;
     vec4 color;
     vec4 attenuation;
-    bool enabled;
 };
 
 struct SpotLight {
@@ -67,27 +95,66 @@ struct SpotLight {
     vec4 color;
     vec4 attenuation;
     vec4 cutoff;
-    bool enabled;
 };
 
 // Light uniforms
-uniform float numDirectionalLights;
-uniform float numPointLights;
-uniform float numSpotLights;
-
 uniform DirectionalLight directionalLights[4];
-uniform PointLight pointLights[32];
-uniform SpotLight spotLights[16];
+
+// Clustered point/spot lights (see LightClusterGrid)
+uniform samplerBuffer clusterLightData;      // 5 texels per light
+uniform usamplerBuffer clusterRecords;       // (offset, pointCount << 16 | spotCount)
+uniform usamplerBuffer clusterLightIndices;
+uniform ivec3 clusterGridSize;
+uniform float clusterSliceScale;
+uniform float clusterSliceBias;
+// Texel offsets of this frame's light data, records and indices in the upload ring
+uniform ivec3 clusterBufferBase;
+
+PointLight fetchPointLight(int slot) {
+    int base = clusterBufferBase.x + slot * 5;
+    PointLight light;
+    light.position = texelFetch(clusterLightData, base);
+    light.color = texelFetch(clusterLightData, base + 1);
+    light.attenuation = texelFetch(clusterLightData, base + 2);
+    return light;
+}
+
+SpotLight fetchSpotLight(int slot) {
+    int base = clusterBufferBase.x + slot * 5;
+    SpotLight light;
+    light.position = texelFetch(clusterLightData, base);
+    light.color = texelFetch(clusterLightData, base + 1);
+    light.attenuation = texelFetch(clusterLightData, base + 2);
+    light.direction = texelFetch(clusterLightData, base + 3);
+    light.cutoff = texelFetch(clusterLightData, base + 4);
+    return light;
+}
+
+int getClusterIndex(vec3 fragPos) {
+    vec4 viewPos = view * vec4(fragPos, 1.0);
+    // Clusters are built from the unjittered projection
+    vec4 clipPos = unjitteredViewProjection * vec4(fragPos, 1.0);
+    vec2 ndc = clipPos.xy / clipPos.w;
+
+    ivec2 tile = ivec2(clamp((ndc * 0.5 + 0.5) * vec2(clusterGridSize.xy), vec2(0.0), vec2(clusterGridSize.xy - 1)));
+    int slice = int(clamp(log(-viewPos.z) * clusterSliceScale + clusterSliceBias, 0.0, float(clusterGridSize.z - 1)));
+
+    return (slice * clusterGridSize.y + tile.y) * clusterGridSize.x + tile.x;
+}
+
+// Smoothly fades attenuation to zero at the culling range so cluster edges don't show
+float rangeWindow(float distance, float range) {
+    float ratio = distance / range;
+    float window = clamp(1.0 - ratio * ratio * ratio * ratio, 0.0, 1.0);
+    return window * window;
+}
 
 // Function to get proper normal (with normal mapping)
 vec3 getNormalFromMap() {
-    vec4 normalMap = texture(normalTexture, TexCoord);
-    
-    if (length(normalMap.rgb) < 0.01) {
-        return normalize(Normal);
-    }
-    
-    vec3 tangentNormal = normalMap.rgb * 2.0 - 1.0;
+#ifndef HAS_NORMAL_MAP
+    return normalize(Normal);
+#else
+    vec3 tangentNormal = texture(normalTexture, TexCoord).rgb * 2.0 - 1.0;
     
     vec3 N = normalize(Normal);
     vec3 T = normalize(Tangent);
@@ -99,80 +166,185 @@ vec3 getNormalFromMap() {
     mat3 TBN = mat3(T, B, N);
     
     return normalize(TBN * tangentNormal);
+#endif
 }
 
-// Shadow calculation function - now takes sampler2D as parameter
-float calculateShadow(vec4 fragPosLightSpace, sampler2D shadowMapTexture, vec3 normal, vec3 lightDir) {
-    vec3 projCoords = fragPosLightSpace.xyz / fragPosLightSpace.w;
-    
-    // Transform to [0,1] range
-    projCoords = projCoords * 0.5 + 0.5;
-    
-    // Check if we're outside the shadow map bounds
-    if(projCoords.x < 0.0 || projCoords.x > 1.0 || 
-       projCoords.y < 0.0 || projCoords.y > 1.0 || 
-       projCoords.z > 1.0) {
-        return 0.0; // No shadow if outside bounds
+// Per-pixel rotation of the filter kernel (interleaved gradient noise): a few taps then
+// trade banding for fine noise
+float shadowKernelRotation() {
+    return 6.28318531 * fract(52.9829189 * fract(dot(gl_FragCoord.xy, vec2(0.06711056, 0.00583715))));
+}
+
+// Tap i of count on the unit disk along a golden-angle (Vogel) spiral, which covers the
+// disk evenly for any count
+vec2 vogelDiskTap(int i, int count, float rotation) {
+    float radius = sqrt((float(i) + 0.5) / float(count));
+    float angle = float(i) * 2.39996323 + rotation;
+    return radius * vec2(cos(angle), sin(angle));
+}
+
+// World-space distance to move a receiver toward the light before comparing: shadowBias
+// texels, growing with the surface's slope to the light since a tilted receiver crosses
+// more depth per texel, and more so across the whole filter radius
+float slopeScaledBias(float worldPerTexel, vec3 normal, vec3 lightDir) {
+    float cosTheta = clamp(dot(normal, lightDir), 0.05, 1.0);
+    float tanTheta = min(sqrt(1.0 - cosTheta * cosTheta) / cosTheta, 10.0);
+    return shadowBias * worldPerTexel * (1.0 + tanTheta * (1.0 + shadowSoftness));
+}
+
+#ifdef SHADOW_MOMENTS
+// Chebyshev's upper bound on the lit fraction from one pair of moments, with the lowest
+// lightBleedReduction of it cut off as shadow
+float chebyshevUpperBound(vec2 moments, float mean, float minVariance) {
+    if (mean <= moments.x) return 1.0;
+    float variance = max(moments.y - moments.x * moments.x, minVariance);
+    float difference = mean - moments.x;
+    float bound = variance / (variance + difference * difference);
+    return clamp((bound - lightBleedReduction) / (1.0 - lightBleedReduction), 0.0, 1.0);
+}
+
+// Lit fraction at a receiver depth from the tile's moments around center. Gradients come
+// from the fragment's footprint in light space rather than from center, which jumps
+// between cascades, so the mip level stays continuous across them.
+float momentVisibility(mat4 lightSpaceMatrix, vec4 fragPosLightSpace, vec4 tileRect, vec2 center, float depth) {
+    vec2 ndc = fragPosLightSpace.xy / fragPosLightSpace.w;
+    vec4 dx = lightSpaceMatrix * vec4(fragPosDx, 0.0);
+    vec4 dy = lightSpaceMatrix * vec4(fragPosDy, 0.0);
+    float scale = 0.5 * tileRect.z / fragPosLightSpace.w;
+    vec2 momentTexel = 1.0 / vec2(textureSize(shadowMoments, 0));
+    vec2 uv = clamp(center, tileRect.xy + 0.5 * momentTexel, tileRect.xy + tileRect.z - 0.5 * momentTexel);
+    vec4 moments = textureGrad(shadowMoments, uv, (dx.xy - ndc * dx.w) * scale, (dy.xy - ndc * dy.w) * scale);
+
+    float warped = depth * 2.0 - 1.0;
+    vec2 mean = vec2(exp(EVSM_POSITIVE * warped), -exp(-EVSM_NEGATIVE * warped));
+    // The variance of a flat receiver: a tiny depth step through the warp's slope
+    vec2 slope = 0.0001 * vec2(EVSM_POSITIVE, EVSM_NEGATIVE) * abs(mean);
+    vec2 minVariance = slope * slope;
+    return min(chebyshevUpperBound(moments.xy, mean.x, minVariance.x),
+               chebyshevUpperBound(moments.zw, mean.y, minVariance.y));
+}
+#endif
+
+// Shadow of one atlas tile. Every tap is a hardware 2x2 bilinear comparison; with
+// shadowSoftness above 0 they are spread over a Vogel disk that many texels wide. With
+// SHADOW_MOMENTS a single lookup of the prefiltered moments replaces the taps.
+float calculateShadow(mat4 lightSpaceMatrix, vec4 tileRect, vec3 normal, vec3 lightDir) {
+    vec4 fragPosLightSpace = lightSpaceMatrix * vec4(FragPos, 1.0);
+    vec3 projCoords = fragPosLightSpace.xyz / fragPosLightSpace.w * 0.5 + 0.5;
+    if (projCoords.x < 0.0 || projCoords.x > 1.0 ||
+        projCoords.y < 0.0 || projCoords.y > 1.0 ||
+        projCoords.z > 1.0) {
+        return 0.0;
     }
-    
-    // Sample the shadow map
-    float closestDepth = texture(shadowMapTexture, projCoords.xy).r;
-    float currentDepth = projCoords.z;
-    
-    // Simple shadow test with minimal bias
-    return currentDepth > closestDepth + 0.001 ? 0.7 : 0.0;
 
-    // Perform perspective divide
-    // vec3 projCoords = fragPosLightSpace.xyz / fragPosLightSpace.w;
-    
-    // // Transform to [0,1] range
-    // projCoords = projCoords * 0.5 + 0.5;
-    
-    // // Get closest depth value from light's perspective
-    // float closestDepth = texture(shadowMapTexture, projCoords.xy).r;
-    
-    // // Get depth of current fragment from light's perspective
-    // float currentDepth = projCoords.z;
-    
-    // // Calculate bias to prevent shadow acne
-    // float bias = max(shadowBias * (1.0 - dot(normal, lightDir)), shadowBias * 0.1);
-    
-    // // Check whether current frag pos is in shadow
-    // // PCF (Percentage Closer Filtering) for soft shadows
-    // float shadow = 0.0;
-    // vec2 texelSize = 1.0 / textureSize(shadowMapTexture, 0);
-    // int pcfSamples = int(shadowSoftness);
-    
-    // for(int x = -pcfSamples; x <= pcfSamples; ++x) {
-    //     for(int y = -pcfSamples; y <= pcfSamples; ++y) {
-    //         float pcfDepth = texture(shadowMapTexture, projCoords.xy + vec2(x, y) * texelSize).r;
-    //         shadow += currentDepth - bias > pcfDepth ? 1.0 : 0.0;
-    //     }
-    // }
-    
-    // shadow /= pow(2.0 * pcfSamples + 1.0, 2.0);
-    
-    // // Keep shadow at 0.0 when outside the far plane region of the light's frustum
-    // if(projCoords.z > 1.0)
-    //     shadow = 0.0;
-    
-    // return shadow;
+    // World size of a texel around the fragment, from how fast x moves across the tile;
+    // w scales it with distance under a spot light's perspective
+    vec2 texelSize = 1.0 / vec2(textureSize(shadowAtlas, 0));
+    float tileTexels = tileRect.z / texelSize.x;
+    float xScale = length(vec3(lightSpaceMatrix[0][0], lightSpaceMatrix[1][0], lightSpaceMatrix[2][0]));
+    float worldPerTexel = 2.0 * fragPosLightSpace.w / (xScale * tileTexels);
+    // Biasing in world space works the same for orthographic and perspective depth
+    vec4 biased = lightSpaceMatrix * vec4(FragPos + lightDir * slopeScaledBias(worldPerTexel, normal, lightDir), 1.0);
+    float reference = biased.z / biased.w * 0.5 + 0.5;
+
+    // Taps stay half a texel inside the tile so filtering never reads a neighbour
+    vec2 center = tileRect.xy + projCoords.xy * tileRect.z;
+#ifdef SHADOW_MOMENTS
+    // Perspective tiles hold moments of distance over the far plane
+    float depth = tileRect.w > 0.0 ? clamp(biased.w / tileRect.w, 0.0, 1.0) : reference;
+    return 0.7 * (1.0 - momentVisibility(lightSpaceMatrix, fragPosLightSpace, tileRect, center, depth));
+#else
+    vec2 tileMin = tileRect.xy + 0.5 * texelSize;
+    vec2 tileMax = tileRect.xy + tileRect.z - 0.5 * texelSize;
+    float rotation = shadowKernelRotation();
+    float lit = 0.0;
+    for (int i = 0; i < MAX_SHADOW_TAPS; ++i) {
+        if (i >= shadowFilterTaps) break;
+        vec2 offset = shadowFilterTaps > 1 ? vogelDiskTap(i, shadowFilterTaps, rotation) * shadowSoftness * texelSize : vec2(0.0);
+        lit += texture(shadowAtlas, vec3(clamp(center + offset, tileMin, tileMax), reference));
+    }
+    return 0.7 * (1.0 - lit / float(max(shadowFilterTaps, 1)));
+#endif
+}
+
+// Cascade covering this fragment's view depth, -1 past the last one
+int selectCascade(vec4 cascadeSplits, int cascadeCount) {
+    float viewDepth = -(view * vec4(FragPos, 1.0)).z;
+    for (int cascade = 0; cascade < MAX_CASCADES; ++cascade) {
+        if (cascade >= cascadeCount) break;
+        if (viewDepth <= cascadeSplits[cascade]) return cascade;
+    }
+    return -1;
 }
 
-// Get shadow factor for a light - fixed to pass correct sampler
+// Get shadow factor for a light from its entry in the shadow table
 float getShadowFactor(int lightIndex, vec3 normal, vec3 lightDir) {
-    for(int i = 0; i < int(numShadowMaps) && i < 4; i++) {
-        if(int(shadowMaps[i].lightIndex) == lightIndex) {
-            vec4 fragPosLightSpace = shadowMaps[i].lightSpaceMatrix * vec4(FragPos, 1.0);
-            
-            // Use the correct shadow map based on index
-            if(i == 0) return calculateShadow(fragPosLightSpace, shadowMap0, normal, lightDir);
-            else if(i == 1) return calculateShadow(fragPosLightSpace, shadowMap1, normal, lightDir);
-            else if(i == 2) return calculateShadow(fragPosLightSpace, shadowMap2, normal, lightDir);
-            else if(i == 3) return calculateShadow(fragPosLightSpace, shadowMap3, normal, lightDir);
-        }
+#ifdef HAS_SHADOWS
+    if (lightIndex >= shadowLightCount) return 0.0;
+    vec4 entry = texelFetch(shadowData, shadowDataBase + lightIndex * 2);
+    int cascade = selectCascade(texelFetch(shadowData, shadowDataBase + lightIndex * 2 + 1), int(entry.y));
+    if (cascade < 0) return 0.0;
+
+    int tile = shadowDataBase + shadowLightCount * 2 + (int(entry.x) + cascade) * 5;
+    mat4 lightSpaceMatrix = mat4(texelFetch(shadowData, tile), texelFetch(shadowData, tile + 1),
+                                 texelFetch(shadowData, tile + 2), texelFetch(shadowData, tile + 3));
+    return calculateShadow(lightSpaceMatrix, texelFetch(shadowData, tile + 4), normal, lightDir);
+#else
+    return 0.0;
+#endif
+}
+
+// Shadow factor of a point light from its cube. Face and coordinates follow GL's cube map
+// lookup, which is what ShadowAtlas::getPointLightMatrices renders. The cube is looked up
+// from where it was drawn, which trails the light while its redraw is deferred.
+float getPointShadowFactor(int lightIndex, vec3 normal, vec3 lightDir) {
+#ifdef HAS_SHADOWS
+    if (lightIndex >= shadowLightCount) return 0.0;
+    vec4 entry = texelFetch(shadowData, shadowDataBase + lightIndex * 2);
+    if (entry.z < 0.5) return 0.0;
+
+    vec3 toFragment = FragPos - texelFetch(shadowData, shadowDataBase + lightIndex * 2 + 1).xyz;
+    vec3 axis = abs(toFragment);
+    float face;
+    vec2 coords;
+    float major;
+    if (axis.x >= axis.y && axis.x >= axis.z) {
+        face = toFragment.x > 0.0 ? 0.0 : 1.0;
+        coords = vec2(toFragment.x > 0.0 ? -toFragment.z : toFragment.z, -toFragment.y);
+        major = axis.x;
+    } else if (axis.y >= axis.z) {
+        face = toFragment.y > 0.0 ? 2.0 : 3.0;
+        coords = vec2(toFragment.x, toFragment.y > 0.0 ? toFragment.z : -toFragment.z);
+        major = axis.y;
+    } else {
+        face = toFragment.z > 0.0 ? 4.0 : 5.0;
+        coords = vec2(toFragment.z > 0.0 ? toFragment.x : -toFragment.x, -toFragment.y);
+        major = axis.z;
+    }
+    vec2 uv = coords / major * 0.5 + 0.5;
+    float distance = length(toFragment);
+    if (distance > entry.w) return 0.0;
+
+    // A 90 degree face spans twice the distance to the light
+    float texelSize = 1.0 / float(textureSize(pointShadowMaps, 0).x);
+    float worldPerTexel = 2.0 * major * texelSize;
+    // Moving toward the light shortens the distance by exactly the bias
+    float reference = (distance - slopeScaledBias(worldPerTexel, normal, lightDir)) / entry.w;
+
+    // Taps are kept on their face; a kernel crossing an edge is clamped to it
+    float layer = (entry.z - 1.0) * 6.0 + face;
+    float rotation = shadowKernelRotation();
+    float lit = 0.0;
+    for (int i = 0; i < MAX_SHADOW_TAPS; ++i) {
+        if (i >= shadowFilterTaps) break;
+        vec2 offset = shadowFilterTaps > 1 ? vogelDiskTap(i, shadowFilterTaps, rotation) * shadowSoftness * texelSize : vec2(0.0);
+        vec2 tap = clamp(uv + offset, vec2(0.5 * texelSize), vec2(1.0 - 0.5 * texelSize));
+        lit += texture(pointShadowMaps, vec4(tap, layer, reference));
     }
-    return 0.0; // No shadow map found for this light
+    return 0.7 * (1.0 - lit / float(max(shadowFilterTaps, 1)));
+#else
+    return 0.0;
+#endif
 }
 
 // Updated lighting functions with shadow support
@@ -202,16 +374,15 @@ vec3 calculateDirectionalLight(DirectionalLight light, vec3 normal, vec3 viewDir
 }
 
 vec3 calculatePointLight(PointLight light, vec3 fragPos, vec3 normal, vec3 viewDir, vec3 baseColor, float metallic, float roughness, int lightIndex) {
-    if (!light.enabled) return vec3(0.0);
-    
     vec3 lightDir = normalize(light.position.xyz - fragPos);
     float distance = length(light.position.xyz - fragPos);
     
     // Attenuation
     float attenuation = 1.0 / (light.attenuation.x + light.attenuation.y * distance + light.attenuation.z * distance * distance);
+    attenuation *= rangeWindow(distance, light.position.w);
     
-    // Calculate shadow (point lights would need cube shadow mapping - simplified for now)
-    float shadow = 0.0; // getShadowFactor(lightIndex, normal, lightDir);
+    // Calculate shadow
+    float shadow = getPointShadowFactor(lightIndex, normal, lightDir);
     
     // Diffuse
     float diff = max(dot(normal, lightDir), 0.0);
@@ -230,8 +401,6 @@ vec3 calculatePointLight(PointLight light, vec3 fragPos, vec3 normal, vec3 viewD
 }
 
 vec3 calculateSpotLight(SpotLight light, vec3 fragPos, vec3 normal, vec3 viewDir, vec3 baseColor, float metallic, float roughness, int lightIndex) {
-    if (!light.enabled) return vec3(0.0);
-    
     vec3 lightDir = normalize(light.position.xyz - fragPos);
     float distance = length(light.position.xyz - fragPos);
     
@@ -242,6 +411,7 @@ vec3 calculateSpotLight(SpotLight light, vec3 fragPos, vec3 normal, vec3 viewDir
     
     // Attenuation
     float attenuation = 1.0 / (light.attenuation.x + light.attenuation.y * distance + light.attenuation.z * distance * distance);
+    attenuation *= rangeWindow(distance, light.position.w);
     
     // Calculate shadow
     float shadow = getShadowFactor(lightIndex, normal, lightDir);
@@ -263,6 +433,16 @@ vec3 calculateSpotLight(SpotLight light, vec3 fragPos, vec3 normal, vec3 viewDir
 }
 
 void main() {
+#ifdef SHADOW_MOMENTS
+    fragPosDx = dFdx(FragPos);
+    fragPosDy = dFdy(FragPos);
+#endif
+    vec4 baseColorFactor = texelFetch(materialData, MaterialIndex * 2);
+    vec4 materialParams = texelFetch(materialData, MaterialIndex * 2 + 1);
+    float metallicFactor = materialParams.x;
+    float roughnessFactor = materialParams.y;
+    float alphaCutoff = materialParams.z;
+
     // Sample base color texture
     vec4 baseColor = texture(baseColorTexture, TexCoord);
     
@@ -274,10 +454,11 @@ void main() {
         baseColor.rgb = vec3(0.2, 0.2, 0.2);
     }
     
-    // Handle alpha testing/blending
-    if (!useAlphaBlending && baseColor.a < alphaCutoff) {
+#ifdef ALPHA_MASK
+    if (baseColor.a < alphaCutoff) {
         discard;
     }
+#endif
     
     // Sample metallic-roughness texture
     vec4 metallicRoughness = texture(metallicRoughnessTexture, TexCoord);
@@ -294,25 +475,31 @@ void main() {
     
     // Get proper normal (with normal mapping)
     vec3 norm = getNormalFromMap();
-    vec3 viewDir = normalize(cameraPos - FragPos);
+    vec3 viewDir = normalize(cameraPos.xyz - FragPos);
     
     // Start with ambient light
     vec3 ambient = 0.3 * baseColor.rgb;
     vec3 lighting = ambient;
     
     // Add directional lights with shadows
-    for (int i = 0; i < int(numDirectionalLights) && i < 4; i++) {
-        lighting += calculateDirectionalLight(directionalLights[i], norm, viewDir, baseColor.rgb, metallic, roughness, i);
+    for (int i = 0; i < DIRECTIONAL_LIGHT_COUNT; i++) {
+        lighting += calculateDirectionalLight(directionalLights[i], norm, viewDir, baseColor.rgb, metallic, roughness, int(directionalLights[i].direction.w));
     }
     
-    // Add point lights with shadows
-    for (int i = 0; i < int(numPointLights) && i < 32; i++) {
-        lighting += calculatePointLight(pointLights[i], FragPos, norm, viewDir, baseColor.rgb, metallic, roughness, i);
+    // Only the point/spot lights assigned to this fragment's cluster
+    uvec2 cluster = texelFetch(clusterRecords, clusterBufferBase.y + getClusterIndex(FragPos)).xy;
+    int lightOffset = int(cluster.x);
+    int pointCount = int(cluster.y >> 16u);
+    int spotCount = int(cluster.y & 0xFFFFu);
+
+    for (int i = 0; i < pointCount; i++) {
+        PointLight light = fetchPointLight(int(texelFetch(clusterLightIndices, clusterBufferBase.z + lightOffset + i).r));
+        lighting += calculatePointLight(light, FragPos, norm, viewDir, baseColor.rgb, metallic, roughness, int(light.attenuation.w));
     }
     
-    // Add spot lights with shadows
-    for (int i = 0; i < int(numSpotLights) && i < 16; i++) {
-        lighting += calculateSpotLight(spotLights[i], FragPos, norm, viewDir, baseColor.rgb, metallic, roughness, i);
+    for (int i = pointCount; i < pointCount + spotCount; i++) {
+        SpotLight light = fetchSpotLight(int(texelFetch(clusterLightIndices, clusterBufferBase.z + lightOffset + i).r));
+        lighting += calculateSpotLight(light, FragPos, norm, viewDir, baseColor.rgb, metallic, roughness, int(light.attenuation.w));
     }
     
     // Apply ambient occlusion
@@ -324,4 +511,5 @@ void main() {
     
     // Output final color
     fragColor = vec4(finalColor, baseColor.a);
+    fragVelocity = (CurrentClip.xy / CurrentClip.w - PreviousClip.xy / PreviousClip.w) * 0.5;
 }
\ No newline at end of file
@@ -15,13 +15,40 @@ out vec3 Normal;
 out vec2 TexCoord;
 out vec3 Tangent;
 out vec3 Bitangent;
+flat out int MaterialIndex;
+// Unjittered clip positions of this and the previous frame, for the velocity buffer
+out vec4 CurrentClip;
+out vec4 PreviousClip;
 
-// Uniforms for transformation matrices
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+// Per-view data, uploaded once per pass (ObjectDataBuffer::updateView)
+layout(std140) uniform ViewBlock {
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    mat4 unjitteredViewProjection;
+    mat4 previousViewProjection;
+    vec4 cameraPos;
+};
+
+// 11 texels per object: model matrix columns, normal matrix columns (w of the first = material index),
+// then last frame's model matrix columns
+uniform samplerBuffer objectData;
+// Object indices of the instances that survived culling; this draw's start at instanceBase
+uniform usamplerBuffer instanceObjects;
+uniform int instanceBase;
 
 void main() {
+    int base = int(texelFetch(instanceObjects, instanceBase + gl_InstanceID).r) * 11;
+    mat4 model = mat4(texelFetch(objectData, base),
+                      texelFetch(objectData, base + 1),
+                      texelFetch(objectData, base + 2),
+                      texelFetch(objectData, base + 3));
+    vec4 normalColumn0 = texelFetch(objectData, base + 4);
+    mat3 normalMatrix = mat3(normalColumn0.xyz,
+                             texelFetch(objectData, base + 5).xyz,
+                             texelFetch(objectData, base + 6).xyz);
+    MaterialIndex = int(normalColumn0.w);
+
     // Transform vertex position
     FragPos = vec3(model * vec4(aPos, 1.0));
     
@@ -29,13 +56,18 @@ void main() {
     Color = aColor;
     TexCoord = aUV;
     
-    // Transform normal, tangent, and bitangent properly
-    mat3 normalMatrix = mat3(transpose(inverse(model)));
-    
+    // Transform normal, tangent, and bitangent with the precomputed inverse transpose
     Normal = normalize(normalMatrix * aNormal);
     Tangent = normalize(normalMatrix * aTangent);
     Bitangent = normalize(normalMatrix * aBitangent);
     
     // Final position for OpenGL
-    gl_Position = projection * view * vec4(FragPos, 1.0);
+    gl_Position = viewProjection * vec4(FragPos, 1.0);
+    // Both the camera and moving instances contribute motion
+    mat4 previousModel = mat4(texelFetch(objectData, base + 7),
+                              texelFetch(objectData, base + 8),
+                              texelFetch(objectData, base + 9),
+                              texelFetch(objectData, base + 10));
+    CurrentClip = unjitteredViewProjection * vec4(FragPos, 1.0);
+    PreviousClip = previousViewProjection * (previousModel * vec4(aPos, 1.0));
 }
\ No newline at end of file
@@ -0,0 +1,12 @@
+#version 330 core
+
+uniform vec3 lightPosition;
+uniform float farPlane;
+
+in vec3 worldPos;
+
+void main()
+{
+    // Linear distance to the light, so every face shares one depth scale
+    gl_FragDepth = length(worldPos - lightPosition) / farPlane;
+}
@@ -0,0 +1,23 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+
+// Same per-object data as shadow.vert; each visible instance entry also carries the cube
+// faces it overlaps in its top bits (see DrawViewRequest::faceCount)
+uniform samplerBuffer objectData;
+uniform usamplerBuffer instanceObjects;
+uniform int instanceBase;
+
+flat out int vFaceMask;
+
+void main()
+{
+    uint entry = texelFetch(instanceObjects, instanceBase + gl_InstanceID).r;
+    int base = int(entry & 0x3FFFFFFu) * 11;
+    mat4 model = mat4(texelFetch(objectData, base),
+                      texelFetch(objectData, base + 1),
+                      texelFetch(objectData, base + 2),
+                      texelFetch(objectData, base + 3));
+    vFaceMask = int(entry >> 26u);
+    // World space; the geometry shader projects into each face
+    gl_Position = model * vec4(aPos, 1.0);
+}
@@ -2,9 +2,18 @@
 layout (location = 0) in vec3 aPos;
 
 uniform mat4 lightSpaceMatrix;
-uniform mat4 model;
+
+// Same per-object data and visible instance list as default.vert (see ObjectDataBuffer)
+uniform samplerBuffer objectData;
+uniform usamplerBuffer instanceObjects;
+uniform int instanceBase;
 
 void main()
 {
+    int base = int(texelFetch(instanceObjects, instanceBase + gl_InstanceID).r) * 11;
+    mat4 model = mat4(texelFetch(objectData, base),
+                      texelFetch(objectData, base + 1),
+                      texelFetch(objectData, base + 2),
+                      texelFetch(objectData, base + 3));
     gl_Position = lightSpaceMatrix * model * vec4(aPos, 1.0);
 }
\ No newline at end of file
@@ -0,0 +1,87 @@
+#version 330 core
+
+// One pass of the separable blur that turns a shadow tile's depth into filterable EVSM
+// moments. The horizontal pass (MOMENTS_FROM_DEPTH) reads depth, warps each texel into
+// its moments and averages 2x2 depth texels per moment texel; the vertical pass blurs
+// those moments. Taps are clamped to the tile so neighbours never bleed in.
+
+out vec4 FragColor;
+
+#define MAX_BLUR_RADIUS 16
+// Depth texels per moment texel along each axis; matches ShadowMomentAtlas::DOWNSAMPLE
+#define DOWNSAMPLE 2
+// Warp exponents; the positive one is as large as 32-bit floats allow once squared.
+// Must match default.frag.
+#define EVSM_POSITIVE 40.0
+#define EVSM_NEGATIVE 5.0
+
+// Origin of the tile being written, and its size in moment texels
+uniform ivec2 targetOffset;
+uniform int tileTexels;
+// Where the source tile starts in its texture
+uniform ivec2 sourceOffset;
+uniform int blurRadius;
+#ifdef MOMENTS_FROM_DEPTH
+uniform sampler2D depthMap;
+// Planes of a perspective (spot) tile, whose depth is linearized first; far is 0 for
+// orthographic cascades, whose depth already is linear
+uniform float perspectiveNear;
+uniform float perspectiveFar;
+#else
+uniform sampler2D moments;
+#endif
+
+float gaussian(int offset) {
+    float sigma = max(0.5 * float(blurRadius), 0.5);
+    return exp(-float(offset * offset) / (2.0 * sigma * sigma));
+}
+
+#ifdef MOMENTS_FROM_DEPTH
+vec4 warpedMoments(float depth) {
+    if (perspectiveFar > 0.0) {
+        float ndc = depth * 2.0 - 1.0;
+        float distance = 2.0 * perspectiveNear * perspectiveFar /
+                         (perspectiveFar + perspectiveNear - ndc * (perspectiveFar - perspectiveNear));
+        depth = clamp(distance / perspectiveFar, 0.0, 1.0);
+    }
+    float positive = exp(EVSM_POSITIVE * (depth * 2.0 - 1.0));
+    float negative = -exp(-EVSM_NEGATIVE * (depth * 2.0 - 1.0));
+    return vec4(positive, positive * positive, negative, negative * negative);
+}
+
+// Moments of the 2x2 depth texels under one moment texel
+vec4 sourceMoments(ivec2 texel) {
+    ivec2 base = sourceOffset + texel * DOWNSAMPLE;
+    vec4 sum = vec4(0.0);
+    for (int y = 0; y < DOWNSAMPLE; ++y) {
+        for (int x = 0; x < DOWNSAMPLE; ++x) {
+            sum += warpedMoments(texelFetch(depthMap, base + ivec2(x, y), 0).r);
+        }
+    }
+    return sum / float(DOWNSAMPLE * DOWNSAMPLE);
+}
+#else
+vec4 sourceMoments(ivec2 texel) {
+    return texelFetch(moments, sourceOffset + texel, 0);
+}
+#endif
+
+void main() {
+    ivec2 texel = ivec2(gl_FragCoord.xy) - targetOffset;
+#ifdef MOMENTS_FROM_DEPTH
+    ivec2 direction = ivec2(1, 0);
+#else
+    ivec2 direction = ivec2(0, 1);
+#endif
+
+    vec4 sum = vec4(0.0);
+    float weightSum = 0.0;
+    for (int offset = -MAX_BLUR_RADIUS; offset <= MAX_BLUR_RADIUS; ++offset) {
+        if (offset < -blurRadius || offset > blurRadius) continue;
+        ivec2 tap = clamp(texel + direction * offset, ivec2(0), ivec2(tileTexels - 1));
+        float weight = gaussian(offset);
+        sum += sourceMoments(tap) * weight;
+        weightSum += weight;
+    }
+    FragColor = sum / weightSum;
+}
@@ -1,11 +1,15 @@
 #version  330 core
 
-out vec4 FragColor;
+layout(location = 0) out vec4 FragColor;
+layout(location = 1) out vec2 FragVelocity;
 
 in vec3 TexCoords;
+in vec4 CurrentClip;
+in vec4 PreviousClip;
 
 uniform samplerCube skybox;
 
 void main() {
     FragColor = texture(skybox, TexCoords);
+    FragVelocity = (CurrentClip.xy / CurrentClip.w - PreviousClip.xy / PreviousClip.w) * 0.5;
 }
\ No newline at end of file
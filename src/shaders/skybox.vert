@@ -3,12 +3,19 @@
 layout (location = 0) in vec3 aPos;
 
 out vec3 TexCoords;
+out vec4 CurrentClip;
+out vec4 PreviousClip;
 
 uniform mat4 projection;
 uniform mat4 view;
+// Full (unjittered) view-projections; w = 0 drops the translation, the sky is at infinity
+uniform mat4 unjitteredViewProjection;
+uniform mat4 previousViewProjection;
 
 void main() {
     TexCoords = aPos;
     vec4 pos = projection * view * vec4(aPos, 1.0);
     gl_Position = pos.xyww;
+    CurrentClip = unjitteredViewProjection * vec4(aPos, 0.0);
+    PreviousClip = previousViewProjection * vec4(aPos, 0.0);
 }
\ No newline at end of file
@@ -0,0 +1,74 @@
+#version 330 core
+
+in vec2 screenUV;
+out vec4 FragColor;
+
+uniform sampler2D currentColor;
+uniform sampler2D velocity;
+uniform sampler2D history;
+// This frame's and the previous frame's rendered region, in the lower left corner of
+// textureSize textures (dynamic resolution)
+uniform vec2 renderSize;
+uniform vec2 previousRenderSize;
+uniform vec2 textureSize;
+uniform float historyWeight;
+
+vec3 toYCoCg(vec3 rgb) {
+    return vec3(dot(rgb, vec3(0.25, 0.5, 0.25)),
+                dot(rgb, vec3(0.5, 0.0, -0.5)),
+                dot(rgb, vec3(-0.25, 0.5, -0.25)));
+}
+
+vec3 toRGB(vec3 ycocg) {
+    return vec3(ycocg.x + ycocg.y - ycocg.z,
+                ycocg.x + ycocg.z,
+                ycocg.x - ycocg.y - ycocg.z);
+}
+
+// Moves the history toward the box centre until it lies inside; unlike a per-channel
+// clamp this keeps its hue, which avoids the colour shifts of clamping
+vec3 clipToBox(vec3 boxMin, vec3 boxMax, vec3 color) {
+    vec3 center = 0.5 * (boxMax + boxMin);
+    vec3 extent = 0.5 * (boxMax - boxMin) + 1e-4;
+    vec3 offset = color - center;
+    vec3 units = abs(offset / extent);
+    float maxUnit = max(units.x, max(units.y, units.z));
+    return maxUnit > 1.0 ? center + offset / maxUnit : color;
+}
+
+void main() {
+    // The viewport is the rendered region, so fragment and scene pixels line up
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    ivec2 lastPixel = ivec2(renderSize) - 1;
+
+    vec3 current = texelFetch(currentColor, pixel, 0).rgb;
+    vec3 currentYCoCg = toYCoCg(current);
+    vec3 boxMin = currentYCoCg;
+    vec3 boxMax = currentYCoCg;
+    for (int y = -1; y <= 1; ++y) {
+        for (int x = -1; x <= 1; ++x) {
+            vec3 neighbour = toYCoCg(texelFetch(currentColor, clamp(pixel + ivec2(x, y), ivec2(0), lastPixel), 0).rgb);
+            boxMin = min(boxMin, neighbour);
+            boxMax = max(boxMax, neighbour);
+        }
+    }
+
+    vec2 uv = (vec2(pixel) + 0.5) / renderSize;
+    vec2 previousUV = uv - texelFetch(velocity, pixel, 0).xy;
+    float weight = historyWeight;
+    if (any(lessThan(previousUV, vec2(0.0))) || any(greaterThan(previousUV, vec2(1.0)))) {
+        // Came from off screen: nothing to reuse
+        weight = 0.0;
+    }
+
+    vec2 texel = 1.0 / textureSize;
+    vec2 historyUV = clamp(previousUV * previousRenderSize * texel, 0.5 * texel, (previousRenderSize - 0.5) * texel);
+    vec3 historyYCoCg = clipToBox(boxMin, boxMax, toYCoCg(texture(history, historyUV).rgb));
+
+    // Weighting by inverse luma keeps single bright samples from flickering through the blend
+    float currentWeight = (1.0 - weight) / (1.0 + currentYCoCg.x);
+    float historyBlend = weight / (1.0 + historyYCoCg.x);
+    vec3 resolved = (currentYCoCg * currentWeight + historyYCoCg * historyBlend) / max(currentWeight + historyBlend, 1e-5);
+
+    FragColor = vec4(max(toRGB(resolved), 0.0), 1.0);
+}
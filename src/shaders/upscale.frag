@@ -0,0 +1,38 @@
+#version 330 core
+
+in vec2 screenUV;
+out vec4 FragColor;
+
+uniform sampler2D sceneColor;
+// Pixels rendered this frame, in the lower left corner of a textureSize texture
+uniform vec2 renderSize;
+uniform vec2 textureSize;
+uniform float sharpness;
+
+vec3 fetch(vec2 uv, vec2 uvMin, vec2 uvMax) {
+    // Bilinear taps must not reach the stale pixels outside the rendered region
+    return texture(sceneColor, clamp(uv, uvMin, uvMax)).rgb;
+}
+
+void main() {
+    vec2 texel = 1.0 / textureSize;
+    vec2 uvMin = 0.5 * texel;
+    vec2 uvMax = (renderSize - 0.5) * texel;
+    vec2 uv = screenUV * renderSize * texel;
+
+    vec3 center = fetch(uv, uvMin, uvMax);
+    vec3 north = fetch(uv + vec2(0.0, texel.y), uvMin, uvMax);
+    vec3 south = fetch(uv - vec2(0.0, texel.y), uvMin, uvMax);
+    vec3 east = fetch(uv + vec2(texel.x, 0.0), uvMin, uvMax);
+    vec3 west = fetch(uv - vec2(texel.x, 0.0), uvMin, uvMax);
+
+    // Contrast-adaptive sharpening: the negative lobe shrinks where the neighbourhood
+    // already spans the full range, so edges get crisper without ringing or clipping
+    vec3 low = min(center, min(min(north, south), min(east, west)));
+    vec3 high = max(center, max(max(north, south), max(east, west)));
+    vec3 amount = sqrt(clamp(min(low, 1.0 - high) / max(high, 1e-4), 0.0, 1.0));
+    vec3 weight = -amount * mix(0.125, 0.2, sharpness);
+    vec3 color = (center + (north + south + east + west) * weight) / (1.0 + 4.0 * weight);
+
+    FragColor = vec4(sharpness > 0.0 ? clamp(color, 0.0, 1.0) : center, 1.0);
+}
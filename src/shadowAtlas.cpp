@@ -0,0 +1,296 @@
+#include "shadowAtlas.h"
+#include "error.h"
+#include "glState.h"
+#include "log.h"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+namespace {
+
+// Even bits of a Z-order index, packed
+unsigned int compactBits(unsigned int value) {
+    value &= 0x55555555u;
+    value = (value | (value >> 1)) & 0x33333333u;
+    value = (value | (value >> 2)) & 0x0F0F0F0Fu;
+    value = (value | (value >> 4)) & 0x00FF00FFu;
+    value = (value | (value >> 8)) & 0x0000FFFFu;
+    return value;
+}
+
+} // namespace
+
+ShadowCacheKey::ShadowCacheKey(const Light& light, uint64_t casterGeneration, const glm::mat4& lightSpaceMatrix,
+                               const ShadowAtlasRect& rect)
+    : lightType(light.getType()), casterGeneration(casterGeneration), lightSpaceMatrix(lightSpaceMatrix), rect(rect) {
+    const LightProperties& props = light.getProperties();
+    direction = props.direction;
+    range = props.range;
+    if (lightType != LightType::Directional) {
+        position = props.position;
+    }
+    if (lightType == LightType::Spot) {
+        outerCutoff = props.outerCutoff;
+    }
+}
+
+bool ShadowCacheKey::operator==(const ShadowCacheKey& other) const {
+    return lightType == other.lightType && position == other.position && direction == other.direction &&
+           outerCutoff == other.outerCutoff && range == other.range && casterGeneration == other.casterGeneration &&
+           lightSpaceMatrix == other.lightSpaceMatrix && rect == other.rect;
+}
+
+ShadowAtlas::ShadowAtlas(unsigned int size)
+    : atlasSize(std::max(size, static_cast<unsigned int>(MIN_TILE_SIZE))), framebuffer(0), depthMap(0), compositeFramebuffer(0), compositeMap(0),
+      compositeActive(false) {
+    createDepthTexture(depthMap, framebuffer);
+    getGLState().bindFramebuffer(0);
+    checkGLError("Unbind shadow framebuffer");
+}
+
+ShadowAtlas::~ShadowAtlas() {
+    deleteDepthTexture(depthMap, framebuffer);
+    deleteDepthTexture(compositeMap, compositeFramebuffer);
+}
+
+void ShadowAtlas::createDepthTexture(GLuint& texture, GLuint& textureFramebuffer) {
+    glGenTextures(1, &texture);
+    getGLState().bindTexture(0, GL_TEXTURE_2D, texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, atlasSize, atlasSize, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+
+    float borderColor[] = { 1.0f, 1.0f, 1.0f, 1.0f };
+    glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, borderColor);
+    // Sampled through sampler2DShadow: every lookup is a depth comparison, filtered
+    // bilinearly over 2x2 texels by the hardware
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+
+    checkGLError("Create shadow atlas texture");
+
+    glGenFramebuffers(1, &textureFramebuffer);
+    getGLState().bindFramebuffer(textureFramebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, texture, 0);
+    glDrawBuffer(GL_NONE);
+    glReadBuffer(GL_NONE);
+
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        LOG_ERROR(Shadow, "Shadow atlas framebuffer is not complete");
+    }
+}
+
+void ShadowAtlas::deleteDepthTexture(GLuint& texture, GLuint& textureFramebuffer) {
+    if (texture != 0) {
+        getGLState().textureDeleted(texture);
+        glDeleteTextures(1, &texture);
+        texture = 0;
+    }
+    if (textureFramebuffer != 0) {
+        getGLState().framebufferDeleted(textureFramebuffer);
+        glDeleteFramebuffers(1, &textureFramebuffer);
+        textureFramebuffer = 0;
+    }
+}
+
+bool ShadowAtlas::allocate(const std::vector<unsigned int>& sizes, std::vector<ShadowAtlasRect>& rects) const {
+    rects.assign(sizes.size(), ShadowAtlasRect());
+
+    // Largest first, so every tile starts on a multiple of its own area along the curve
+    std::vector<size_t> order(sizes.size());
+    for (size_t i = 0; i < order.size(); ++i) {
+        order[i] = i;
+    }
+    std::stable_sort(order.begin(), order.end(), [&sizes](size_t a, size_t b) { return sizes[a] > sizes[b]; });
+
+    uint64_t units = atlasSize / MIN_TILE_SIZE;
+    uint64_t cursor = 0;
+    for (size_t index : order) {
+        uint64_t tileUnits = std::max(sizes[index], static_cast<unsigned int>(MIN_TILE_SIZE)) / MIN_TILE_SIZE;
+        if (cursor + tileUnits * tileUnits > units * units) {
+            rects.assign(sizes.size(), ShadowAtlasRect());
+            return false;
+        }
+        unsigned int curve = static_cast<unsigned int>(cursor);
+        rects[index].x = compactBits(curve) * MIN_TILE_SIZE;
+        rects[index].y = compactBits(curve >> 1) * MIN_TILE_SIZE;
+        rects[index].size = static_cast<unsigned int>(tileUnits) * MIN_TILE_SIZE;
+        cursor += tileUnits * tileUnits;
+    }
+    return true;
+}
+
+void ShadowAtlas::setTileViewport(const ShadowAtlasRect& rect) {
+    GLStateCache& state = getGLState();
+    state.viewport(rect.x, rect.y, rect.size, rect.size);
+    // Clearing and drawing depth need depth writes on
+    state.depthMask(true);
+}
+
+void ShadowAtlas::bindTile(const ShadowAtlasRect& rect) {
+    getGLState().bindFramebuffer(framebuffer);
+    setTileViewport(rect);
+    // The scissor test isn't tracked by the state cache and is off everywhere else
+    glEnable(GL_SCISSOR_TEST);
+    glScissor(rect.x, rect.y, rect.size, rect.size);
+    glClear(GL_DEPTH_BUFFER_BIT);
+    glDisable(GL_SCISSOR_TEST);
+    LOG_TRACE(Shadow, "Shadow tile: %u at (%u, %u)", rect.size, rect.x, rect.y);
+}
+
+void ShadowAtlas::beginComposite() {
+    if (compositeMap == 0) {
+        createDepthTexture(compositeMap, compositeFramebuffer);
+        LOG_DEBUG(Shadow, "Created %ux%u composite shadow atlas for dynamic casters", atlasSize, atlasSize);
+    }
+
+    GLStateCache& state = getGLState();
+    state.bindFramebuffer(compositeFramebuffer);
+    state.depthMask(true);
+    // The read binding isn't tracked by the state cache; only the draw binding is
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+    glBlitFramebuffer(0, 0, atlasSize, atlasSize, 0, 0, atlasSize, atlasSize, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, compositeFramebuffer);
+    compositeActive = true;
+}
+
+void ShadowAtlas::bindCompositeTile(const ShadowAtlasRect& rect) {
+    getGLState().bindFramebuffer(compositeFramebuffer);
+    setTileViewport(rect);
+}
+
+void ShadowAtlas::unbind() {
+    getGLState().bindFramebuffer(0);
+}
+
+void ShadowAtlas::bindTexture(unsigned int unit) {
+    getGLState().bindTexture(unit, GL_TEXTURE_2D, getDepthMap());
+}
+
+size_t ShadowAtlas::getBytes() const {
+    // Depth24 is stored in 32 bits
+    size_t bytes = static_cast<size_t>(atlasSize) * atlasSize * 4;
+    return compositeMap != 0 ? bytes * 2 : bytes;
+}
+
+glm::mat4 ShadowAtlas::getSpotLightMatrix(const Light& light, float nearPlane, float farPlane) {
+    if(light.getType() != LightType::Spot) {
+        std::cerr << "getSpotLightMatrix is only valid for spot lights." << std::endl;
+        return glm::mat4(1.0f);
+    }
+
+    const LightProperties& props = light.getProperties();
+
+    float fov = glm::radians(props.outerCutoff * 2.0f);
+    glm::mat4 lightProjection = glm::perspective(fov, 1.0f, nearPlane, farPlane);
+
+    glm::vec3 target = props.position + props.direction;
+    glm::mat4 lightView = glm::lookAt(props.position, target, glm::vec3(0.0f, 1.0f, 0.0f));
+    return lightProjection * lightView;
+}
+
+std::vector<glm::mat4> ShadowAtlas::getPointLightMatrices(const Light& light, float nearPlane, float farPlane) {
+    if(light.getType() != LightType::Point) {
+        std::cerr << "getPointLightMatrices is only valid for point lights." << std::endl;
+        return {};
+    }
+    return getPointLightMatrices(light.getProperties().position, nearPlane, farPlane);
+}
+
+std::vector<glm::mat4> ShadowAtlas::getPointLightMatrices(const glm::vec3& position, float nearPlane, float farPlane) {
+    glm::mat4 shadowProj = glm::perspective(glm::radians(90.0f), 1.0f, nearPlane, farPlane);
+
+    std::vector<glm::mat4> shadowTransforms;
+    shadowTransforms.push_back(shadowProj * glm::lookAt(position, position + glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f)));
+    shadowTransforms.push_back(shadowProj * glm::lookAt(position, position + glm::vec3(-1.0f, 0.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f)));
+    shadowTransforms.push_back(shadowProj * glm::lookAt(position, position + glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f)));
+    shadowTransforms.push_back(shadowProj * glm::lookAt(position, position + glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, 0.0f, -1.0f)));
+    shadowTransforms.push_back(shadowProj * glm::lookAt(position, position + glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, -1.0f, 0.0f)));
+    shadowTransforms.push_back(shadowProj * glm::lookAt(position, position + glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, -1.0f, 0.0f)));
+
+    return shadowTransforms;
+}
+
+glm::mat4 ShadowAtlas::getCascadeMatrix(const Light& light, unsigned int tileSize, const glm::vec3& sliceCenter,
+                                        float sliceRadius, const glm::vec3& casterCenter, float casterRadius) {
+    if (light.getType() != LightType::Directional) {
+        return glm::mat4(1.0f);
+    }
+
+    glm::vec3 lightDir = glm::normalize(light.getProperties().direction);
+    glm::vec3 up = glm::vec3(0.0f, 1.0f, 0.0f);
+    if (glm::abs(glm::dot(lightDir, up)) > 0.95f) {
+        up = glm::vec3(1.0f, 0.0f, 0.0f);
+    }
+    // Rotation only: translating with the camera would move texel boundaries every frame
+    glm::mat4 lightView = glm::lookAt(glm::vec3(0.0f), lightDir, up);
+
+    glm::vec3 center = glm::vec3(lightView * glm::vec4(sliceCenter, 1.0f));
+    float texel = 2.0f * sliceRadius / tileSize;
+    center.x = std::floor(center.x / texel) * texel;
+    center.y = std::floor(center.y / texel) * texel;
+
+    // The light looks down -z, so larger z is closer to it
+    float nearZ = center.z + sliceRadius;
+    float farZ = center.z - sliceRadius;
+    if (casterRadius > 0.0f) {
+        float casterZ = (lightView * glm::vec4(casterCenter, 1.0f)).z;
+        nearZ = std::max(nearZ, casterZ + casterRadius);
+        farZ = std::min(farZ, casterZ - casterRadius);
+    }
+    // Coarse steps keep the depth range, and with it the matrix, fixed while the slice
+    // moves inside the caster sphere
+    float depthStep = sliceRadius * 0.25f;
+    nearZ = std::ceil(nearZ / depthStep) * depthStep;
+    farZ = std::floor(farZ / depthStep) * depthStep;
+
+    LOG_TRACE(Shadow, "Cascade: radius %.2f, snapped center (%.2f, %.2f), depth [%.2f, %.2f]",
+              sliceRadius, center.x, center.y, -nearZ, -farZ);
+
+    glm::mat4 lightProjection = glm::ortho(center.x - sliceRadius, center.x + sliceRadius,
+                                           center.y - sliceRadius, center.y + sliceRadius, -nearZ, -farZ);
+    return lightProjection * lightView;
+}
+
+glm::mat4 ShadowAtlas::getLightSpaceMatrixForBounds(const Light& light, const glm::vec3& sceneMin, const glm::vec3& sceneMax) {
+    if (light.getType() != LightType::Directional) {
+        return glm::mat4(1.0f);
+    }
+
+    const LightProperties& props = light.getProperties();
+    glm::vec3 lightDir = glm::normalize(props.direction);
+    
+    // Calculate scene center and size
+    glm::vec3 sceneCenter = (sceneMin + sceneMax) * 0.5f;
+    glm::vec3 sceneSize = sceneMax - sceneMin;
+    float sceneRadius = glm::length(sceneSize) * 0.5f;
+    
+    LOG_TRACE(Shadow, "Bounds-based shadow: dir (%.3f, %.3f, %.3f), center (%.2f, %.2f, %.2f), radius %.2f",
+              lightDir.x, lightDir.y, lightDir.z, sceneCenter.x, sceneCenter.y, sceneCenter.z, sceneRadius);
+    
+    // Position light
+    float lightDistance = sceneRadius * 2.0f;
+    glm::vec3 lightPos = sceneCenter - lightDir * lightDistance;
+    
+    // Create up vector
+    glm::vec3 up = glm::vec3(0.0f, 1.0f, 0.0f);
+    if (glm::abs(glm::dot(lightDir, up)) > 0.95f) {
+        up = glm::vec3(1.0f, 0.0f, 0.0f);
+    }
+    
+    // Create matrices
+    glm::mat4 lightView = glm::lookAt(lightPos, sceneCenter, up);
+    
+    // Use scene bounds for orthographic projection
+    float padding = sceneRadius * 0.1f; // 10% padding
+    glm::mat4 lightProjection = glm::ortho(
+        -sceneRadius - padding, sceneRadius + padding,
+        -sceneRadius - padding, sceneRadius + padding,
+        0.1f, lightDistance + sceneRadius + padding
+    );
+    
+    return lightProjection * lightView;
+}
@@ -0,0 +1,119 @@
+// shadowAtlas.h - Every shadow map packed into one depth texture
+#ifndef SHADOW_ATLAS_H
+#define SHADOW_ATLAS_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <cstdint>
+#include <vector>
+#include "shader.h"
+#include "light.h"
+#include "camera.h"
+
+// A square tile of the atlas, in texels
+struct ShadowAtlasRect {
+    unsigned int x = 0;
+    unsigned int y = 0;
+    unsigned int size = 0;
+
+    bool operator==(const ShadowAtlasRect& other) const {
+        return x == other.x && y == other.y && size == other.size;
+    }
+    bool operator!=(const ShadowAtlasRect& other) const { return !(*this == other); }
+};
+
+// Everything a cached shadow tile was rendered from. The tile is drawn again as soon as
+// any of it differs; light color and intensity don't affect depth and are left out.
+struct ShadowCacheKey {
+    LightType lightType = LightType::Directional;
+    // Position is ignored for directional lights, the cone for all but spot lights
+    glm::vec3 position = glm::vec3(0.0f);
+    glm::vec3 direction = glm::vec3(0.0f);
+    float outerCutoff = 0.0f;
+    float range = 0.0f;
+    // Scene's static caster generation
+    uint64_t casterGeneration = 0;
+    glm::mat4 lightSpaceMatrix = glm::mat4(1.0f);
+    // Moving to another tile leaves the depth behind
+    ShadowAtlasRect rect;
+
+    ShadowCacheKey() {}
+    ShadowCacheKey(const Light& light, uint64_t casterGeneration, const glm::mat4& lightSpaceMatrix,
+                   const ShadowAtlasRect& rect);
+
+    bool operator==(const ShadowCacheKey& other) const;
+    bool operator!=(const ShadowCacheKey& other) const { return !(*this == other); }
+};
+
+// One square depth texture holding the shadow maps of every shadowed light, one tile per
+// cascade or spot light, with a single framebuffer. Tiles are power-of-two squares packed
+// largest first along a Z-order curve, which fills the atlas without gaps for any set of
+// sizes whose area fits. The atlas only holds static casters, so unchanged tiles keep their
+// depth across frames; when the scene has dynamic casters a second atlas gets a copy of it
+// with them drawn on top each frame, and that is the one the main pass samples.
+class ShadowAtlas {
+public:
+    static const unsigned int DEFAULT_SIZE = 4096;
+    static const unsigned int MIN_TILE_SIZE = 128;
+
+    explicit ShadowAtlas(unsigned int size = DEFAULT_SIZE);
+    ~ShadowAtlas();
+
+    ShadowAtlas(const ShadowAtlas&) = delete;
+    ShadowAtlas& operator=(const ShadowAtlas&) = delete;
+
+    // Places power-of-two tiles of at least MIN_TILE_SIZE, in the order given. False if
+    // their total area is larger than the atlas.
+    bool allocate(const std::vector<unsigned int>& sizes, std::vector<ShadowAtlasRect>& rects) const;
+
+    // Binds the static atlas with the viewport on one tile and clears the tile
+    void bindTile(const ShadowAtlasRect& rect);
+    void unbind();
+    // Binds the atlas the main pass should sample: the composite if it was written this
+    // frame, otherwise the static atlas
+    void bindTexture(unsigned int unit);
+
+    // Starts a frame: the static atlas is sampled until the composite is begun
+    void beginFrame() { compositeActive = false; }
+    // Copies the static atlas into the composite; every tile is then drawn over with
+    // bindCompositeTile()
+    void beginComposite();
+    void bindCompositeTile(const ShadowAtlasRect& rect);
+
+    // Ortho matrix of a cascade around a bounding sphere of its frustum slice. The light
+    // view has a fixed orientation and the center is snapped to whole texels of a tile of
+    // tileSize, so the matrix only changes in texel steps and edges don't shimmer as the
+    // camera moves. Depth covers both the slice and the caster sphere, so off-screen
+    // casters still land.
+    static glm::mat4 getCascadeMatrix(const Light& light, unsigned int tileSize, const glm::vec3& sliceCenter,
+                                      float sliceRadius, const glm::vec3& casterCenter, float casterRadius);
+
+    // Alternative using explicit bounds
+    static glm::mat4 getLightSpaceMatrixForBounds(const Light& light, const glm::vec3& sceneMin, const glm::vec3& sceneMax);
+
+    static std::vector<glm::mat4> getPointLightMatrices(const Light& light, float nearPlane = 0.1f, float farPlane = 100.0f);
+    // The same faces around any position, such as where a cached cube was drawn from
+    static std::vector<glm::mat4> getPointLightMatrices(const glm::vec3& position, float nearPlane, float farPlane);
+    static glm::mat4 getSpotLightMatrix(const Light& light, float nearPlane = 0.1f, float farPlane = 100.0f);
+
+    GLuint getDepthMap() const { return compositeActive ? compositeMap : depthMap; }
+    unsigned int getSize() const { return atlasSize; }
+    // Both atlases, once the composite exists
+    size_t getBytes() const;
+
+private:
+    unsigned int atlasSize;
+    GLuint framebuffer;
+    GLuint depthMap;
+    // Static depth plus dynamic casters; allocated on first use
+    GLuint compositeFramebuffer;
+    GLuint compositeMap;
+    bool compositeActive;
+
+    void createDepthTexture(GLuint& texture, GLuint& textureFramebuffer);
+    void deleteDepthTexture(GLuint& texture, GLuint& textureFramebuffer);
+    void setTileViewport(const ShadowAtlasRect& rect);
+};
+
+#endif
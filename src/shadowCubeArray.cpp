@@ -0,0 +1,127 @@
+#include "shadowCubeArray.h"
+#include "error.h"
+#include "glState.h"
+#include "log.h"
+#include <algorithm>
+
+ShadowCubeArray::ShadowCubeArray(unsigned int faceSize, int capacity)
+    : faceSize(faceSize), capacity(std::max(capacity, 1)), depthArray(0), framebuffer(0), compositeArray(0),
+      compositeFramebuffer(0), layerFramebuffer(0), copyFramebuffer(0), compositeActive(false) {
+    createDepthArray(depthArray, framebuffer);
+
+    // Depth-only framebuffers, re-attached one layer at a time
+    GLStateCache& state = getGLState();
+    glGenFramebuffers(1, &layerFramebuffer);
+    glGenFramebuffers(1, &copyFramebuffer);
+    state.bindFramebuffer(copyFramebuffer);
+    glDrawBuffer(GL_NONE);
+    glReadBuffer(GL_NONE);
+    state.bindFramebuffer(layerFramebuffer);
+    glDrawBuffer(GL_NONE);
+    glReadBuffer(GL_NONE);
+    state.bindFramebuffer(0);
+    checkGLError("Create shadow cube array");
+
+    LOG_DEBUG(Shadow, "Created shadow cube array: %d cubes of %u^2", this->capacity, faceSize);
+}
+
+ShadowCubeArray::~ShadowCubeArray() {
+    deleteDepthArray(depthArray, framebuffer);
+    deleteDepthArray(compositeArray, compositeFramebuffer);
+    GLStateCache& state = getGLState();
+    state.framebufferDeleted(layerFramebuffer);
+    state.framebufferDeleted(copyFramebuffer);
+    glDeleteFramebuffers(1, &layerFramebuffer);
+    glDeleteFramebuffers(1, &copyFramebuffer);
+}
+
+void ShadowCubeArray::createDepthArray(GLuint& texture, GLuint& layeredFramebuffer) {
+    glGenTextures(1, &texture);
+    getGLState().bindTexture(0, GL_TEXTURE_2D_ARRAY, texture);
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT24, faceSize, faceSize, capacity * FACES, 0,
+                 GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    // Lookups never leave their face; the edge keeps filtering from wrapping to the other side
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    // Compared in the sampler like the atlas (sampler2DArrayShadow)
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+
+    checkGLError("Create shadow cube texture");
+
+    glGenFramebuffers(1, &layeredFramebuffer);
+    getGLState().bindFramebuffer(layeredFramebuffer);
+    // Attaching the whole array makes gl_Layer select the face
+    glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, texture, 0);
+    glDrawBuffer(GL_NONE);
+    glReadBuffer(GL_NONE);
+
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        LOG_ERROR(Shadow, "Shadow cube framebuffer is not complete");
+    }
+}
+
+void ShadowCubeArray::deleteDepthArray(GLuint& texture, GLuint& layeredFramebuffer) {
+    if (texture != 0) {
+        getGLState().textureDeleted(texture);
+        glDeleteTextures(1, &texture);
+        texture = 0;
+    }
+    if (layeredFramebuffer != 0) {
+        getGLState().framebufferDeleted(layeredFramebuffer);
+        glDeleteFramebuffers(1, &layeredFramebuffer);
+        layeredFramebuffer = 0;
+    }
+}
+
+void ShadowCubeArray::bindCube(int cube) {
+    GLStateCache& state = getGLState();
+    state.bindFramebuffer(layerFramebuffer);
+    state.viewport(0, 0, faceSize, faceSize);
+    state.depthMask(true);
+    for (int face = 0; face < FACES; ++face) {
+        glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depthArray, 0, cube * FACES + face);
+        glClear(GL_DEPTH_BUFFER_BIT);
+    }
+    state.bindFramebuffer(framebuffer);
+    LOG_TRACE(Shadow, "Shadow cube %d", cube);
+}
+
+void ShadowCubeArray::beginComposite(const std::vector<int>& cubes) {
+    if (compositeArray == 0) {
+        createDepthArray(compositeArray, compositeFramebuffer);
+        LOG_DEBUG(Shadow, "Created composite shadow cube array for dynamic casters");
+    }
+
+    GLStateCache& state = getGLState();
+    state.bindFramebuffer(layerFramebuffer);
+    state.depthMask(true);
+    // The read binding isn't tracked by the state cache; only the draw binding is
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, copyFramebuffer);
+    for (int cube : cubes) {
+        for (int face = 0; face < FACES; ++face) {
+            int layer = cube * FACES + face;
+            glFramebufferTextureLayer(GL_READ_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depthArray, 0, layer);
+            glFramebufferTextureLayer(GL_DRAW_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, compositeArray, 0, layer);
+            glBlitFramebuffer(0, 0, faceSize, faceSize, 0, 0, faceSize, faceSize, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+        }
+    }
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, layerFramebuffer);
+
+    state.bindFramebuffer(compositeFramebuffer);
+    state.viewport(0, 0, faceSize, faceSize);
+    compositeActive = true;
+}
+
+void ShadowCubeArray::bindTexture(unsigned int unit) {
+    getGLState().bindTexture(unit, GL_TEXTURE_2D_ARRAY, compositeActive ? compositeArray : depthArray);
+}
+
+size_t ShadowCubeArray::getBytes() const {
+    // Depth24 is stored in 32 bits
+    size_t bytes = static_cast<size_t>(faceSize) * faceSize * 4 * capacity * FACES;
+    return compositeArray != 0 ? bytes * 2 : bytes;
+}
@@ -0,0 +1,59 @@
+// shadowCubeArray.h - Depth cube maps of point-light shadows
+#ifndef SHADOW_CUBE_ARRAY_H
+#define SHADOW_CUBE_ARRAY_H
+
+#include <glad/glad.h>
+#include <cstddef>
+#include <vector>
+
+// Depth cube maps of every shadowed point light, holding distance to the light over its
+// far plane. GL 3.3 has no cube map arrays, so cube n is layers 6n..6n+5 of one 2D array
+// texture, in +X, -X, +Y, -Y, +Z, -Z order, and default.frag picks the face itself. A
+// layered framebuffer takes a whole cube in one pass with the geometry shader choosing
+// the layer. Like ShadowAtlas it only holds static casters; a composite copy gets the
+// dynamic ones drawn on top each frame.
+class ShadowCubeArray {
+public:
+    static const unsigned int DEFAULT_FACE_SIZE = 512;
+    static const int FACES = 6;
+
+    ShadowCubeArray(unsigned int faceSize, int capacity);
+    ~ShadowCubeArray();
+
+    ShadowCubeArray(const ShadowCubeArray&) = delete;
+    ShadowCubeArray& operator=(const ShadowCubeArray&) = delete;
+
+    // Clears one cube's faces and binds the static array for a layered draw
+    void bindCube(int cube);
+    // Binds the array the main pass should sample: the composite if it was written this
+    // frame, otherwise the static array
+    void bindTexture(unsigned int unit);
+
+    // Starts a frame: the static array is sampled until the composite is begun
+    void beginFrame() { compositeActive = false; }
+    // Copies the listed cubes into the composite and binds it for layered drawing
+    void beginComposite(const std::vector<int>& cubes);
+
+    unsigned int getFaceSize() const { return faceSize; }
+    int getCapacity() const { return capacity; }
+    // Both arrays, once the composite exists
+    size_t getBytes() const;
+
+private:
+    unsigned int faceSize;
+    int capacity;
+    GLuint depthArray;
+    GLuint framebuffer;
+    // Static depth plus dynamic casters; allocated on first use
+    GLuint compositeArray;
+    GLuint compositeFramebuffer;
+    // Single-layer attachments: clearing a layered framebuffer would clear every cube
+    GLuint layerFramebuffer;
+    GLuint copyFramebuffer;
+    bool compositeActive;
+
+    void createDepthArray(GLuint& texture, GLuint& layeredFramebuffer);
+    void deleteDepthArray(GLuint& texture, GLuint& layeredFramebuffer);
+};
+
+#endif
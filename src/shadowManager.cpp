@@ -1,7 +1,132 @@
 #include "shadowManager.h"
 #include "scene.h"
+#include "error.h"
+#include "glState.h"
+#include "gpuProfiler.h"
+#include "cpuProfiler.h"
+#include "frustum.h"
+#include "log.h"
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+#include <glm/gtc/type_ptr.hpp>
 
-ShadowManager::ShadowManager() : shadowBias(0.005f), shadowSoftness(1.0f) {
+namespace {
+
+// Near plane of point-light cube faces
+const float POINT_SHADOW_NEAR = 0.05f;
+// Depth range of spot light tiles; moments linearize their depth between these
+const float SPOT_SHADOW_NEAR = 0.1f;
+const float SPOT_SHADOW_FAR = 100.0f;
+
+// View-space far distance of cascade index + 1 of count: the "practical" split scheme,
+// blending logarithmic splits (even texel density in perspective) with uniform ones
+float cascadeSplit(int index, int count, float nearPlane, float farPlane, float lambda) {
+    float fraction = static_cast<float>(index + 1) / count;
+    float logarithmic = nearPlane * std::pow(farPlane / nearPlane, fraction);
+    float uniform = nearPlane + (farPlane - nearPlane) * fraction;
+    return lambda * logarithmic + (1.0f - lambda) * uniform;
+}
+
+// Smallest sphere around the camera frustum between two view distances. It depends only
+// on the distances and the projection, never on the camera's rotation, so cascade size
+// and texel size stay fixed while looking around.
+void frustumSliceSphere(const Camera& camera, float sliceNear, float sliceFar, glm::vec3& center, float& radius) {
+    float tanHalfFov = std::tan(glm::radians(camera.getFov()) * 0.5f);
+    float aspect = camera.getAspectRatio();
+    // Squared slope of the frustum's corner edges against the view axis
+    float k2 = tanHalfFov * tanHalfFov * (1.0f + aspect * aspect);
+    float distance;
+    if (k2 >= (sliceFar - sliceNear) / (sliceFar + sliceNear)) {
+        // Wide slices are bounded by the far cap alone
+        distance = sliceFar;
+        radius = sliceFar * std::sqrt(k2);
+    } else {
+        distance = 0.5f * (sliceFar + sliceNear) * (1.0f + k2);
+        radius = 0.5f * std::sqrt((sliceFar - sliceNear) * (sliceFar - sliceNear) +
+                                  2.0f * (sliceFar * sliceFar + sliceNear * sliceNear) * k2 +
+                                  (sliceFar + sliceNear) * (sliceFar + sliceNear) * k2 * k2);
+    }
+    center = camera.getPosition() + glm::normalize(camera.getFront()) * distance;
+}
+
+// Screen-space importance of a local light: the projected size of its range sphere
+// against the screen height, 1 with the camera inside it, 0 entirely off screen
+float localLightImportance(const Light& light, const Camera& camera, const Frustum& frustum) {
+    const LightProperties& props = light.getProperties();
+    // The same range light clustering culls with
+    float range = std::min(light.calculateRange(), props.range);
+    glm::vec3 extent(range);
+    if (!frustum.intersectsAABB(props.position - extent, props.position + extent)) {
+        return 0.0f;
+    }
+    float distance = glm::length(props.position - camera.getPosition());
+    if (distance <= range) {
+        return 1.0f;
+    }
+    float tanHalfFov = std::tan(glm::radians(camera.getFov()) * 0.5f);
+    return std::min(1.0f, range / (distance * tanHalfFov));
+}
+
+// Whether a tile's cached depth still holds for key: unchanged, or only behind on static
+// caster changes that stayed out of a local light's reach. Nothing past the lit range can
+// shadow a lit point, so changes there leave the depth as good as new.
+bool reuseCachedTile(const Light& light, const Scene& scene, bool valid, ShadowCacheKey& cached, const ShadowCacheKey& key) {
+    if (!valid) return false;
+    if (cached == key) return true;
+    if (light.getType() == LightType::Directional) return false;
+
+    ShadowCacheKey current = cached;
+    current.casterGeneration = key.casterGeneration;
+    if (current != key) return false;
+    const LightProperties& props = light.getProperties();
+    glm::vec3 reach(std::min(light.calculateRange(), props.range));
+    if (scene.casterChangesIntersect(cached.casterGeneration, props.position - reach, props.position + reach)) {
+        return false;
+    }
+    cached = key;
+    return true;
+}
+
+// Whether a map's cached depth is out of date for key, and why. Depth in another place,
+// or none at all, can't stand in for the new one; anything else can, a while longer.
+bool staleShadowMap(const Light& light, const Scene& scene, bool valid, ShadowCacheKey& cached,
+                    const ShadowCacheKey& key, ShadowUpdateReason& reason) {
+    if (reuseCachedTile(light, scene, valid, cached, key)) return false;
+    if (!valid || cached.rect != key.rect) {
+        reason = ShadowUpdateReason::Invalid;
+        return true;
+    }
+    ShadowCacheKey sameCasters = cached;
+    sameCasters.casterGeneration = key.casterGeneration;
+    reason = sameCasters == key ? ShadowUpdateReason::Casters : ShadowUpdateReason::Light;
+    return true;
+}
+
+// How near a local light is to the camera against its range: 1 with the camera inside it,
+// halving by the time the camera is another range further out
+float localLightProximity(const Light& light, const Camera& camera) {
+    const LightProperties& props = light.getProperties();
+    float range = std::max(std::min(light.calculateRange(), props.range), 1e-3f);
+    float outside = std::max(0.0f, glm::length(props.position - camera.getPosition()) - range);
+    return range / (range + outside);
+}
+
+int log2Floor(unsigned int value) {
+    int level = 0;
+    while (value > 1) {
+        value >>= 1;
+        level++;
+    }
+    return level;
+}
+
+} // namespace
+
+ShadowManager::ShadowManager(DynamicUploadRing& uploads)
+    : uploads(uploads), atlasSize(ShadowAtlas::DEFAULT_SIZE), filterMode(ShadowFilterMode::PCF),
+      lightBleedReduction(0.2f), momentBlurRadius(-1), momentsComposited(false), shadowDataBase(0),
+      shadowTableLights(0), shadowBias(1.0f), shadowSoftness(1.0f) {
     sceneCenter = glm::vec3(0.0f);
     sceneRadius = 50.0f;
 }
@@ -10,12 +135,66 @@ ShadowManager::ShadowManager() : shadowBias(0.005f), shadowSoftness(1.0f) {
 ShadowManager::~ShadowManager() {
 }
 
-void ShadowManager::addShadowMap(size_t lightIndex, LightType lightType, unsigned int width, unsigned int height) {
+void ShadowManager::addShadowMap(size_t lightIndex, LightType lightType, unsigned int resolution) {
     if (findShadowMap(lightIndex)) {
         std::cerr << "Shadow map for light index " << lightIndex << " already exists." << std::endl;
         return;
     }
-    shadowMaps.emplace_back(lightIndex, lightType, width, height);
+    int cascades = lightType == LightType::Directional ? cascadeSettings.count : 1;
+    shadowMaps.emplace_back(lightIndex, lightType, resolution, cascades);
+}
+
+void ShadowManager::setCascadeSettings(const CascadeSettings& settings) {
+    cascadeSettings = settings;
+    cascadeSettings.count = std::max(1, std::min(settings.count, MAX_SHADOW_CASCADES));
+    for (ShadowMapInfo& shadowInfo : shadowMaps) {
+        if (shadowInfo.lightType != LightType::Directional) continue;
+        shadowInfo.cascadeCount = cascadeSettings.count;
+        // New splits mean new matrices anyway; this just makes it explicit
+        for (bool& valid : shadowInfo.tileValid) {
+            valid = false;
+        }
+    }
+}
+
+int ShadowManager::getShadowFilterTaps() const {
+    if (shadowSoftness <= 0.0f) {
+        return 1;
+    }
+    // Each bilinear tap covers about two texels of the disk, so the kernel stays as dense
+    // as it grows; a few taps at least to have something to spread
+    float area = 3.14159265f * shadowSoftness * shadowSoftness;
+    int taps = static_cast<int>(std::ceil(area * 0.5f));
+    return std::max(4, std::min(taps, MAX_SHADOW_FILTER_TAPS));
+}
+
+void ShadowManager::setPointShadowShader(const std::string& vertexPath, const std::string& geometryPath,
+                                         const std::string& fragmentPath) {
+    cubeShader = std::make_unique<Shader>(vertexPath.c_str(), geometryPath.c_str(), fragmentPath.c_str(), "");
+}
+
+void ShadowManager::setFilterMode(ShadowFilterMode mode) {
+    filterMode = mode;
+    if (mode == ShadowFilterMode::PCF) {
+        momentAtlas.reset();
+    }
+}
+
+void ShadowManager::setMomentShader(const std::string& vertexPath, const std::string& fragmentPath) {
+    momentsShader = std::make_unique<Shader>(vertexPath.c_str(), fragmentPath.c_str(), "#define MOMENTS_FROM_DEPTH 1\n");
+    momentBlurShader = std::make_unique<Shader>(vertexPath.c_str(), fragmentPath.c_str(), "");
+}
+
+void ShadowManager::setAtlasSize(unsigned int size) {
+    if (size == atlasSize) return;
+    atlasSize = size;
+    atlas.reset();
+    momentAtlas.reset();
+    for (ShadowMapInfo& shadowInfo : shadowMaps) {
+        for (bool& valid : shadowInfo.tileValid) {
+            valid = false;
+        }
+    }
 }
 
 void ShadowManager::removeShadowMap(size_t lightIndex) {
@@ -55,31 +234,27 @@ void ShadowManager::bindShadowMapsForRendering(Shader& shader) {
     
     shader.setFloat("shadowBias", shadowBias);
     shader.setFloat("shadowSoftness", shadowSoftness);
+    shader.setInt("shadowFilterTaps", getShadowFilterTaps());
+    shader.setInt("shadowLightCount", atlas ? shadowTableLights : 0);
+    if (!atlas) return;
 
-    int shadowMapCount = 0;
-    
-    for (const auto& shadowInfo : shadowMaps) {
-        if (!shadowInfo.enabled || shadowMapCount >= 4) {
-            continue;
-        }
-        
-        // Bind to texture units 10, 11, 12, 13 for shadow maps
-        int textureUnit = 10 + shadowMapCount;
-        shadowInfo.shadowBuffer->bindTexture(textureUnit);
-        
-        // Set the uniform for the specific shadow map sampler
-        std::string samplerName = "shadowMap" + std::to_string(shadowMapCount);
-        shader.setFloat(samplerName.c_str(), static_cast<float>(textureUnit));
-        
-        std::string uniformBase = "shadowMaps[" + std::to_string(shadowMapCount) + "]";
-        shader.setFloat((uniformBase + ".textureUnit").c_str(), static_cast<float>(textureUnit));
-        shader.setFloat((uniformBase + ".lightIndex").c_str(), static_cast<float>(shadowInfo.lightIndex));
-        shader.setMat4((uniformBase + ".lightSpaceMatrix").c_str(), glm::value_ptr(shadowInfo.lightSpaceMatrix));
+    atlas->bindTexture(SHADOW_ATLAS_UNIT);
+    getGLState().bindTexture(SHADOW_DATA_UNIT, GL_TEXTURE_BUFFER, uploads.getTextureView(GL_RGBA32F));
+    shader.setInt("shadowAtlas", SHADOW_ATLAS_UNIT);
+    shader.setInt("shadowData", SHADOW_DATA_UNIT);
+    shader.setInt("shadowDataBase", shadowDataBase);
 
-        shadowMapCount++;
+    if (cubeMaps) {
+        cubeMaps->bindTexture(POINT_SHADOW_UNIT);
     }
+    // Set even without cubes so the sampler never shares a unit with another type
+    shader.setInt("pointShadowMaps", POINT_SHADOW_UNIT);
 
-    shader.setFloat("numShadowMaps", static_cast<float>(shadowMapCount));
+    if (momentAtlas) {
+        momentAtlas->bindTexture(SHADOW_MOMENT_UNIT);
+        shader.setInt("shadowMoments", SHADOW_MOMENT_UNIT);
+        shader.setFloat("lightBleedReduction", lightBleedReduction);
+    }
 }
 
 
@@ -93,108 +268,582 @@ const char* getLightTypeName(LightType type) {
 }
 
 
-void ShadowManager::renderShadowMaps(const LightManager& lightManager, Scene& scene, Shader& shadowShader, const Camera& camera) {
-    // Save current OpenGL state
-    GLint viewport[4];
-    glGetIntegerv(GL_VIEWPORT, viewport);
-    GLint currentProgram;
-    glGetIntegerv(GL_CURRENT_PROGRAM, &currentProgram);
-    
-    std::cout << "Starting shadow map rendering with camera..." << std::endl;
+void ShadowManager::assignTiles(const LightManager& lightManager, const Camera& camera) {
+    PROFILE_ZONE("Shadow atlas");
+    Frustum frustum(camera.getProjectionMatrix() * camera.getViewMatrix());
+    const int minLevel = log2Floor(ShadowAtlas::MIN_TILE_SIZE);
+    const int maxLevel = log2Floor(atlasSize);
 
-    for(auto& shadowInfo : shadowMaps) {
-        if(!shadowInfo.enabled || shadowInfo.lightIndex >= lightManager.getLightCount()) {
-            continue;
+    // Ideal sizes from importance, with a little hysteresis so a light near the boundary
+    // between two sizes doesn't flip back and forth and lose its cached tiles
+    uint64_t totalArea = 0;
+    for (ShadowMapInfo& shadowInfo : shadowMaps) {
+        shadowInfo.tileCount = 0;
+        shadowInfo.tileSize = 0;
+        shadowInfo.importance = 0.0f;
+        if (!shadowInfo.enabled || shadowInfo.lightIndex >= lightManager.getLightCount()) continue;
+        const Light& light = lightManager.getLight(shadowInfo.lightIndex);
+        if (!light.getProperties().enabled) continue;
+
+        switch (light.getType()) {
+            case LightType::Directional:
+                // Cascades are already sized to their slice of the view
+                shadowInfo.importance = 1.0f;
+                shadowInfo.tileCount = shadowInfo.cascadeCount;
+                break;
+            case LightType::Spot:
+                shadowInfo.importance = localLightImportance(light, camera, frustum);
+                shadowInfo.tileCount = shadowInfo.importance > 0.0f ? 1 : 0;
+                break;
+            case LightType::Point:
+                // Cubes, given out by assignCubes()
+                break;
         }
+        if (shadowInfo.tileCount == 0) continue;
 
-        const Light& light = lightManager.getLight(shadowInfo.lightIndex);
-        if(!light.getProperties().enabled) {
-            continue;
+        float ideal = std::log2(std::max(1.0f, shadowInfo.resolution * shadowInfo.importance));
+        if (shadowInfo.sizeLevel < 0 || std::fabs(ideal - shadowInfo.sizeLevel) > 0.75f) {
+            shadowInfo.sizeLevel = static_cast<int>(std::lround(ideal));
         }
+        int level = std::max(minLevel, std::min(shadowInfo.sizeLevel, std::min(maxLevel, log2Floor(shadowInfo.resolution))));
+        shadowInfo.tileSize = 1u << level;
+        totalArea += static_cast<uint64_t>(shadowInfo.tileSize) * shadowInfo.tileSize * shadowInfo.tileCount;
+    }
 
-        std::cout << "Rendering shadow for light " << shadowInfo.lightIndex << std::endl;
+    // Most important first; at equal importance cascaded lights, which cover the whole
+    // view, come before local ones
+    std::vector<ShadowMapInfo*> ranked;
+    for (ShadowMapInfo& shadowInfo : shadowMaps) {
+        if (shadowInfo.tileCount > 0) ranked.push_back(&shadowInfo);
+    }
+    std::stable_sort(ranked.begin(), ranked.end(), [](const ShadowMapInfo* a, const ShadowMapInfo* b) {
+        if (a->importance != b->importance) return a->importance > b->importance;
+        return a->tileCount > b->tileCount;
+    });
+    std::vector<unsigned int> wanted;
+    for (const ShadowMapInfo* shadowInfo : ranked) {
+        wanted.push_back(shadowInfo->tileSize);
+    }
 
-        shadowShader.activate();
+    // Halve the least important lights until everything fits; drop lights already at the
+    // smallest size if that is not enough
+    uint64_t atlasArea = static_cast<uint64_t>(atlasSize) * atlasSize;
+    while (totalArea > atlasArea) {
+        ShadowMapInfo* shrink = nullptr;
+        ShadowMapInfo* drop = nullptr;
+        for (auto it = ranked.rbegin(); it != ranked.rend(); ++it) {
+            if ((*it)->tileCount == 0) continue;
+            if (!drop) drop = *it;
+            if ((*it)->tileSize > ShadowAtlas::MIN_TILE_SIZE) {
+                shrink = *it;
+                break;
+            }
+        }
+        uint64_t lightArea = 0;
+        if (shrink) {
+            lightArea = static_cast<uint64_t>(shrink->tileSize) * shrink->tileSize * shrink->tileCount;
+            shrink->tileSize /= 2;
+            totalArea -= lightArea - lightArea / 4;
+        } else {
+            totalArea -= static_cast<uint64_t>(drop->tileSize) * drop->tileSize * drop->tileCount;
+            drop->tileCount = 0;
+            drop->tileSize = 0;
+            renderStats.droppedLights++;
+        }
+    }
+
+    // Shrinking an important light can free more than the others needed, so hand the
+    // space back in order of importance
+    for (size_t i = 0; i < ranked.size(); ++i) {
+        ShadowMapInfo& shadowInfo = *ranked[i];
+        while (shadowInfo.tileCount > 0 && shadowInfo.tileSize < wanted[i]) {
+            uint64_t growth = static_cast<uint64_t>(shadowInfo.tileSize) * shadowInfo.tileSize * shadowInfo.tileCount * 3;
+            if (totalArea + growth > atlasArea) break;
+            shadowInfo.tileSize *= 2;
+            totalArea += growth;
+        }
+    }
+
+    std::vector<unsigned int> sizes;
+    for (const ShadowMapInfo& shadowInfo : shadowMaps) {
+        for (int tile = 0; tile < shadowInfo.tileCount; ++tile) {
+            sizes.push_back(shadowInfo.tileSize);
+        }
+    }
+    std::vector<ShadowAtlasRect> rects;
+    atlas->allocate(sizes, rects);
+
+    size_t next = 0;
+    for (ShadowMapInfo& shadowInfo : shadowMaps) {
+        for (int tile = 0; tile < shadowInfo.tileCount; ++tile) {
+            shadowInfo.rects[tile] = rects[next++];
+        }
+        if (shadowInfo.tileCount > 0) {
+            renderStats.shadowedLights++;
+        }
+    }
+    renderStats.atlasUsage = static_cast<float>(static_cast<double>(totalArea) / atlasArea);
+}
+
+void ShadowManager::assignCubes(const LightManager& lightManager, const Camera& camera) {
+    Frustum frustum(camera.getProjectionMatrix() * camera.getViewMatrix());
+    std::vector<ShadowMapInfo*> ranked;
+    for (ShadowMapInfo& shadowInfo : shadowMaps) {
+        if (shadowInfo.lightType != LightType::Point) continue;
+        if (cubeShader && shadowInfo.enabled && shadowInfo.lightIndex < lightManager.getLightCount()) {
+            const Light& light = lightManager.getLight(shadowInfo.lightIndex);
+            if (light.getProperties().enabled && light.getType() == LightType::Point) {
+                shadowInfo.importance = localLightImportance(light, camera, frustum);
+            }
+        }
+        if (shadowInfo.importance > 0.0f) {
+            ranked.push_back(&shadowInfo);
+        } else {
+            shadowInfo.cubeSlot = -1;
+        }
+    }
+    std::stable_sort(ranked.begin(), ranked.end(), [](const ShadowMapInfo* a, const ShadowMapInfo* b) {
+        return a->importance > b->importance;
+    });
+    if (ranked.size() > static_cast<size_t>(MAX_SHADOW_CUBES)) {
+        for (size_t i = MAX_SHADOW_CUBES; i < ranked.size(); ++i) {
+            ranked[i]->cubeSlot = -1;
+            renderStats.droppedLights++;
+        }
+        ranked.resize(MAX_SHADOW_CUBES);
+    }
+    if (ranked.empty()) return;
+
+    // Grown in powers of two; the cached cubes go with the old array
+    int needed = static_cast<int>(ranked.size());
+    if (!cubeMaps || cubeMaps->getCapacity() < needed) {
+        int capacity = 1;
+        while (capacity < needed) {
+            capacity *= 2;
+        }
+        cubeMaps = std::make_unique<ShadowCubeArray>(static_cast<unsigned int>(ShadowCubeArray::DEFAULT_FACE_SIZE),
+                                                     std::min(capacity, MAX_SHADOW_CUBES));
+        for (ShadowMapInfo& shadowInfo : shadowMaps) {
+            shadowInfo.cubeSlot = -1;
+        }
+    }
+
+    // Lights keep their cube while they stay shadowed; the rest take free ones
+    std::vector<bool> used(cubeMaps->getCapacity(), false);
+    for (const ShadowMapInfo* shadowInfo : ranked) {
+        if (shadowInfo->cubeSlot >= 0) used[shadowInfo->cubeSlot] = true;
+    }
+    int next = 0;
+    for (ShadowMapInfo* shadowInfo : ranked) {
+        if (shadowInfo->cubeSlot >= 0) continue;
+        while (used[next]) {
+            next++;
+        }
+        shadowInfo->cubeSlot = next;
+        shadowInfo->tileValid[0] = false;
+        used[next] = true;
+    }
+    renderStats.shadowedLights += needed;
+}
+
+void ShadowManager::renderShadowMaps(const LightManager& lightManager, Scene& scene, Shader& shadowShader, const Camera& camera) {
+    // The state cache knows the camera viewport, so nothing is read back from the driver
+    GLStateCache& state = getGLState();
+    const GLint* cachedViewport = state.getViewport();
+    GLint viewport[4] = { cachedViewport[0], cachedViewport[1], cachedViewport[2], cachedViewport[3] };
+    GLuint target = state.getFramebuffer();
+    
+    renderStats = ShadowRenderStats();
+    if (!atlas) {
+        atlas = std::make_unique<ShadowAtlas>(atlasSize);
+    }
+    if (filterMode == ShadowFilterMode::Moments && momentsShader && !momentAtlas) {
+        momentAtlas = std::make_unique<ShadowMomentAtlas>(atlasSize);
+        for (ShadowMapInfo& shadowInfo : shadowMaps) {
+            for (bool& valid : shadowInfo.momentsValid) {
+                valid = false;
+            }
+        }
+    }
+    atlas->beginFrame();
+    if (cubeMaps) {
+        cubeMaps->beginFrame();
+    }
+    assignTiles(lightManager, camera);
+    assignCubes(lightManager, camera);
 
+    // Every map's matrices and cache state first, so the scheduler can rank all the stale
+    // ones before any is drawn
+    scheduler.beginFrame();
+    for (ShadowMapInfo& shadowInfo : shadowMaps) {
+        if (shadowInfo.tileCount == 0 && shadowInfo.cubeSlot < 0) continue;
+        const Light& light = lightManager.getLight(shadowInfo.lightIndex);
         switch (light.getType()) {
             case LightType::Directional:
-                renderDirectionalLightShadow(light, scene, shadowShader, shadowInfo, camera);
+                updateCascadeMatrices(light, scene, shadowInfo, camera);
                 break;
             case LightType::Spot:
-                renderSpotLightShadow(light, scene, shadowShader, shadowInfo, camera);
+                updateSpotLightMatrix(light, shadowInfo, camera);
                 break;
             case LightType::Point:
-                renderPointLightShadow(light, scene, shadowShader, shadowInfo, camera);
+                queueShadowCube(light, scene, shadowInfo, camera);
                 break;
         }
-        
-        shadowShader.deactivate();
-        
-        GLenum error = glGetError();
-        if (error != GL_NO_ERROR) {
-            std::cerr << "OpenGL error after shadow light " << shadowInfo.lightIndex << ": " << error << std::endl;
+        for (int tile = 0; tile < shadowInfo.tileCount; ++tile) {
+            queueShadowTile(light, scene, shadowInfo, tile, camera);
         }
     }
+    scheduler.schedule();
+    // Every view is culled in one go on the draw list workers, then only replayed here
+    queueShadowViews(lightManager, scene);
+    scene.buildDrawLists();
+    applySchedule(lightManager, scene, shadowShader);
 
-    // Restore OpenGL state
-    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
-    glUseProgram(currentProgram);
-    
-    std::cout << "Shadow map rendering complete." << std::endl;
+    if (scene.hasDynamicCasters() && renderStats.shadowedLights > 0) {
+        GpuProfileScope gpuScope("Shadow dynamic");
+        compositeDynamicCasters(scene, shadowShader);
+    }
+    if (momentAtlas) {
+        GpuProfileScope gpuScope("Shadow moments");
+        filterMoments();
+    }
+    uploadShadowTable(lightManager);
+
+    LOG_DEBUG(Shadow, "Shadow atlas: %d lights (%d dropped), %.0f%% used; %d tiles rendered, %d cached, %d composited, "
+              "%d filtered, %d deferred; %d cubes rendered, %d cached, %d composited, %d deferred",
+              renderStats.shadowedLights, renderStats.droppedLights, renderStats.atlasUsage * 100.0f,
+              renderStats.tilesRendered, renderStats.tilesCached, renderStats.tilesComposited, renderStats.tilesFiltered,
+              renderStats.tilesDeferred, renderStats.cubesRendered, renderStats.cubesCached, renderStats.cubesComposited,
+              renderStats.cubesDeferred);
+
+    // The main pass binds its own programs; only its target and viewport need restoring
+    state.bindFramebuffer(target);
+    state.viewport(viewport[0], viewport[1], viewport[2], viewport[3]);
 }
 
-void ShadowManager::renderDirectionalLightShadow(const Light& light, Scene& scene, Shader& shadowShader, ShadowMapInfo& shadowMapInfo, const Camera& camera) {
-    std::cout << "=== Rendering Directional Light Shadow ===" << std::endl;
-    
-    // Calculate light space matrix using the camera
-    shadowMapInfo.lightSpaceMatrix = shadowMapInfo.shadowBuffer->getLightSpaceMatrix(light, camera);
-    
-    // Bind shadow framebuffer
-    shadowMapInfo.shadowBuffer->bind();
-    
-    // Clear and setup for shadow rendering
-    glClear(GL_DEPTH_BUFFER_BIT);
-    glCullFace(GL_FRONT); // Reduce shadow acne
-    
-    // Set shadow shader uniforms
-    shadowShader.setMat4("lightSpaceMatrix", glm::value_ptr(shadowMapInfo.lightSpaceMatrix));
-    
-    // Render each model for shadows
-    int modelCount = 0;
-    for(const Model& model : scene.getModels()) {
-        shadowShader.setMat4("model", glm::value_ptr(model.getModelMatrix()));
-        const_cast<Model&>(model).drawGeometryOnly();
-        modelCount++;
+void ShadowManager::updateCascadeMatrices(const Light& light, Scene& scene, ShadowMapInfo& shadowMapInfo, const Camera& camera) {
+    PROFILE_ZONE("Shadow matrices");
+    glm::vec3 casterCenter;
+    float casterRadius;
+    scene.getCasterSphere(casterCenter, casterRadius);
+
+    float nearPlane = camera.getNearPlane();
+    float farPlane = camera.getFarPlane();
+    if (cascadeSettings.maxDistance > 0.0f) {
+        farPlane = std::min(farPlane, cascadeSettings.maxDistance);
+    }
+
+    float sliceNear = nearPlane;
+    shadowMapInfo.cascadeSplits = glm::vec4(farPlane);
+    for (int cascade = 0; cascade < shadowMapInfo.cascadeCount; ++cascade) {
+        float sliceFar = cascadeSplit(cascade, shadowMapInfo.cascadeCount, nearPlane, farPlane, cascadeSettings.splitLambda);
+        glm::vec3 center;
+        float radius;
+        frustumSliceSphere(camera, sliceNear, sliceFar, center, radius);
+        // Rounded up so float noise between camera rotations never changes the texel size
+        radius = std::ceil(radius * 16.0f) / 16.0f;
+        // Distant cascades have wide margins and large texels, so they mostly stay cached
+        // while the near ones follow the camera
+        float margin = cascade > 0 ? radius * cascadeSettings.cacheMargin : 0.0f;
+        if (!shadowMapInfo.anchored[cascade] || glm::length(center - shadowMapInfo.cascadeAnchors[cascade]) > margin) {
+            shadowMapInfo.cascadeAnchors[cascade] = center;
+            shadowMapInfo.anchored[cascade] = true;
+            // The old depth no longer covers the slice, so it can't wait for a later frame
+            shadowMapInfo.tileValid[cascade] = false;
+        }
+        shadowMapInfo.lightSpaceMatrices[cascade] = ShadowAtlas::getCascadeMatrix(light, shadowMapInfo.tileSize,
+                                                                                  shadowMapInfo.cascadeAnchors[cascade],
+                                                                                  radius + margin, casterCenter, casterRadius);
+        shadowMapInfo.cascadeSplits[cascade] = sliceFar;
+        sliceNear = sliceFar;
     }
-    
-    std::cout << "Rendered " << modelCount << " models to shadow map" << std::endl;
-    
-    // Restore face culling
-    glCullFace(GL_BACK);
-    
-    // Unbind shadow framebuffer
-    shadowMapInfo.shadowBuffer->unbind();
 }
 
-void ShadowManager::renderSpotLightShadow(const Light& light, Scene& scene, Shader& shadowShader, ShadowMapInfo& shadowInfo, const Camera& camera) {
+void ShadowManager::updateSpotLightMatrix(const Light& light, ShadowMapInfo& shadowInfo, const Camera& camera) {
     // For spot lights, we can still use the existing method since it doesn't depend on scene bounds as much
-    shadowInfo.lightSpaceMatrix = shadowInfo.shadowBuffer->getSpotLightMatrix(light);
-    
-    shadowInfo.shadowBuffer->bind();
-    glClear(GL_DEPTH_BUFFER_BIT);
-    glCullFace(GL_FRONT);
-    
-    shadowShader.setMat4("lightSpaceMatrix", glm::value_ptr(shadowInfo.lightSpaceMatrix));
-    
-    for(const Model& model : scene.getModels()) {
-        shadowShader.setMat4("model", glm::value_ptr(model.getModelMatrix()));
-        const_cast<Model&>(model).drawGeometryOnly();
+    shadowInfo.lightSpaceMatrices[0] = ShadowAtlas::getSpotLightMatrix(light, SPOT_SHADOW_NEAR, SPOT_SHADOW_FAR);
+    // A single cascade covering everything
+    shadowInfo.cascadeSplits = glm::vec4(camera.getFarPlane());
+}
+
+void ShadowManager::queueShadowTile(const Light& light, const Scene& scene, ShadowMapInfo& shadowInfo, int tile,
+                                    const Camera& camera) {
+    ShadowCacheKey key(light, scene.getCasterGeneration(), shadowInfo.lightSpaceMatrices[tile], shadowInfo.rects[tile]);
+    ShadowUpdate update;
+    if (!staleShadowMap(light, scene, shadowInfo.tileValid[tile], shadowInfo.tileKeys[tile], key, update.reason)) {
+        shadowInfo.framesWaiting[tile] = 0;
+        renderStats.tilesCached++;
+        return;
     }
-    
-    glCullFace(GL_BACK);
-    shadowInfo.shadowBuffer->unbind();
+    update.lightIndex = shadowInfo.lightIndex;
+    update.tile = tile;
+    update.coverage = shadowInfo.importance;
+    // Near cascades hold the most visible texels
+    update.proximity = light.getType() == LightType::Directional ? 1.0f / (1.0f + tile) : localLightProximity(light, camera);
+    update.framesWaiting = shadowInfo.framesWaiting[tile];
+    update.cost = shadowInfo.updateCost[tile];
+    scheduler.add(update);
+}
+
+void ShadowManager::queueShadowCube(const Light& light, const Scene& scene, ShadowMapInfo& shadowInfo, const Camera& camera) {
+    // The first face's matrix covers the position and far plane; a new cube slot clears tileValid
+    float farPlane = std::min(light.calculateRange(), light.getProperties().range);
+    ShadowAtlasRect faceRect;
+    faceRect.size = cubeMaps->getFaceSize();
+    ShadowCacheKey key(light, scene.getCasterGeneration(),
+                       ShadowAtlas::getPointLightMatrices(light, POINT_SHADOW_NEAR, farPlane)[0], faceRect);
+    ShadowUpdate update;
+    if (!staleShadowMap(light, scene, shadowInfo.tileValid[0], shadowInfo.tileKeys[0], key, update.reason)) {
+        shadowInfo.framesWaiting[0] = 0;
+        renderStats.cubesCached++;
+        return;
+    }
+    update.lightIndex = shadowInfo.lightIndex;
+    update.tile = -1;
+    update.coverage = shadowInfo.importance;
+    update.proximity = localLightProximity(light, camera);
+    update.framesWaiting = shadowInfo.framesWaiting[0];
+    update.cost = shadowInfo.updateCost[0];
+    scheduler.add(update);
+}
+
+void ShadowManager::queueShadowViews(const LightManager& lightManager, Scene& scene) {
+    PROFILE_ZONE("Shadow views");
+    for (ShadowMapInfo& shadowInfo : shadowMaps) {
+        std::fill(std::begin(shadowInfo.staticViews), std::end(shadowInfo.staticViews), -1);
+        std::fill(std::begin(shadowInfo.dynamicViews), std::end(shadowInfo.dynamicViews), -1);
+    }
+
+    for (const ShadowUpdate& update : scheduler.getUpdates()) {
+        ShadowMapInfo& shadowInfo = *findShadowMap(update.lightIndex);
+        int slot = std::max(update.tile, 0);
+        if (!update.scheduled) {
+            // Deferred maps are sampled the way their depth was drawn: with the old matrix
+            // the shadows stay on their casters, only a few frames behind the light
+            shadowInfo.framesWaiting[slot]++;
+            if (update.tile < 0) {
+                renderStats.cubesDeferred++;
+            } else {
+                shadowInfo.lightSpaceMatrices[slot] = shadowInfo.tileKeys[slot].lightSpaceMatrix;
+                renderStats.tilesDeferred++;
+            }
+            continue;
+        }
+        shadowInfo.framesWaiting[slot] = 0;
+        if (update.tile < 0) {
+            const Light& light = lightManager.getLight(update.lightIndex);
+            // Nothing past the lit range can shadow a lit point, so depth only has to reach it
+            shadowInfo.farPlane = std::min(light.calculateRange(), light.getProperties().range);
+            shadowInfo.cubeOrigin = light.getProperties().position;
+            std::vector<glm::mat4> faces = ShadowAtlas::getPointLightMatrices(shadowInfo.cubeOrigin, POINT_SHADOW_NEAR,
+                                                                              shadowInfo.farPlane);
+            shadowInfo.staticViews[0] = scene.addCubeShadowView(faces.data(), ShadowCasters::Static);
+        } else {
+            shadowInfo.staticViews[slot] = scene.addShadowView(shadowInfo.lightSpaceMatrices[slot], ShadowCasters::Static);
+        }
+    }
+
+    // Dynamic casters go over every map, with the matrices it is sampled with
+    if (!scene.hasDynamicCasters()) return;
+    for (ShadowMapInfo& shadowInfo : shadowMaps) {
+        for (int tile = 0; tile < shadowInfo.tileCount; ++tile) {
+            shadowInfo.dynamicViews[tile] = scene.addShadowView(shadowInfo.lightSpaceMatrices[tile], ShadowCasters::Dynamic);
+        }
+        if (shadowInfo.cubeSlot >= 0 && cubeShader) {
+            std::vector<glm::mat4> faces = ShadowAtlas::getPointLightMatrices(shadowInfo.cubeOrigin, POINT_SHADOW_NEAR,
+                                                                              shadowInfo.farPlane);
+            shadowInfo.dynamicViews[0] = scene.addCubeShadowView(faces.data(), ShadowCasters::Dynamic);
+        }
+    }
+}
+
+void ShadowManager::applySchedule(const LightManager& lightManager, Scene& scene, Shader& shadowShader) {
+    PROFILE_ZONE("Shadow updates");
+    const std::vector<ShadowUpdate>& updates = scheduler.getUpdates();
+    bool anyScheduled = std::any_of(updates.begin(), updates.end(), [](const ShadowUpdate& update) {
+        return update.scheduled;
+    });
+    if (!anyScheduled) return;
+
+    // Only frames that redraw something are timed, which is what the scheduler's
+    // millisecond budget divides by
+    GpuProfileScope updatesScope("Shadow updates");
+    for (const ShadowUpdate& update : updates) {
+        if (!update.scheduled) continue;
+        ShadowMapInfo& shadowInfo = *findShadowMap(update.lightIndex);
+        const Light& light = lightManager.getLight(update.lightIndex);
+        LOG_TRACE(Shadow, "Rendering shadow for light %zu", update.lightIndex);
+        GpuProfileScope gpuScope("Shadow " + std::to_string(update.lightIndex));
+        size_t triangles;
+        if (update.tile < 0) {
+            PROFILE_ZONE("Shadow cube");
+            cubeShader->activate();
+            triangles = renderPointLightShadow(light, scene, shadowInfo);
+        } else {
+            PROFILE_ZONE("Shadow map");
+            shadowShader.activate();
+            triangles = renderShadowTile(light, scene, shadowShader, shadowInfo, update.tile);
+        }
+        scheduler.recordUpdate(triangles);
+        checkGLError("shadow light " + std::to_string(update.lightIndex));
+    }
+}
+
+size_t ShadowManager::renderShadowTile(const Light& light, Scene& scene, Shader& shadowShader, ShadowMapInfo& shadowInfo, int tile) {
+    const glm::mat4& matrix = shadowInfo.lightSpaceMatrices[tile];
+    atlas->bindTile(shadowInfo.rects[tile]);
+    size_t triangles = scene.drawShadowView(shadowShader, shadowInfo.staticViews[tile]);
+    shadowInfo.tileKeys[tile] = ShadowCacheKey(light, scene.getCasterGeneration(), matrix, shadowInfo.rects[tile]);
+    shadowInfo.tileValid[tile] = true;
+    shadowInfo.momentsValid[tile] = false;
+    shadowInfo.updateCost[tile] = triangles;
+    renderStats.tilesRendered++;
+    return triangles;
+}
+
+void ShadowManager::compositeDynamicCasters(Scene& scene, Shader& shadowShader) {
+    PROFILE_ZONE("Shadow dynamic casters");
+    bool hasTiles = false;
+    std::vector<int> cubes;
+    for (const ShadowMapInfo& shadowInfo : shadowMaps) {
+        hasTiles = hasTiles || shadowInfo.tileCount > 0;
+        if (shadowInfo.cubeSlot >= 0) cubes.push_back(shadowInfo.cubeSlot);
+    }
+
+    if (hasTiles) {
+        shadowShader.activate();
+        atlas->beginComposite();
+        // The depth range only covers the casters as of the last static change; clamping keeps
+        // dynamic casters that moved out of it in front of the light instead of clipped
+        glEnable(GL_DEPTH_CLAMP);
+        for (const ShadowMapInfo& shadowInfo : shadowMaps) {
+            for (int tile = 0; tile < shadowInfo.tileCount; ++tile) {
+                atlas->bindCompositeTile(shadowInfo.rects[tile]);
+                scene.drawShadowView(shadowShader, shadowInfo.dynamicViews[tile]);
+                renderStats.tilesComposited++;
+            }
+        }
+        glDisable(GL_DEPTH_CLAMP);
+    }
+
+    // Cube depth is distance within the light's range, which already holds every caster
+    // that can shadow a lit point
+    if (!cubes.empty() && cubeShader) {
+        cubeShader->activate();
+        cubeMaps->beginComposite(cubes);
+        for (const ShadowMapInfo& shadowInfo : shadowMaps) {
+            if (shadowInfo.cubeSlot < 0) continue;
+            std::vector<glm::mat4> faces = ShadowAtlas::getPointLightMatrices(shadowInfo.cubeOrigin, POINT_SHADOW_NEAR,
+                                                                              shadowInfo.farPlane);
+            drawCubeCasters(scene, shadowInfo, faces, shadowInfo.dynamicViews[0]);
+            renderStats.cubesComposited++;
+        }
+    }
+}
+
+void ShadowManager::filterMoments() {
+    PROFILE_ZONE("Shadow moments");
+    // Softness is a radius in depth texels; the Gaussian reaches about twice its sigma
+    int radius = static_cast<int>(std::ceil(shadowSoftness / ShadowMomentAtlas::DOWNSAMPLE));
+    radius = std::max(1, std::min(radius, static_cast<int>(ShadowMomentAtlas::MAX_BLUR_RADIUS)));
+    // Composited depth changes every frame, and moments of the last composite have to go
+    // once the static depth is sampled again
+    bool composited = renderStats.tilesComposited > 0;
+    bool refilterAll = composited || momentsComposited || radius != momentBlurRadius;
+    momentsComposited = composited;
+    momentBlurRadius = radius;
+
+    GLuint depthMap = atlas->getDepthMap();
+    for (ShadowMapInfo& shadowInfo : shadowMaps) {
+        bool perspective = shadowInfo.lightType == LightType::Spot;
+        for (int tile = 0; tile < shadowInfo.tileCount; ++tile) {
+            if (shadowInfo.momentsValid[tile] && !refilterAll) continue;
+            momentAtlas->filterTile(depthMap, shadowInfo.rects[tile], perspective ? SPOT_SHADOW_NEAR : 0.0f,
+                                    perspective ? SPOT_SHADOW_FAR : 0.0f, radius, *momentsShader, *momentBlurShader);
+            shadowInfo.momentsValid[tile] = true;
+            renderStats.tilesFiltered++;
+        }
+    }
+    if (renderStats.tilesFiltered > 0) {
+        momentAtlas->generateMipmaps();
+    }
+}
+
+void ShadowManager::uploadShadowTable(const LightManager& lightManager) {
+    // Two texels per light index: (first tile, tile count, cube + 1, far plane) and the cascade
+    // splits (a cube's origin),
+    // then five per tile: the matrix columns and the tile rectangle in atlas UVs with the
+    // far plane of perspective tiles (0 for cascades), which moments are linear in
+    size_t lightCount = lightManager.getLightCount();
+    size_t tileCount = 0;
+    for (const ShadowMapInfo& shadowInfo : shadowMaps) {
+        tileCount += shadowInfo.tileCount;
+    }
+    shadowTableLights = 0;
+    if (renderStats.shadowedLights == 0) return;
+
+    UploadAllocation allocation = uploads.allocate((lightCount * 2 + tileCount * 5) * sizeof(glm::vec4), sizeof(glm::vec4));
+    if (!allocation.valid()) {
+        // The ring grows next frame; shadows are skipped until then
+        return;
+    }
+    glm::vec4* texels = reinterpret_cast<glm::vec4*>(allocation.data);
+    for (size_t i = 0; i < lightCount * 2; ++i) {
+        texels[i] = glm::vec4(0.0f);
+    }
+
+    float inverseSize = 1.0f / atlas->getSize();
+    glm::vec4* tileTexels = texels + lightCount * 2;
+    int firstTile = 0;
+    for (const ShadowMapInfo& shadowInfo : shadowMaps) {
+        if (shadowInfo.cubeSlot >= 0) {
+            // Cubes have no tiles: (0, 0, cube + 1, far plane) and the position the cube
+            // was drawn from in place of the splits
+            texels[shadowInfo.lightIndex * 2] = glm::vec4(0.0f, 0.0f, static_cast<float>(shadowInfo.cubeSlot + 1), shadowInfo.farPlane);
+            texels[shadowInfo.lightIndex * 2 + 1] = glm::vec4(shadowInfo.cubeOrigin, 0.0f);
+            continue;
+        }
+        if (shadowInfo.tileCount == 0) continue;
+        texels[shadowInfo.lightIndex * 2] = glm::vec4(static_cast<float>(firstTile), static_cast<float>(shadowInfo.tileCount), 0.0f, 0.0f);
+        texels[shadowInfo.lightIndex * 2 + 1] = shadowInfo.cascadeSplits;
+        for (int tile = 0; tile < shadowInfo.tileCount; ++tile) {
+            glm::vec4* record = tileTexels + (firstTile + tile) * 5;
+            for (int column = 0; column < 4; ++column) {
+                record[column] = shadowInfo.lightSpaceMatrices[tile][column];
+            }
+            const ShadowAtlasRect& rect = shadowInfo.rects[tile];
+            float perspectiveFar = shadowInfo.lightType == LightType::Spot ? SPOT_SHADOW_FAR : 0.0f;
+            record[4] = glm::vec4(glm::vec3(rect.x, rect.y, rect.size) * inverseSize, perspectiveFar);
+        }
+        firstTile += shadowInfo.tileCount;
+    }
+
+    shadowDataBase = static_cast<int>(allocation.offset / sizeof(glm::vec4));
+    shadowTableLights = static_cast<int>(lightCount);
+}
+
+size_t ShadowManager::renderPointLightShadow(const Light& light, Scene& scene, ShadowMapInfo& shadowInfo) {
+    // Origin and far plane were moved to the light's when its view was queued
+    std::vector<glm::mat4> faces = ShadowAtlas::getPointLightMatrices(shadowInfo.cubeOrigin, POINT_SHADOW_NEAR,
+                                                                      shadowInfo.farPlane);
+
+    ShadowAtlasRect faceRect;
+    faceRect.size = cubeMaps->getFaceSize();
+    cubeMaps->bindCube(shadowInfo.cubeSlot);
+    size_t triangles = drawCubeCasters(scene, shadowInfo, faces, shadowInfo.staticViews[0]);
+    shadowInfo.tileKeys[0] = ShadowCacheKey(light, scene.getCasterGeneration(), faces[0], faceRect);
+    shadowInfo.tileValid[0] = true;
+    shadowInfo.updateCost[0] = triangles;
+    renderStats.cubesRendered++;
+    return triangles;
 }
 
-void ShadowManager::renderPointLightShadow(const Light&, Scene& scene, Shader& shadowShader, ShadowMapInfo& shadowInfo, const Camera& camera) {
-    std::cout << "Point light shadows not implemented yet." << std::endl;
+size_t ShadowManager::drawCubeCasters(Scene& scene, const ShadowMapInfo& shadowInfo,
+                                      const std::vector<glm::mat4>& faceMatrices, int view) {
+    glUniformMatrix4fv(cubeShader->getUniformLocation("faceMatrices"), ShadowCubeArray::FACES, GL_FALSE,
+                       glm::value_ptr(faceMatrices[0]));
+    cubeShader->setInt("firstLayer", shadowInfo.cubeSlot * ShadowCubeArray::FACES);
+    cubeShader->setVec3("lightPosition", glm::value_ptr(shadowInfo.cubeOrigin));
+    cubeShader->setFloat("farPlane", shadowInfo.farPlane);
+    return scene.drawShadowView(*cubeShader, view);
 }
@@ -2,49 +2,211 @@
 #ifndef SHADOW_MANAGER
 #define SHADOW_MANAGER
 
-#include "shadowBuffer.h"
+#include "shadowAtlas.h"
+#include "shadowCubeArray.h"
+#include "shadowMomentAtlas.h"
+#include "shadowScheduler.h"
 #include "lightManager.h"
 #include "shader.h"
+#include "uploadRing.h"
 #include <vector>
 #include <memory>
+#include <string>
 #include "model.h"
 #include "camera.h"
 
 class Scene;
 
+const int MAX_SHADOW_CASCADES = 4;
+// Main pass units of the atlas and of the per-light shadow table
+const GLuint SHADOW_ATLAS_UNIT = 10;
+const GLuint SHADOW_DATA_UNIT = 11;
+// Main pass unit of the point-light shadow cubes
+const GLuint POINT_SHADOW_UNIT = 12;
+// Main pass unit of the atlas tiles' prefiltered moments
+const GLuint SHADOW_MOMENT_UNIT = 13;
+// Point lights shadowed at once; the least important beyond it go without
+const int MAX_SHADOW_CUBES = 16;
+// Filter taps per shadow lookup; matches MAX_SHADOW_TAPS in default.frag
+const int MAX_SHADOW_FILTER_TAPS = 32;
+
+// How the main pass filters atlas tiles
+enum class ShadowFilterMode {
+    // Comparison taps over the depth, more of them the softer the shadows
+    PCF,
+    // One lookup of prefiltered EVSM moments (ShadowMomentAtlas), blurred once per tile
+    // change rather than per pixel, so very soft shadows cost the same as sharp ones.
+    // Point-light cubes stay on PCF.
+    Moments
+};
+
+// Cascades of directional light shadows
+struct CascadeSettings {
+    int count = 4;
+    // Split distribution: 0 = uniform, 1 = logarithmic
+    float splitLambda = 0.75f;
+    // Shadowed distance from the camera; 0 follows the camera's far plane
+    float maxDistance = 0.0f;
+    // Cascades after the first are fitted this fraction of their radius larger and stay
+    // put until the camera's slice leaves that margin, so they can stay cached while the
+    // camera moves. Costs the same fraction of their resolution.
+    float cacheMargin = 0.2f;
+};
+
+// Atlas tiles whose static depth was drawn or reused from cache in the last
+// renderShadowMaps(), and tiles that had dynamic casters drawn over a copy of it
+struct ShadowRenderStats {
+    int tilesRendered = 0;
+    int tilesCached = 0;
+    int tilesComposited = 0;
+    // Tiles whose moments were rebuilt from their depth
+    int tilesFiltered = 0;
+    // The same for point-light cubes
+    int cubesRendered = 0;
+    int cubesCached = 0;
+    int cubesComposited = 0;
+    // Stale tiles and cubes the update scheduler left for a later frame
+    int tilesDeferred = 0;
+    int cubesDeferred = 0;
+    // Lights given tiles or cubes, and lights left without shadows because the atlas was full
+    // or every cube was taken
+    int shadowedLights = 0;
+    int droppedLights = 0;
+    // Fraction of the atlas covered by tiles
+    float atlasUsage = 0.0f;
+};
+
 struct ShadowMapInfo {
     size_t lightIndex;
     LightType lightType;
-    std::unique_ptr<ShadowBuffer> shadowBuffer;
-    glm::mat4 lightSpaceMatrix;
+    // Tile size when the light covers the whole screen
+    unsigned int resolution;
+    // Tiles this frame: one per cascade, one for spot lights, none when off screen or
+    // without atlas space. All tiles of a light share tileSize.
+    int tileCount;
+    unsigned int tileSize;
+    // Screen-space importance in [0, 1]; lights of lower importance shrink first
+    float importance;
+    // log2 of the size importance asked for last frame, kept unless it moves clearly
+    int sizeLevel;
+    ShadowAtlasRect rects[MAX_SHADOW_CASCADES];
+    // What each tile's static depth was rendered from
+    ShadowCacheKey tileKeys[MAX_SHADOW_CASCADES];
+    bool tileValid[MAX_SHADOW_CASCADES];
+    // Whether each tile's moments were filtered from its current depth
+    bool momentsValid[MAX_SHADOW_CASCADES];
+    // Triangles each tile's (or the cube's) last static redraw took, and frames it has
+    // been left stale by the update scheduler
+    size_t updateCost[MAX_SHADOW_CASCADES];
+    int framesWaiting[MAX_SHADOW_CASCADES];
+    // This frame's draw list views of each tile's (the cube's: the first) static and
+    // dynamic casters, -1 when not drawn
+    int staticViews[MAX_SHADOW_CASCADES];
+    int dynamicViews[MAX_SHADOW_CASCADES];
+    // One per cascade; spot lights only use the first
+    glm::mat4 lightSpaceMatrices[MAX_SHADOW_CASCADES];
+    // View-space far distance of each cascade
+    glm::vec4 cascadeSplits;
+    // World-space center each cascade is fitted around, kept while the slice stays inside
+    // its margin
+    glm::vec3 cascadeAnchors[MAX_SHADOW_CASCADES];
+    bool anchored[MAX_SHADOW_CASCADES];
+    int cascadeCount;
+    // Point lights: cube in the shadow cube array, kept while the light stays shadowed so
+    // its depth stays cached (-1 for none), and the position and distance its depth was
+    // drawn from, which trail the light while its redraw is deferred. The cube's cache key
+    // is tileKeys[0].
+    int cubeSlot;
+    glm::vec3 cubeOrigin;
+    float farPlane;
     bool enabled;
 
-    ShadowMapInfo(size_t idx, LightType type, unsigned int width = 2048, unsigned int height = 2048) 
-        : lightIndex(idx), lightType(type), shadowBuffer(std::make_unique<ShadowBuffer>(width, height)), 
-          lightSpaceMatrix(1.0f), enabled(true) {}
+    ShadowMapInfo(size_t idx, LightType type, unsigned int resolution = 2048, int cascades = 1)
+        : lightIndex(idx), lightType(type), resolution(resolution), tileCount(0), tileSize(0), importance(0.0f),
+          sizeLevel(-1), cascadeSplits(0.0f), cascadeCount(cascades), cubeSlot(-1), cubeOrigin(0.0f), farPlane(0.0f),
+          enabled(true) {
+        for (int i = 0; i < MAX_SHADOW_CASCADES; ++i) {
+            tileValid[i] = false;
+            momentsValid[i] = false;
+            updateCost[i] = 0;
+            framesWaiting[i] = 0;
+            staticViews[i] = -1;
+            dynamicViews[i] = -1;
+            lightSpaceMatrices[i] = glm::mat4(1.0f);
+            cascadeAnchors[i] = glm::vec3(0.0f);
+            anchored[i] = false;
+        }
+    }
 };
 
+// Shadows of any number of lights, rendered into one ShadowAtlas. Each frame every
+// shadowed light is given tiles sized by its screen-space importance, shrinking the least
+// important ones until everything fits, and a table of per-light tile ranges, cascade
+// splits, matrices and tile rectangles is written to the upload ring for default.frag.
+// Point lights instead get a cube of a ShadowCubeArray, drawn in one layered pass. Stale
+// tiles and cubes are redrawn as the ShadowUpdateScheduler's per-frame budget allows.
 class ShadowManager {
 public:
-    ShadowManager();
+    explicit ShadowManager(DynamicUploadRing& uploads);
     ~ShadowManager();
 
-    void addShadowMap(size_t lightIndex, LightType lightType, unsigned int width = 2048, unsigned int height = 2048);
+    // resolution is the tile size at full importance, capped by the atlas
+    void addShadowMap(size_t lightIndex, LightType lightType, unsigned int resolution = 2048);
     void removeShadowMap(size_t lightIndex);
     void clearAllShadowMaps();
 
-    // Updated to use camera
+    // Assigns atlas tiles, renders the scheduled tiles and cubes whose cache keys changed
+    // and uploads the shadow table; call after the upload ring's beginFrame()
     void renderShadowMaps(const LightManager& lightManager, Scene& scene, Shader& shadowShader, const Camera& camera);
 
     void bindShadowMapsForRendering(Shader& mainShader);
     void enableShadows(size_t lightIndex, bool enabled);
 
+    // Point lights are only shadowed once the cube shader is set
+    void setPointShadowShader(const std::string& vertexPath, const std::string& geometryPath, const std::string& fragmentPath);
+
+    // Receiver bias in shadow map texels, scaled up with the receiver's slope to the light
     void setShadowBias(float bias) { shadowBias = bias; }
+    // Filter radius in texels. 0 is a single hardware 2x2 PCF tap; wider kernels take more
+    // taps (getShadowFilterTaps()) on a per-pixel rotated Vogel disk. With moments it is
+    // the radius of their blur instead.
     void setShadowSoftness(float softness) { shadowSoftness = softness; }
+    // Moments only apply once their shader is set; PCF frees the moment atlas
+    void setFilterMode(ShadowFilterMode mode);
+    void setMomentShader(const std::string& vertexPath, const std::string& fragmentPath);
+    // Share of the Chebyshev bound cut off as shadow, trading contact softness for less
+    // light bleeding where casters overlap
+    void setLightBleedReduction(float amount) { lightBleedReduction = amount; }
+
+    void setCascadeSettings(const CascadeSettings& settings);
+    const CascadeSettings& getCascadeSettings() const { return cascadeSettings; }
+    const ShadowRenderStats& getRenderStats() const { return renderStats; }
+    // Budget and ranking of static redraws, and the last frame's schedule
+    ShadowUpdateScheduler& getScheduler() { return scheduler; }
+    const ShadowUpdateScheduler& getScheduler() const { return scheduler; }
 
     float getShadowBias() const { return shadowBias; }
     float getShadowSoftness() const { return shadowSoftness; }
+    int getShadowFilterTaps() const;
+    ShadowFilterMode getFilterMode() const { return filterMode; }
+    float getLightBleedReduction() const { return lightBleedReduction; }
+    // Whether the main pass samples moments (SHADOW_MOMENTS); from the first
+    // renderShadowMaps() in Moments mode
+    bool usesMoments() const { return momentAtlas != nullptr; }
     size_t getShadowMapCount() const { return shadowMaps.size(); }
+    // Lights with tiles in the last renderShadowMaps(); HAS_SHADOWS is only set when non-zero
+    int getShadowedLightCount() const { return renderStats.shadowedLights; }
+
+    // The atlas is recreated at its next use
+    void setAtlasSize(unsigned int size);
+    unsigned int getAtlasSize() const { return atlasSize; }
+    // 0 until the first renderShadowMaps()
+    size_t getAtlasBytes() const { return atlas ? atlas->getBytes() : 0; }
+    // 0 until a point light is shadowed
+    size_t getCubeMapBytes() const { return cubeMaps ? cubeMaps->getBytes() : 0; }
+    int getCubeMapCapacity() const { return cubeMaps ? cubeMaps->getCapacity() : 0; }
+    // 0 outside Moments mode
+    size_t getMomentAtlasBytes() const { return momentAtlas ? momentAtlas->getBytes() : 0; }
 
     // Keep these for backward compatibility if needed
     void setSceneBounds(const glm::vec3& center, float radius) {
@@ -53,7 +215,29 @@ public:
     }
 
 private:
+    DynamicUploadRing& uploads;
+    std::unique_ptr<ShadowAtlas> atlas;
+    unsigned int atlasSize;
+    // Grown to the number of shadowed point lights
+    std::unique_ptr<ShadowCubeArray> cubeMaps;
+    std::unique_ptr<Shader> cubeShader;
+    // Created with the atlas in Moments mode, with the two passes of shadowMoments.frag
+    std::unique_ptr<ShadowMomentAtlas> momentAtlas;
+    std::unique_ptr<Shader> momentsShader;
+    std::unique_ptr<Shader> momentBlurShader;
+    ShadowFilterMode filterMode;
+    float lightBleedReduction;
+    // What the moments were last filtered with; a change refilters every tile
+    int momentBlurRadius;
+    bool momentsComposited;
     std::vector<ShadowMapInfo> shadowMaps;
+    CascadeSettings cascadeSettings;
+    ShadowRenderStats renderStats;
+    ShadowUpdateScheduler scheduler;
+    // Texel offset of this frame's shadow table in the ring's RGBA32F view, and the
+    // number of light entries it starts with
+    int shadowDataBase;
+    int shadowTableLights;
     float shadowBias;
     float shadowSoftness;
 
@@ -63,10 +247,31 @@ private:
 
     ShadowMapInfo* findShadowMap(size_t lightIndex);
     
-    // Updated to use camera
-    void renderDirectionalLightShadow(const Light& light, Scene& scene, Shader& shadowShader, ShadowMapInfo& shadowMapInfo, const Camera& camera);
-    void renderSpotLightShadow(const Light& light, Scene& scene, Shader& shadowShader, ShadowMapInfo& shadowInfo, const Camera& camera);
-    void renderPointLightShadow(const Light& light, Scene& scene, Shader& shadowShader, ShadowMapInfo& shadowInfo, const Camera& camera);
+    // Sizes and places every shadowed light's tiles for this frame
+    void assignTiles(const LightManager& lightManager, const Camera& camera);
+    // Gives the most important point lights a cube each
+    void assignCubes(const LightManager& lightManager, const Camera& camera);
+    // Fits each cascade to its slice of the view; a slice leaving its margin invalidates the tile
+    void updateCascadeMatrices(const Light& light, Scene& scene, ShadowMapInfo& shadowMapInfo, const Camera& camera);
+    void updateSpotLightMatrix(const Light& light, ShadowMapInfo& shadowInfo, const Camera& camera);
+    // Hands a tile or cube whose key changed to the scheduler
+    void queueShadowTile(const Light& light, const Scene& scene, ShadowMapInfo& shadowInfo, int tile, const Camera& camera);
+    void queueShadowCube(const Light& light, const Scene& scene, ShadowMapInfo& shadowInfo, const Camera& camera);
+    // Queues the casters of the scheduled tiles and cubes, and the dynamic casters of every
+    // map, as draw list views; the deferred ones keep their cached matrices
+    void queueShadowViews(const LightManager& lightManager, Scene& scene);
+    // Redraws the scheduled tiles and cubes from their built views
+    void applySchedule(const LightManager& lightManager, Scene& scene, Shader& shadowShader);
+    // Redraw static casters, returning the triangles drawn
+    size_t renderShadowTile(const Light& light, Scene& scene, Shader& shadowShader, ShadowMapInfo& shadowInfo, int tile);
+    size_t renderPointLightShadow(const Light& light, Scene& scene, ShadowMapInfo& shadowInfo);
+    size_t drawCubeCasters(Scene& scene, const ShadowMapInfo& shadowInfo, const std::vector<glm::mat4>& faceMatrices,
+                           int view);
+    // Draws the dynamic casters of every tile and cube over a copy of the static depth
+    void compositeDynamicCasters(Scene& scene, Shader& shadowShader);
+    // Rebuilds the moments of tiles whose depth changed, then the mip chain
+    void filterMoments();
+    void uploadShadowTable(const LightManager& lightManager);
 };
 
 #endif // SHADOW_MANAGER
\ No newline at end of file
@@ -0,0 +1,143 @@
+#include "shadowMomentAtlas.h"
+#include "error.h"
+#include "glExtensions.h"
+#include "glState.h"
+#include "log.h"
+#include <algorithm>
+
+namespace {
+
+// Plenty for shadows seen at grazing angles; past it the cost grows faster than the gain
+const float MAX_MOMENT_ANISOTROPY = 8.0f;
+
+} // namespace
+
+ShadowMomentAtlas::ShadowMomentAtlas(unsigned int depthAtlasSize)
+    : size(std::max(depthAtlasSize / DOWNSAMPLE, 1u)), momentMap(0), framebuffer(0), scratchMap(0), scratchFramebuffer(0),
+      scratchSize(0), depthSampler(0) {
+    createMomentTexture(momentMap, framebuffer, size, true);
+
+    glGenSamplers(1, &depthSampler);
+    glSamplerParameteri(depthSampler, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glSamplerParameteri(depthSampler, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glSamplerParameteri(depthSampler, GL_TEXTURE_COMPARE_MODE, GL_NONE);
+    getGLState().bindFramebuffer(0);
+    checkGLError("Create shadow moment atlas");
+
+    LOG_DEBUG(Shadow, "Created %ux%u shadow moment atlas", size, size);
+}
+
+ShadowMomentAtlas::~ShadowMomentAtlas() {
+    deleteMomentTexture(momentMap, framebuffer);
+    deleteMomentTexture(scratchMap, scratchFramebuffer);
+    glDeleteSamplers(1, &depthSampler);
+}
+
+void ShadowMomentAtlas::createMomentTexture(GLuint& texture, GLuint& textureFramebuffer, unsigned int textureSize,
+                                            bool mipmapped) {
+    glGenTextures(1, &texture);
+    getGLState().bindTexture(0, GL_TEXTURE_2D, texture);
+    // 32-bit floats: the positive warp squared reaches e^80
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, textureSize, textureSize, 0, GL_RGBA, GL_FLOAT, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    if (mipmapped) {
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, MAX_MIP_LEVEL);
+        const GLExtensionSupport& extensions = getGLExtensions();
+        if (extensions.textureFilterAnisotropic) {
+            glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAX_ANISOTROPY_EXT,
+                            std::min(extensions.maxAnisotropy, MAX_MOMENT_ANISOTROPY));
+        }
+        glGenerateMipmap(GL_TEXTURE_2D);
+    } else {
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    }
+    checkGLError("Create shadow moment texture");
+
+    glGenFramebuffers(1, &textureFramebuffer);
+    getGLState().bindFramebuffer(textureFramebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        LOG_ERROR(Shadow, "Shadow moment framebuffer is not complete");
+    }
+}
+
+void ShadowMomentAtlas::deleteMomentTexture(GLuint& texture, GLuint& textureFramebuffer) {
+    if (texture != 0) {
+        getGLState().textureDeleted(texture);
+        glDeleteTextures(1, &texture);
+        texture = 0;
+    }
+    if (textureFramebuffer != 0) {
+        getGLState().framebufferDeleted(textureFramebuffer);
+        glDeleteFramebuffers(1, &textureFramebuffer);
+        textureFramebuffer = 0;
+    }
+}
+
+void ShadowMomentAtlas::filterTile(GLuint depthMap, const ShadowAtlasRect& depthRect, float perspectiveNear,
+                                   float perspectiveFar, int blurRadius, Shader& momentsShader, Shader& blurShader) {
+    unsigned int tileSize = std::max(depthRect.size / DOWNSAMPLE, 1u);
+    if (tileSize > scratchSize) {
+        deleteMomentTexture(scratchMap, scratchFramebuffer);
+        scratchSize = tileSize;
+        createMomentTexture(scratchMap, scratchFramebuffer, scratchSize, false);
+        LOG_DEBUG(Shadow, "Shadow moment scratch grown to %ux%u", scratchSize, scratchSize);
+    }
+    GLStateCache& state = getGLState();
+    int radius = std::max(1, std::min(blurRadius, static_cast<int>(MAX_BLUR_RADIUS)));
+    int tileX = static_cast<int>(depthRect.x / DOWNSAMPLE);
+    int tileY = static_cast<int>(depthRect.y / DOWNSAMPLE);
+    state.setDepthTest(false);
+    state.setCullFace(false);
+    emptyVAO.bind();
+
+    // Depth to moments, blurred along x into the scratch's lower left corner
+    momentsShader.activate();
+    state.bindFramebuffer(scratchFramebuffer);
+    state.viewport(0, 0, tileSize, tileSize);
+    state.bindTexture(0, GL_TEXTURE_2D, depthMap);
+    glBindSampler(0, depthSampler);
+    momentsShader.setInt("depthMap", 0);
+    glUniform2i(momentsShader.getUniformLocation("targetOffset"), 0, 0);
+    glUniform2i(momentsShader.getUniformLocation("sourceOffset"), depthRect.x, depthRect.y);
+    momentsShader.setInt("tileTexels", static_cast<int>(tileSize));
+    momentsShader.setInt("blurRadius", radius);
+    momentsShader.setFloat("perspectiveNear", perspectiveNear);
+    momentsShader.setFloat("perspectiveFar", perspectiveFar);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    glBindSampler(0, 0);
+
+    // Blurred along y into the tile
+    blurShader.activate();
+    state.bindFramebuffer(framebuffer);
+    state.viewport(tileX, tileY, tileSize, tileSize);
+    state.bindTexture(0, GL_TEXTURE_2D, scratchMap);
+    blurShader.setInt("moments", 0);
+    glUniform2i(blurShader.getUniformLocation("targetOffset"), tileX, tileY);
+    glUniform2i(blurShader.getUniformLocation("sourceOffset"), 0, 0);
+    blurShader.setInt("tileTexels", static_cast<int>(tileSize));
+    blurShader.setInt("blurRadius", radius);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+
+    state.setDepthTest(true);
+    LOG_TRACE(Shadow, "Shadow moments: %u at (%d, %d), radius %d", tileSize, tileX, tileY, radius);
+}
+
+void ShadowMomentAtlas::generateMipmaps() {
+    // Unit 0 last held the scratch texture, so this binding also selects the unit
+    getGLState().bindTexture(0, GL_TEXTURE_2D, momentMap);
+    glGenerateMipmap(GL_TEXTURE_2D);
+}
+
+void ShadowMomentAtlas::bindTexture(unsigned int unit) {
+    getGLState().bindTexture(unit, GL_TEXTURE_2D, momentMap);
+}
+
+size_t ShadowMomentAtlas::getBytes() const {
+    // RGBA32F; a full mip chain adds a third
+    size_t bytes = static_cast<size_t>(size) * size * 16;
+    return bytes + bytes / 3 + static_cast<size_t>(scratchSize) * scratchSize * 16;
+}
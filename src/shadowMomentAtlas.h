@@ -0,0 +1,62 @@
+// shadowMomentAtlas.h - Prefiltered EVSM moments of the shadow atlas
+#ifndef SHADOW_MOMENT_ATLAS_H
+#define SHADOW_MOMENT_ATLAS_H
+
+#include <glad/glad.h>
+#include <cstddef>
+#include "shadowAtlas.h"
+#include "shader.h"
+#include "VAO.h"
+
+// Exponential variance shadow map moments of every ShadowAtlas tile, at the same UVs and
+// half the resolution. A tile's moments are rebuilt from its depth only when that depth
+// changes: a horizontal pass warps depth into (e^cd, e^2cd, -e^-cd, e^-2cd) and blurs it into
+// a scratch texture, a vertical pass blurs that into the tile. Being linear, the moments
+// then filter like colour, so the main pass gets the whole blur plus trilinear and
+// anisotropic filtering from a single lookup. Tiles are power-of-two squares aligned to
+// their size, so mip levels up to MAX_MIP_LEVEL never mix two tiles.
+class ShadowMomentAtlas {
+public:
+    // Depth texels per moment texel along each axis; matches DOWNSAMPLE in shadowMoments.frag
+    static const unsigned int DOWNSAMPLE = 2;
+    // Blur radius in moment texels; matches MAX_BLUR_RADIUS in shadowMoments.frag
+    static const int MAX_BLUR_RADIUS = 16;
+    // Levels below this still hold 4x4 texels of the smallest tile
+    static const int MAX_MIP_LEVEL = 4;
+
+    explicit ShadowMomentAtlas(unsigned int depthAtlasSize);
+    ~ShadowMomentAtlas();
+
+    ShadowMomentAtlas(const ShadowMomentAtlas&) = delete;
+    ShadowMomentAtlas& operator=(const ShadowMomentAtlas&) = delete;
+
+    // Rebuilds one tile's moments from its depth in depthMap. A perspective tile's depth is
+    // linearized between its planes first; perspectiveFar is 0 for orthographic ones.
+    // momentsShader and blurShader are the two passes of shadowMoments.frag.
+    void filterTile(GLuint depthMap, const ShadowAtlasRect& depthRect, float perspectiveNear, float perspectiveFar,
+                    int blurRadius, Shader& momentsShader, Shader& blurShader);
+    // Rebuilds the mip chain once the frame's tiles are filtered
+    void generateMipmaps();
+
+    void bindTexture(unsigned int unit);
+    unsigned int getSize() const { return size; }
+    // Mip chain and scratch included
+    size_t getBytes() const;
+
+private:
+    unsigned int size;
+    GLuint momentMap;
+    GLuint framebuffer;
+    // Horizontal pass output, grown to the largest tile filtered so far
+    GLuint scratchMap;
+    GLuint scratchFramebuffer;
+    unsigned int scratchSize;
+    // Reads the depth atlas as plain depth: the texture itself compares for sampler2DShadow
+    GLuint depthSampler;
+    VertexArrayObject emptyVAO;
+
+    void createMomentTexture(GLuint& texture, GLuint& textureFramebuffer, unsigned int textureSize, bool mipmapped);
+    void deleteMomentTexture(GLuint& texture, GLuint& textureFramebuffer);
+};
+
+#endif
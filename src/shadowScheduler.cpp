@@ -0,0 +1,107 @@
+#include "shadowScheduler.h"
+#include "gpuProfiler.h"
+#include "log.h"
+#include <algorithm>
+
+namespace {
+
+// What each reason's change is worth against the others; invalid maps skip the ranking
+float changeWeight(ShadowUpdateReason reason) {
+    switch (reason) {
+        case ShadowUpdateReason::Invalid: return 4.0f;
+        case ShadowUpdateReason::Light: return 1.0f;
+        case ShadowUpdateReason::Casters: return 0.5f;
+    }
+    return 1.0f;
+}
+
+// Floor under coverage times proximity, so a tiny distant light still climbs past a busy
+// one within a bounded number of frames
+const float MIN_RELEVANCE = 0.1f;
+// Weight of the newest frame in the running averages; roughly matches the GPU profiler's
+// history, which the millisecond budget divides by them
+const float AVERAGE_WEIGHT = 1.0f / 64.0f;
+
+} // namespace
+
+ShadowUpdateScheduler::ShadowUpdateScheduler()
+    : frameBudget(0), scheduledTriangles(0), frameTriangles(0), deferred(0), averageUpdateTriangles(0.0f),
+      averageFrameTriangles(0.0f), msPerTriangle(0.0f) {
+}
+
+void ShadowUpdateScheduler::beginFrame() {
+    if (frameTriangles > 0) {
+        averageFrameTriangles = averageFrameTriangles > 0.0f
+            ? averageFrameTriangles + (frameTriangles - averageFrameTriangles) * AVERAGE_WEIGHT
+            : static_cast<float>(frameTriangles);
+    }
+    updates.clear();
+    scheduledTriangles = 0;
+    frameTriangles = 0;
+    deferred = 0;
+
+    frameBudget = 0;
+    if (!settings.enabled) return;
+    frameBudget = settings.triangleBudget;
+    if (settings.millisecondBudget > 0.0f) {
+        measureCost();
+        if (msPerTriangle > 0.0f) {
+            size_t timeBudget = static_cast<size_t>(settings.millisecondBudget / msPerTriangle);
+            frameBudget = frameBudget > 0 ? std::min(frameBudget, timeBudget) : std::max<size_t>(timeBudget, 1);
+        }
+    }
+}
+
+void ShadowUpdateScheduler::measureCost() {
+    // Frames without redraws have no "Shadow updates" sample, so both averages only cover
+    // frames that drew something
+    if (averageFrameTriangles <= 0.0f) return;
+    for (const GpuPassStats& pass : getGpuProfiler().getStats()) {
+        if (pass.name != "Shadow updates") continue;
+        if (pass.samples > 0) {
+            msPerTriangle = pass.averageMs / averageFrameTriangles;
+        }
+        return;
+    }
+}
+
+void ShadowUpdateScheduler::add(ShadowUpdate update) {
+    float relevance = std::max(update.coverage * update.proximity, MIN_RELEVANCE);
+    update.priority = changeWeight(update.reason) * relevance * (1.0f + update.framesWaiting);
+    if (update.cost == 0) {
+        update.cost = static_cast<size_t>(averageUpdateTriangles);
+    }
+    updates.push_back(update);
+}
+
+void ShadowUpdateScheduler::schedule() {
+    std::stable_sort(updates.begin(), updates.end(), [](const ShadowUpdate& a, const ShadowUpdate& b) {
+        bool aInvalid = a.reason == ShadowUpdateReason::Invalid;
+        bool bInvalid = b.reason == ShadowUpdateReason::Invalid;
+        if (aInvalid != bInvalid) return aInvalid;
+        return a.priority > b.priority;
+    });
+
+    // Smaller updates further down still fill what a larger one left. The first update
+    // always goes, so one map costing more than the whole budget can't stall everything.
+    for (ShadowUpdate& update : updates) {
+        update.scheduled = frameBudget == 0 || update.reason == ShadowUpdateReason::Invalid ||
+                           scheduledTriangles == 0 || scheduledTriangles + update.cost <= frameBudget;
+        if (update.scheduled) {
+            scheduledTriangles += update.cost;
+        } else {
+            deferred++;
+        }
+    }
+    if (deferred > 0) {
+        LOG_TRACE(Shadow, "Shadow schedule: %zu updates, %d deferred, %zu of %zu triangles",
+                  updates.size(), deferred, scheduledTriangles, frameBudget);
+    }
+}
+
+void ShadowUpdateScheduler::recordUpdate(size_t triangles) {
+    frameTriangles += triangles;
+    averageUpdateTriangles = averageUpdateTriangles > 0.0f
+        ? averageUpdateTriangles + (triangles - averageUpdateTriangles) * AVERAGE_WEIGHT
+        : static_cast<float>(triangles);
+}
@@ -0,0 +1,95 @@
+// shadowScheduler.h - Per-frame budget for shadow map updates
+#ifndef SHADOW_SCHEDULER_H
+#define SHADOW_SCHEDULER_H
+
+#include <cstddef>
+#include <vector>
+
+struct ShadowScheduleSettings {
+    // Off redraws every stale tile and cube in the frame it goes stale
+    bool enabled = false;
+    // Static caster triangles redrawn per frame; 0 for no limit
+    size_t triangleBudget = 0;
+    // GPU time of the redraws per frame, turned into triangles with their measured cost;
+    // 0 for no limit. The smaller of the two budgets applies.
+    float millisecondBudget = 0.0f;
+};
+
+// Why a tile or cube's cached depth no longer matches its light
+enum class ShadowUpdateReason {
+    // No usable depth: new, moved in the atlas or to another cube, or a cascade whose slice
+    // left its margin. These are always redrawn.
+    Invalid,
+    // The light moved, turned or changed its cone or range
+    Light,
+    // Static casters in its reach changed
+    Casters
+};
+
+// One stale tile or cube of a frame's schedule
+struct ShadowUpdate {
+    size_t lightIndex = 0;
+    // Cascade, 0 for a spot light's tile, -1 for a point light's cube
+    int tile = 0;
+    ShadowUpdateReason reason = ShadowUpdateReason::Casters;
+    // Screen-space importance of the light, and how close it is against its range
+    // (cascades: how near the camera their slice is), both in [0, 1]
+    float coverage = 0.0f;
+    float proximity = 0.0f;
+    // Frames it was left stale before this one
+    int framesWaiting = 0;
+    float priority = 0.0f;
+    // Triangles its last redraw took, or the running average for ones never drawn
+    size_t cost = 0;
+    bool scheduled = false;
+};
+
+// Picks which stale shadow maps are redrawn each frame. Updates are ranked by coverage,
+// proximity and what changed, and every frame waited raises that, so the ones left out
+// come round in turn rather than starving behind a permanently busier light. The most
+// urgent fill the triangle budget; invalid maps go first regardless and count against it.
+// Maps left stale keep being sampled with the matrix their depth was drawn with, so their
+// shadows lag behind but stay where their casters were.
+class ShadowUpdateScheduler {
+public:
+    ShadowUpdateScheduler();
+
+    void setSettings(const ShadowScheduleSettings& settings) { this->settings = settings; }
+    ShadowScheduleSettings& getSettings() { return settings; }
+    const ShadowScheduleSettings& getSettings() const { return settings; }
+
+    // Clears the schedule and works out this frame's triangle budget
+    void beginFrame();
+    // Queues a stale map; cost is 0 when it was never drawn
+    void add(ShadowUpdate update);
+    // Sorts the queue by priority and marks the updates that fit the budget
+    void schedule();
+    // Triangles one scheduled redraw took, to estimate the cost of ones never drawn
+    void recordUpdate(size_t triangles);
+
+    // This frame's updates, most urgent first, once scheduled
+    const std::vector<ShadowUpdate>& getUpdates() const { return updates; }
+    // 0 when nothing limits the frame
+    size_t getTriangleBudget() const { return frameBudget; }
+    size_t getScheduledTriangles() const { return scheduledTriangles; }
+    // Measured GPU cost of a thousand redrawn triangles, 0 until known
+    float getMsPerThousandTriangles() const { return msPerTriangle * 1000.0f; }
+    int getDeferredCount() const { return deferred; }
+
+private:
+    ShadowScheduleSettings settings;
+    std::vector<ShadowUpdate> updates;
+    size_t frameBudget;
+    size_t scheduledTriangles;
+    size_t frameTriangles;
+    int deferred;
+    // Running averages of one redraw's triangles and of a frame's redrawn triangles
+    float averageUpdateTriangles;
+    float averageFrameTriangles;
+    float msPerTriangle;
+
+    // Turns the millisecond budget into triangles from the "Shadow updates" GPU pass
+    void measureCost();
+};
+
+#endif // SHADOW_SCHEDULER_H
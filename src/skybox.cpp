@@ -1,5 +1,7 @@
 #include "skybox.h"
 #include "stb_image.h"
+#include "glState.h"
+#include "jobSystem.h"
 #include <iostream>
 #include <glm/gtc/type_ptr.hpp>
 
@@ -63,36 +65,57 @@ Skybox::Skybox(const std::vector<std::string>& faces)
 }
 
 Skybox::~Skybox() {
-    if (VAO != 0) glDeleteVertexArrays(1, &VAO);
+    if (VAO != 0) {
+        getGLState().vertexArrayDeleted(VAO);
+        glDeleteVertexArrays(1, &VAO);
+    }
     if (VBO != 0) glDeleteBuffers(1, &VBO);
-    if (textureID != 0) glDeleteTextures(1, &textureID);
+    if (textureID != 0) {
+        getGLState().textureDeleted(textureID);
+        glDeleteTextures(1, &textureID);
+    }
 }
 
 void Skybox::setupCube() {
     glGenVertexArrays(1, &VAO);
     glGenBuffers(1, &VBO);
     
-    glBindVertexArray(VAO);
+    getGLState().bindVertexArray(VAO);
     glBindBuffer(GL_ARRAY_BUFFER, VBO);
     glBufferData(GL_ARRAY_BUFFER, sizeof(skyboxVertices), &skyboxVertices, GL_STATIC_DRAW);
     
     glEnableVertexAttribArray(0);
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
     
-    glBindVertexArray(0);
+    getGLState().bindVertexArray(0);
     glBindBuffer(GL_ARRAY_BUFFER, 0);
 }
 
 void Skybox::loadCubemapTextures(const std::vector<std::string>& faces) {
     glGenTextures(1, &textureID);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
+    getGLState().bindTexture(0, GL_TEXTURE_CUBE_MAP, textureID);
 
     // Face names for debugging
     std::vector<std::string> faceNames = {"Right (+X)", "Left (-X)", "Top (+Y)", "Bottom (-Y)", "Front (+Z)", "Back (-Z)"};
 
-    int width, height, nrChannels;
+    // The faces decode in parallel; uploads stay on this thread
+    struct DecodedFace {
+        unsigned char* data = nullptr;
+        int width = 0, height = 0, nrChannels = 0;
+        const char* error = nullptr;
+    };
+    std::vector<DecodedFace> decoded(faces.size());
+    getJobSystem().parallelFor(faces.size(), 1, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            DecodedFace& face = decoded[i];
+            face.data = stbi_load(faces[i].c_str(), &face.width, &face.height, &face.nrChannels, 0);
+            if (!face.data) face.error = stbi_failure_reason();
+        }
+    });
+
     for (unsigned int i = 0; i < faces.size(); i++) {
-        unsigned char* data = stbi_load(faces[i].c_str(), &width, &height, &nrChannels, 0);
+        unsigned char* data = decoded[i].data;
+        int width = decoded[i].width, height = decoded[i].height, nrChannels = decoded[i].nrChannels;
         if (data) {
             GLenum format = GL_RGB;
             if (nrChannels == 1) format = GL_RED;
@@ -106,7 +129,7 @@ void Skybox::loadCubemapTextures(const std::vector<std::string>& faces) {
             stbi_image_free(data);
         } else {
             std::cerr << "ERROR: Cubemap texture failed to load at path: " << faces[i] << std::endl;
-            std::cerr << "STB Error: " << stbi_failure_reason() << std::endl;
+            std::cerr << "STB Error: " << (decoded[i].error ? decoded[i].error : "unknown") << std::endl;
             
             // Create a fallback colored texture for missing faces
             unsigned char fallbackColor[3];
@@ -133,7 +156,8 @@ void Skybox::draw(Shader& shader, Camera& camera) {
     if (!initialized) return;
     
     // Change depth function so depth test passes when values are equal to depth buffer's content
-    glDepthFunc(GL_LEQUAL);
+    GLStateCache& state = getGLState();
+    state.depthFunc(GL_LEQUAL);
     
     shader.activate();
     
@@ -143,27 +167,26 @@ void Skybox::draw(Shader& shader, Camera& camera) {
     
     shader.setMat4("view", glm::value_ptr(view));
     shader.setMat4("projection", glm::value_ptr(projection));
+    glm::mat4 unjitteredViewProjection = camera.getUnjitteredProjectionMatrix() * camera.getViewMatrix();
+    glm::mat4 previousViewProjection = camera.getPreviousViewProjection();
+    shader.setMat4("unjitteredViewProjection", glm::value_ptr(unjitteredViewProjection));
+    shader.setMat4("previousViewProjection", glm::value_ptr(previousViewProjection));
     
     // Skybox cube
-    glBindVertexArray(VAO);
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
-    glUniform1i(glGetUniformLocation(shader.ID, "skybox"), 0);
+    state.bindVertexArray(VAO);
+    state.bindTexture(0, GL_TEXTURE_CUBE_MAP, textureID);
+    shader.setInt("skybox", 0);
     
     glDrawArrays(GL_TRIANGLES, 0, 36);
-    glBindVertexArray(0);
     
     // Set depth function back to default
-    glDepthFunc(GL_LESS);
-    
-    shader.deactivate();
+    state.depthFunc(GL_LESS);
 }
 
 void Skybox::bind() {
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
+    getGLState().bindTexture(0, GL_TEXTURE_CUBE_MAP, textureID);
 }
 
 void Skybox::unbind() {
-    glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+    getGLState().bindTexture(0, GL_TEXTURE_CUBE_MAP, 0);
 }
\ No newline at end of file
@@ -0,0 +1,149 @@
+#include "temporalAA.h"
+#include "error.h"
+#include "glState.h"
+#include "log.h"
+
+namespace {
+
+// Radical inverse in the given base, in [0, 1)
+float halton(unsigned int index, unsigned int base) {
+    float result = 0.0f;
+    float fraction = 1.0f / base;
+    while (index > 0) {
+        result += fraction * (index % base);
+        index /= base;
+        fraction /= base;
+    }
+    return result;
+}
+
+} // namespace
+
+TemporalAA::TemporalAA(const std::string& vertexPath, const std::string& fragmentPath)
+    : resolveShader(vertexPath.c_str(), fragmentPath.c_str()), historyTextures{0, 0}, historyFramebuffers{0, 0},
+      width(0), height(0), current(0), historyValid(false), previousRenderWidth(0), previousRenderHeight(0), frameIndex(0) {
+}
+
+TemporalAA::~TemporalAA() {
+    releaseHistory();
+}
+
+void TemporalAA::releaseHistory() {
+    GLStateCache& state = getGLState();
+    for (int i = 0; i < 2; ++i) {
+        if (historyFramebuffers[i] != 0) {
+            state.framebufferDeleted(historyFramebuffers[i]);
+            glDeleteFramebuffers(1, &historyFramebuffers[i]);
+        }
+        if (historyTextures[i] != 0) {
+            state.textureDeleted(historyTextures[i]);
+            glDeleteTextures(1, &historyTextures[i]);
+        }
+        historyFramebuffers[i] = 0;
+        historyTextures[i] = 0;
+    }
+}
+
+void TemporalAA::createHistory(unsigned int newWidth, unsigned int newHeight) {
+    releaseHistory();
+    width = newWidth;
+    height = newHeight;
+
+    GLStateCache& state = getGLState();
+    for (int i = 0; i < 2; ++i) {
+        glGenTextures(1, &historyTextures[i]);
+        state.bindTexture(0, GL_TEXTURE_2D, historyTextures[i]);
+        // Half floats keep a 10% blend from stalling on 8-bit quantization steps
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, width, height, 0, GL_RGBA, GL_HALF_FLOAT, nullptr);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+        glGenFramebuffers(1, &historyFramebuffers[i]);
+        state.bindFramebuffer(historyFramebuffers[i]);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, historyTextures[i], 0);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+            LOG_ERROR(Render, "TAA history %ux%u is not complete", width, height);
+        }
+    }
+    checkGLError("create TAA history");
+    historyValid = false;
+    LOG_INFO(Render, "TAA history %ux%u (%.1f MB)", width, height, getMemoryBytes() / (1024.0 * 1024.0));
+}
+
+size_t TemporalAA::getMemoryBytes() const {
+    return historyTextures[0] != 0 ? static_cast<size_t>(width) * height * 8 * 2 : 0;
+}
+
+void TemporalAA::jitterCamera(Camera& camera, unsigned int renderWidth, unsigned int renderHeight) {
+    if (!settings.enabled || renderWidth == 0 || renderHeight == 0) {
+        camera.setJitter(glm::vec2(0.0f));
+        return;
+    }
+    // Index 0 of the sequence is (0, 0); start at 1 for a well spread set of 8
+    frameIndex = (frameIndex % JITTER_PHASES) + 1;
+    glm::vec2 offset(halton(frameIndex, 2) - 0.5f, halton(frameIndex, 3) - 0.5f);
+    camera.setJitter(offset * glm::vec2(2.0f / renderWidth, 2.0f / renderHeight));
+}
+
+FrameGraphResource TemporalAA::addPass(FrameGraph& graph, FrameGraphResource color, FrameGraphResource velocity,
+                                       unsigned int renderWidth, unsigned int renderHeight) {
+    if (!settings.enabled || velocity == NO_RESOURCE) {
+        historyValid = false;
+        return color;
+    }
+    const FrameGraphTextureDesc& colorDesc = graph.getDesc(color);
+    if (width != colorDesc.width || height != colorDesc.height) {
+        createHistory(colorDesc.width, colorDesc.height);
+    }
+
+    // The history outlives the frame, so both halves are imported rather than transient
+    FrameGraphTextureDesc historyDesc;
+    historyDesc.width = width;
+    historyDesc.height = height;
+    historyDesc.format = GL_RGBA16F;
+    int previous = current;
+    int next = 1 - current;
+    FrameGraphResource history = graph.importTexture("TAA history", historyTextures[previous], historyDesc);
+    FrameGraphResource output = graph.importTexture("TAA output", historyTextures[next], historyDesc);
+
+    graph.addPass("Temporal AA",
+        [&](FrameGraphPassBuilder& builder) {
+            builder.read(color);
+            builder.read(velocity);
+            builder.read(history);
+            builder.write(output);
+        },
+        [this, color, velocity, previous, next, renderWidth, renderHeight](FrameGraph& frame) {
+            GLStateCache& state = getGLState();
+            state.bindFramebuffer(historyFramebuffers[next]);
+            state.viewport(0, 0, renderWidth, renderHeight);
+            state.setDepthTest(false);
+            state.setCullFace(false);
+
+            resolveShader.activate();
+            state.bindTexture(0, GL_TEXTURE_2D, frame.getTexture(color));
+            state.bindTexture(1, GL_TEXTURE_2D, frame.getTexture(velocity));
+            state.bindTexture(2, GL_TEXTURE_2D, historyTextures[previous]);
+            resolveShader.setInt("currentColor", 0);
+            resolveShader.setInt("velocity", 1);
+            resolveShader.setInt("history", 2);
+            GLfloat renderSize[2] = { static_cast<GLfloat>(renderWidth), static_cast<GLfloat>(renderHeight) };
+            GLfloat previousRenderSize[2] = { static_cast<GLfloat>(previousRenderWidth), static_cast<GLfloat>(previousRenderHeight) };
+            GLfloat textureSize[2] = { static_cast<GLfloat>(width), static_cast<GLfloat>(height) };
+            resolveShader.setVec2("renderSize", renderSize);
+            resolveShader.setVec2("previousRenderSize", previousRenderSize);
+            resolveShader.setVec2("textureSize", textureSize);
+            resolveShader.setFloat("historyWeight", historyValid ? settings.historyWeight : 0.0f);
+            emptyVAO.bind();
+            glDrawArrays(GL_TRIANGLES, 0, 3);
+            state.setDepthTest(true);
+
+            current = next;
+            historyValid = true;
+            previousRenderWidth = renderWidth;
+            previousRenderHeight = renderHeight;
+        });
+    return output;
+}
@@ -0,0 +1,67 @@
+#ifndef TEMPORAL_AA_H
+#define TEMPORAL_AA_H
+
+#include <glad/glad.h>
+#include <string>
+#include "camera.h"
+#include "frameGraph.h"
+#include "shader.h"
+#include "VAO.h"
+
+struct TemporalAASettings {
+    bool enabled = true;
+    // Share of the reprojected history in each resolved pixel
+    float historyWeight = 0.9f;
+};
+
+// Temporal anti-aliasing on a single-sampled target with a velocity attachment. The camera
+// is jittered by a Halton(2,3) sequence so consecutive frames sample different subpixel
+// positions. The resolve follows the velocity buffer back into the previous result, clips
+// that history to the YCoCg bounds of the current 3x3 neighbourhood so disocclusions and
+// lighting changes don't ghost, and blends. History is RGBA16F ping-pong at the target's
+// size; like the target, only the lower left render-size region is valid, and the previous
+// frame's region size is kept so dynamic resolution can change it between frames.
+class TemporalAA {
+public:
+    static const int JITTER_PHASES = 8;
+
+    TemporalAA(const std::string& vertexPath, const std::string& fragmentPath);
+    ~TemporalAA();
+
+    TemporalAA(const TemporalAA&) = delete;
+    TemporalAA& operator=(const TemporalAA&) = delete;
+
+    // Sets this frame's jitter for a render size; zero while disabled
+    void jitterCamera(Camera& camera, unsigned int renderWidth, unsigned int renderHeight);
+    // Declares the resolve of the scene's color into the history and returns the resource
+    // holding the result, in the same lower left region as the scene. Returns color
+    // unchanged while disabled or without velocity.
+    FrameGraphResource addPass(FrameGraph& graph, FrameGraphResource color, FrameGraphResource velocity,
+                               unsigned int renderWidth, unsigned int renderHeight);
+    // The next resolve starts over from the current frame (camera cuts)
+    void invalidateHistory() { historyValid = false; }
+
+    TemporalAASettings& getSettings() { return settings; }
+    size_t getMemoryBytes() const;
+
+private:
+    TemporalAASettings settings;
+    Shader resolveShader;
+    VertexArrayObject emptyVAO;
+
+    GLuint historyTextures[2];
+    GLuint historyFramebuffers[2];
+    unsigned int width;
+    unsigned int height;
+    // The texture written by the last resolve
+    int current;
+    bool historyValid;
+    unsigned int previousRenderWidth;
+    unsigned int previousRenderHeight;
+    unsigned int frameIndex;
+
+    void createHistory(unsigned int width, unsigned int height);
+    void releaseHistory();
+};
+
+#endif // TEMPORAL_AA_H
@@ -1,28 +1,34 @@
 #include "texture.h"
+#include "glState.h"
 #include <iostream>
 #include <filesystem>
 
 Texture::Texture(const char* image, TextureType texType, GLuint slot)
-    : type(texType), unit(slot), loaded(false), filePath(image), initialized(false), ID(0)
+    : type(texType), unit(slot), loaded(false), filePath(image), initialized(false), ID(0), pixels(nullptr),
+      width(0), height(0), channels(0), decodeError(nullptr)
 {
     // Don't create OpenGL objects here - defer until first use
 }
 
 Texture::Texture(Texture&& other) noexcept
     : ID(other.ID), type(other.type), unit(other.unit), loaded(other.loaded), 
-      filePath(std::move(other.filePath)), initialized(other.initialized)
+      filePath(std::move(other.filePath)), initialized(other.initialized), pixels(other.pixels), width(other.width),
+      height(other.height), channels(other.channels), decodeError(other.decodeError)
 {
     other.ID = 0;
     other.loaded = false;
     other.initialized = false;
+    other.pixels = nullptr;
 }
 
 Texture& Texture::operator=(Texture&& other) noexcept {
     if (this != &other) {
         // Clean up current texture
         if (ID != 0) {
+            getGLState().textureDeleted(ID);
             glDeleteTextures(1, &ID);
         }
+        releasePixels();
         
         // Move from other
         ID = other.ID;
@@ -31,15 +37,36 @@ Texture& Texture::operator=(Texture&& other) noexcept {
         loaded = other.loaded;
         filePath = std::move(other.filePath);
         initialized = other.initialized;
+        pixels = other.pixels;
+        width = other.width;
+        height = other.height;
+        channels = other.channels;
+        decodeError = other.decodeError;
         
         // Reset other
         other.ID = 0;
         other.loaded = false;
         other.initialized = false;
+        other.pixels = nullptr;
     }
     return *this;
 }
 
+void Texture::decode() {
+    if (initialized || pixels) return;
+    pixels = stbi_load(filePath.c_str(), &width, &height, &channels, 0);
+    if (!pixels) {
+        decodeError = stbi_failure_reason();
+    }
+}
+
+void Texture::releasePixels() {
+    if (pixels) {
+        stbi_image_free(pixels);
+        pixels = nullptr;
+    }
+}
+
 void Texture::initializeGL() {
     if (initialized) return;
 
@@ -60,7 +87,7 @@ void Texture::initializeGL() {
     }
     
     
-    glBindTexture(GL_TEXTURE_2D, ID);
+    getGLState().bindTexture(unit, GL_TEXTURE_2D, ID);
     checkGLError("binding texture");
 
     // Set texture parameters
@@ -70,17 +97,16 @@ void Texture::initializeGL() {
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
     checkGLError("setting texture parameters");
 
-    // Load image
-    int width, height, nrChannels;
-    unsigned char* data = stbi_load(filePath.c_str(), &width, &height, &nrChannels, 0);
+    // Load image, unless a loader already decoded it
+    decode();
     
-    if (data) {
+    if (pixels) {
         
         // Determine format
         GLenum format = GL_RGB;
         GLenum internalFormat = GL_RGB8;
         
-        switch (nrChannels) {
+        switch (channels) {
             case 1:
                 format = GL_RED;
                 internalFormat = GL_R8;
@@ -94,13 +120,13 @@ void Texture::initializeGL() {
                 internalFormat = GL_RGBA8;
                 break;
             default:
-                std::cerr << "Unsupported number of channels: " << nrChannels << std::endl;
-                stbi_image_free(data);
+                std::cerr << "Unsupported number of channels: " << channels << std::endl;
+                releasePixels();
                 return;
         }
         
         // Upload texture data
-        glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, GL_UNSIGNED_BYTE, data);
+        glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, GL_UNSIGNED_BYTE, pixels);
         checkGLError("uploading texture data");
         glGenerateMipmap(GL_TEXTURE_2D);
         checkGLError("generating mipmaps");
@@ -115,12 +141,10 @@ void Texture::initializeGL() {
         }
     } else {
         std::cerr << "Failed to load texture data from: " << filePath << std::endl;
-        std::cerr << "STB Error: " << stbi_failure_reason() << std::endl;
+        std::cerr << "STB Error: " << (decodeError ? decodeError : "unknown") << std::endl;
     }
     
-    stbi_image_free(data);
-    glBindTexture(GL_TEXTURE_2D, 0);
-    checkGLError("unbinding texture");
+    releasePixels();
     initialized = true;
 }
 
@@ -157,18 +181,17 @@ void Texture::bind() {
         std::cerr << "Warning: Attempting to bind invalid texture (ID: " << ID << ", loaded: " << loaded << ")" << std::endl;
         return;
     }
-    glActiveTexture(GL_TEXTURE0 + unit);
-    glBindTexture(GL_TEXTURE_2D, ID);
-    checkGLError("binding texture");
+    getGLState().bindTexture(unit, GL_TEXTURE_2D, ID);
 }
 
 void Texture::unbind() {
-    glBindTexture(GL_TEXTURE_2D, 0);
-    checkGLError("unbinding texture");
+    getGLState().bindTexture(unit, GL_TEXTURE_2D, 0);
 }
 
 Texture::~Texture() {
     if (ID != 0) {
+        getGLState().textureDeleted(ID);
         glDeleteTextures(1, &ID);
     }
+    releasePixels();
 }
\ No newline at end of file
@@ -38,6 +38,9 @@ public:
     Texture(const Texture&) = delete;
     Texture& operator=(const Texture&) = delete;
 
+    // Reads and decodes the image into memory without touching GL, so loaders can run it
+    // on job system workers; loadTexture() decodes by itself when this wasn't called
+    void decode();
     // Load the texture (called when OpenGL context is ready)
     void loadTexture();
     
@@ -50,7 +53,15 @@ public:
 
 private:
     bool initialized; // Track if OpenGL object has been created
+    // Decoded image waiting for upload, freed once uploaded
+    unsigned char* pixels;
+    int width;
+    int height;
+    int channels;
+    // stb's reason is per thread, so a failed decode on a worker keeps its own
+    const char* decodeError;
     void initializeGL(); // Create the actual OpenGL texture object
+    void releasePixels();
 };
 
 #endif
\ No newline at end of file
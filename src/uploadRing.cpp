@@ -0,0 +1,240 @@
+#include "uploadRing.h"
+#include "glExtensions.h"
+#include "glState.h"
+#include "error.h"
+#include "log.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+namespace {
+
+// Frame regions start on this boundary so any allocation alignment up to it holds
+const GLsizeiptr REGION_ALIGNMENT = 256;
+
+GLsizeiptr alignUp(GLsizeiptr value, GLsizeiptr alignment) {
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+} // namespace
+
+DynamicUploadRing::DynamicUploadRing(GLsizeiptr frameCapacity)
+    : buffer(0), frameCapacity(alignUp(frameCapacity, REGION_ALIGNMENT)), requestedCapacity(0),
+      mode(Mode::Unsynchronized), initialized(false), inFrame(false), frameIndex(FRAME_COUNT - 1),
+      fences{}, frameStart(0), head(0), flushedUpTo(0), uniformAlignment(REGION_ALIGNMENT), mapped(nullptr) {
+}
+
+DynamicUploadRing::~DynamicUploadRing() {
+    if (!initialized) return;
+    for (GLsync& fence : fences) {
+        if (fence) {
+            glDeleteSync(fence);
+            fence = nullptr;
+        }
+    }
+    for (auto& view : textureViews) {
+        getGLState().textureDeleted(view.second);
+        glDeleteTextures(1, &view.second);
+    }
+    destroyBuffer();
+}
+
+void DynamicUploadRing::initializeGL() {
+    if (initialized) return;
+
+    const char* requested = std::getenv("RAYTRACER_UPLOAD_RING");
+    bool forceFallback = requested && std::string(requested) == "unsynchronized";
+    mode = getGLExtensions().bufferStorage && !forceFallback ? Mode::Persistent : Mode::Unsynchronized;
+
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &uniformAlignment);
+    if (uniformAlignment <= 0 || uniformAlignment > REGION_ALIGNMENT) {
+        LOG_WARN(Render, "Uniform buffer offset alignment %d exceeds the upload ring's %d-byte regions",
+                 uniformAlignment, static_cast<int>(REGION_ALIGNMENT));
+        uniformAlignment = REGION_ALIGNMENT;
+    }
+
+    createBuffer();
+    initialized = true;
+}
+
+void DynamicUploadRing::createBuffer() {
+    const GLsizeiptr total = frameCapacity * FRAME_COUNT;
+    glGenBuffers(1, &buffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+
+    if (mode == Mode::Persistent) {
+        const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(GL_COPY_WRITE_BUFFER, total, nullptr, flags);
+        mapped = static_cast<unsigned char*>(glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, total, flags));
+        if (!mapped) {
+            // Immutable storage can't be respecified, so start over with a fresh name
+            LOG_WARN(Render, "Persistent mapping failed; upload ring falls back to unsynchronized maps");
+            glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+            glDeleteBuffers(1, &buffer);
+            glGenBuffers(1, &buffer);
+            glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+            mode = Mode::Unsynchronized;
+        }
+    }
+    if (mode == Mode::Unsynchronized) {
+        glBufferData(GL_COPY_WRITE_BUFFER, total, nullptr, GL_STREAM_DRAW);
+        staging.resize(static_cast<size_t>(frameCapacity));
+    }
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    GLint maxTexels = 0;
+    glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &maxTexels);
+    if (static_cast<GLsizeiptr>(maxTexels) < total / 4) {
+        LOG_WARN(Render, "Upload ring of %lld bytes exceeds GL_MAX_TEXTURE_BUFFER_SIZE (%d texels) for 32-bit views",
+                 static_cast<long long>(total), maxTexels);
+    }
+
+    // Views created before a resize keep their names and follow the new storage
+    for (auto& view : textureViews) {
+        getGLState().bindTexture(0, GL_TEXTURE_BUFFER, view.second);
+        glTexBuffer(GL_TEXTURE_BUFFER, view.first, buffer);
+    }
+
+    checkGLError("create upload ring");
+    LOG_INFO(Render, "Upload ring: %u x %lld KB, %s", FRAME_COUNT, static_cast<long long>(frameCapacity / 1024),
+             mode == Mode::Persistent ? "persistently mapped" : "unsynchronized maps");
+}
+
+void DynamicUploadRing::destroyBuffer() {
+    if (buffer == 0) return;
+    if (mapped) {
+        glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+        glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        mapped = nullptr;
+    }
+    glDeleteBuffers(1, &buffer);
+    buffer = 0;
+}
+
+void DynamicUploadRing::waitForFence(unsigned int index) {
+    GLsync& fence = fences[index];
+    if (!fence) return;
+
+    GLenum result = glClientWaitSync(fence, 0, 0);
+    if (result == GL_TIMEOUT_EXPIRED) {
+        // The GPU is still FRAME_COUNT frames behind; block until it catches up
+        auto start = std::chrono::steady_clock::now();
+        do {
+            result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000ull);
+        } while (result == GL_TIMEOUT_EXPIRED);
+        stats.fenceWaits++;
+        stats.fenceWaitMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+    if (result == GL_WAIT_FAILED) {
+        LOG_ERROR(Render, "Upload ring fence wait failed");
+    }
+    glDeleteSync(fence);
+    fence = nullptr;
+}
+
+void DynamicUploadRing::beginFrame() {
+    initializeGL();
+    if (inFrame) return;
+
+    if (requestedCapacity > frameCapacity) {
+        // Every region may still be read, so drain them all before replacing the storage
+        for (unsigned int i = 0; i < FRAME_COUNT; ++i) {
+            waitForFence(i);
+        }
+        destroyBuffer();
+        frameCapacity = requestedCapacity;
+        createBuffer();
+    }
+
+    frameIndex = (frameIndex + 1) % FRAME_COUNT;
+    waitForFence(frameIndex);
+    frameStart = static_cast<GLintptr>(frameIndex) * frameCapacity;
+    head = frameStart;
+    flushedUpTo = frameStart;
+    stats.frameBytes = 0;
+    inFrame = true;
+}
+
+UploadAllocation DynamicUploadRing::allocate(GLsizeiptr size, GLsizeiptr alignment) {
+    if (!inFrame) {
+        beginFrame();
+    }
+
+    UploadAllocation allocation;
+    GLintptr offset = alignUp(head, alignment);
+    if (offset + size > frameStart + frameCapacity) {
+        GLsizeiptr needed = (offset - frameStart) + size;
+        GLsizeiptr grown = std::max(requestedCapacity, frameCapacity);
+        while (grown < needed) {
+            grown *= 2;
+        }
+        if (grown > requestedCapacity) {
+            LOG_WARN(Render, "Upload ring frame region full (%lld of %lld bytes); growing to %lld next frame",
+                     static_cast<long long>(needed), static_cast<long long>(frameCapacity), static_cast<long long>(grown));
+            requestedCapacity = grown;
+        }
+        stats.overflows++;
+        return allocation;
+    }
+
+    head = offset + size;
+    allocation.offset = offset;
+    allocation.size = size;
+    allocation.data = mode == Mode::Persistent ? mapped + offset : staging.data() + (offset - frameStart);
+    stats.frameBytes = static_cast<size_t>(head - frameStart);
+    return allocation;
+}
+
+UploadAllocation DynamicUploadRing::allocateUniform(GLsizeiptr size) {
+    return allocate(size, uniformAlignment);
+}
+
+void DynamicUploadRing::flush() {
+    if (head <= flushedUpTo) return;
+
+    if (mode == Mode::Unsynchronized) {
+        // The fence already guarantees the GPU is done with this range
+        GLsizeiptr length = head - flushedUpTo;
+        const unsigned char* source = staging.data() + (flushedUpTo - frameStart);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+        void* target = glMapBufferRange(GL_COPY_WRITE_BUFFER, flushedUpTo, length,
+                                        GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT);
+        if (target) {
+            std::memcpy(target, source, static_cast<size_t>(length));
+            glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+        } else {
+            glBufferSubData(GL_COPY_WRITE_BUFFER, flushedUpTo, length, source);
+        }
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    }
+    // Coherent persistent mappings need nothing beyond the writes themselves
+    flushedUpTo = head;
+}
+
+void DynamicUploadRing::endFrame() {
+    if (!inFrame) return;
+    flush();
+    fences[frameIndex] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    stats.peakFrameBytes = std::max(stats.peakFrameBytes, stats.frameBytes);
+    inFrame = false;
+}
+
+GLuint DynamicUploadRing::getTextureView(GLenum internalFormat) {
+    initializeGL();
+    for (const auto& view : textureViews) {
+        if (view.first == internalFormat) {
+            return view.second;
+        }
+    }
+
+    GLuint texture = 0;
+    glGenTextures(1, &texture);
+    getGLState().bindTexture(0, GL_TEXTURE_BUFFER, texture);
+    glTexBuffer(GL_TEXTURE_BUFFER, internalFormat, buffer);
+    textureViews.emplace_back(internalFormat, texture);
+    checkGLError("create upload ring texture view");
+    return texture;
+}
@@ -0,0 +1,98 @@
+#ifndef UPLOAD_RING_H
+#define UPLOAD_RING_H
+
+#include <glad/glad.h>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+// A suballocation from the current frame's region. data may be written until the next
+// flush(); offset is in bytes from the start of the ring buffer.
+struct UploadAllocation {
+    unsigned char* data = nullptr;
+    GLintptr offset = 0;
+    GLsizeiptr size = 0;
+
+    bool valid() const { return data != nullptr; }
+};
+
+struct UploadRingStats {
+    size_t frameBytes = 0;
+    size_t peakFrameBytes = 0;
+    int fenceWaits = 0;
+    double fenceWaitMs = 0.0;
+    int overflows = 0;
+};
+
+// One GL buffer split into FRAME_COUNT regions, used round-robin for data written every
+// frame (view block, visible instance lists, clustered lights). A fence placed at the end
+// of each frame is waited on before its region is written again, so no upload waits on
+// draws still in flight. With ARB_buffer_storage the buffer is mapped once, persistent and
+// coherent, and allocations are written in place; otherwise they are staged and copied
+// with an unsynchronized map in flush(). RAYTRACER_UPLOAD_RING=unsynchronized forces the
+// fallback.
+//
+// Texture buffers cannot be bound at an offset in GL 3.3, so texture views cover the whole
+// ring and shaders add the allocation's texel offset (offset / texel size) to their fetches.
+class DynamicUploadRing {
+public:
+    enum class Mode {
+        Persistent,
+        Unsynchronized
+    };
+
+    static const unsigned int FRAME_COUNT = 3;
+    static const GLsizeiptr DEFAULT_FRAME_CAPACITY = 4 * 1024 * 1024;
+
+    explicit DynamicUploadRing(GLsizeiptr frameCapacity = DEFAULT_FRAME_CAPACITY);
+    ~DynamicUploadRing();
+
+    DynamicUploadRing(const DynamicUploadRing&) = delete;
+    DynamicUploadRing& operator=(const DynamicUploadRing&) = delete;
+
+    // Moves to the next region, waiting for the GPU to finish the frame that last used it
+    void beginFrame();
+    // Returns an invalid allocation when the frame region is full; the ring grows at the
+    // next beginFrame(). alignment must be a power of two.
+    UploadAllocation allocate(GLsizeiptr size, GLsizeiptr alignment = 16);
+    // Aligned for glBindBufferRange(GL_UNIFORM_BUFFER, ...)
+    UploadAllocation allocateUniform(GLsizeiptr size);
+    // Makes everything allocated so far visible to the GPU; call before drawing with it
+    void flush();
+    // Flushes and fences the frame's region
+    void endFrame();
+
+    GLuint getBuffer() const { return buffer; }
+    // Texture buffer over the whole ring with the given format, created on first request
+    GLuint getTextureView(GLenum internalFormat);
+    Mode getMode() const { return mode; }
+    const UploadRingStats& getStats() const { return stats; }
+
+private:
+    GLuint buffer;
+    GLsizeiptr frameCapacity;
+    GLsizeiptr requestedCapacity;
+    Mode mode;
+    bool initialized;
+    bool inFrame;
+    unsigned int frameIndex;
+    GLsync fences[FRAME_COUNT];
+    GLintptr frameStart;
+    GLintptr head;
+    GLintptr flushedUpTo;
+    GLint uniformAlignment;
+
+    // Persistent mode writes through the mapping, the fallback into staging
+    unsigned char* mapped;
+    std::vector<unsigned char> staging;
+    std::vector<std::pair<GLenum, GLuint>> textureViews;
+
+    UploadRingStats stats;
+
+    void initializeGL();
+    void createBuffer();
+    void destroyBuffer();
+    void waitForFence(unsigned int index);
+};
+
+#endif // UPLOAD_RING_H